@@ -0,0 +1,193 @@
+#include <benchmark/benchmark.h>
+
+#include "fixed_matrix/fixed_matrix.hpp"
+#include "fixed_matrix/fixed_matrix_kernels.hpp"
+#include "fixed_matrix/fixed_matrix_batch.hpp"
+
+#include <array>
+#include <vector>
+
+// Operations on a batch of small matrices, so that a single iteration is long
+// enough to be measured.
+constexpr std::size_t batch_size = 1024;
+
+template<class T, std::size_t N>
+static std::vector<fixed_matrix<T, N, N>> make_batch()
+{
+	std::vector<fixed_matrix<T, N, N>> batch;
+	batch.reserve(batch_size);
+	for (std::size_t index = 0; index < batch_size; ++index) {
+		fixed_matrix<T, N, N> m(T{ 1 });
+		for (std::size_t i = 0; i < N; ++i) {
+			m[i][i] = static_cast<T>(N + index % 7);
+		}
+		batch.push_back(m);
+	}
+	return batch;
+}
+
+template<class T, std::size_t N>
+static void FixedMultiply(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	const auto b = make_batch<T, N>();
+	auto c = make_batch<T, N>();
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			c[index] = a[index] * b[index];
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void NaiveFixedMultiply(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	const auto b = make_batch<T, N>();
+	auto c = make_batch<T, N>();
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			for (std::size_t i = 0; i < N; ++i) {
+				for (std::size_t j = 0; j < N; ++j) {
+					T sum{};
+					for (std::size_t k = 0; k < N; ++k) {
+						sum += a[index](i, k) * b[index](k, j);
+					}
+					c[index](i, j) = sum;
+				}
+			}
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void FixedTransformVector(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	std::vector<std::array<T, N>> points(batch_size);
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			points[index] = a[index] * points[index];
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void FixedTranspose(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	auto t = make_batch<T, N>();
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			t[index] = transpose(a[index]);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void FixedInverse(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	auto inv = make_batch<T, N>();
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			inv[index] = inverse(a[index]);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+// The same operations on fixed_matrix_batch, one thread.
+template<class T, std::size_t N>
+static void BatchMultiply(benchmark::State& state)
+{
+	const auto matrices = make_batch<T, N>();
+	const fixed_matrix_batch<T, N, N> a(matrices.cbegin(), matrices.cend());
+	const fixed_matrix_batch<T, N, N> b(matrices.cbegin(), matrices.cend());
+	fixed_matrix_batch<T, N, N> c;
+	for (auto _ : state) {
+		multiply(matrix_execution::seq, a, b, c);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void BatchTransformVector(benchmark::State& state)
+{
+	const auto matrices = make_batch<T, N>();
+	const fixed_matrix_batch<T, N, N> a(matrices.cbegin(), matrices.cend());
+	fixed_vector_batch<T, N> points(batch_size);
+	for (auto _ : state) {
+		multiply(matrix_execution::seq, a, points, points);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+template<class T, std::size_t N>
+static void BatchInverse(benchmark::State& state)
+{
+	const auto matrices = make_batch<T, N>();
+	const fixed_matrix_batch<T, N, N> a(matrices.cbegin(), matrices.cend());
+	fixed_matrix_batch<T, N, N> inv;
+	for (auto _ : state) {
+		inverse(matrix_execution::seq, a, inv);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+// Gauss-Jordan elimination, the usual general-purpose inverse.
+template<class T, std::size_t N>
+static void NaiveFixedInverse(benchmark::State& state)
+{
+	const auto a = make_batch<T, N>();
+	auto inv = make_batch<T, N>();
+	for (auto _ : state) {
+		for (std::size_t index = 0; index < batch_size; ++index) {
+			inv[index] = matrix_detail::inverse_elimination(a[index]);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+BENCHMARK_TEMPLATE(FixedMultiply, float, 4);
+BENCHMARK_TEMPLATE(FixedMultiply, double, 4);
+BENCHMARK_TEMPLATE(FixedMultiply, double, 3);
+BENCHMARK_TEMPLATE(FixedMultiply, double, 8);
+BENCHMARK_TEMPLATE(NaiveFixedMultiply, float, 4);
+BENCHMARK_TEMPLATE(NaiveFixedMultiply, double, 4);
+BENCHMARK_TEMPLATE(NaiveFixedMultiply, double, 3);
+BENCHMARK_TEMPLATE(NaiveFixedMultiply, double, 8);
+
+BENCHMARK_TEMPLATE(FixedTransformVector, float, 4);
+BENCHMARK_TEMPLATE(FixedTransformVector, double, 4);
+BENCHMARK_TEMPLATE(FixedTranspose, float, 4);
+BENCHMARK_TEMPLATE(FixedTranspose, double, 4);
+
+BENCHMARK_TEMPLATE(FixedInverse, float, 4);
+BENCHMARK_TEMPLATE(FixedInverse, double, 4);
+BENCHMARK_TEMPLATE(FixedInverse, double, 3);
+BENCHMARK_TEMPLATE(NaiveFixedInverse, float, 4);
+BENCHMARK_TEMPLATE(NaiveFixedInverse, double, 4);
+BENCHMARK_TEMPLATE(NaiveFixedInverse, double, 3);
+
+BENCHMARK_TEMPLATE(BatchMultiply, float, 4);
+BENCHMARK_TEMPLATE(BatchMultiply, double, 4);
+BENCHMARK_TEMPLATE(BatchMultiply, double, 3);
+BENCHMARK_TEMPLATE(BatchTransformVector, float, 4);
+BENCHMARK_TEMPLATE(BatchTransformVector, double, 4);
+BENCHMARK_TEMPLATE(BatchInverse, float, 4);
+BENCHMARK_TEMPLATE(BatchInverse, double, 4);
+BENCHMARK_TEMPLATE(BatchInverse, double, 3);
@@ -0,0 +1,537 @@
+#include <benchmark/benchmark.h>
+
+#include "naive.hpp"
+#include "matrix/matrix.hpp"
+#include "matrix/shared_matrix.hpp"
+#include "matrix_ops/multiply.hpp"
+#include "matrix_ops/factorization.hpp"
+#include "matrix_ops/quantized.hpp"
+#include "matrix_ops/reductions.hpp"
+#include "matrix_ops/strassen.hpp"
+#include "matrix_io/tiled_matrix.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+// Square matrices of n x n elements, n = state.range(0).
+
+template<class M>
+static void Construct(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	for (auto _ : state) {
+		M m(n, n, T{ 1 });
+		benchmark::DoNotOptimize(m[0][0]);
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class M>
+static void Fill(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		m.fill(T{ 2 });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class T>
+static void NaiveFill(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	naive_matrix<T> m(n, n, T{ 1 });
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j < n; ++j) {
+				m(i, j) = T{ 2 };
+			}
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// Sum of all elements through MatrixIterator.
+template<class M>
+static void Iterate(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(std::accumulate(m.begin(), m.end(), T{}));
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// std::fill through MatrixIterator against the per-row loops of matrix_segmented::fill.
+template<class M>
+static void IteratorFill(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		std::fill(m.begin(), m.end(), T{ 2 });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class M>
+static void SegmentedFill(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		matrix_segmented::fill(m.begin(), m.end(), T{ 2 });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class T>
+static void NaiveIterate(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const naive_matrix<T> m(n, n, T{ 1 });
+	for (auto _ : state) {
+		T sum{};
+		for (const auto& row : m) {
+			for (const T& value : row) {
+				sum += value;
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// Sum of all elements with the vectorized reductions, to compare with Iterate.
+template<class M>
+static void Sum(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(sum(m));
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class M>
+static void KahanSum(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(sum(m, summation::kahan));
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class M>
+static void ColSums(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(col_sums(m).data());
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// Column sums down the columns.
+template<class T>
+static void NaiveColSums(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const naive_matrix<T> m(n, n, T{ 1 });
+	for (auto _ : state) {
+		std::vector<T> sums(n);
+		for (std::size_t column = 0; column < n; ++column) {
+			for (std::size_t row = 0; row < n; ++row) {
+				sums[column] += m[row][column];
+			}
+		}
+		benchmark::DoNotOptimize(sums.data());
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// Sum of all elements through the bounds-checked operator().
+template<class M>
+static void ElementAccess(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		T sum{};
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j < n; ++j) {
+				sum += m(i, j);
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class M>
+static void Copy(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m(n, n, T{ 1 });
+	for (auto _ : state) {
+		M copy = m;
+		benchmark::DoNotOptimize(copy[0][0]);
+	}
+	state.SetBytesProcessed(state.iterations() * n * n * sizeof(T));
+}
+
+// A version with one changed row, to compare with Copy of the whole matrix.
+static void PublishRow(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	shared_matrix<double> m(n, n, 1.0);
+	std::size_t row = 0;
+	for (auto _ : state) {
+		m.set(row, 0, 2.0);
+		benchmark::DoNotOptimize(m.publish());
+		row = (row + 1) % n;
+	}
+	// One changed row of n elements per publish.
+	state.SetItemsProcessed(state.iterations() * n);
+}
+
+template<class M>
+static void FusedExpression(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M a(n, n, T{ 1 });
+	const M b(n, n, T{ 2 });
+	M c(n, n, T{});
+	for (auto _ : state) {
+		c = a + b * T{ 2 } - a;
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+template<class T>
+static void NaiveExpression(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const naive_matrix<T> a(n, n, T{ 1 });
+	const naive_matrix<T> b(n, n, T{ 2 });
+	naive_matrix<T> c(n, n, T{});
+	for (auto _ : state) {
+		// What operator-by-operator evaluation with temporaries costs.
+		naive_matrix<T> scaled(n, n);
+		naive_matrix<T> sum(n, n);
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j < n; ++j) scaled(i, j) = b(i, j) * T{ 2 };
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j < n; ++j) sum(i, j) = a(i, j) + scaled(i, j);
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j < n; ++j) c(i, j) = sum(i, j) - a(i, j);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+static void set_flops(benchmark::State& state, const std::size_t n)
+{
+	state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+template<class M, class ExecutionPolicy>
+static void Multiply(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M a(n, n, T{ 1 });
+	const M b(n, n, T{ 2 });
+	M c(n, n, T{});
+	for (auto _ : state) {
+		multiply(ExecutionPolicy{}, a, b, c);
+		benchmark::ClobberMemory();
+	}
+	set_flops(state, n);
+}
+
+template<class T>
+static void NaiveMultiply(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const naive_matrix<T> a(n, n, T{ 1 });
+	const naive_matrix<T> b(n, n, T{ 2 });
+	naive_matrix<T> c(n, n, T{});
+	for (auto _ : state) {
+		naive_multiply(a, b, c);
+		benchmark::ClobberMemory();
+	}
+	set_flops(state, n);
+}
+
+// FLOPS counts the 2 n^3 operations of the classic product, to compare with Multiply.
+template<class M, class ExecutionPolicy>
+static void Strassen(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M a(n, n, T{ 1 });
+	const M b(n, n, T{ 2 });
+	M c(n, n, T{});
+	strassen_workspace<T> workspace;
+	workspace.reserve(n, n, n, matrix_execution::thread_count(ExecutionPolicy{}));
+	for (auto _ : state) {
+		multiply_strassen(ExecutionPolicy{}, a, b, c, workspace);
+		benchmark::ClobberMemory();
+	}
+	set_flops(state, n);
+}
+
+// Quantized a * transpose(b), to compare with Multiply of matrix<float>.
+template<class Q>
+static void QuantizedMultiply(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const auto a = quantize<Q>(matrix<float>(n, n, 1.0f));
+	const auto b = quantize<Q>(matrix<float>(n, n, 2.0f));
+	matrix<float> c(n, n);
+	for (auto _ : state) {
+		multiply_transposed(matrix_execution::seq, a, b, c);
+		benchmark::ClobberMemory();
+	}
+	set_flops(state, n);
+}
+
+// 16-bit operands and a float result, converted while packing.
+template<class H>
+static void HalfMultiply(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const matrix<H> a(n, n, H(1.0f));
+	const matrix<H> b(n, n, H(2.0f));
+	matrix<float> c(n, n);
+	for (auto _ : state) {
+		multiply(matrix_execution::seq, a, b, c);
+		benchmark::ClobberMemory();
+	}
+	set_flops(state, n);
+}
+
+// Out-of-core multiply with a cache of a quarter of the tiles of each operand,
+// to compare with Multiply of matrix<double>.
+static void TiledMultiply(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const tiled_matrix_options options{ 256, std::max<std::size_t>(4, n * n / (256 * 256) / 4), 2 };
+	{
+		tiled_matrix<double> a("tiled_multiply_a.tiles", n, n, options);
+		tiled_matrix<double> b("tiled_multiply_b.tiles", n, n, options);
+		tiled_matrix<double> c("tiled_multiply_c.tiles", n, n, options);
+		a.set_block(0, 0, matrix<double>(n, n, 1.0));
+		b.set_block(0, 0, matrix<double>(n, n, 2.0));
+		for (auto _ : state) {
+			multiply(matrix_execution::seq, a, b, c);
+		}
+	}
+	set_flops(state, n);
+	std::remove("tiled_multiply_a.tiles");
+	std::remove("tiled_multiply_b.tiles");
+	std::remove("tiled_multiply_c.tiles");
+}
+
+// Transposition moves as many bytes as a copy, Copy is the bound to compare with.
+template<class M>
+static void Transpose(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	M m(n, n + 1);
+	std::iota(std::begin(m), std::end(m), T{});
+	for (auto _ : state) {
+		M t = transpose(m);
+		benchmark::DoNotOptimize(t[0][0]);
+	}
+	state.SetBytesProcessed(state.iterations() * n * (n + 1) * sizeof(T));
+}
+
+template<class M>
+static void TransposeInplace(benchmark::State& state)
+{
+	using T = typename M::value_type;
+	const auto n = static_cast<std::size_t>(state.range(0));
+	M m(n, n);
+	std::iota(std::begin(m), std::end(m), T{});
+	for (auto _ : state) {
+		m.transpose_inplace();
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * n * n * sizeof(T));
+}
+
+template<class T>
+static void NaiveTranspose(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const naive_matrix<T> m(n, n + 1, T{ 1 });
+	for (auto _ : state) {
+		naive_matrix<T> t(n + 1, n);
+		for (std::size_t i = 0; i < n; ++i) {
+			for (std::size_t j = 0; j <= n; ++j) {
+				t[j][i] = m[i][j];
+			}
+		}
+		benchmark::DoNotOptimize(t[0][0]);
+	}
+	state.SetBytesProcessed(state.iterations() * n * (n + 1) * sizeof(T));
+}
+
+// Diagonally dominant, so that every factorization succeeds.
+template<class M>
+static M dominant_matrix(const std::size_t n)
+{
+	using T = typename M::value_type;
+	M m(n, n);
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t j = 0; j < n; ++j) m[i][j] = static_cast<T>((i * 7 + j * 13) % 17) / T(17);
+		m[i][i] += static_cast<T>(n);
+	}
+	return m;
+}
+
+template<class M, class ExecutionPolicy>
+static void LU(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m = dominant_matrix<M>(n);
+	for (auto _ : state) {
+		auto f = lu(ExecutionPolicy{}, m);
+		benchmark::DoNotOptimize(f.factors[0][0]);
+	}
+	state.counters["FLOPS"] = benchmark::Counter(2.0 / 3.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+template<class M, class ExecutionPolicy>
+static void Cholesky(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const M m = dominant_matrix<M>(n) + transpose(dominant_matrix<M>(n));
+	for (auto _ : state) {
+		M c = cholesky(ExecutionPolicy{}, m);
+		benchmark::DoNotOptimize(c[0][0]);
+	}
+	state.counters["FLOPS"] = benchmark::Counter(1.0 / 3.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Unblocked Gaussian elimination with partial pivoting.
+template<class T>
+static void NaiveLU(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const auto source = dominant_matrix<matrix<T>>(n);
+	naive_matrix<T> m(n, n);
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < n; ++i) std::copy_n(source[i], n, m[i].begin());
+		for (std::size_t k = 0; k < n; ++k) {
+			std::size_t pivot = k;
+			for (std::size_t i = k + 1; i < n; ++i) {
+				if (std::abs(m[i][k]) > std::abs(m[pivot][k])) pivot = i;
+			}
+			std::swap(m[k], m[pivot]);
+			for (std::size_t i = k + 1; i < n; ++i) {
+				const T l = m[i][k] / m[k][k];
+				m[i][k] = l;
+				for (std::size_t j = k + 1; j < n; ++j) m[i][j] -= l * m[k][j];
+			}
+		}
+		benchmark::DoNotOptimize(m[0][0]);
+	}
+	state.counters["FLOPS"] = benchmark::Counter(2.0 / 3.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+using matrix_execution::sequenced_policy;
+using matrix_execution::parallel_policy;
+
+#define MATRIX_CONTAINER_BENCHMARKS(T)                                                          \
+	BENCHMARK_TEMPLATE(Construct, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);              \
+	BENCHMARK_TEMPLATE(Construct, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);   \
+	BENCHMARK_TEMPLATE(Construct, naive_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);        \
+	BENCHMARK_TEMPLATE(Fill, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);                   \
+	BENCHMARK_TEMPLATE(Fill, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);        \
+	BENCHMARK_TEMPLATE(NaiveFill, T)->RangeMultiplier(4)->Range(16, 1024);                      \
+	BENCHMARK_TEMPLATE(Iterate, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);                \
+	BENCHMARK_TEMPLATE(Iterate, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);     \
+	BENCHMARK_TEMPLATE(NaiveIterate, T)->RangeMultiplier(4)->Range(16, 1024);                   \
+	BENCHMARK_TEMPLATE(Sum, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);                    \
+	BENCHMARK_TEMPLATE(ColSums, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);                \
+	BENCHMARK_TEMPLATE(NaiveColSums, T)->RangeMultiplier(4)->Range(16, 1024);                   \
+	BENCHMARK_TEMPLATE(IteratorFill, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);           \
+	BENCHMARK_TEMPLATE(SegmentedFill, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);          \
+	BENCHMARK_TEMPLATE(ElementAccess, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);          \
+	BENCHMARK_TEMPLATE(ElementAccess, naive_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);    \
+	BENCHMARK_TEMPLATE(Copy, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);                   \
+	BENCHMARK_TEMPLATE(Copy, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);        \
+	BENCHMARK_TEMPLATE(Copy, naive_matrix<T>)->RangeMultiplier(4)->Range(16, 1024);             \
+	BENCHMARK_TEMPLATE(FusedExpression, matrix<T>)->RangeMultiplier(4)->Range(16, 1024);        \
+	BENCHMARK_TEMPLATE(NaiveExpression, T)->RangeMultiplier(4)->Range(16, 1024);                \
+	BENCHMARK_TEMPLATE(Transpose, matrix<T>)->RangeMultiplier(4)->Range(16, 4096);              \
+	BENCHMARK_TEMPLATE(Transpose, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 4096);   \
+	BENCHMARK_TEMPLATE(TransposeInplace, contiguous_matrix<T>)->RangeMultiplier(4)->Range(16, 4096); \
+	BENCHMARK_TEMPLATE(NaiveTranspose, T)->RangeMultiplier(4)->Range(16, 4096)
+
+#define MATRIX_MULTIPLY_BENCHMARKS(T)                                                                          \
+	BENCHMARK_TEMPLATE(Multiply, matrix<T>, sequenced_policy)->RangeMultiplier(2)->Range(16, 1024);            \
+	BENCHMARK_TEMPLATE(Multiply, contiguous_matrix<T>, sequenced_policy)->RangeMultiplier(2)->Range(16, 1024); \
+	BENCHMARK_TEMPLATE(Multiply, matrix<T>, parallel_policy)->RangeMultiplier(2)->Range(64, 1024)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(NaiveMultiply, T)->RangeMultiplier(2)->Range(16, 512)
+
+MATRIX_CONTAINER_BENCHMARKS(double);
+MATRIX_CONTAINER_BENCHMARKS(float);
+MATRIX_CONTAINER_BENCHMARKS(int);
+
+BENCHMARK_TEMPLATE(KahanSum, matrix<double>)->RangeMultiplier(4)->Range(16, 1024);
+BENCHMARK_TEMPLATE(KahanSum, matrix<float>)->RangeMultiplier(4)->Range(16, 1024);
+
+#define MATRIX_FACTORIZATION_BENCHMARKS(T)                                                                  \
+	BENCHMARK_TEMPLATE(LU, matrix<T>, sequenced_policy)->RangeMultiplier(2)->Range(64, 2048);                   \
+	BENCHMARK_TEMPLATE(LU, contiguous_matrix<T>, parallel_policy)->RangeMultiplier(2)->Range(64, 2048)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(Cholesky, contiguous_matrix<T>, sequenced_policy)->RangeMultiplier(2)->Range(64, 2048);  \
+	BENCHMARK_TEMPLATE(NaiveLU, T)->RangeMultiplier(2)->Range(64, 1024)
+
+MATRIX_MULTIPLY_BENCHMARKS(double);
+MATRIX_MULTIPLY_BENCHMARKS(float);
+MATRIX_MULTIPLY_BENCHMARKS(int);
+
+BENCHMARK_TEMPLATE(Multiply, matrix<double>, sequenced_policy)->Arg(2048)->Arg(4096);
+BENCHMARK_TEMPLATE(Strassen, matrix<double>, sequenced_policy)->Arg(2048)->Arg(4096);
+BENCHMARK_TEMPLATE(Strassen, matrix<double>, parallel_policy)->Arg(2048)->Arg(4096)->UseRealTime();
+
+BENCHMARK_TEMPLATE(QuantizedMultiply, std::int8_t)->RangeMultiplier(2)->Range(64, 1024);
+BENCHMARK_TEMPLATE(QuantizedMultiply, std::int16_t)->RangeMultiplier(2)->Range(64, 1024);
+BENCHMARK_TEMPLATE(HalfMultiply, float16)->RangeMultiplier(2)->Range(64, 1024);
+BENCHMARK_TEMPLATE(HalfMultiply, bfloat16)->RangeMultiplier(2)->Range(64, 1024);
+BENCHMARK(TiledMultiply)->Arg(1024)->Arg(2048);
+BENCHMARK(PublishRow)->RangeMultiplier(4)->Range(16, 1024);
+
+MATRIX_FACTORIZATION_BENCHMARKS(double);
+MATRIX_FACTORIZATION_BENCHMARKS(float);
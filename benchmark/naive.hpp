@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef MATRIX_BENCHMARK_NAIVE_HPP
+#define MATRIX_BENCHMARK_NAIVE_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Straightforward implementations the library is measured against.
+
+template<class T>
+struct naive_matrix
+{
+	using value_type = T;
+
+	naive_matrix(const std::size_t rows, const std::size_t columns, const T& value = T{})
+		: rows_(rows, std::vector<T>(columns, value))
+	{}
+
+	inline std::size_t count_rows() const noexcept { return rows_.size(); }
+	inline std::size_t count_columns() const noexcept { return rows_.empty() ? 0 : rows_[0].size(); }
+
+	inline T& operator()(const std::size_t row, const std::size_t column) { return rows_[row][column]; }
+	inline const T& operator()(const std::size_t row, const std::size_t column) const { return rows_[row][column]; }
+
+	inline std::vector<T>& operator[](const std::size_t row) { return rows_[row]; }
+	inline const std::vector<T>& operator[](const std::size_t row) const { return rows_[row]; }
+
+	inline auto begin() const noexcept { return rows_.begin(); }
+	inline auto end() const noexcept { return rows_.end(); }
+
+private:
+	std::vector<std::vector<T>> rows_;
+};
+
+// c = a * b with the textbook i-j-k loop.
+template<class MA, class MB, class MC>
+void naive_multiply(const MA& a, const MB& b, MC& c)
+{
+	for (std::size_t i = 0; i < a.count_rows(); ++i) {
+		for (std::size_t j = 0; j < b.count_columns(); ++j) {
+			typename MC::value_type sum{};
+			for (std::size_t k = 0; k < a.count_columns(); ++k) {
+				sum += a[i][k] * b[k][j];
+			}
+			c[i][j] = sum;
+		}
+	}
+}
+
+#endif // !MATRIX_BENCHMARK_NAIVE_HPP
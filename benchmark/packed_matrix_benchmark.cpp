@@ -0,0 +1,149 @@
+#include <benchmark/benchmark.h>
+
+#include "matrix/matrix.hpp"
+#include "matrix_ops/multiply.hpp"
+#include "packed_matrix/packed_matrix.hpp"
+
+#include <numeric>
+#include <vector>
+
+// Products and solves of packed n x n matrices, n = state.range(0). The Naive
+// counterparts work on the dense matrix of the same elements.
+static matrix<double> diagonally_dominant(const std::size_t n)
+{
+	matrix<double> m(n, n, 1.0 / static_cast<double>(n));
+	for (std::size_t i = 0; i < n; ++i) m[i][i] = 2.0;
+	return m;
+}
+
+// y = A x over the dense rows, the bound of a matrix stored in full.
+static void dense_multiply_vector(const matrix<double>& a, const std::vector<double>& x, std::vector<double>& y)
+{
+	for (std::size_t i = 0; i < a.count_rows(); ++i) {
+		const double* row = a[i];
+		double sum = 0.0;
+		for (std::size_t j = 0; j < a.count_columns(); ++j) {
+			sum += row[j] * x[j];
+		}
+		y[i] = sum;
+	}
+}
+
+template<class ExecutionPolicy>
+static void SymmetricMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const symmetric_matrix<double> a(diagonally_dominant(n));
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		multiply_vector(ExecutionPolicy{}, a, x, y);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+static void NaiveSymmetricMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const matrix<double> a = diagonally_dominant(n);
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		dense_multiply_vector(a, x, y);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+// Symmetric times a dense n x n matrix, to compare with Multiply of matrix<double>.
+template<class ExecutionPolicy>
+static void SymmetricMultiply(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const symmetric_matrix<double> a(diagonally_dominant(n));
+	const matrix<double> b(n, n, 1.0);
+	matrix<double> c(n, n);
+	for (auto _ : state) {
+		multiply(ExecutionPolicy{}, a, b, c);
+		benchmark::DoNotOptimize(c[0][0]);
+	}
+	state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Lower triangular solve with state.range(1) right-hand sides.
+template<class ExecutionPolicy>
+static void TriangularSolve(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const auto columns = static_cast<std::size_t>(state.range(1));
+	const lower_triangular_matrix<double> t(diagonally_dominant(n));
+	const matrix<double> b(n, columns, 1.0);
+	for (auto _ : state) {
+		matrix<double> x = solve(ExecutionPolicy{}, t, b);
+		benchmark::DoNotOptimize(x[0][0]);
+	}
+	state.SetItemsProcessed(state.iterations() * n * n / 2 * columns);
+}
+
+static void NaiveTriangularSolve(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const auto columns = static_cast<std::size_t>(state.range(1));
+	const matrix<double> t = diagonally_dominant(n);
+	const matrix<double> b(n, columns, 1.0);
+	for (auto _ : state) {
+		matrix<double> x = b;
+		for (std::size_t column = 0; column < columns; ++column) {
+			for (std::size_t i = 0; i < n; ++i) {
+				double sum = x[i][column];
+				for (std::size_t p = 0; p < i; ++p) sum -= t[i][p] * x[p][column];
+				x[i][column] = sum / t[i][i];
+			}
+		}
+		benchmark::DoNotOptimize(x[0][0]);
+	}
+	state.SetItemsProcessed(state.iterations() * n * n / 2 * columns);
+}
+
+// Band of 8 diagonals on each side of the main one.
+template<class ExecutionPolicy>
+static void BandedMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const banded_matrix<double> a(diagonally_dominant(n), 8, 8);
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		multiply_vector(ExecutionPolicy{}, a, x, y);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * a.row_width());
+}
+
+static void NaiveBandedMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const matrix<double> a = banded_matrix<double>(diagonally_dominant(n), 8, 8).to_dense();
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		dense_multiply_vector(a, x, y);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * n * 17);
+}
+
+using matrix_execution::sequenced_policy;
+using matrix_execution::parallel_policy;
+
+BENCHMARK_TEMPLATE(SymmetricMultiplyVector, sequenced_policy)->RangeMultiplier(4)->Range(256, 4096);
+BENCHMARK_TEMPLATE(SymmetricMultiplyVector, parallel_policy)->RangeMultiplier(4)->Range(1024, 4096)->UseRealTime();
+BENCHMARK(NaiveSymmetricMultiplyVector)->RangeMultiplier(4)->Range(256, 4096);
+BENCHMARK_TEMPLATE(SymmetricMultiply, sequenced_policy)->Arg(512)->Arg(1024);
+BENCHMARK_TEMPLATE(SymmetricMultiply, parallel_policy)->Arg(1024)->UseRealTime();
+BENCHMARK_TEMPLATE(TriangularSolve, sequenced_policy)->Args({ 1024, 1 })->Args({ 1024, 64 })->Args({ 2048, 64 });
+BENCHMARK_TEMPLATE(TriangularSolve, parallel_policy)->Args({ 2048, 64 })->UseRealTime();
+BENCHMARK(NaiveTriangularSolve)->Args({ 1024, 1 })->Args({ 1024, 64 });
+BENCHMARK_TEMPLATE(BandedMultiplyVector, sequenced_policy)->RangeMultiplier(4)->Range(1024, 16384);
+BENCHMARK(NaiveBandedMultiplyVector)->RangeMultiplier(4)->Range(1024, 4096);
@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include "matrix/matrix.hpp"
+#include "sparse_matrix/sparse_matrix.hpp"
+
+#include <random>
+#include <vector>
+
+// Products of an n x n matrix with 1% of non-zero elements by a vector,
+// n = state.range(0). NaiveSparseMultiplyVector multiplies the dense matrix.
+static std::vector<sparse_triplet<double>> random_triplets(const std::size_t n)
+{
+	std::mt19937 g(5);
+	std::uniform_int_distribution<std::size_t> index_dist(0, n - 1);
+	std::vector<sparse_triplet<double>> triplets(n * n / 100);
+	for (auto& triplet : triplets) {
+		triplet = { index_dist(g), index_dist(g), 1.0 };
+	}
+	return triplets;
+}
+
+template<class F, class ExecutionPolicy>
+static void SparseMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const sparse_matrix<double, F> a(n, n, random_triplets(n));
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		multiply_vector(ExecutionPolicy{}, a, x, y);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * a.count_nonzeros());
+}
+
+static void NaiveSparseMultiplyVector(benchmark::State& state)
+{
+	const auto n = static_cast<std::size_t>(state.range(0));
+	const matrix<double> a = csr_matrix<double>(n, n, random_triplets(n)).to_dense();
+	const std::vector<double> x(n, 2.0);
+	std::vector<double> y(n);
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < n; ++i) {
+			double sum = 0.0;
+			for (std::size_t j = 0; j < n; ++j) {
+				sum += a(i, j) * x[j];
+			}
+			y[i] = sum;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * (n * n / 100));
+}
+
+using matrix_execution::sequenced_policy;
+using matrix_execution::parallel_policy;
+
+BENCHMARK_TEMPLATE(SparseMultiplyVector, csr_format, sequenced_policy)->RangeMultiplier(4)->Range(256, 16384);
+BENCHMARK_TEMPLATE(SparseMultiplyVector, csc_format, sequenced_policy)->RangeMultiplier(4)->Range(256, 16384);
+BENCHMARK_TEMPLATE(SparseMultiplyVector, csr_format, parallel_policy)->RangeMultiplier(4)->Range(1024, 16384)->UseRealTime();
+BENCHMARK(NaiveSparseMultiplyVector)->RangeMultiplier(4)->Range(256, 4096);
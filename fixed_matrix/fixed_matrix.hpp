@@ -5,6 +5,12 @@
 
 #include <stdexcept>
 #include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "../matrix_ops/expression.hpp"
+#include "../matrix/matrix_view.hpp"
 
 struct fixed_matrix_error : std::runtime_error {
 	explicit fixed_matrix_error(const char* q) : std::runtime_error(q) {}
@@ -32,34 +38,103 @@ struct fixed_matrix
 	constexpr explicit fixed_matrix() noexcept 
 		: elems_{} 
 	{}
-	explicit fixed_matrix(const T& val) { std::fill(begin(), end(), val); }
+	constexpr explicit fixed_matrix(const T& val) 
+		: elems_{}
+	{ 
+		for (size_type i = 0; i < RowsCount; ++i)
+			for (size_type j = 0; j < ColumnsCount; ++j)
+				elems_[i][j] = val;
+	}
 
-	explicit fixed_matrix(const T(&arr)[LINEAR_SIZE]) { std::copy(std::cbegin(arr), std::cend(arr), begin()); }
+	constexpr explicit fixed_matrix(const T(&arr)[LINEAR_SIZE]) 
+		: elems_{}
+	{
+		const T* src = arr;
+		for (size_type i = 0; i < RowsCount; ++i)
+			for (size_type j = 0; j < ColumnsCount; ++j)
+				elems_[i][j] = *src++;
+	}
 
-	explicit fixed_matrix(const T(&arr)[RowsCount][ColumnsCount])
+	constexpr explicit fixed_matrix(const T(&arr)[RowsCount][ColumnsCount])
+		: elems_{}
 	{
-		std::copy(reinterpret_cast<const T*>(arr), reinterpret_cast<const T*>(arr) + LINEAR_SIZE, begin());
+		for (size_type i = 0; i < RowsCount; ++i)
+			for (size_type j = 0; j < ColumnsCount; ++j)
+				elems_[i][j] = arr[i][j];
 	}
 
-	explicit fixed_matrix(std::initializer_list<T> init_lst)
+	constexpr explicit fixed_matrix(std::initializer_list<T> init_lst)
+		: elems_{}
 	{
 		if (std::size(init_lst) != LINEAR_SIZE)
 			throw fixed_matrix_error{ "Invalid argument for constructor fixed_matrix<T>::fixed_matrix(std::initializer_list<T>)" };
 
-		std::copy(std::cbegin(init_lst), std::cend(init_lst), begin());
+		const T* src = init_lst.begin();
+		for (size_type i = 0; i < RowsCount; ++i)
+			for (size_type j = 0; j < ColumnsCount; ++j)
+				elems_[i][j] = *src++;
 	}
 
-	fixed_matrix(const fixed_matrix& other) { std::copy(std::cbegin(other), std::cend(other), begin()); }
-	fixed_matrix& operator =(const fixed_matrix& other)
+	// Evaluates an element-wise expression (see expression.hpp) in a single pass.
+	template<class E>
+	fixed_matrix(const matrix_expression<E>& expression)
+	{
+		check_shape(expression.self());
+		matrix_detail::evaluate(matrix_execution::seq, *this, expression.self(), matrix_detail::assign_op{});
+	}
+
+	template<class E>
+	fixed_matrix& operator=(const matrix_expression<E>& expression)
+	{
+		check_shape(expression.self());
+		matrix_detail::evaluate(matrix_execution::seq, *this, expression.self(), matrix_detail::assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	fixed_matrix& operator+=(const E& e)
+	{
+		check_shape(e);
+		matrix_detail::evaluate(matrix_execution::seq, *this, matrix_detail::make_operand(e), matrix_detail::add_assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	fixed_matrix& operator-=(const E& e)
+	{
+		check_shape(e);
+		matrix_detail::evaluate(matrix_execution::seq, *this, matrix_detail::make_operand(e), matrix_detail::subtract_assign_op{});
+		return *this;
+	}
+
+	constexpr fixed_matrix(const fixed_matrix& other) 
+		: elems_{}
+	{ 
+		assign_elements(other);
+	}
+	constexpr fixed_matrix& operator =(const fixed_matrix& other)
 	{
 		if (this == &other)
 			return *this;
 
-		std::copy(std::cbegin(other), std::cend(other), begin());
+		assign_elements(other);
+		return *this;
 	}
 
-	fixed_matrix(fixed_matrix&&) = delete;
-	fixed_matrix& operator=(fixed_matrix&&) = delete;
+	// The elements live inside the object, so a move can only move them one by one.
+	constexpr fixed_matrix(fixed_matrix&& other) noexcept(std::is_nothrow_default_constructible_v<T> && std::is_nothrow_move_assignable_v<T>)
+		: elems_{}
+	{
+		assign_elements(std::move(other));
+	}
+	constexpr fixed_matrix& operator =(fixed_matrix&& other) noexcept(std::is_nothrow_move_assignable_v<T>)
+	{
+		if (this == &other)
+			return *this;
+
+		assign_elements(std::move(other));
+		return *this;
+	}
 
 	constexpr inline size_type count_rows() const noexcept { return RowsCount; }
 	constexpr inline size_type count_columns() const noexcept { return ColumnsCount; }
@@ -84,6 +159,19 @@ struct fixed_matrix
 	constexpr inline const T* operator [](size_type row_index) const noexcept { return elems_[row_index]; }
 	constexpr inline T* operator [](size_type row_index) noexcept { return elems_[row_index]; }
 
+	// Views of the elements (see matrix_view.hpp).
+	inline matrix_view<T> view() noexcept { return { data(), RowsCount, ColumnsCount, ColumnsCount }; }
+	inline const_matrix_view<T> view() const noexcept { return { data(), RowsCount, ColumnsCount, ColumnsCount }; }
+
+	inline matrix_view<T> block(size_type row_index, size_type col_index, size_type rows, size_type columns) { return view().block(row_index, col_index, rows, columns); }
+	inline const_matrix_view<T> block(size_type row_index, size_type col_index, size_type rows, size_type columns) const { return view().block(row_index, col_index, rows, columns); }
+	inline matrix_view<T> row(size_type row_index) { return view().row(row_index); }
+	inline const_matrix_view<T> row(size_type row_index) const { return view().row(row_index); }
+	inline matrix_view<T> column(size_type col_index) { return view().column(col_index); }
+	inline const_matrix_view<T> column(size_type col_index) const { return view().column(col_index); }
+	inline transposed_view<T> transposed() noexcept { return view().transposed(); }
+	inline transposed_view<const T> transposed() const noexcept { return view().transposed(); }
+
 	constexpr inline iterator begin() noexcept { return reinterpret_cast<T*>(elems_); }
 	constexpr inline iterator end() noexcept { return reinterpret_cast<T*>(elems_) + LINEAR_SIZE; }
 
@@ -104,6 +192,22 @@ struct fixed_matrix
 	constexpr inline const_reverce_iterator rend() const noexcept { return crend(); }
 
 private:
+	// Copies (or moves, for an rvalue) the elements of 'other', usable in constant expressions.
+	template<class M>
+	constexpr inline void assign_elements(M&& other)
+	{
+		for (size_type i = 0; i < RowsCount; ++i)
+			for (size_type j = 0; j < ColumnsCount; ++j)
+				elems_[i][j] = std::forward<M>(other).elems_[i][j];
+	}
+
+	template<class E>
+	inline void check_shape(const E& e) const
+	{
+		if (e.count_rows() != RowsCount || e.count_columns() != ColumnsCount)
+			throw fixed_matrix_error{ "size error: expression has a different shape" };
+	}
+
 	constexpr inline void range_check(size_type row_index, size_type col_index) const
 	{
 		if (row_index >= RowsCount)
@@ -116,4 +220,7 @@ private:
 	T elems_[RowsCount][ColumnsCount];
 };
 
+template<typename T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+struct is_matrix_container<fixed_matrix<T, RowsCount, ColumnsCount>> : std::true_type {};
+
 #endif // !FIXED_MATRIX_HPP
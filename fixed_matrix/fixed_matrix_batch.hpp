@@ -0,0 +1,659 @@
+#pragma once
+
+#ifndef FIXED_MATRIX_BATCH_HPP
+#define FIXED_MATRIX_BATCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_matrix.hpp"
+#include "fixed_matrix_kernels.hpp"
+#include "../matrix_ops/simd.hpp"
+#include "../matrix_ops/thread_pool.hpp"
+
+// Batches of small matrices in structure-of-arrays layout.
+//
+// fixed_matrix_batch<T, R, C> holds size() matrices of R x C elements. Each
+// element (i, j) has its own array holding its values in all the matrices, so
+// the same operation applied to every matrix of the batch reads and writes
+// these arrays in contiguous runs. The batched kernels work on blocks of
+// batch_lanes matrices (one cache line of each element array): every
+// arithmetic operation of a block is done on a lane_pack, which the compiler
+// turns into SIMD instructions, using AVX2 when available. Blocks are split
+// between threads by the execution policy.
+//
+// Single matrices are gathered from and scattered to the arrays with at(),
+// operator[], set(), gather() and scatter(). Vectors are batches of one
+// column (fixed_vector_batch).
+//
+//   fixed_matrix_batch<float, 4, 4> transforms(n);
+//   fixed_vector_batch<float, 4> points(n);
+//   ...
+//   const auto moved = transforms * points;
+//   const auto undone = inverse(transforms) * moved;
+
+template<typename T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+struct fixed_matrix_batch;
+
+template<typename T, const std::size_t Size>
+using fixed_vector_batch = fixed_matrix_batch<T, Size, 1>;
+
+namespace matrix_detail {
+
+	// Matrices processed together: one cache line of every element array.
+	template<class T>
+	constexpr std::size_t batch_lanes = 64 / sizeof(T);
+
+	// Values of one element in batch_lanes matrices, with element-wise
+	// arithmetic written as loops the compiler vectorizes.
+	template<class T>
+	struct lane_pack
+	{
+		static constexpr std::size_t size = batch_lanes<T>;
+
+		static MATRIX_FORCE_INLINE lane_pack load(const T* values) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = values[lane];
+			return result;
+		}
+
+		static MATRIX_FORCE_INLINE lane_pack broadcast(const T value) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = value;
+			return result;
+		}
+
+		MATRIX_FORCE_INLINE void store(T* values) const noexcept
+		{
+			for (std::size_t lane = 0; lane < size; ++lane) values[lane] = lanes[lane];
+		}
+
+		MATRIX_FORCE_INLINE lane_pack& operator+=(const lane_pack& other) noexcept
+		{
+			for (std::size_t lane = 0; lane < size; ++lane) lanes[lane] += other.lanes[lane];
+			return *this;
+		}
+
+		MATRIX_FORCE_INLINE lane_pack operator-() const noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = -lanes[lane];
+			return result;
+		}
+
+		friend MATRIX_FORCE_INLINE lane_pack operator+(const lane_pack& a, const lane_pack& b) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = a.lanes[lane] + b.lanes[lane];
+			return result;
+		}
+
+		friend MATRIX_FORCE_INLINE lane_pack operator-(const lane_pack& a, const lane_pack& b) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = a.lanes[lane] - b.lanes[lane];
+			return result;
+		}
+
+		friend MATRIX_FORCE_INLINE lane_pack operator*(const lane_pack& a, const lane_pack& b) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = a.lanes[lane] * b.lanes[lane];
+			return result;
+		}
+
+		friend MATRIX_FORCE_INLINE lane_pack operator/(const lane_pack& a, const lane_pack& b) noexcept
+		{
+			lane_pack result;
+			for (std::size_t lane = 0; lane < size; ++lane) result.lanes[lane] = a.lanes[lane] / b.lanes[lane];
+			return result;
+		}
+
+		T lanes[size];
+	};
+
+	// Operands of batched products: a batch gives the values of its matrices,
+	// a single fixed_matrix the same value in every lane.
+	template<class T, std::size_t R, std::size_t C>
+	MATRIX_FORCE_INLINE lane_pack<T> load_lanes(const fixed_matrix_batch<T, R, C>& batch, const std::size_t row, const std::size_t column, const std::size_t first) noexcept
+	{
+		return lane_pack<T>::load(batch.element(row, column) + first);
+	}
+
+	template<class T, std::size_t R, std::size_t C>
+	MATRIX_FORCE_INLINE lane_pack<T> load_lanes(const fixed_matrix<T, R, C>& m, const std::size_t row, const std::size_t column, std::size_t) noexcept
+	{
+		return lane_pack<T>::broadcast(m[row][column]);
+	}
+
+	template<class T, std::size_t R, std::size_t C>
+	MATRIX_FORCE_INLINE void load_lanes(const fixed_matrix_batch<T, R, C>& batch, const std::size_t first, lane_pack<T>(&packs)[R][C]) noexcept
+	{
+		for (std::size_t i = 0; i < R; ++i) {
+			for (std::size_t j = 0; j < C; ++j) {
+				packs[i][j] = load_lanes(batch, i, j, first);
+			}
+		}
+	}
+
+	// The operands are read before the result is written, so 'out' may be one of them.
+	template<class T, std::size_t R, std::size_t N, std::size_t C, class MA, class MB>
+	struct batch_multiply_kernel
+	{
+		const MA& a;
+		const MB& b;
+		fixed_matrix_batch<T, R, C>& out;
+
+		MATRIX_FORCE_INLINE void operator()(const std::size_t block) const noexcept
+		{
+			const std::size_t first = block * lane_pack<T>::size;
+			lane_pack<T> lhs[R][N];
+			lane_pack<T> rhs[N][C];
+			for (std::size_t i = 0; i < R; ++i) {
+				for (std::size_t k = 0; k < N; ++k) {
+					lhs[i][k] = load_lanes(a, i, k, first);
+				}
+			}
+			for (std::size_t k = 0; k < N; ++k) {
+				for (std::size_t j = 0; j < C; ++j) {
+					rhs[k][j] = load_lanes(b, k, j, first);
+				}
+			}
+
+			for (std::size_t i = 0; i < R; ++i) {
+				for (std::size_t j = 0; j < C; ++j) {
+					lane_pack<T> sum = lhs[i][0] * rhs[0][j];
+					for (std::size_t k = 1; k < N; ++k) {
+						sum += lhs[i][k] * rhs[k][j];
+					}
+					sum.store(out.element(i, j) + first);
+				}
+			}
+		}
+	};
+
+	inline void record_singular(std::atomic<std::size_t>& singular, const std::size_t index) noexcept
+	{
+		std::size_t current = singular.load(std::memory_order_relaxed);
+		while (index < current && !singular.compare_exchange_weak(current, index, std::memory_order_relaxed)) {}
+	}
+
+	// Closed-form inverses of the kernels of fixed_matrix_kernels.hpp on lane
+	// packs. Lanes past 'count' are padding and never reported as singular.
+	template<class T, std::size_t Size>
+	struct batch_inverse_kernel
+	{
+		const fixed_matrix_batch<T, Size, Size>& m;
+		fixed_matrix_batch<T, Size, Size>& out;
+		std::size_t count;
+		std::atomic<std::size_t>& singular;
+
+		MATRIX_FORCE_INLINE void operator()(const std::size_t block) const noexcept
+		{
+			const std::size_t first = block * lane_pack<T>::size;
+			lane_pack<T> in[Size][Size];
+			lane_pack<T> adjugate[Size][Size];
+			load_lanes(m, first, in);
+
+			lane_pack<T> det;
+			if constexpr (Size == 1) {
+				det = in[0][0];
+				adjugate[0][0] = lane_pack<T>::broadcast(T{ 1 });
+			}
+			else if constexpr (Size == 2) {
+				det = determinant_2x2(in);
+				adjugate_2x2(in, adjugate);
+			}
+			else if constexpr (Size == 3) {
+				det = adjugate_3x3(in, adjugate);
+			}
+			else {
+				det = adjugate_4x4(in, adjugate);
+			}
+
+			bool any_zero = false;
+			for (std::size_t lane = 0; lane < lane_pack<T>::size; ++lane) {
+				any_zero |= (det.lanes[lane] == T{});
+			}
+			if (any_zero) {
+				for (std::size_t lane = 0; lane < lane_pack<T>::size && first + lane < count; ++lane) {
+					if (det.lanes[lane] == T{}) record_singular(singular, first + lane);
+				}
+			}
+
+			// Padding lanes hold zero matrices: their scale is 0, not 1 / 0, so
+			// they stay zero instead of becoming NaN.
+			lane_pack<T> scale;
+			for (std::size_t lane = 0; lane < lane_pack<T>::size; ++lane) {
+				const bool used = first + lane < count;
+				scale.lanes[lane] = used ? T{ 1 } / det.lanes[lane] : T{};
+			}
+			for (std::size_t i = 0; i < Size; ++i) {
+				for (std::size_t j = 0; j < Size; ++j) {
+					(adjugate[i][j] * scale).store(out.element(i, j) + first);
+				}
+			}
+		}
+	};
+
+	// Bigger matrices are inverted one by one by elimination.
+	template<class T, std::size_t Size>
+	struct batch_elimination_inverse_kernel
+	{
+		const fixed_matrix_batch<T, Size, Size>& m;
+		fixed_matrix_batch<T, Size, Size>& out;
+		std::size_t count;
+		std::atomic<std::size_t>& singular;
+
+		void operator()(const std::size_t block) const
+		{
+			const std::size_t first = block * lane_pack<T>::size;
+			const std::size_t last = std::min(first + lane_pack<T>::size, count);
+			for (std::size_t index = first; index < last; ++index) {
+				try {
+					out.set(index, inverse(m[index]));
+				}
+				catch (const fixed_matrix_error&) {
+					record_singular(singular, index);
+				}
+			}
+		}
+	};
+
+	template<class Kernel>
+	inline void run_batch_blocks(const Kernel& kernel, std::size_t first, const std::size_t last)
+	{
+		for (; first < last; ++first) kernel(first);
+	}
+
+#if MATRIX_X86
+	// The kernels are inlined here and compiled for AVX2.
+	template<class Kernel>
+	MATRIX_TARGET("avx2,fma") inline void run_batch_blocks_avx2(const Kernel& kernel, std::size_t first, const std::size_t last)
+	{
+		for (; first < last; ++first) kernel(first);
+	}
+#endif
+
+	// Runs kernel(block) for the blocks of 'lanes' matrices covering [0, count).
+	template<class ExecutionPolicy, class Kernel>
+	inline void for_each_batch_block(const ExecutionPolicy& policy, const std::size_t count, const std::size_t lanes,
+		const std::size_t elements, const Kernel& kernel)
+	{
+		const std::size_t blocks = (count + lanes - 1) / lanes;
+		const std::size_t grain = std::max<std::size_t>(1, matrix_execution::min_parallel_elements / (lanes * std::max<std::size_t>(elements, 1)));
+#if MATRIX_X86
+		const bool avx2 = active_simd_level() >= simd_level::avx2;
+#endif
+		matrix_execution::for_each_tile(policy, 0, blocks, grain, [&](const std::size_t first, const std::size_t last) {
+#if MATRIX_X86
+			if (avx2) {
+				run_batch_blocks_avx2(kernel, first, last);
+				return;
+			}
+#endif
+			run_batch_blocks(kernel, first, last);
+		});
+	}
+
+	inline void check_batch_sizes(const std::size_t a, const std::size_t b)
+	{
+		if (a != b) {
+			throw fixed_matrix_error{ "size error: batches have different sizes" };
+		}
+	}
+
+} // namespace matrix_detail
+
+template<typename T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+struct fixed_matrix_batch
+{
+	static_assert(std::is_arithmetic_v<T>, "fixed_matrix_batch requires arithmetic elements");
+
+	using value_type = T;
+	using size_type = std::size_t;
+	using matrix_type = fixed_matrix<T, RowsCount, ColumnsCount>;
+
+	// Capacity is a multiple of 'lanes', the matrices of a block are always allocated.
+	static constexpr size_type lanes = matrix_detail::batch_lanes<T>;
+	static constexpr size_type matrix_elements = RowsCount * ColumnsCount;
+
+	fixed_matrix_batch() noexcept = default;
+
+	explicit fixed_matrix_batch(const size_type count)
+		: fixed_matrix_batch(count, matrix_type{})
+	{}
+
+	fixed_matrix_batch(const size_type count, const matrix_type& value)
+	{
+		resize(count, value);
+	}
+
+	template<class InputIt, class = std::enable_if_t<!std::is_integral_v<InputIt>>>
+	fixed_matrix_batch(InputIt first, const InputIt last)
+	{
+		using category = typename std::iterator_traits<InputIt>::iterator_category;
+		if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+			reserve(static_cast<size_type>(std::distance(first, last)));
+		}
+		for (; first != last; ++first) {
+			push_back(*first);
+		}
+	}
+
+	fixed_matrix_batch(std::initializer_list<matrix_type> matrices)
+		: fixed_matrix_batch(matrices.begin(), matrices.end())
+	{}
+
+	fixed_matrix_batch(const fixed_matrix_batch& other)
+	{
+		reallocate(other.count_);
+		for (size_type element = 0; element < matrix_elements; ++element) {
+			std::memcpy(data_.data() + element * capacity_, other.data_.data() + element * other.capacity_, other.count_ * sizeof(T));
+		}
+		count_ = other.count_;
+	}
+
+	fixed_matrix_batch(fixed_matrix_batch&& other) noexcept
+		: data_{ std::move(other.data_) }
+		, count_{ std::exchange(other.count_, 0) }
+		, capacity_{ std::exchange(other.capacity_, 0) }
+	{}
+
+	fixed_matrix_batch& operator=(const fixed_matrix_batch& other)
+	{
+		if (this != &other) {
+			fixed_matrix_batch tmp(other);
+			swap(tmp);
+		}
+		return *this;
+	}
+
+	fixed_matrix_batch& operator=(fixed_matrix_batch&& other) noexcept
+	{
+		if (this != &other) {
+			fixed_matrix_batch tmp(std::move(other));
+			swap(tmp);
+		}
+		return *this;
+	}
+
+	void swap(fixed_matrix_batch& other) noexcept
+	{
+		std::swap(data_, other.data_);
+		std::swap(count_, other.count_);
+		std::swap(capacity_, other.capacity_);
+	}
+
+	inline size_type size() const noexcept { return count_; }
+	inline size_type capacity() const noexcept { return capacity_; }
+	inline bool empty() const noexcept { return count_ == 0; }
+
+	static constexpr size_type count_rows() noexcept { return RowsCount; }
+	static constexpr size_type count_columns() noexcept { return ColumnsCount; }
+
+	// Values of element (row, column) in all the matrices: size() of them, 64-byte aligned.
+	inline T* element(const size_type row, const size_type column) noexcept
+	{
+		return data_.data() + (row * ColumnsCount + column) * capacity_;
+	}
+	inline const T* element(const size_type row, const size_type column) const noexcept
+	{
+		return data_.data() + (row * ColumnsCount + column) * capacity_;
+	}
+
+	// Gathers the matrix at 'index'.
+	inline matrix_type operator[](const size_type index) const noexcept
+	{
+		matrix_type result;
+		for (size_type i = 0; i < RowsCount; ++i) {
+			for (size_type j = 0; j < ColumnsCount; ++j) {
+				result[i][j] = element(i, j)[index];
+			}
+		}
+		return result;
+	}
+
+	matrix_type at(const size_type index) const
+	{
+		range_check(index);
+		return (*this)[index];
+	}
+
+	// Scatters 'm' to the matrix at 'index'.
+	inline void set(const size_type index, const matrix_type& m) noexcept
+	{
+		for (size_type i = 0; i < RowsCount; ++i) {
+			for (size_type j = 0; j < ColumnsCount; ++j) {
+				element(i, j)[index] = m[i][j];
+			}
+		}
+	}
+
+	// Copies 'count' matrices starting at 'first' to 'out'.
+	void gather(const size_type first, const size_type count, matrix_type* out) const
+	{
+		range_check(first, count);
+		for (size_type i = 0; i < RowsCount; ++i) {
+			for (size_type j = 0; j < ColumnsCount; ++j) {
+				const T* values = element(i, j) + first;
+				for (size_type index = 0; index < count; ++index) {
+					out[index][i][j] = values[index];
+				}
+			}
+		}
+	}
+
+	// Copies 'count' matrices from 'in' to the ones starting at 'first'.
+	void scatter(const matrix_type* in, const size_type count, const size_type first)
+	{
+		range_check(first, count);
+		for (size_type i = 0; i < RowsCount; ++i) {
+			for (size_type j = 0; j < ColumnsCount; ++j) {
+				T* values = element(i, j) + first;
+				for (size_type index = 0; index < count; ++index) {
+					values[index] = in[index][i][j];
+				}
+			}
+		}
+	}
+
+	void reserve(const size_type count)
+	{
+		if (count > capacity_) {
+			reallocate(count);
+		}
+	}
+
+	void resize(const size_type count, const matrix_type& value = matrix_type{})
+	{
+		if (count > capacity_) {
+			reallocate(std::max(count, 2 * capacity_));
+		}
+		for (size_type i = 0; i < RowsCount; ++i) {
+			for (size_type j = 0; j < ColumnsCount; ++j) {
+				T* values = element(i, j);
+				if (count > count_) {
+					std::fill(values + count_, values + count, value[i][j]);
+				}
+				else {
+					// Padding lanes stay zero.
+					std::fill(values + count, values + count_, T{});
+				}
+			}
+		}
+		count_ = count;
+	}
+
+	void push_back(const matrix_type& m)
+	{
+		if (count_ == capacity_) {
+			reallocate(std::max<size_type>(lanes, 2 * capacity_));
+		}
+		set(count_, m);
+		++count_;
+	}
+
+	inline void clear() noexcept { resize(0); }
+
+private:
+	// Moves the matrices to a buffer for at least 'capacity' of them, the new padding lanes are zero.
+	void reallocate(const size_type capacity)
+	{
+		const size_type new_capacity = (capacity + lanes - 1) / lanes * lanes;
+		matrix_detail::aligned_buffer<T> data(new_capacity * matrix_elements);
+		std::fill(data.data(), data.data() + new_capacity * matrix_elements, T{});
+		for (size_type element = 0; element < matrix_elements; ++element) {
+			if (count_ != 0) {
+				std::memcpy(data.data() + element * new_capacity, data_.data() + element * capacity_, count_ * sizeof(T));
+			}
+		}
+		data_ = std::move(data);
+		capacity_ = new_capacity;
+	}
+
+	inline void range_check(const size_type index) const
+	{
+		if (index >= count_)
+			throw fixed_matrix_error{ "range error: index is out of range" };
+	}
+
+	inline void range_check(const size_type first, const size_type count) const
+	{
+		if (first > count_ || count > count_ - first)
+			throw fixed_matrix_error{ "range error: matrices are out of range" };
+	}
+
+	matrix_detail::aligned_buffer<T> data_;
+	size_type count_{ 0 };
+	size_type capacity_{ 0 };
+};
+
+template<typename T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+inline void swap(fixed_matrix_batch<T, RowsCount, ColumnsCount>& lhs, fixed_matrix_batch<T, RowsCount, ColumnsCount>& rhs) noexcept
+{
+	lhs.swap(rhs);
+}
+
+// out[k] = a[k] * b[k]. 'out' is resized to the size of the batches and may be one of them.
+template<class ExecutionPolicy, class T, std::size_t R, std::size_t N, std::size_t C,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const fixed_matrix_batch<T, R, N>& a, const fixed_matrix_batch<T, N, C>& b,
+	fixed_matrix_batch<T, R, C>& out)
+{
+	matrix_detail::check_batch_sizes(a.size(), b.size());
+	out.resize(a.size());
+	using kernel = matrix_detail::batch_multiply_kernel<T, R, N, C, fixed_matrix_batch<T, R, N>, fixed_matrix_batch<T, N, C>>;
+	matrix_detail::for_each_batch_block(policy, a.size(), out.lanes, R * N * C, kernel{ a, b, out });
+}
+
+// out[k] = a * b[k], e.g. one transformation applied to a batch of vectors.
+template<class ExecutionPolicy, class T, std::size_t R, std::size_t N, std::size_t C,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const fixed_matrix<T, R, N>& a, const fixed_matrix_batch<T, N, C>& b,
+	fixed_matrix_batch<T, R, C>& out)
+{
+	out.resize(b.size());
+	using kernel = matrix_detail::batch_multiply_kernel<T, R, N, C, fixed_matrix<T, R, N>, fixed_matrix_batch<T, N, C>>;
+	matrix_detail::for_each_batch_block(policy, b.size(), out.lanes, R * N * C, kernel{ a, b, out });
+}
+
+// out[k] = a[k] * b.
+template<class ExecutionPolicy, class T, std::size_t R, std::size_t N, std::size_t C,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const fixed_matrix_batch<T, R, N>& a, const fixed_matrix<T, N, C>& b,
+	fixed_matrix_batch<T, R, C>& out)
+{
+	out.resize(a.size());
+	using kernel = matrix_detail::batch_multiply_kernel<T, R, N, C, fixed_matrix_batch<T, R, N>, fixed_matrix<T, N, C>>;
+	matrix_detail::for_each_batch_block(policy, a.size(), out.lanes, R * N * C, kernel{ a, b, out });
+}
+
+template<class T, std::size_t R, std::size_t N, std::size_t C>
+fixed_matrix_batch<T, R, C> operator*(const fixed_matrix_batch<T, R, N>& a, const fixed_matrix_batch<T, N, C>& b)
+{
+	fixed_matrix_batch<T, R, C> result;
+	multiply(matrix_execution::par, a, b, result);
+	return result;
+}
+
+template<class T, std::size_t R, std::size_t N, std::size_t C>
+fixed_matrix_batch<T, R, C> operator*(const fixed_matrix<T, R, N>& a, const fixed_matrix_batch<T, N, C>& b)
+{
+	fixed_matrix_batch<T, R, C> result;
+	multiply(matrix_execution::par, a, b, result);
+	return result;
+}
+
+template<class T, std::size_t R, std::size_t N, std::size_t C>
+fixed_matrix_batch<T, R, C> operator*(const fixed_matrix_batch<T, R, N>& a, const fixed_matrix<T, N, C>& b)
+{
+	fixed_matrix_batch<T, R, C> result;
+	multiply(matrix_execution::par, a, b, result);
+	return result;
+}
+
+// In structure-of-arrays layout a transposition only exchanges element arrays.
+template<class T, std::size_t R, std::size_t C>
+fixed_matrix_batch<T, C, R> transpose(const fixed_matrix_batch<T, R, C>& batch)
+{
+	fixed_matrix_batch<T, C, R> result(batch.size());
+	for (std::size_t i = 0; i < R; ++i) {
+		for (std::size_t j = 0; j < C; ++j) {
+			std::copy_n(batch.element(i, j), batch.size(), result.element(j, i));
+		}
+	}
+	return result;
+}
+
+// out[k] = inverse(batch[k]), 'out' may be 'batch'. Throws fixed_matrix_error
+// naming the first singular matrix of the batch, if any.
+template<class ExecutionPolicy, class T, std::size_t Size,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void inverse(const ExecutionPolicy& policy, const fixed_matrix_batch<T, Size, Size>& batch, fixed_matrix_batch<T, Size, Size>& out)
+{
+	static_assert(!std::is_integral_v<T>, "inverse() requires non-integer elements");
+
+	const std::size_t count = batch.size();
+	out.resize(count);
+	std::atomic<std::size_t> singular{ std::numeric_limits<std::size_t>::max() };
+	if constexpr (Size <= matrix_detail::max_unrolled_dimension) {
+		using kernel = matrix_detail::batch_inverse_kernel<T, Size>;
+		matrix_detail::for_each_batch_block(policy, count, out.lanes, Size * Size * Size, kernel{ batch, out, count, singular });
+	}
+	else {
+		using kernel = matrix_detail::batch_elimination_inverse_kernel<T, Size>;
+		matrix_detail::for_each_batch_block(policy, count, out.lanes, Size * Size * Size, kernel{ batch, out, count, singular });
+	}
+
+	if (singular.load() != std::numeric_limits<std::size_t>::max()) {
+		throw fixed_matrix_error{ "inverse error: matrix " + std::to_string(singular.load()) + " of the batch is singular" };
+	}
+}
+
+template<class ExecutionPolicy, class T, std::size_t Size,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+fixed_matrix_batch<T, Size, Size> inverse(const ExecutionPolicy& policy, const fixed_matrix_batch<T, Size, Size>& batch)
+{
+	fixed_matrix_batch<T, Size, Size> result;
+	inverse(policy, batch, result);
+	return result;
+}
+
+template<class T, std::size_t Size>
+fixed_matrix_batch<T, Size, Size> inverse(const fixed_matrix_batch<T, Size, Size>& batch)
+{
+	return inverse(matrix_execution::par, batch);
+}
+
+#endif // !FIXED_MATRIX_BATCH_HPP
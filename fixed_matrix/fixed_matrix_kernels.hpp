@@ -0,0 +1,518 @@
+#pragma once
+
+#ifndef FIXED_MATRIX_KERNELS_HPP
+#define FIXED_MATRIX_KERNELS_HPP
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_matrix.hpp"
+#include "../matrix_ops/simd.hpp"
+#include "../matrix_ops/transpose.hpp"
+
+// Small-size kernels for fixed_matrix: product, transpose, matrix-vector product,
+// determinant and inverse.
+//
+// All of them are constexpr. For dimensions up to 4 the loops are expanded at
+// compile time into straight-line code, the determinant and the inverse of 2x2,
+// 3x3 and 4x4 matrices use closed-form cofactor expansions. Bigger matrices go
+// through generic loops (Gaussian elimination for the determinant and the
+// inverse). At runtime float 4x4 products, transposes and matrix-vector products
+// use SSE, transposes of bigger matrices use the blocked kernels of
+// matrix_ops/transpose.hpp.
+
+namespace matrix_detail {
+
+	constexpr std::size_t max_unrolled_dimension = 4;
+
+	template<std::size_t... Dimensions>
+	inline constexpr bool is_unrolled_v = ((Dimensions <= max_unrolled_dimension) && ...);
+
+	template<class T>
+	constexpr T abs_value(const T& value) { return (value < T{}) ? -value : value; }
+
+	// sum(a[row][k] * b[k][column]) over k in [0, N), N >= 1.
+	template<std::size_t Row, std::size_t Column, class MA, class MB, std::size_t... K>
+	constexpr auto unrolled_dot(const MA& a, const MB& b, std::index_sequence<K...>)
+	{
+		auto sum = a[Row][0] * b[0][Column];
+		((sum += a[Row][K + 1] * b[K + 1][Column]), ...);
+		return sum;
+	}
+
+	template<class T, std::size_t R, std::size_t N, std::size_t C, std::size_t... I>
+	constexpr void unrolled_multiply(const fixed_matrix<T, R, N>& a, const fixed_matrix<T, N, C>& b, fixed_matrix<T, R, C>& c,
+		std::index_sequence<I...>)
+	{
+		((c[I / C][I % C] = unrolled_dot<I / C, I % C>(a, b, std::make_index_sequence<N - 1>{})), ...);
+	}
+
+	template<class T, std::size_t R, std::size_t C, std::size_t... I>
+	constexpr void unrolled_transpose(const fixed_matrix<T, R, C>& m, fixed_matrix<T, C, R>& t, std::index_sequence<I...>)
+	{
+		((t[I % C][I / C] = m[I / C][I % C]), ...);
+	}
+
+	// A vector indexed as a one-column matrix.
+	template<class T, std::size_t N>
+	struct column_of
+	{
+		const std::array<T, N>& v;
+		struct element
+		{
+			const T& value;
+			constexpr const T& operator[](std::size_t) const noexcept { return value; }
+		};
+		constexpr element operator[](const std::size_t index) const noexcept { return { v[index] }; }
+	};
+
+	// 'column' is indexed as a one-column matrix, see column_of.
+	template<class T, std::size_t R, std::size_t C, class Column, std::size_t... I>
+	constexpr void unrolled_multiply_vector(const fixed_matrix<T, R, C>& m, const Column& column, std::array<T, R>& result,
+		std::index_sequence<I...>)
+	{
+		((result[I] = unrolled_dot<I, 0>(m, column, std::make_index_sequence<C - 1>{})), ...);
+	}
+
+	// Closed-form determinants and adjugates. They only need m[i][j] and arithmetic
+	// on the elements, so they also work on element types holding several lanes.
+	template<class M>
+	constexpr auto determinant_2x2(const M& m)
+	{
+		return m[0][0] * m[1][1] - m[0][1] * m[1][0];
+	}
+
+	template<class M, class Out>
+	constexpr void adjugate_2x2(const M& m, Out& out)
+	{
+		const auto a00 = m[0][0], a01 = m[0][1];
+		const auto a10 = m[1][0], a11 = m[1][1];
+		out[0][0] = a11;
+		out[0][1] = -a01;
+		out[1][0] = -a10;
+		out[1][1] = a00;
+	}
+
+	template<class M, class Out>
+	constexpr auto adjugate_3x3(const M& m, Out& out)
+	{
+		const auto a00 = m[0][0], a01 = m[0][1], a02 = m[0][2];
+		const auto a10 = m[1][0], a11 = m[1][1], a12 = m[1][2];
+		const auto a20 = m[2][0], a21 = m[2][1], a22 = m[2][2];
+
+		out[0][0] = a11 * a22 - a12 * a21;
+		out[0][1] = a02 * a21 - a01 * a22;
+		out[0][2] = a01 * a12 - a02 * a11;
+		out[1][0] = a12 * a20 - a10 * a22;
+		out[1][1] = a00 * a22 - a02 * a20;
+		out[1][2] = a02 * a10 - a00 * a12;
+		out[2][0] = a10 * a21 - a11 * a20;
+		out[2][1] = a01 * a20 - a00 * a21;
+		out[2][2] = a00 * a11 - a01 * a10;
+
+		// Returns the determinant, expanded along the first row.
+		return a00 * out[0][0] + a01 * out[1][0] + a02 * out[2][0];
+	}
+
+	template<class M>
+	constexpr auto determinant_3x3(const M& m)
+	{
+		return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+			- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+			+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	}
+
+	// 4x4 via the 2x2 minors of the upper (s) and lower (c) row pairs.
+	template<class M>
+	struct minors_4x4
+	{
+		using value_type = std::decay_t<decltype(std::declval<const M&>()[0][0])>;
+
+		constexpr explicit minors_4x4(const M& m)
+			: s0{ m[0][0] * m[1][1] - m[1][0] * m[0][1] }
+			, s1{ m[0][0] * m[1][2] - m[1][0] * m[0][2] }
+			, s2{ m[0][0] * m[1][3] - m[1][0] * m[0][3] }
+			, s3{ m[0][1] * m[1][2] - m[1][1] * m[0][2] }
+			, s4{ m[0][1] * m[1][3] - m[1][1] * m[0][3] }
+			, s5{ m[0][2] * m[1][3] - m[1][2] * m[0][3] }
+			, c0{ m[2][0] * m[3][1] - m[3][0] * m[2][1] }
+			, c1{ m[2][0] * m[3][2] - m[3][0] * m[2][2] }
+			, c2{ m[2][0] * m[3][3] - m[3][0] * m[2][3] }
+			, c3{ m[2][1] * m[3][2] - m[3][1] * m[2][2] }
+			, c4{ m[2][1] * m[3][3] - m[3][1] * m[2][3] }
+			, c5{ m[2][2] * m[3][3] - m[3][2] * m[2][3] }
+		{}
+
+		constexpr value_type determinant() const { return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0; }
+
+		value_type s0, s1, s2, s3, s4, s5;
+		value_type c0, c1, c2, c3, c4, c5;
+	};
+
+	template<class M>
+	constexpr auto determinant_4x4(const M& m)
+	{
+		return minors_4x4<M>{ m }.determinant();
+	}
+
+	template<class M, class Out>
+	constexpr auto adjugate_4x4(const M& m, Out& out)
+	{
+		const minors_4x4<M> k{ m };
+		const auto a00 = m[0][0], a01 = m[0][1], a02 = m[0][2], a03 = m[0][3];
+		const auto a10 = m[1][0], a11 = m[1][1], a12 = m[1][2], a13 = m[1][3];
+		const auto a20 = m[2][0], a21 = m[2][1], a22 = m[2][2], a23 = m[2][3];
+		const auto a30 = m[3][0], a31 = m[3][1], a32 = m[3][2], a33 = m[3][3];
+
+		out[0][0] = a11 * k.c5 - a12 * k.c4 + a13 * k.c3;
+		out[0][1] = -a01 * k.c5 + a02 * k.c4 - a03 * k.c3;
+		out[0][2] = a31 * k.s5 - a32 * k.s4 + a33 * k.s3;
+		out[0][3] = -a21 * k.s5 + a22 * k.s4 - a23 * k.s3;
+
+		out[1][0] = -a10 * k.c5 + a12 * k.c2 - a13 * k.c1;
+		out[1][1] = a00 * k.c5 - a02 * k.c2 + a03 * k.c1;
+		out[1][2] = -a30 * k.s5 + a32 * k.s2 - a33 * k.s1;
+		out[1][3] = a20 * k.s5 - a22 * k.s2 + a23 * k.s1;
+
+		out[2][0] = a10 * k.c4 - a11 * k.c2 + a13 * k.c0;
+		out[2][1] = -a00 * k.c4 + a01 * k.c2 - a03 * k.c0;
+		out[2][2] = a30 * k.s4 - a31 * k.s2 + a33 * k.s0;
+		out[2][3] = -a20 * k.s4 + a21 * k.s2 - a23 * k.s0;
+
+		out[3][0] = -a10 * k.c3 + a11 * k.c1 - a12 * k.c0;
+		out[3][1] = a00 * k.c3 - a01 * k.c1 + a02 * k.c0;
+		out[3][2] = -a30 * k.s3 + a31 * k.s1 - a32 * k.s0;
+		out[3][3] = a20 * k.s3 - a21 * k.s1 + a22 * k.s0;
+
+		return k.determinant();
+	}
+
+	// Gaussian elimination with partial pivoting, for floating-point elements.
+	template<class T, std::size_t N>
+	constexpr T determinant_elimination(fixed_matrix<T, N, N> m)
+	{
+		T result{ 1 };
+		for (std::size_t k = 0; k < N; ++k) {
+			std::size_t pivot = k;
+			for (std::size_t i = k + 1; i < N; ++i) {
+				if (abs_value(m[i][k]) > abs_value(m[pivot][k])) pivot = i;
+			}
+			if (m[pivot][k] == T{}) return T{};
+			if (pivot != k) {
+				for (std::size_t j = k; j < N; ++j) {
+					const T tmp = m[k][j];
+					m[k][j] = m[pivot][j];
+					m[pivot][j] = tmp;
+				}
+				result = -result;
+			}
+			result *= m[k][k];
+			for (std::size_t i = k + 1; i < N; ++i) {
+				const T factor = m[i][k] / m[k][k];
+				for (std::size_t j = k + 1; j < N; ++j) {
+					m[i][j] -= factor * m[k][j];
+				}
+			}
+		}
+		return result;
+	}
+
+	// Bareiss fraction-free elimination: exact for integer elements, every
+	// division is exact.
+	template<class T, std::size_t N>
+	constexpr T determinant_bareiss(fixed_matrix<T, N, N> m)
+	{
+		T sign{ 1 };
+		T previous{ 1 };
+		for (std::size_t k = 0; k + 1 < N; ++k) {
+			if (m[k][k] == T{}) {
+				std::size_t pivot = k + 1;
+				while (pivot < N && m[pivot][k] == T{}) ++pivot;
+				if (pivot == N) return T{};
+				for (std::size_t j = k; j < N; ++j) {
+					const T tmp = m[k][j];
+					m[k][j] = m[pivot][j];
+					m[pivot][j] = tmp;
+				}
+				sign = -sign;
+			}
+			for (std::size_t i = k + 1; i < N; ++i) {
+				for (std::size_t j = k + 1; j < N; ++j) {
+					m[i][j] = (m[i][j] * m[k][k] - m[i][k] * m[k][j]) / previous;
+				}
+			}
+			previous = m[k][k];
+		}
+		return sign * m[N - 1][N - 1];
+	}
+
+	// Gauss-Jordan elimination with partial pivoting.
+	template<class T, std::size_t N>
+	constexpr fixed_matrix<T, N, N> inverse_elimination(fixed_matrix<T, N, N> m)
+	{
+		fixed_matrix<T, N, N> result;
+		for (std::size_t i = 0; i < N; ++i) {
+			result[i][i] = T{ 1 };
+		}
+
+		for (std::size_t k = 0; k < N; ++k) {
+			std::size_t pivot = k;
+			for (std::size_t i = k + 1; i < N; ++i) {
+				if (abs_value(m[i][k]) > abs_value(m[pivot][k])) pivot = i;
+			}
+			if (m[pivot][k] == T{}) {
+				throw fixed_matrix_error{ "inverse error: matrix is singular" };
+			}
+			if (pivot != k) {
+				for (std::size_t j = 0; j < N; ++j) {
+					T tmp = m[k][j];
+					m[k][j] = m[pivot][j];
+					m[pivot][j] = tmp;
+					tmp = result[k][j];
+					result[k][j] = result[pivot][j];
+					result[pivot][j] = tmp;
+				}
+			}
+
+			const T scale = T{ 1 } / m[k][k];
+			for (std::size_t j = 0; j < N; ++j) {
+				m[k][j] *= scale;
+				result[k][j] *= scale;
+			}
+			for (std::size_t i = 0; i < N; ++i) {
+				if (i == k) continue;
+				const T factor = m[i][k];
+				for (std::size_t j = 0; j < N; ++j) {
+					m[i][j] -= factor * m[k][j];
+					result[i][j] -= factor * result[k][j];
+				}
+			}
+		}
+		return result;
+	}
+
+#if MATRIX_X86 && MATRIX_SSE2_BASELINE && MATRIX_HAS_CONSTANT_EVALUATED
+#define MATRIX_FIXED_SSE 1
+
+	// c.row(i) = sum(a[i][k] * b.row(k))
+	inline void multiply_4x4_sse(const float* a, const float* b, float* c) noexcept
+	{
+		const __m128 b0 = _mm_loadu_ps(b);
+		const __m128 b1 = _mm_loadu_ps(b + 4);
+		const __m128 b2 = _mm_loadu_ps(b + 8);
+		const __m128 b3 = _mm_loadu_ps(b + 12);
+		for (int i = 0; i < 4; ++i) {
+			const float* row = a + 4 * i;
+			__m128 sum = _mm_mul_ps(_mm_set1_ps(row[0]), b0);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[1]), b1));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[2]), b2));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(row[3]), b3));
+			_mm_storeu_ps(c + 4 * i, sum);
+		}
+	}
+
+	inline void transpose_4x4_sse(const float* m, float* t) noexcept
+	{
+		__m128 r0 = _mm_loadu_ps(m);
+		__m128 r1 = _mm_loadu_ps(m + 4);
+		__m128 r2 = _mm_loadu_ps(m + 8);
+		__m128 r3 = _mm_loadu_ps(m + 12);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(t, r0);
+		_mm_storeu_ps(t + 4, r1);
+		_mm_storeu_ps(t + 8, r2);
+		_mm_storeu_ps(t + 12, r3);
+	}
+
+	// The four row-vector products are transposed so that one addition sums them all.
+	inline void multiply_vector_4x4_sse(const float* m, const float* v, float* result) noexcept
+	{
+		const __m128 x = _mm_loadu_ps(v);
+		__m128 p0 = _mm_mul_ps(_mm_loadu_ps(m), x);
+		__m128 p1 = _mm_mul_ps(_mm_loadu_ps(m + 4), x);
+		__m128 p2 = _mm_mul_ps(_mm_loadu_ps(m + 8), x);
+		__m128 p3 = _mm_mul_ps(_mm_loadu_ps(m + 12), x);
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		_mm_storeu_ps(result, _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+	}
+#else
+#define MATRIX_FIXED_SSE 0
+#endif
+
+	template<class T, std::size_t R, std::size_t C>
+	inline constexpr bool is_float_4x4_v = std::is_same_v<T, float> && R == 4 && C == 4;
+
+} // namespace matrix_detail
+
+template<class T, const std::size_t RowsCount, const std::size_t InnerCount, const std::size_t ColumnsCount>
+constexpr fixed_matrix<T, RowsCount, ColumnsCount> operator*(const fixed_matrix<T, RowsCount, InnerCount>& a,
+	const fixed_matrix<T, InnerCount, ColumnsCount>& b)
+{
+	fixed_matrix<T, RowsCount, ColumnsCount> result;
+#if MATRIX_FIXED_SSE
+	if constexpr (matrix_detail::is_float_4x4_v<T, RowsCount, InnerCount> && ColumnsCount == 4) {
+		if (!MATRIX_IS_CONSTANT_EVALUATED()) {
+			matrix_detail::multiply_4x4_sse(a.data(), b.data(), result.data());
+			return result;
+		}
+	}
+#endif
+	if constexpr (InnerCount == 0) {
+		return result;
+	}
+	else if constexpr (matrix_detail::is_unrolled_v<RowsCount, InnerCount, ColumnsCount>) {
+		matrix_detail::unrolled_multiply(a, b, result, std::make_index_sequence<RowsCount * ColumnsCount>{});
+	}
+	else {
+		for (std::size_t i = 0; i < RowsCount; ++i) {
+			for (std::size_t k = 0; k < InnerCount; ++k) {
+				const T aik = a[i][k];
+				for (std::size_t j = 0; j < ColumnsCount; ++j) {
+					result[i][j] += aik * b[k][j];
+				}
+			}
+		}
+	}
+	return result;
+}
+
+// Matrix-vector product m * v.
+template<class T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+constexpr std::array<T, RowsCount> operator*(const fixed_matrix<T, RowsCount, ColumnsCount>& m, const std::array<T, ColumnsCount>& v)
+{
+	std::array<T, RowsCount> result{};
+#if MATRIX_FIXED_SSE
+	if constexpr (matrix_detail::is_float_4x4_v<T, RowsCount, ColumnsCount>) {
+		if (!MATRIX_IS_CONSTANT_EVALUATED()) {
+			matrix_detail::multiply_vector_4x4_sse(m.data(), v.data(), result.data());
+			return result;
+		}
+	}
+#endif
+	if constexpr (ColumnsCount == 0) {
+		return result;
+	}
+	else if constexpr (matrix_detail::is_unrolled_v<RowsCount, ColumnsCount>) {
+		matrix_detail::unrolled_multiply_vector(m, matrix_detail::column_of<T, ColumnsCount>{ v }, result,
+			std::make_index_sequence<RowsCount>{});
+	}
+	else {
+		for (std::size_t i = 0; i < RowsCount; ++i) {
+			T sum{};
+			for (std::size_t j = 0; j < ColumnsCount; ++j) {
+				sum += m[i][j] * v[j];
+			}
+			result[i] = sum;
+		}
+	}
+	return result;
+}
+
+template<class T, const std::size_t RowsCount, const std::size_t ColumnsCount>
+constexpr fixed_matrix<T, ColumnsCount, RowsCount> transpose(const fixed_matrix<T, RowsCount, ColumnsCount>& m)
+{
+	fixed_matrix<T, ColumnsCount, RowsCount> result;
+#if MATRIX_FIXED_SSE
+	if constexpr (matrix_detail::is_float_4x4_v<T, RowsCount, ColumnsCount>) {
+		if (!MATRIX_IS_CONSTANT_EVALUATED()) {
+			matrix_detail::transpose_4x4_sse(m.data(), result.data());
+			return result;
+		}
+	}
+#endif
+	if constexpr (matrix_detail::is_unrolled_v<RowsCount, ColumnsCount>) {
+		matrix_detail::unrolled_transpose(m, result, std::make_index_sequence<RowsCount * ColumnsCount>{});
+	}
+	else {
+		if constexpr (matrix_detail::has_transpose_kernels_v<T>) {
+			if (!MATRIX_IS_CONSTANT_EVALUATED()) {
+				::transpose(matrix_execution::seq, m.view(), result.view());
+				return result;
+			}
+		}
+		for (std::size_t i = 0; i < RowsCount; ++i) {
+			for (std::size_t j = 0; j < ColumnsCount; ++j) {
+				result[j][i] = m[i][j];
+			}
+		}
+	}
+	return result;
+}
+
+template<class T, const std::size_t Size>
+constexpr void transpose_inplace(fixed_matrix<T, Size, Size>& m)
+{
+	if constexpr (!matrix_detail::is_unrolled_v<Size>) {
+		if (!MATRIX_IS_CONSTANT_EVALUATED()) {
+			matrix_detail::transpose_square_inplace(matrix_execution::seq, m.view());
+			return;
+		}
+	}
+	for (std::size_t i = 0; i < Size; ++i) {
+		for (std::size_t j = i + 1; j < Size; ++j) {
+			const T value = m[i][j];
+			m[i][j] = m[j][i];
+			m[j][i] = value;
+		}
+	}
+}
+
+// Exact for integer elements (fraction-free elimination above 4x4).
+template<class T, const std::size_t Size>
+constexpr T determinant(const fixed_matrix<T, Size, Size>& m)
+{
+	if constexpr (Size == 0) return T{ 1 };
+	else if constexpr (Size == 1) return m[0][0];
+	else if constexpr (Size == 2) return matrix_detail::determinant_2x2(m);
+	else if constexpr (Size == 3) return matrix_detail::determinant_3x3(m);
+	else if constexpr (Size == 4) return matrix_detail::determinant_4x4(m);
+	else if constexpr (std::is_integral_v<T>) return matrix_detail::determinant_bareiss(m);
+	else return matrix_detail::determinant_elimination(m);
+}
+
+// Throws fixed_matrix_error if the matrix is singular.
+template<class T, const std::size_t Size>
+constexpr fixed_matrix<T, Size, Size> inverse(const fixed_matrix<T, Size, Size>& m)
+{
+	static_assert(!std::is_integral_v<T>, "inverse() requires non-integer elements");
+
+	if constexpr (Size <= 4) {
+		fixed_matrix<T, Size, Size> result;
+		T det{};
+		if constexpr (Size == 0) {
+			return result;
+		}
+		else if constexpr (Size == 1) {
+			det = m[0][0];
+			result[0][0] = T{ 1 };
+		}
+		else if constexpr (Size == 2) {
+			det = matrix_detail::determinant_2x2(m);
+			matrix_detail::adjugate_2x2(m, result);
+		}
+		else if constexpr (Size == 3) {
+			det = matrix_detail::adjugate_3x3(m, result);
+		}
+		else {
+			det = matrix_detail::adjugate_4x4(m, result);
+		}
+
+		if (det == T{}) {
+			throw fixed_matrix_error{ "inverse error: matrix is singular" };
+		}
+		const T scale = T{ 1 } / det;
+		for (std::size_t i = 0; i < Size; ++i) {
+			for (std::size_t j = 0; j < Size; ++j) {
+				result[i][j] *= scale;
+			}
+		}
+		return result;
+	}
+	else {
+		return matrix_detail::inverse_elimination(m);
+	}
+}
+
+#endif // !FIXED_MATRIX_KERNELS_HPP
@@ -1,9 +1,21 @@
 #include "pch.h"
 #include "../fixed_matrix/fixed_matrix.hpp"
+#include "../fixed_matrix/fixed_matrix_kernels.hpp"
+#include "../fixed_matrix/fixed_matrix_batch.hpp"
+#include "../matrix_ops/multiply.hpp"
+#include "../matrix_ops/factorization.hpp"
+#include "../matrix_ops/reductions.hpp"
+#include "../matrix_io/binary_format.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
 #include <random>
+#include <string>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 
 TEST(FixedMatrixConstruction, DefaultConstructor) {
 	constexpr int rowsCount = 3;
@@ -112,6 +124,19 @@ TEST(FixedMatrixUsage, CopyAssignmentOperator) {
 	EXPECT_TRUE(std::cend(mtx) == it);
 }
 
+TEST(FixedMatrixUsage, MoveOperations) {
+	static_assert(std::is_nothrow_move_constructible_v<fixed_matrix<double, 3, 3>>);
+
+	fixed_matrix<std::string, 2, 2> mtx({ "a", "b", "c", "d" });
+	fixed_matrix<std::string, 2, 2> moved = std::move(mtx);
+	EXPECT_EQ(moved(1, 0), "c");
+
+	fixed_matrix<std::string, 2, 2> assigned;
+	assigned = std::move(moved);
+	EXPECT_EQ(assigned(0, 1), "b");
+	EXPECT_EQ(assigned(1, 1), "d");
+}
+
 TEST(FixedMatrixUsage, OperationsWithSize) {
 	constexpr int rowsCount = 4;
 	constexpr int columnsCount = 5;
@@ -199,4 +224,375 @@ TEST(FixedMatrixUsage, OperationsWithIterators) {
 	decltype(mtx)::const_iterator it;
 	std::tie(it, std::ignore) = std::mismatch(std::cbegin(mtx), std::cend(mtx), std::crbegin(reversed_mtx));
 	EXPECT_TRUE(std::cend(mtx) == it);
-}
\ No newline at end of file
+}
+
+TEST(FixedMatrixArithmetic, Multiply) {
+	const fixed_matrix<int, 2, 3> a({ 1, 2, 3, 4, 5, 6 });
+	const fixed_matrix<int, 3, 2> b({ 7, 8, 9, 10, 11, 12 });
+	const auto expected = { 58, 64, 139, 154 };
+
+	fixed_matrix<int, 2, 2> c;
+	multiply(a, b, c);
+	EXPECT_EQ((a * b)(1, 1), 154);
+
+	decltype(c)::const_iterator it;
+	std::tie(it, std::ignore) = std::mismatch(std::cbegin(c), std::cend(c), std::cbegin(expected));
+	EXPECT_TRUE(std::cend(c) == it);
+}
+
+TEST(FixedMatrixArithmetic, FusedExpressions) {
+	const fixed_matrix<int, 2, 3> a({ 1, 2, 3, 4, 5, 6 });
+	const fixed_matrix<int, 2, 3> b(1);
+
+	fixed_matrix<int, 2, 3> result = a * 2 - b + -a;
+	const auto expected = { 0, 1, 2, 3, 4, 5 };
+
+	decltype(result)::const_iterator it;
+	std::tie(it, std::ignore) = std::mismatch(std::cbegin(result), std::cend(result), std::cbegin(expected));
+	EXPECT_TRUE(std::cend(result) == it);
+
+	result += b;
+	EXPECT_EQ(result(1, 2), 6);
+
+	const fixed_matrix<int, 3, 2> transposed_shape;
+	EXPECT_THROW(result = a + b * 0 + transposed_shape * 0 + a, std::invalid_argument);
+}
+
+TEST(FixedMatrixArithmetic, Reductions) {
+	const fixed_matrix<double, 2, 3> a({ 1.0, -2.0, 3.0, -4.0, 5.0, -6.0 });
+	const fixed_matrix<double, 2, 3> b(2.0);
+
+	EXPECT_EQ(sum(a), -3.0);
+	EXPECT_EQ(sum(a, summation::kahan), -3.0);
+	EXPECT_EQ(dot(a, b), -6.0);
+	EXPECT_EQ(max_value(a), 5.0);
+	EXPECT_EQ(argmin(a), std::make_pair(std::size_t{ 1 }, std::size_t{ 2 }));
+	EXPECT_EQ(row_sums(a), (std::vector<double>{ 2.0, -5.0 }));
+	EXPECT_EQ(col_sums(a), (std::vector<double>{ -3.0, 3.0, -3.0 }));
+	EXPECT_EQ(col_reduce(a, 0.0, [](double x, double y) { return std::max(x, y); }), (std::vector<double>{ 1.0, 5.0, 3.0 }));
+	EXPECT_DOUBLE_EQ(norm_frobenius(a), std::sqrt(91.0));
+	EXPECT_EQ(norm_l1(a), 9.0);
+	EXPECT_EQ(norm_inf(a), 15.0);
+}
+
+TEST(FixedMatrixKernels, ConstantExpressions) {
+	constexpr fixed_matrix<int, 2, 3> a({ 1, 2, 3, 4, 5, 6 });
+	constexpr fixed_matrix<int, 3, 2> b({ 7, 8, 9, 10, 11, 12 });
+	constexpr auto product = a * b;
+	static_assert(product[0][0] == 58 && product[1][1] == 154);
+
+	constexpr auto transposed = transpose(a);
+	static_assert(transposed[2][0] == 3 && transposed[0][1] == 4);
+
+	constexpr std::array<int, 3> v{ 1, 0, -1 };
+	constexpr auto av = a * v;
+	static_assert(av[0] == -2 && av[1] == -2);
+
+	constexpr fixed_matrix<double, 3, 3> m({ 2.0, 0.0, 0.0, 0.0, 4.0, 0.0, 0.0, 0.0, 8.0 });
+	static_assert(determinant(m) == 64.0);
+	static_assert(inverse(m)[2][2] == 0.125);
+
+	constexpr fixed_matrix<float, 4, 4> f({ 1.f, 2.f, 3.f, 4.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f });
+	static_assert((f * f)[0][3] == 8.f);
+	static_assert(transpose(f)[3][0] == 4.f);
+
+	EXPECT_EQ(product(1, 0), 139);
+}
+
+template<class T, std::size_t N>
+fixed_matrix<T, N, N> random_fixed_matrix(std::mt19937& g)
+{
+	std::uniform_real_distribution<T> dist(-2, 2);
+	fixed_matrix<T, N, N> m;
+	std::generate(std::begin(m), std::end(m), [&] { return dist(g); });
+	for (std::size_t i = 0; i < N; ++i) {
+		m[i][i] += T(N);
+	}
+	return m;
+}
+
+template<class T, std::size_t N>
+void check_inverse(std::mt19937& g, const T tolerance)
+{
+	const auto m = random_fixed_matrix<T, N>(g);
+	const auto identity = m * inverse(m);
+	for (std::size_t i = 0; i < N; ++i) {
+		for (std::size_t j = 0; j < N; ++j) {
+			EXPECT_NEAR(identity(i, j), (i == j) ? T(1) : T(0), tolerance);
+		}
+	}
+
+	// det(m * m) == det(m)^2
+	const T det = determinant(m);
+	EXPECT_NEAR(determinant(m * m), det * det, tolerance * det * det);
+}
+
+TEST(FixedMatrixKernels, InverseAndDeterminant) {
+	std::mt19937 g(7);
+	check_inverse<double, 2>(g, 1e-12);
+	check_inverse<double, 3>(g, 1e-12);
+	check_inverse<double, 4>(g, 1e-12);
+	check_inverse<double, 6>(g, 1e-12);
+	check_inverse<float, 4>(g, 1e-5f);
+
+	const fixed_matrix<long, 5, 5> integers({
+		0, 3, 1, 1, 1,
+		4, 1, 2, 0, -2,
+		2, -1, 0, 3, 1,
+		-1, 0, 2, 2, 0,
+		1, 1, 1, 0, 3 });
+	EXPECT_EQ(determinant(integers), 405);
+
+	const fixed_matrix<double, 3, 3> singular({ 1.0, 2.0, 3.0, 2.0, 4.0, 6.0, 0.0, 1.0, 1.0 });
+	EXPECT_EQ(determinant(singular), 0.0);
+	EXPECT_THROW(inverse(singular), fixed_matrix_error);
+}
+
+TEST(FixedMatrixKernels, Float4x4MatchesGeneric) {
+	std::mt19937 g(11);
+	const auto a = random_fixed_matrix<float, 4>(g);
+	const auto b = random_fixed_matrix<float, 4>(g);
+	const std::array<float, 4> v{ 1.f, -2.f, 0.5f, 3.f };
+
+	fixed_matrix<float, 4, 4> expected;
+	multiply(a, b, expected);
+	const auto product = a * b;
+	const auto transposed = transpose(a);
+	const auto av = a * v;
+	for (std::size_t i = 0; i < 4; ++i) {
+		float expected_av = 0.f;
+		for (std::size_t j = 0; j < 4; ++j) {
+			EXPECT_NEAR(product(i, j), expected(i, j), 1e-5f);
+			EXPECT_EQ(transposed(j, i), a(i, j));
+			expected_av += a(i, j) * v[j];
+		}
+		EXPECT_NEAR(av[i], expected_av, 1e-5f);
+	}
+}
+
+TEST(FixedMatrixUsage, BinaryFile) {
+	const std::string path = ::testing::TempDir() + "fixed_matrix_binary.bin";
+
+	const fixed_matrix<std::int64_t, 3, 5> a{
+		1, 2, 3, 4, 5,
+		-6, -7, -8, -9, -10,
+		11, 12, 13, 14, 15 };
+	save_matrix(path, a);
+
+	const auto loaded = load_matrix<fixed_matrix<std::int64_t, 3, 5>>(path);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(loaded)));
+
+	fixed_matrix<std::int64_t, 5, 3> other_shape;
+	EXPECT_THROW(load_matrix(path, other_shape), matrix_file_error);
+}
+
+TEST(FixedMatrixUsage, Views) {
+	fixed_matrix<int, 3, 4> m{
+		1, 2, 3, 4,
+		5, 6, 7, 8,
+		9, 10, 11, 12 };
+
+	EXPECT_EQ(m.block(1, 1, 2, 2)(1, 0), 10);
+	EXPECT_EQ(m.row(2).count_columns(), 4);
+	EXPECT_EQ(m.column(3)(1, 0), 8);
+	EXPECT_EQ(m.transposed()(3, 0), 4);
+	EXPECT_THROW(m.block(2, 2, 2, 2), std::out_of_range);
+
+	m.block(0, 0, 2, 2) += m.block(1, 2, 2, 2);
+	EXPECT_EQ(m(0, 0), 8);
+	EXPECT_EQ(m(1, 1), 18);
+	m.column(0) = m.row(2).block(0, 1, 1, 3).transposed() * 2;
+	EXPECT_EQ(m(0, 0), 20);
+	EXPECT_EQ(m(2, 0), 24);
+
+	const fixed_matrix<int, 4, 3> t = m.transposed() * 1;
+	EXPECT_EQ(t(3, 2), 12);
+}
+
+TEST(FixedMatrixKernels, Transpose) {
+	constexpr fixed_matrix<int, 3, 3> small({ 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+	constexpr auto small_t = [](fixed_matrix<int, 3, 3> m) { transpose_inplace(m); return m; }(small);
+	static_assert(small_t[0][2] == 7 && small_t[2][1] == 6);
+
+	fixed_matrix<double, 40, 24> a;
+	std::iota(std::begin(a), std::end(a), 0.0);
+	const auto t = transpose(a);
+	fixed_matrix<double, 40, 40> square;
+	std::iota(std::begin(square), std::end(square), 0.0);
+	const auto square_t = transpose(square);
+	transpose_inplace(square);
+	for (std::size_t i = 0; i < 40; ++i) {
+		for (std::size_t j = 0; j < 24; ++j) {
+			EXPECT_EQ(t(j, i), a(i, j));
+		}
+		for (std::size_t j = 0; j < 40; ++j) {
+			EXPECT_EQ(square(j, i), double(i * 40 + j));
+			EXPECT_EQ(square_t(j, i), double(i * 40 + j));
+		}
+	}
+}
+
+TEST(FixedMatrixKernels, Factorizations) {
+	constexpr fixed_matrix<double, 3, 3> a({ 2.0, 1.0, 1.0, 4.0, -6.0, 0.0, -2.0, 7.0, 2.0 });
+	constexpr auto f = lu(a);
+	static_assert(f.pivots[0] == 1 && f.sign == -1);
+	static_assert(f.determinant() == -16.0);
+	constexpr auto x = solve(a, std::array<double, 3>{ 5.0, -2.0, 9.0 });
+	static_assert(x[0] == 1.0 && x[1] == 1.0 && x[2] == 2.0);
+
+	std::mt19937 g(5);
+	const auto m = random_fixed_matrix<double, 6>(g);
+	const auto inv = lu(m).inverse();
+	const auto identity = m * inv;
+	const auto spd = m * transpose(m);
+	const auto c = cholesky(spd);
+	const auto llt = c * transpose(c);
+	const fixed_matrix<double, 6, 4> tall = m.block(0, 0, 6, 4) * 1.0;
+	const auto f_qr = qr(tall);
+	const fixed_matrix<double, 6, 4> q = f_qr.q();
+	const fixed_matrix<double, 4, 4> r = f_qr.r();
+	const auto qr_product = q * r;
+	for (std::size_t i = 0; i < 6; ++i) {
+		for (std::size_t j = 0; j < 6; ++j) {
+			EXPECT_NEAR(identity(i, j), (i == j) ? 1.0 : 0.0, 1e-12);
+			EXPECT_NEAR(llt(i, j), spd(i, j), 1e-12);
+			if (j < i) {
+				EXPECT_EQ(c(j, i), 0.0);
+			}
+			if (j < 4) {
+				EXPECT_NEAR(qr_product(i, j), tall(i, j), 1e-12);
+			}
+		}
+	}
+	const fixed_matrix<double, 6, 6> negative = -spd;
+	EXPECT_THROW(cholesky(negative), matrix_factorization_error);
+}
+
+template<class T, std::size_t R, std::size_t C>
+static fixed_matrix_batch<T, R, C> random_batch(const std::size_t count, const unsigned seed)
+{
+	std::mt19937 g(seed);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	fixed_matrix_batch<T, R, C> batch;
+	for (std::size_t index = 0; index < count; ++index) {
+		fixed_matrix<T, R, C> m;
+		std::generate(std::begin(m), std::end(m), [&]() { return static_cast<T>(dist(g)); });
+		for (std::size_t i = 0; i < std::min(R, C); ++i) {
+			m[i][i] += static_cast<T>(4);
+		}
+		batch.push_back(m);
+	}
+	return batch;
+}
+
+template<class T, std::size_t R, std::size_t C>
+static bool near_equal(const fixed_matrix<T, R, C>& a, const fixed_matrix<T, R, C>& b, const T tolerance)
+{
+	return std::equal(std::cbegin(a), std::cend(a), std::cbegin(b), [tolerance](T x, T y) { return std::abs(x - y) <= tolerance; });
+}
+
+template<class T, std::size_t R, std::size_t C>
+static bool same_elements(const fixed_matrix<T, R, C>& a, const fixed_matrix<T, R, C>& b)
+{
+	return std::equal(std::cbegin(a), std::cend(a), std::cbegin(b));
+}
+
+TEST(FixedMatrixBatch, GatherScatterAndGrowth) {
+	fixed_matrix_batch<float, 4, 4> batch(3, fixed_matrix<float, 4, 4>(1.0f));
+	EXPECT_EQ(batch.size(), 3);
+	EXPECT_EQ(batch.capacity() % batch.lanes, 0);
+	EXPECT_EQ(reinterpret_cast<std::uintptr_t>(batch.element(3, 2)) % 64, 0);
+
+	fixed_matrix<float, 4, 4> m;
+	std::iota(std::begin(m), std::end(m), 0.0f);
+	batch.set(1, m);
+	EXPECT_TRUE(same_elements(batch[1], m));
+	EXPECT_EQ(batch.element(2, 3)[1], 11.0f);
+	EXPECT_TRUE(same_elements(batch.at(2), fixed_matrix<float, 4, 4>(1.0f)));
+	EXPECT_THROW(batch.at(3), fixed_matrix_error);
+
+	for (int i = 0; i < 40; ++i) {
+		batch.push_back(m);
+	}
+	EXPECT_EQ(batch.size(), 43);
+	EXPECT_TRUE(same_elements(batch[1], m));
+	EXPECT_TRUE(same_elements(batch[42], m));
+
+	std::vector<fixed_matrix<float, 4, 4>> matrices(5);
+	batch.gather(38, 5, matrices.data());
+	EXPECT_TRUE(std::all_of(matrices.cbegin(), matrices.cend(), [&m](const auto& x) { return same_elements(x, m); }));
+	matrices[2] = fixed_matrix<float, 4, 4>(7.0f);
+	batch.scatter(matrices.data(), 5, 0);
+	EXPECT_TRUE(same_elements(batch[2], fixed_matrix<float, 4, 4>(7.0f)));
+	EXPECT_THROW(batch.gather(40, 5, matrices.data()), fixed_matrix_error);
+
+	const fixed_matrix_batch<float, 4, 4> copy = batch;
+	batch.resize(2);
+	EXPECT_EQ(copy.size(), 43);
+	EXPECT_TRUE(same_elements(copy[42], m));
+	const fixed_matrix_batch<float, 4, 4> from_range(matrices.cbegin(), matrices.cend());
+	EXPECT_EQ(from_range.size(), 5);
+	EXPECT_TRUE(same_elements(from_range[2], fixed_matrix<float, 4, 4>(7.0f)));
+}
+
+template<class T, std::size_t N>
+static void check_batch_kernels(const T tolerance)
+{
+	const std::size_t count = 3 * matrix_detail::batch_lanes<T> + 5;
+	const auto a = random_batch<T, N, N>(count, 1);
+	const auto b = random_batch<T, N, N>(count, 2);
+	const auto vectors = random_batch<T, N, 1>(count, 3);
+	const fixed_matrix<T, N, N> single = a[7];
+
+	for (auto level : { simd_level::sse2, simd_level::avx2 }) {
+		limit_simd_level(level);
+		const auto product = a * b;
+		const auto transformed = a * vectors;
+		const auto broadcast = single * b;
+		const auto inverses = inverse(matrix_execution::seq, a);
+		const auto transposed = transpose(a);
+		ASSERT_EQ(product.size(), count);
+		for (std::size_t k = 0; k < count; ++k) {
+			EXPECT_TRUE(near_equal(product[k], a[k] * b[k], tolerance));
+			EXPECT_TRUE(near_equal(transformed[k], a[k] * vectors[k], tolerance));
+			EXPECT_TRUE(near_equal(broadcast[k], single * b[k], tolerance));
+			EXPECT_TRUE(near_equal(inverses[k], inverse(a[k]), tolerance));
+			EXPECT_TRUE(same_elements(transposed[k], transpose(a[k])));
+		}
+	}
+	limit_simd_level(simd_level::avx512);
+
+	// The padding lanes past size() stay zero.
+	const auto inverses = inverse(a);
+	for (std::size_t i = 0; i < N; ++i) {
+		for (std::size_t j = 0; j < N; ++j) {
+			const T* values = inverses.element(i, j);
+			EXPECT_TRUE(std::all_of(values + count, values + inverses.capacity(), [](const T x) { return x == T{}; }));
+		}
+	}
+
+	auto in_place = a;
+	multiply(matrix_execution::par, in_place, b, in_place);
+	EXPECT_TRUE(near_equal(in_place[count - 1], a[count - 1] * b[count - 1], tolerance));
+}
+
+TEST(FixedMatrixBatch, KernelsMatchSingleMatrices) {
+	check_batch_kernels<float, 4>(1e-5f);
+	check_batch_kernels<double, 3>(1e-12);
+	check_batch_kernels<double, 2>(1e-12);
+	check_batch_kernels<double, 6>(1e-12);
+}
+
+TEST(FixedMatrixBatch, Errors) {
+	auto batch = random_batch<double, 3, 3>(20, 4);
+	batch.set(13, fixed_matrix<double, 3, 3>(1.0));
+	batch.set(17, fixed_matrix<double, 3, 3>{});
+	try {
+		(void)inverse(batch);
+		FAIL() << "inverse of a singular matrix";
+	}
+	catch (const fixed_matrix_error& e) {
+		EXPECT_NE(std::string(e.what()).find("matrix 13 "), std::string::npos);
+	}
+	EXPECT_THROW((void)(batch * random_batch<double, 3, 3>(19, 5)), fixed_matrix_error);
+}
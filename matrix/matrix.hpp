@@ -11,36 +11,108 @@
 #include <iterator>
 #include <vector>
 #include <cassert>
+#include <cstring>
+#include <utility>
 
-template<class T, class A>
+#include "../matrix_ops/thread_pool.hpp"
+#include "../matrix_ops/expression.hpp"
+#include "../matrix_ops/transpose.hpp"
+#include "../matrix_ops/segmented.hpp"
+#include "matrix_view.hpp"
+#include "matrix_instrumentation.hpp"
+
+// Storage policies for matrix<T, A, S>.
+//
+// row_storage keeps every row in a separate allocation, contiguous_storage keeps
+// all rows in one row-major block. In both cases RowAlignment (in bytes, 0 - none)
+// pads the row stride (space_columns()) to a multiple of RowAlignment, and the
+// rows (or the block) are allocated on RowAlignment boundaries with any
+// allocator. With RowAlignment equal to the cache line size (aligned_matrix) every
+// row starts on its own cache line and fills whole ones: SIMD loops over a row
+// need no peeling for alignment, and threads writing adjacent rows never share
+// a line. The padding is never constructed nor visible through count_columns(),
+// iterators or views.
+template<std::size_t RowAlignment = 0>
+struct row_storage
+{
+	static constexpr bool is_contiguous = false;
+	static constexpr std::size_t row_alignment = RowAlignment;
+};
+
+template<std::size_t RowAlignment = 0>
+struct contiguous_storage
+{
+	static constexpr bool is_contiguous = true;
+	static constexpr std::size_t row_alignment = RowAlignment;
+};
+
+template<class T, class A, class S = row_storage<>>
 struct matrix_base
 {
 	using allocator_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
 	using row_allocator = typename std::allocator_traits<A>::template rebind_alloc<T*>;
 	using size_type = std::size_t;
+	using storage_policy = S;
+
+	static_assert(S::row_alignment == 0 || S::row_alignment % sizeof(T) == 0, 
+		"Row alignment must be a multiple of the element size");
+	static_assert((S::row_alignment & (S::row_alignment - 1)) == 0, "Row alignment must be a power of two");
+
+	static constexpr bool is_contiguous = S::is_contiguous;
 
-	explicit matrix_base(const allocator_type& al) {}
-	explicit matrix_base(const size_type rows, const size_type columns, const T& value, const allocator_type& al)
+	explicit matrix_base(const allocator_type& al) 
+		: alloc_{ row_allocator(al), al } 
+	{}
+	explicit matrix_base(const size_type rows, const size_type columns, const allocator_type& al)
 		: count_rows_{ rows }
 		, count_columns_{ columns }
 		, space_rows_{ rows }
-		, space_columns_{ columns }
-		, alloc_{ row_allocator(), al }
+		, space_columns_{ row_stride(columns) }
+		, alloc_{ row_allocator(al), al }
 	{
-		if (count_rows_ == 0) return;
-		elem_ = alloc_.allocate(count_rows_);
-
-		if (count_columns_ == 0) return;
+		if (count_rows_ == 0 || count_columns_ == 0) {
+			space_rows_ = space_columns_ = 0;
+			return;
+		}
 		elem_ = allocate_matrix();
 	}
 
+	matrix_base(const matrix_base&) = delete;
+	matrix_base& operator=(const matrix_base&) = delete;
+
+	matrix_base(matrix_base&& other) noexcept
+		: elem_{ std::exchange(other.elem_, nullptr) }
+		, count_rows_{ std::exchange(other.count_rows_, 0) }
+		, count_columns_{ std::exchange(other.count_columns_, 0) }
+		, space_rows_{ std::exchange(other.space_rows_, 0) }
+		, space_columns_{ std::exchange(other.space_columns_, 0) }
+		, alloc_{ std::move(other.alloc_) }
+	{}
+	matrix_base& operator=(matrix_base&&) = delete;
+
 	~matrix_base() { deallocate_matrix(); }
 
 	allocator_type& get_allocator() { return alloc_.inner_allocator(); }
+	allocator_type get_allocator() const { return alloc_.inner_allocator(); }
 
-	void swap(matrix_base& other)
+	// Swaps storage together with the allocators.
+	void swap(matrix_base& other) noexcept
 	{
 		std::swap(alloc_, other.alloc_);
+		swap_storage(other);
+	}
+
+	// Number of elements allocated per row for the given number of columns.
+	static constexpr size_type row_stride(const size_type columns) noexcept
+	{
+		constexpr size_type step = (S::row_alignment > sizeof(T)) ? S::row_alignment / sizeof(T) : 1;
+		return (columns + step - 1) / step * step;
+	}
+
+protected:
+	// Swaps storage only, the allocators must be equal.
+	inline void swap_storage(matrix_base& other) noexcept
+	{
 		std::swap(elem_, other.elem_);
 		std::swap(count_rows_, other.count_rows_);
 		std::swap(count_columns_, other.count_columns_);
@@ -48,33 +120,172 @@ struct matrix_base
 		std::swap(space_columns_, other.space_columns_);
 	}
 
-protected:
+	// Takes the storage of 'other' leaving it empty. The own storage must be 
+	// released before, the allocator is left as is.
+	inline void take_storage(matrix_base& other) noexcept
+	{
+		elem_ = std::exchange(other.elem_, nullptr);
+		count_rows_ = std::exchange(other.count_rows_, 0);
+		count_columns_ = std::exchange(other.count_columns_, 0);
+		space_rows_ = std::exchange(other.space_rows_, 0);
+		space_columns_ = std::exchange(other.space_columns_, 0);
+	}
+
+	// Allocates storage for rows x columns elements ('columns' is a row stride),
+	// nothing is allocated if one of them is zero.
+	inline void allocate_space(const size_type rows, const size_type columns)
+	{
+		assert(elem_ == nullptr);
+		if (rows == 0 || columns == 0) return;
+		space_rows_ = rows;
+		space_columns_ = columns;
+		elem_ = allocate_matrix();
+	}
+
+	// Row storage only: enlarges the row table and allocates the new rows, 
+	// the existing rows stay where they are.
+	inline void grow_row_table(const size_type rows)
+	{
+		static_assert(!is_contiguous, "Rows of contiguous storage can't be reallocated separately");
+		assert(elem_ != nullptr && rows > space_rows_);
+
+		auto table = allocate_table(rows);
+		size_type row = space_rows_;
+		try {
+			for (; row < rows; ++row) {
+				table[row] = allocate_row();
+			}
+		}
+		catch (...) {
+			while (row-- > space_rows_) {
+				deallocate_elements(table[row], space_columns_);
+			}
+			deallocate_table(table, rows);
+			throw;
+		}
+		std::copy_n(elem_, space_rows_, table);
+		deallocate_table(elem_, space_rows_);
+		elem_ = table;
+		space_rows_ = rows;
+	}
+
+	// Over-aligned rows are allocated as arrays of row_alignment-byte chunks
+	// through the allocator rebound to the chunk type: the allocator has to
+	// honour the alignment of the type it allocates, as it does for any
+	// over-aligned type.
+	template<std::size_t Alignment>
+	struct alignas(Alignment) aligned_chunk
+	{
+		unsigned char bytes[Alignment];
+	};
+	static constexpr bool is_over_aligned = S::row_alignment > alignof(T);
+	using chunk_type = std::conditional_t<is_over_aligned, aligned_chunk<(is_over_aligned ? S::row_alignment : 1)>, T>;
+	using chunk_allocator = typename std::allocator_traits<A>::template rebind_alloc<chunk_type>;
+
+	static constexpr size_type count_chunks(const size_type count) noexcept
+	{
+		return (count * sizeof(T) + sizeof(chunk_type) - 1) / sizeof(chunk_type);
+	}
+
+	inline T* allocate_elements(const size_type count)
+	{
+		if constexpr (matrix_detail::counts_matrix_allocations<A>) {
+			matrix_instrumentation::record_allocation(count_chunks(count) * sizeof(chunk_type));
+		}
+		if constexpr (is_over_aligned) {
+			chunk_allocator chunks(alloc_.inner_allocator());
+			return reinterpret_cast<T*>(std::addressof(*std::allocator_traits<chunk_allocator>::allocate(chunks, count_chunks(count))));
+		}
+		else {
+			return (alloc_.inner_allocator()).allocate(count);
+		}
+	}
+	inline void deallocate_elements(T* elements, const size_type count)
+	{
+		if constexpr (matrix_detail::counts_matrix_allocations<A>) {
+			matrix_instrumentation::record_deallocation(count_chunks(count) * sizeof(chunk_type));
+		}
+		if constexpr (is_over_aligned) {
+			chunk_allocator chunks(alloc_.inner_allocator());
+			std::allocator_traits<chunk_allocator>::deallocate(chunks, reinterpret_cast<chunk_type*>(elements), count_chunks(count));
+		}
+		else {
+			(alloc_.inner_allocator()).deallocate(elements, count);
+		}
+	}
+
+	inline T** allocate_table(const size_type rows)
+	{
+		if constexpr (matrix_detail::counts_matrix_allocations<A>) {
+			matrix_instrumentation::record_allocation(rows * sizeof(T*));
+		}
+		return alloc_.allocate(rows);
+	}
+	inline void deallocate_table(T** table, const size_type rows)
+	{
+		if constexpr (matrix_detail::counts_matrix_allocations<A>) {
+			matrix_instrumentation::record_deallocation(rows * sizeof(T*));
+		}
+		alloc_.deallocate(table, rows);
+	}
+
 	inline T* allocate_row()
 	{
-		return (alloc_.inner_allocator()).allocate(space_columns_);
+		return allocate_elements(space_columns_);
 	}
 	inline void deallocate_row(const size_type row)
 	{
 		assert(elem_ != nullptr);
-		assert(row < count_rows_);
-		return (alloc_.inner_allocator()).deallocate(elem_[row], space_columns_);
+		assert(row < space_rows_);
+		deallocate_elements(elem_[row], space_columns_);
 	}
 
 	inline T** allocate_matrix()
 	{
-		auto result = alloc_.allocate(space_rows_);
-		for (size_type row = 0; row < space_rows_; ++row) {
-			result[row] = allocate_row();
+		auto result = allocate_table(space_rows_);
+		if constexpr (is_contiguous) {
+			T* block = nullptr;
+			try {
+				block = allocate_elements(space_rows_ * space_columns_);
+			}
+			catch (...) {
+				deallocate_table(result, space_rows_);
+				throw;
+			}
+			for (size_type row = 0; row < space_rows_; ++row) {
+				result[row] = block + row * space_columns_;
+			}
+		}
+		else {
+			size_type row = 0;
+			try {
+				for (; row < space_rows_; ++row) {
+					result[row] = allocate_row();
+				}
+			}
+			catch (...) {
+				while (row-- > 0) {
+					deallocate_elements(result[row], space_columns_);
+				}
+				deallocate_table(result, space_rows_);
+				throw;
+			}
 		}
 		return result;
 	}
 	inline void deallocate_matrix()
 	{
-		assert(elem_ != nullptr);
-		for (size_type row = 0; row < space_rows_; ++row) {
-			deallocate_row(row);
+		if (elem_ == nullptr) return;
+		if constexpr (is_contiguous) {
+			deallocate_elements(elem_[0], space_rows_ * space_columns_);
 		}
-		alloc_.deallocate(elem_, space_rows_);
+		else {
+			for (size_type row = 0; row < space_rows_; ++row) {
+				deallocate_row(row);
+			}
+		}
+		deallocate_table(elem_, space_rows_);
+		elem_ = nullptr;
 	}
 
 	inline void destroy_row(const size_type row)
@@ -93,19 +304,6 @@ protected:
 		}
 	}
 
-	inline void destroy_and_deallocate_row(const size_type row)
-	{
-		destroy_row(row);
-		deallocate_row(row);
-	}
-
-	inline void destroy_and_deallocate_matrix()
-	{
-		for (size_type row = 0; row < count_rows_; ++row) {
-			destroy_and_deallocate_row(row);
-		}
-	}
-
 	template<class... Args>
 	static inline void construct(T* ptr, Args&&... args) { ::new(static_cast<void*>(ptr)) T(std::forward<Args>(args)...); }
 	static inline void destroy(T* ptr) noexcept { ptr->~T(); }
@@ -113,6 +311,7 @@ protected:
 	inline void check_row_index(const size_type index) const
 	{
 		if (index >= count_rows_) {
+			if constexpr (matrix_instrumentation::enabled) matrix_instrumentation::record_range_error();
 			throw std::out_of_range{ "Row index is out of range" };
 		}
 	}
@@ -120,6 +319,7 @@ protected:
 	inline void check_column_index(const size_type index) const
 	{
 		if (index >= count_columns_) {
+			if constexpr (matrix_instrumentation::enabled) matrix_instrumentation::record_range_error();
 			throw std::out_of_range{ "Column index is out of range" };
 		}
 	}
@@ -142,8 +342,8 @@ protected:
 	std::scoped_allocator_adaptor<row_allocator, allocator_type> alloc_;
 };
 
-template<typename T, typename A = std::allocator<T>>
-struct matrix : public matrix_base<T, A>
+template<typename T, typename A = std::allocator<T>, typename S = row_storage<>>
+struct matrix : public matrix_base<T, A, S>
 {
 private:
 	struct MstrixIteratorTag{};
@@ -166,14 +366,18 @@ public:
 	using reverse_iterator = std::reverse_iterator<iterator>;
 	using const_reverce_iterator = std::reverse_iterator<const_iterator>;
 
-	using base = matrix_base<T, A>;
+	using base = matrix_base<T, A, S>;
 	using allocator_type = typename base::allocator_type;
+	using storage_policy = S;
 
+	static constexpr bool is_contiguous = base::is_contiguous;
+
+	// Without columns there are no elements: end() is then begin().
 	inline iterator begin() noexcept { return { this->elem_, this->count_columns_ }; }
-	inline iterator end() noexcept { return { (this->elem_ + this->count_rows_), this->count_columns_ }; }
+	inline iterator end() noexcept { return { this->elem_ + end_row(), this->count_columns_ }; }
 
-	inline const_iterator cbegin() const noexcept { return { this->elem_, 0, this->count_columns_ }; }
-	inline const_iterator cend() const noexcept { return { (this->elem_ + this->count_rows_), this->count_columns_ }; }
+	inline const_iterator cbegin() const noexcept { return { this->elem_, this->count_columns_ }; }
+	inline const_iterator cend() const noexcept { return { this->elem_ + end_row(), this->count_columns_ }; }
 
 	inline const_iterator begin() const noexcept { return cbegin(); }
 	inline const_iterator end() const noexcept { return cend(); }
@@ -195,9 +399,19 @@ public:
 	explicit matrix(
 		const size_type rows,
 		const size_type columns
-	) : base{ rows, columns, T{}, allocator_type{} }
+	) : base{ rows, columns, allocator_type{} }
 	{
-		std::uninitialized_fill(begin(), end(), T{});
+		construct_all(matrix_execution::seq, T{});
+	}
+
+	// For allocators without a default constructor (pool_allocator, arena_allocator).
+	explicit matrix(
+		const size_type rows,
+		const size_type columns,
+		const allocator_type& alloc
+	) : base{ rows, columns, alloc }
+	{
+		construct_all(matrix_execution::seq, T{});
 	}
 
 	explicit matrix(
@@ -205,20 +419,189 @@ public:
 		const size_type columns, 
 		const T& value,
 		const allocator_type& alloc = allocator_type{}
-	) : base{ rows, columns, value, alloc }
+	) : base{ rows, columns, alloc }
+	{
+		construct_all(matrix_execution::seq, value);
+	}
+
+	// With matrix_execution::par rows are filled by the shared thread pool.
+	template<class ExecutionPolicy, class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+	explicit matrix(
+		const ExecutionPolicy& policy,
+		const size_type rows,
+		const size_type columns,
+		const T& value = T{},
+		const allocator_type& alloc = allocator_type{}
+	) : base{ rows, columns, alloc }
+	{
+		construct_all(policy, value);
+	}
+
+	matrix(const matrix& other)
+		: matrix(other, alloc_traits::select_on_container_copy_construction(other.get_allocator()))
+	{}
+
+	matrix(const matrix& other, const allocator_type& alloc)
+		: base{ other.count_rows_, other.count_columns_, alloc }
 	{
-		std::uninitialized_fill(begin(), end(), value);
+		construct_rows([this, &other](const size_type row) {
+			matrix_detail::uninitialized_copy_elements(other.elem_[row], this->count_columns_, this->elem_[row]);
+		});
+		if constexpr (matrix_instrumentation::enabled) {
+			matrix_instrumentation::record_element_copies(this->count_rows_ * this->count_columns_);
+		}
+	}
+
+	matrix(matrix&& other) noexcept
+		: base{ std::move(other) }
+	{}
+
+	// Takes the storage of 'other' if the allocators are equal, 
+	// otherwise moves the elements one by one.
+	matrix(matrix&& other, const allocator_type& alloc)
+		: base{ alloc }
+	{
+		if (alloc_traits::is_always_equal::value || this->get_allocator() == other.get_allocator()) {
+			this->take_storage(other);
+		}
+		else {
+			matrix tmp(other.count_rows_, other.count_columns_, alloc, uninitialized_tag{});
+			tmp.construct_rows([&tmp, &other](const size_type row) {
+				std::uninitialized_move_n(other.elem_[row], tmp.count_columns_, tmp.elem_[row]);
+			});
+			base::swap(tmp);
+		}
+	}
+
+	// Evaluates an element-wise expression (see expression.hpp) in a single pass.
+	template<class E>
+	matrix(const matrix_expression<E>& expression, const allocator_type& alloc = allocator_type{})
+		: base{ expression.self().count_rows(), expression.self().count_columns(), alloc }
+	{
+		if constexpr (std::is_nothrow_constructible_v<T, typename E::value_type>) {
+			matrix_detail::evaluate(matrix_execution::par, *this, expression.self(), matrix_detail::construct_op{});
+		}
+		else {
+			construct_all(matrix_execution::seq, T{});
+			matrix_detail::evaluate(matrix_execution::seq, *this, expression.self(), matrix_detail::assign_op{});
+		}
 	}
 
 	~matrix() { destroy_all(); }
 
+	// Strong exception guarantee: the copy is built aside and then swapped in,
+	// unless the rows can be copied over in place without throwing.
+	matrix& operator=(const matrix& other)
+	{
+		if (this == &other) {
+			return *this;
+		}
+		if constexpr (std::is_nothrow_copy_assignable_v<T> && !alloc_traits::propagate_on_container_copy_assignment::value) {
+			if (this->count_rows_ == other.count_rows_ && this->count_columns_ == other.count_columns_) {
+				for (size_type row = 0; row < this->count_rows_; ++row) {
+					matrix_detail::copy_elements(other.elem_[row], this->count_columns_, this->elem_[row]);
+				}
+				if constexpr (matrix_instrumentation::enabled) {
+					matrix_instrumentation::record_element_copies(this->count_rows_ * this->count_columns_);
+				}
+				return *this;
+			}
+		}
+		matrix tmp(other, alloc_traits::propagate_on_container_copy_assignment::value ? other.get_allocator() : this->get_allocator());
+		base::swap(tmp);
+		return *this;
+	}
+
+	matrix& operator=(matrix&& other) noexcept(
+		alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+	{
+		if (this == &other) {
+			return *this;
+		}
+		if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+			clear_storage();
+			this->alloc_ = other.alloc_;
+			this->take_storage(other);
+		}
+		else {
+			if (alloc_traits::is_always_equal::value || this->get_allocator() == other.get_allocator()) {
+				clear_storage();
+				this->take_storage(other);
+			}
+			else {
+				matrix tmp(std::move(other), this->get_allocator());
+				base::swap(tmp);
+			}
+		}
+		return *this;
+	}
+
+	// Allocators are exchanged only if they propagate on swap, 
+	// otherwise they must be equal.
+	void swap(matrix& other) noexcept
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value) {
+			base::swap(other);
+		}
+		else {
+			assert(this->get_allocator() == other.get_allocator());
+			this->swap_storage(other);
+		}
+	}
+
+	template<class E>
+	matrix& operator=(const matrix_expression<E>& expression)
+	{
+		const auto& e = expression.self();
+		if (e.count_rows() == this->count_rows_ && e.count_columns() == this->count_columns_) {
+			matrix_detail::evaluate(matrix_execution::par, *this, e, matrix_detail::assign_op{});
+		}
+		else {
+			matrix tmp(expression, this->get_allocator());
+			base::swap(tmp);
+		}
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	matrix& operator+=(const E& e)
+	{
+		matrix_detail::evaluate(matrix_execution::par, *this, matrix_detail::make_operand(e), matrix_detail::add_assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	matrix& operator-=(const E& e)
+	{
+		matrix_detail::evaluate(matrix_execution::par, *this, matrix_detail::make_operand(e), matrix_detail::subtract_assign_op{});
+		return *this;
+	}
+
 
 	inline size_type count_rows() const noexcept { return this->count_rows_; }
 	inline size_type count_columns() const noexcept { return this->count_columns_; }
 
 	inline size_type space_rows() const noexcept { return this->space_rows_; }
+	// Number of elements allocated per row. For contiguous storage this is also 
+	// the distance between the beginnings of two adjacent rows.
 	inline size_type space_columns() const noexcept { return this->space_columns_; }
 
+	// Available only for contiguous storage: rows are laid out one after another 
+	// with the stride of space_columns() elements.
+	inline pointer data() noexcept
+	{
+		static_assert(is_contiguous, "matrix::data() requires contiguous_storage");
+		return (this->elem_ == nullptr) ? nullptr : this->elem_[0];
+	}
+	inline const_pointer data() const noexcept
+	{
+		static_assert(is_contiguous, "matrix::data() requires contiguous_storage");
+		return (this->elem_ == nullptr) ? nullptr : this->elem_[0];
+	}
+
+	inline T* operator[](const size_type row) noexcept { return this->elem_[row]; }
+	inline const T* operator[](const size_type row) const noexcept { return this->elem_[row]; }
+
 	T& operator()(const size_type row, const size_type column)
 	{
 		this->check_indexes(row, column);
@@ -230,7 +613,496 @@ public:
 		return this->elem_[row][column];
 	}
 
+	// Views of the elements (see matrix_view.hpp), invalidated by reallocation.
+	// With contiguous storage the views are strided, with row storage they
+	// refer to the row table.
+	matrix_view<T> view() noexcept
+	{
+		if constexpr (is_contiguous) return { data(), this->count_rows_, this->count_columns_, this->space_columns_ };
+		else return { this->elem_, this->count_rows_, this->count_columns_, 0 };
+	}
+	const_matrix_view<T> view() const noexcept
+	{
+		if constexpr (is_contiguous) return { data(), this->count_rows_, this->count_columns_, this->space_columns_ };
+		else return { this->elem_, this->count_rows_, this->count_columns_, 0 };
+	}
+
+	inline matrix_view<T> block(const size_type row, const size_type column, const size_type rows, const size_type columns) { return view().block(row, column, rows, columns); }
+	inline const_matrix_view<T> block(const size_type row, const size_type column, const size_type rows, const size_type columns) const { return view().block(row, column, rows, columns); }
+	inline matrix_view<T> row(const size_type index) { return view().row(index); }
+	inline const_matrix_view<T> row(const size_type index) const { return view().row(index); }
+	inline matrix_view<T> column(const size_type index) { return view().column(index); }
+	inline const_matrix_view<T> column(const size_type index) const { return view().column(index); }
+	inline transposed_view<T> transposed() noexcept { return view().transposed(); }
+	inline transposed_view<const T> transposed() const noexcept { return view().transposed(); }
+
+	// Transposes the matrix in place (see matrix_ops/transpose.hpp). Square
+	// matrices swap tiles across the diagonal. A non-square contiguous matrix of
+	// trivially copyable elements is permuted inside its block when the block can
+	// hold the new shape with row_stride(count_rows()) and only the row table is
+	// reallocated. Otherwise the transpose is built in new storage, which is
+	// all transpose_inplace can do for row storage.
+	void transpose_inplace() { transpose_inplace(matrix_execution::par); }
+	friend void transpose_inplace(matrix& m) { m.transpose_inplace(); }
+
+	// Transposed copy, with the blocked kernels for trivially copyable elements.
+	friend matrix transpose(const matrix& m)
+	{
+		return matrix(transpose_tag{}, matrix_execution::par, m,
+			alloc_traits::select_on_container_copy_construction(m.get_allocator()));
+	}
+
+	template<class ExecutionPolicy>
+	void transpose_inplace(const ExecutionPolicy& policy)
+	{
+		const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::transpose };
+		if (this->count_rows_ == this->count_columns_) {
+			matrix_detail::transpose_square_inplace(policy, view());
+			return;
+		}
+		if (this->elem_ == nullptr) {
+			std::swap(this->count_rows_, this->count_columns_);
+			return;
+		}
+		if constexpr (is_contiguous && std::is_trivially_copyable_v<T>) {
+			if (transpose_in_block()) return;
+		}
+		matrix tmp(transpose_tag{}, policy, *this, this->get_allocator());
+		this->swap_storage(tmp);
+	}
+
+	// Capacity management and growth.
+	//
+	// space_rows() x space_columns() elements are allocated, growing beyond that
+	// reallocates the storage geometrically, so appending a row or a column costs
+	// amortized O(count_columns()) or O(count_rows()). With row_storage growing the 
+	// number of rows only reallocates the row table: the rows are not moved and
+	// pointers to them stay valid. Elements are moved to new storage if their move
+	// constructor can't throw, otherwise copied.
+	//
+	// All operations except erase_row leave the elements unchanged if an exception
+	// is thrown (the capacity may have grown).
+
+	// A zero dimension means the current one.
+	void reserve(const size_type rows, const size_type columns)
+	{
+		ensure_space(std::max(rows, this->count_rows_), std::max(columns, this->count_columns_));
+	}
+
+	void resize(const size_type rows, const size_type columns) { resize(rows, columns, T{}); }
+
+	// New elements are copies of 'value'.
+	void resize(const size_type rows, const size_type columns, const T& value)
+	{
+		ensure_space(grown_space(this->space_rows_, rows), grown_space(this->space_columns_, columns));
+
+		const size_type kept_rows = std::min(rows, this->count_rows_);
+		const size_type old_columns = this->count_columns_;
+		size_type row = 0;
+		size_type new_row = this->count_rows_;
+		try {
+			if (columns > old_columns) {
+				for (; row < kept_rows; ++row) {
+					std::uninitialized_fill(this->elem_[row] + old_columns, this->elem_[row] + columns, value);
+				}
+			}
+			if (columns != 0) {
+				for (; new_row < rows; ++new_row) {
+					std::uninitialized_fill_n(this->elem_[new_row], columns, value);
+				}
+			}
+		}
+		catch (...) {
+			while (new_row-- > this->count_rows_) {
+				destroy_range(this->elem_[new_row], this->elem_[new_row] + columns);
+			}
+			while (row-- > 0) {
+				destroy_range(this->elem_[row] + old_columns, this->elem_[row] + columns);
+			}
+			throw;
+		}
+
+		if (columns < old_columns) {
+			for (row = 0; row < kept_rows; ++row) {
+				destroy_range(this->elem_[row] + columns, this->elem_[row] + old_columns);
+			}
+		}
+		if (old_columns != 0) {
+			for (row = rows; row < this->count_rows_; ++row) {
+				destroy_range(this->elem_[row], this->elem_[row] + old_columns);
+			}
+		}
+		this->count_rows_ = rows;
+		this->count_columns_ = columns;
+	}
+
+	// Releases the unused capacity, including the row padding left after shrinking columns.
+	void shrink_to_fit()
+	{
+		if (this->elem_ == nullptr) return;
+		if (this->count_rows_ == 0 || this->count_columns_ == 0) {
+			destroy_all();
+			this->deallocate_matrix();
+			this->space_rows_ = this->space_columns_ = 0;
+			return;
+		}
+		if (this->space_rows_ == this->count_rows_ && this->space_columns_ == base::row_stride(this->count_columns_)) return;
+		reallocate(this->count_rows_, base::row_stride(this->count_columns_), this->count_rows_,
+			[this](const size_type row) { return this->elem_[row]; });
+	}
+
+	// Appends a row copied from a range of count_columns() values. The first row
+	// added to a matrix without rows defines the number of columns.
+	template<class Row>
+	void push_row(const Row& values) { insert_row(this->count_rows_, values); }
+	void push_row(std::initializer_list<T> values) { insert_row(this->count_rows_, values); }
+
+	// Appends a row with every element constructed from 'args'.
+	template<class... Args>
+	T* emplace_row(Args&&... args)
+	{
+		const size_type row = this->count_rows_;
+		make_row_space(this->count_columns_);
+		if (this->count_columns_ != 0) {
+			T* dst = this->elem_[row];
+			size_type column = 0;
+			try {
+				for (; column < this->count_columns_; ++column) {
+					base::construct(dst + column, args...);
+				}
+			}
+			catch (...) {
+				destroy_range(dst, dst + column);
+				throw;
+			}
+		}
+		++this->count_rows_;
+		return this->elem_ == nullptr ? nullptr : this->elem_[row];
+	}
+
+	// Inserts a row copied from a range of count_columns() values before the row 'index'.
+	template<class Row>
+	void insert_row(const size_type index, const Row& values)
+	{
+		if (index > this->count_rows_) {
+			if constexpr (matrix_instrumentation::enabled) matrix_instrumentation::record_range_error();
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		const size_type columns = static_cast<size_type>(std::size(values));
+		if (columns != this->count_columns_ && this->count_rows_ != 0) {
+			throw std::invalid_argument{ "Row size does not match the number of columns" };
+		}
+
+		make_row_space(columns);
+		const size_type last = this->count_rows_;
+		if (columns != 0) {
+			std::uninitialized_copy_n(std::begin(values), columns, this->elem_[last]);
+		}
+		this->count_columns_ = columns;
+		if (index == last || columns == 0) {
+			++this->count_rows_;
+			return;
+		}
+
+		if constexpr (!is_contiguous) {
+			std::rotate(this->elem_ + index, this->elem_ + last, this->elem_ + last + 1);
+			++this->count_rows_;
+		}
+		else if constexpr (std::is_nothrow_swappable_v<T>) {
+			for (size_type row = last; row > index; --row) {
+				std::swap_ranges(this->elem_[row - 1], this->elem_[row - 1] + columns, this->elem_[row]);
+			}
+			++this->count_rows_;
+		}
+		else {
+			// Rows can't be shifted without the risk of an exception in the middle,
+			// a reordered copy is built instead.
+			++this->count_rows_;
+			try {
+				reallocate(this->space_rows_, this->space_columns_, last + 1, [this, index, last](const size_type row) {
+					return this->elem_[(row < index) ? row : (row == index) ? last : row - 1];
+				});
+			}
+			catch (...) {
+				--this->count_rows_;
+				destroy_range(this->elem_[last], this->elem_[last] + columns);
+				throw;
+			}
+		}
+	}
+	void insert_row(const size_type index, std::initializer_list<T> values) { insert_row<std::initializer_list<T>>(index, values); }
+
+	// Removes the row 'index'. With contiguous storage the following rows are
+	// moved up by move assignment, if that throws the matrix is left valid
+	// but with unspecified contents of the moved rows.
+	void erase_row(const size_type index)
+	{
+		this->check_row_index(index);
+		const size_type last = this->count_rows_ - 1;
+		if (this->count_columns_ != 0) {
+			if constexpr (!is_contiguous) {
+				destroy_range(this->elem_[index], this->elem_[index] + this->count_columns_);
+				std::rotate(this->elem_ + index, this->elem_ + index + 1, this->elem_ + this->count_rows_);
+			}
+			else {
+				for (size_type row = index; row < last; ++row) {
+					std::move(this->elem_[row + 1], this->elem_[row + 1] + this->count_columns_, this->elem_[row]);
+				}
+				destroy_range(this->elem_[last], this->elem_[last] + this->count_columns_);
+			}
+		}
+		this->count_rows_ = last;
+	}
+
+	// Appends a column copied from a range of count_rows() values. The first column
+	// added to an empty matrix defines the number of rows.
+	template<class Column>
+	void push_column(const Column& values)
+	{
+		const size_type rows = static_cast<size_type>(std::size(values));
+		if (rows != this->count_rows_ && (this->count_rows_ != 0 || this->count_columns_ != 0)) {
+			throw std::invalid_argument{ "Column size does not match the number of rows" };
+		}
+
+		const size_type column = this->count_columns_;
+		ensure_space(rows, grown_space(this->space_columns_, column + 1));
+
+		size_type row = 0;
+		try {
+			auto it = std::begin(values);
+			for (; row < rows; ++row, ++it) {
+				base::construct(this->elem_[row] + column, *it);
+			}
+		}
+		catch (...) {
+			while (row-- > 0) {
+				base::destroy(this->elem_[row] + column);
+			}
+			throw;
+		}
+		this->count_rows_ = rows;
+		++this->count_columns_;
+	}
+	void push_column(std::initializer_list<T> values) { push_column<std::initializer_list<T>>(values); }
+
+	void fill(const T& value) { fill(matrix_execution::seq, value); }
+
+	template<class ExecutionPolicy>
+	void fill(const ExecutionPolicy& policy, const T& value)
+	{
+		if (this->elem_ == nullptr) return;
+		matrix_execution::for_each_tile(policy, 0, this->count_rows_, matrix_execution::row_grain(this->count_columns_),
+			[this, &value](const size_type first, const size_type last) {
+				for (size_type row = first; row < last; ++row) {
+					matrix_detail::fill_elements(matrix_detail::assume_aligned<S::row_alignment>(this->elem_[row]), this->count_columns_, value);
+				}
+			});
+	}
+
 private:
+	using alloc_traits = std::allocator_traits<allocator_type>;
+
+	inline size_type end_row() const noexcept { return this->count_columns_ == 0 ? 0 : this->count_rows_; }
+
+	struct uninitialized_tag {};
+
+	// Allocates storage without constructing elements, they must be constructed 
+	// with construct_rows() before the constructor exits.
+	matrix(const size_type rows, const size_type columns, const allocator_type& alloc, uninitialized_tag)
+		: base{ rows, columns, alloc }
+	{}
+
+	struct transpose_tag {};
+
+	// Transpose of 'other', with its allocator. 'alloc' is taken by value: GCC 12
+	// reports a reference to the (empty) allocator of *this as maybe uninitialized.
+	template<class ExecutionPolicy>
+	matrix(transpose_tag, const ExecutionPolicy& policy, const matrix& other, allocator_type alloc)
+		: base{ other.count_columns_, other.count_rows_, alloc }
+	{
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (this->elem_ != nullptr) {
+				::transpose(policy, other.view(), view());
+			}
+		}
+		else {
+			construct_rows([this, &other](const size_type row) {
+				size_type column = 0;
+				try {
+					for (; column < this->count_columns_; ++column) {
+						base::construct(this->elem_[row] + column, other.elem_[column][row]);
+					}
+				}
+				catch (...) {
+					destroy_range(this->elem_[row], this->elem_[row] + column);
+					throw;
+				}
+			});
+		}
+	}
+
+	struct reserve_tag {};
+
+	// Empty matrix with storage for space_rows x space_columns elements.
+	matrix(reserve_tag, const size_type space_rows, const size_type space_columns, const allocator_type& alloc)
+		: base{ alloc }
+	{
+		this->allocate_space(space_rows, space_columns);
+	}
+
+	// Capacity to grow to if 'required' elements don't fit into 'space'.
+	static constexpr size_type grown_space(const size_type space, const size_type required) noexcept
+	{
+		return (required <= space) ? space : std::max(required, 2 * space);
+	}
+
+	// Provides storage for at least rows x columns elements keeping the elements.
+	void ensure_space(size_type rows, size_type columns)
+	{
+		if (rows == 0 || columns == 0) return;
+
+		columns = base::row_stride(columns);
+		if (this->elem_ != nullptr) {
+			if (rows <= this->space_rows_ && columns <= this->space_columns_) return;
+			rows = std::max(rows, this->space_rows_);
+			columns = std::max(columns, this->space_columns_);
+			if constexpr (!is_contiguous) {
+				if (columns == this->space_columns_) {
+					this->grow_row_table(rows);
+					return;
+				}
+			}
+		}
+		reallocate(rows, columns, this->count_rows_, [this](const size_type row) { return this->elem_[row]; });
+	}
+
+	// Room for one more row of 'columns' elements.
+	inline void make_row_space(const size_type columns)
+	{
+		ensure_space(grown_space(this->space_rows_, this->count_rows_ + 1), std::max(columns, this->count_columns_));
+	}
+
+	// Moves 'rows' rows to new storage of the given capacity, row i of the new
+	// storage is taken from source_row(i). The elements are copied if moving 
+	// them may throw, so nothing changes if an exception is thrown.
+	template<class SourceRow>
+	void reallocate(const size_type space_rows, const size_type space_columns, const size_type rows, SourceRow source_row)
+	{
+		matrix tmp(reserve_tag{}, space_rows, space_columns, this->get_allocator());
+		tmp.count_columns_ = this->count_columns_;
+		if (this->count_columns_ != 0) {
+			for (; tmp.count_rows_ < rows; ++tmp.count_rows_) {
+				T* src = source_row(tmp.count_rows_);
+				if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+					std::uninitialized_move_n(src, this->count_columns_, tmp.elem_[tmp.count_rows_]);
+				}
+				else {
+					std::uninitialized_copy_n(src, this->count_columns_, tmp.elem_[tmp.count_rows_]);
+				}
+			}
+		}
+		tmp.count_rows_ = rows;
+		this->swap_storage(tmp);
+	}
+
+	static inline void destroy_range(T* first, T* last) noexcept
+	{
+		for (; first != last; ++first) {
+			base::destroy(first);
+		}
+	}
+
+	// Calls construct_row(row) for every row. construct_row must either construct all
+	// elements of the row or none, the rows constructed before a failure are destroyed.
+	template<class RowConstructor>
+	void construct_rows(RowConstructor construct_row)
+	{
+		if (this->elem_ == nullptr) return;
+
+		size_type row = 0;
+		try {
+			for (; row < this->count_rows_; ++row) {
+				construct_row(row);
+			}
+		}
+		catch (...) {
+			while (row-- > 0) {
+				this->destroy_row(row);
+			}
+			throw;
+		}
+	}
+
+	inline void clear_storage() noexcept
+	{
+		destroy_all();
+		this->deallocate_matrix();
+		this->count_rows_ = this->count_columns_ = 0;
+		this->space_rows_ = this->space_columns_ = 0;
+	}
+
+	// Rows are filled in parallel only if copying can't throw, otherwise
+	// the already constructed rows are destroyed on failure.
+	template<class ExecutionPolicy>
+	void construct_all(const ExecutionPolicy& policy, const T& value)
+	{
+		if (this->elem_ == nullptr) return;
+		if constexpr (std::is_nothrow_copy_constructible_v<T>) {
+			matrix_execution::for_each_tile(policy, 0, this->count_rows_, matrix_execution::row_grain(this->count_columns_),
+				[this, &value](const size_type first, const size_type last) {
+					for (size_type row = first; row < last; ++row) {
+						matrix_detail::uninitialized_fill_elements(matrix_detail::assume_aligned<S::row_alignment>(this->elem_[row]), this->count_columns_, value);
+					}
+				});
+		}
+		else {
+			construct_rows([this, &value](const size_type row) {
+				std::uninitialized_fill_n(this->elem_[row], this->count_columns_, value);
+			});
+		}
+	}
+
+	// Contiguous storage: transposes a non-square matrix inside its block. Returns
+	// false if the block can't hold count_columns() rows of row_stride(count_rows())
+	// elements, nothing is changed then.
+	bool transpose_in_block()
+	{
+		const size_type rows = this->count_rows_;
+		const size_type columns = this->count_columns_;
+		const size_type block_size = this->space_rows_ * this->space_columns_;
+		const size_type stride = base::row_stride(rows);
+		if (block_size % stride != 0 || block_size / stride < columns) return false;
+
+		// Everything that may throw is allocated before the elements start moving.
+		const size_type space_rows = block_size / stride;
+		std::vector<bool> moved(rows * columns);
+		T** table = this->allocate_table(space_rows);
+
+		T* block = this->elem_[0];
+		if (this->space_columns_ != columns) {
+			for (size_type row = 1; row < rows; ++row) {
+				std::memmove(block + row * columns, block + row * this->space_columns_, columns * sizeof(T));
+			}
+		}
+		matrix_detail::transpose_packed_inplace(block, rows, columns, moved);
+		if (stride != rows) {
+			for (size_type row = columns; row-- > 1;) {
+				std::memmove(block + row * stride, block + row * rows, rows * sizeof(T));
+			}
+		}
+
+		for (size_type row = 0; row < space_rows; ++row) {
+			table[row] = block + row * stride;
+		}
+		this->deallocate_table(this->elem_, this->space_rows_);
+		this->elem_ = table;
+		this->space_rows_ = space_rows;
+		this->space_columns_ = stride;
+		this->count_rows_ = columns;
+		this->count_columns_ = rows;
+		return true;
+	}
+
 	inline void destroy_all() noexcept
 	{
 		for (size_type row = 0; row < this->count_rows_; ++row) {
@@ -241,98 +1113,145 @@ private:
 	}
 };
 
-template<class T, class A>
+// Random access over the elements row after row. The iterator is segmented (see
+// segmented.hpp): each row is a contiguous run, so the algorithms of
+// matrix_segmented process whole rows with pointer loops.
+template<class T, class A, class S>
 template<class MatrixIteratorTag>
-struct matrix<T, A>::MatrixIterator : public std::iterator<std::random_access_iterator_tag, T, ptrdiff_t, T*, const T&>
+struct matrix<T, A, S>::MatrixIterator
 {
-	using mtx_t = matrix<T, A>;
-	friend class mtx_t;
+	using mtx_t = matrix<T, A, S>;
+	friend mtx_t;
+	template<class OtherTag>
+	friend struct MatrixIterator;
 
+	static constexpr bool is_const = std::is_same_v<MatrixIteratorTag, typename mtx_t::ConstMatrixIteratorTag>;
+
+	using iterator_category = std::random_access_iterator_tag;
 	using value_type = T;
-	using size_type = mtx_t::size_type;
-	using difference_type = mtx_t::size_type;
-	using reference = std::conditional_t<std::is_same_v<MatrixIteratorTag, mtx_t::ConstMatrixIteratorTag>, const T&, T&>;
-	using pointer = std::conditional_t<std::is_same_v<MatrixIteratorTag, mtx_t::ConstMatrixIteratorTag>, const T*, T*>;
+	using size_type = typename mtx_t::size_type;
+	using difference_type = typename mtx_t::difference_type;
+	using reference = std::conditional_t<is_const, const T&, T&>;
+	using pointer = std::conditional_t<is_const, const T*, T*>;
 private:
-	MatrixIterator(T** ptr, const size_type columnsCount) noexcept
-		: ptr_{ ptr }
-		, maxColumnIndex_{ columnsCount - 1 }
+	MatrixIterator(T* const* row, const size_type columnsCount) noexcept
+		: row_{ row }
+		, columnsCount_{ columnsCount }
 	{}
 
 public:
 	MatrixIterator() noexcept = default;
-	MatrixIterator(const MatrixIterator& other) noexcept
-		: ptr_{ other.ptr_ }
-		, maxColumnIndex_{ other.maxColumnIndex_ }
+
+	// iterator converts to const_iterator.
+	template<class OtherTag, class = std::enable_if_t<is_const && !std::is_same_v<OtherTag, MatrixIteratorTag>>>
+	MatrixIterator(const MatrixIterator<OtherTag>& other) noexcept
+		: row_{ other.row_ }
+		, column_{ other.column_ }
+		, columnsCount_{ other.columnsCount_ }
 	{}
-	MatrixIterator& operator=(const MatrixIterator& other)
-	{
-		if (this == &other) {
-			return *this;
-		}
-		ptr_ = other.ptr_;
-		currentColumn_ = other.currentColumn_;
-		maxColumnIndex_ = other.maxColumnIndex_;
-	}
 
-	inline bool operator==(MatrixIterator const& other) const noexcept { return ptr_ == other.ptr_ && currentColumn_ == other.currentColumn_; }
+	inline bool operator==(MatrixIterator const& other) const noexcept { return row_ == other.row_ && column_ == other.column_; }
 	inline bool operator!=(MatrixIterator const& other) const noexcept { return !(*this == other); }
 
-	inline bool operator<(MatrixIterator const& other) const noexcept { return ptr_ < other.ptr_ || (ptr_ == other.ptr_ && currentColumn_ < other.currentColumn_); }
-	inline bool operator>(MatrixIterator const& other) const noexcept { return ptr_ > other.ptr_ || (ptr_ == other.ptr_ && currentColumn_ > other.currentColumn_); }
+	inline bool operator<(MatrixIterator const& other) const noexcept { return row_ < other.row_ || (row_ == other.row_ && column_ < other.column_); }
+	inline bool operator>(MatrixIterator const& other) const noexcept { return other < *this; }
 
-	inline bool operator<=(MatrixIterator const& other) const noexcept { return !(*this > other); }
+	inline bool operator<=(MatrixIterator const& other) const noexcept { return !(other < *this); }
 	inline bool operator>=(MatrixIterator const& other) const noexcept { return !(*this < other); }
 
-	inline reference operator*() const noexcept { return *((*ptr_) + currentColumn_); }
-	inline pointer operator->() const noexcept { return (*ptr_) + currentColumn_; }
+	inline reference operator*() const noexcept { return (*row_)[column_]; }
+	inline pointer operator->() const noexcept { return (*row_) + column_; }
+	inline reference operator[](const difference_type n) const noexcept { return *(*this + n); }
 
 	inline MatrixIterator& operator++() noexcept
 	{
-		if (currentColumn_ == maxColumnIndex_) {
-			++ptr_;
-			currentColumn_ = 0;
-		}
-		else {
-			++currentColumn_;
+		if (++column_ == columnsCount_) {
+			++row_;
+			column_ = 0;
 		}
 		return *this;
 	}
-	inline MatrixIterator& operator++(int) noexcept
+	inline MatrixIterator operator++(int) noexcept
 	{
 		auto tmp = *this;
-		this->operator++();
+		++*this;
 		return tmp;
 	}
 
-	inline MatrixIterator& operator--()
+	inline MatrixIterator& operator--() noexcept
 	{
-		if (currentColumn_ == 0) {
-			--ptr_;
-			currentColumn_ = maxColumnIndex_;
-		}
-		else {
-			--currentColumn_;
+		if (column_ == 0) {
+			--row_;
+			column_ = columnsCount_;
 		}
+		--column_;
 		return *this;
 	}
-	inline MatrixIterator& operator--(int)
+	inline MatrixIterator operator--(int) noexcept
 	{
 		auto tmp = *this;
-		this->operator--();
+		--*this;
 		return tmp;
 	}
 
-	inline difference_type operator-(const MatrixIterator& other) { return ptr_ - other.ptr_; }
+	inline MatrixIterator& operator+=(const difference_type n) noexcept
+	{
+		// Without columns begin() == end(), the only valid step is 0.
+		if (columnsCount_ == 0) return *this;
+		const auto columns = static_cast<difference_type>(columnsCount_);
+		const difference_type position = static_cast<difference_type>(column_) + n;
+		difference_type rows = position / columns;
+		difference_type column = position % columns;
+		if (column < 0) {
+			column += columns;
+			--rows;
+		}
+		row_ += rows;
+		column_ = static_cast<size_type>(column);
+		return *this;
+	}
+	inline MatrixIterator& operator-=(const difference_type n) noexcept { return *this += -n; }
+
+	inline MatrixIterator operator+(const difference_type n) const noexcept { auto tmp = *this; return tmp += n; }
+	inline MatrixIterator operator-(const difference_type n) const noexcept { auto tmp = *this; return tmp -= n; }
+	friend inline MatrixIterator operator+(const difference_type n, const MatrixIterator& it) noexcept { return it + n; }
+
+	inline difference_type operator-(const MatrixIterator& other) const noexcept
+	{
+		return (row_ - other.row_) * static_cast<difference_type>(columnsCount_)
+			+ (static_cast<difference_type>(column_) - static_cast<difference_type>(other.column_));
+	}
+
+	// Segmented iteration: the row is the segment.
+	inline T* const* segment() const noexcept { return row_; }
+	inline pointer local() const noexcept { return (*row_) + column_; }
+	inline pointer segment_end() const noexcept { return (*row_) + columnsCount_; }
+	inline MatrixIterator next_segment() const noexcept { return { row_ + 1, columnsCount_ }; }
 
-	inline MatrixIterator operator+(const size_type indx) { return { ptr_ + indx, maxColumnIndex_ }; }
-	inline MatrixIterator operator-(const size_type indx) { return { ptr_ - indx, maxColumnIndex_ }; }
 private:
-	T** ptr_{ nullptr };
-	size_type currentColumn_{ 0 };
-	size_type maxColumnIndex_{ 0 };
+	T* const* row_{ nullptr };
+	size_type column_{ 0 };
+	size_type columnsCount_{ 0 };
 };
 
+template<class T, class A, class S>
+inline void swap(matrix<T, A, S>& lhs, matrix<T, A, S>& rhs) noexcept
+{
+	lhs.swap(rhs);
+}
+
+template<class T, class A, class S>
+struct is_matrix_container<matrix<T, A, S>> : std::true_type {};
+
+template<class T, class A, class S>
+struct row_alignment_of<matrix<T, A, S>> : std::integral_constant<std::size_t, S::row_alignment> {};
 
+template<typename T, typename A = std::allocator<T>>
+using contiguous_matrix = matrix<T, A, contiguous_storage<>>;
+
+// One block with every row aligned and padded to 64-byte cache lines (see the
+// storage policies above).
+template<typename T, typename A = std::allocator<T>>
+using aligned_matrix = matrix<T, A, contiguous_storage<64>>;
 
 #endif // MATRIX_HPP
\ No newline at end of file
@@ -0,0 +1,317 @@
+#pragma once
+#ifndef MATRIX_ALLOCATORS_HPP
+#define MATRIX_ALLOCATORS_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Allocators for the A parameter of matrix<T, A, S>.
+//
+// A matrix makes a few allocations of the same sizes over and over: one block
+// per row (or one block for all rows) and the row table. Both resources below
+// hand out such blocks without going to the global heap each time:
+//
+//   block_pool      - recycles freed blocks by size, for matrices created and
+//                     destroyed repeatedly with the same shapes;
+//   monotonic_arena - bump allocation, nothing is freed until release(), for
+//                     the short-lived temporaries of one computation.
+//
+// The resource is shared by all copies and rebinds of an allocator referring to
+// it and must outlive every matrix using it. Resources are not synchronized:
+// use one per thread (or per request), not one shared by concurrent threads.
+// Like std::pmr allocators, they don't propagate on copy, move or swap of the
+// matrices.
+//
+//   block_pool pool;
+//   matrix<double, pool_allocator<double>> m(rows, columns, pool_allocator<double>{ pool });
+//
+// The allocators have no default constructor, there is no resource to default
+// to: every matrix is created with an allocator passed to its constructor (or
+// copied from another matrix). What default-constructs a matrix, such as
+// load_matrix<M>(path), doesn't compile for them; load into a matrix created with
+// its allocator instead.
+
+namespace matrix_detail {
+
+	// Memory from the global heap is aligned to a cache line.
+	constexpr std::size_t upstream_alignment = 64;
+	constexpr std::size_t min_block_alignment = alignof(std::max_align_t);
+
+	inline constexpr std::size_t align_up(const std::size_t value, const std::size_t alignment) noexcept
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Allocations from the global heap, all freed at once.
+	struct upstream_blocks
+	{
+		upstream_blocks() = default;
+		upstream_blocks(const upstream_blocks&) = delete;
+		upstream_blocks& operator=(const upstream_blocks&) = delete;
+		~upstream_blocks() { release(); }
+
+		void* allocate(const std::size_t bytes)
+		{
+			// Room for the block before it is allocated, so that it is never
+			// lost; the capacity grows geometrically as push_back's would.
+			if (blocks_.size() == blocks_.capacity()) {
+				blocks_.reserve(2 * blocks_.size() + 1);
+			}
+			void* block = ::operator new(bytes, std::align_val_t{ upstream_alignment });
+			blocks_.push_back(block);
+			++count_;
+			return block;
+		}
+
+		void release() noexcept
+		{
+			for (void* block : blocks_) {
+				::operator delete(block, std::align_val_t{ upstream_alignment });
+			}
+			blocks_.clear();
+		}
+
+		inline std::size_t count() const noexcept { return count_; }
+
+	private:
+		std::vector<void*> blocks_;
+		std::size_t count_{ 0 };
+	};
+
+} // namespace matrix_detail
+
+// Pool of blocks grouped by size. A freed block goes to the free list of its
+// size and is reused by the next allocation of that size. Blocks up to
+// max_chunked_block bytes are carved from chunks holding several of them,
+// bigger blocks are allocated one by one. Memory returns to the global heap
+// only on release() or destruction.
+class block_pool
+{
+public:
+	static constexpr std::size_t max_chunked_block = 64 * 1024;
+	static constexpr std::size_t max_chunk_size = 1024 * 1024;
+
+	block_pool() = default;
+	block_pool(const block_pool&) = delete;
+	block_pool& operator=(const block_pool&) = delete;
+
+	void* allocate(const std::size_t bytes, const std::size_t alignment)
+	{
+		if (alignment > matrix_detail::upstream_alignment) {
+			throw std::bad_alloc{};
+		}
+
+		size_class& sc = find_class(block_size(bytes, alignment));
+		if (sc.free != nullptr) {
+			free_block* block = sc.free;
+			sc.free = block->next;
+			return block;
+		}
+		if (sc.bytes > max_chunked_block) {
+			return upstream_.allocate(sc.bytes);
+		}
+		if (sc.chunk_left == 0) {
+			refill(sc);
+		}
+		void* block = sc.chunk_next;
+		sc.chunk_next += sc.bytes;
+		--sc.chunk_left;
+		return block;
+	}
+
+	// 'ptr' must come from this pool with the same size and alignment. A block of
+	// a size never allocated is foreign: asserted in debug builds, ignored (and
+	// leaked) otherwise rather than linked into no size class.
+	void deallocate(void* ptr, const std::size_t bytes, const std::size_t alignment) noexcept
+	{
+		if (ptr == nullptr) return;
+
+		size_class* sc = find_existing_class(block_size(bytes, alignment));
+		assert(sc != nullptr && "Block was not allocated by this pool");
+		if (sc == nullptr) return;
+		auto* block = static_cast<free_block*>(ptr);
+		block->next = sc->free;
+		sc->free = block;
+	}
+
+	// Returns all memory to the global heap. No block allocated before may be in use.
+	void release() noexcept
+	{
+		upstream_.release();
+		classes_.clear();
+	}
+
+	// Number of allocations made from the global heap so far.
+	inline std::size_t upstream_allocations() const noexcept { return upstream_.count(); }
+
+private:
+	struct free_block
+	{
+		free_block* next;
+	};
+
+	struct size_class
+	{
+		std::size_t bytes;
+		free_block* free;
+		char* chunk_next;
+		std::size_t chunk_left;
+		std::size_t next_chunk_blocks;
+	};
+
+	static constexpr std::size_t block_size(const std::size_t bytes, const std::size_t alignment) noexcept
+	{
+		return matrix_detail::align_up(std::max(bytes, sizeof(free_block)), std::max(alignment, matrix_detail::min_block_alignment));
+	}
+
+	// A matrix uses two or three block sizes, a linear search is enough.
+	size_class* find_existing_class(const std::size_t bytes) noexcept
+	{
+		for (auto& sc : classes_) {
+			if (sc.bytes == bytes) return &sc;
+		}
+		return nullptr;
+	}
+
+	size_class& find_class(const std::size_t bytes)
+	{
+		if (size_class* sc = find_existing_class(bytes)) {
+			return *sc;
+		}
+		classes_.push_back({ bytes, nullptr, nullptr, 0, 4 });
+		return classes_.back();
+	}
+
+	// Chunks of a size class double in size up to max_chunk_size.
+	void refill(size_class& sc)
+	{
+		const std::size_t blocks = std::max<std::size_t>(1, std::min(sc.next_chunk_blocks, max_chunk_size / sc.bytes));
+		sc.chunk_next = static_cast<char*>(upstream_.allocate(blocks * sc.bytes));
+		sc.chunk_left = blocks;
+		sc.next_chunk_blocks = blocks * 2;
+	}
+
+	std::vector<size_class> classes_;
+	matrix_detail::upstream_blocks upstream_;
+};
+
+// Bump allocator: deallocation does nothing, all memory is freed by release()
+// or destruction. Optionally starts with a caller-provided buffer (e.g. on the
+// stack), further memory comes from the global heap in chunks of doubling size.
+class monotonic_arena
+{
+public:
+	static constexpr std::size_t initial_chunk_size = 4 * 1024;
+
+	monotonic_arena() = default;
+	monotonic_arena(void* buffer, const std::size_t size) noexcept
+		: initial_buffer_{ static_cast<char*>(buffer) }
+		, initial_size_{ size }
+		, current_{ initial_buffer_ }
+		, left_{ size }
+	{}
+	monotonic_arena(const monotonic_arena&) = delete;
+	monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+	void* allocate(const std::size_t bytes, std::size_t alignment)
+	{
+		alignment = std::max(alignment, matrix_detail::min_block_alignment);
+		if (alignment > matrix_detail::upstream_alignment) {
+			throw std::bad_alloc{};
+		}
+
+		void* ptr = current_;
+		if (current_ == nullptr || std::align(alignment, bytes, ptr, left_) == nullptr) {
+			next_chunk_size_ = std::max(next_chunk_size_, matrix_detail::align_up(bytes, matrix_detail::upstream_alignment));
+			ptr = upstream_.allocate(next_chunk_size_);
+			left_ = next_chunk_size_;
+			next_chunk_size_ *= 2;
+		}
+		current_ = static_cast<char*>(ptr) + bytes;
+		left_ -= bytes;
+		return ptr;
+	}
+
+	void deallocate(void*, std::size_t, std::size_t) noexcept {}
+
+	// Frees all memory and starts over from the initial buffer. Nothing allocated
+	// before may be in use.
+	void release() noexcept
+	{
+		upstream_.release();
+		current_ = initial_buffer_;
+		left_ = initial_size_;
+		next_chunk_size_ = initial_chunk_size;
+	}
+
+	// Number of allocations made from the global heap so far.
+	inline std::size_t upstream_allocations() const noexcept { return upstream_.count(); }
+
+private:
+	char* initial_buffer_{ nullptr };
+	std::size_t initial_size_{ 0 };
+
+	char* current_{ nullptr };
+	std::size_t left_{ 0 };
+	std::size_t next_chunk_size_{ initial_chunk_size };
+
+	matrix_detail::upstream_blocks upstream_;
+};
+
+// Standard allocator handing out memory of a resource (block_pool, monotonic_arena
+// or any type with the same allocate/deallocate members). Allocators are equal
+// if they refer to the same resource.
+template<class T, class Resource>
+struct resource_allocator
+{
+	using value_type = T;
+	using resource_type = Resource;
+
+	template<class U>
+	struct rebind { using other = resource_allocator<U, Resource>; };
+
+	explicit resource_allocator(Resource& resource) noexcept : resource_{ &resource } {}
+
+	template<class U>
+	resource_allocator(const resource_allocator<U, Resource>& other) noexcept : resource_{ &other.resource() } {}
+
+	inline T* allocate(const std::size_t n)
+	{
+		return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	inline void deallocate(T* ptr, const std::size_t n) noexcept
+	{
+		resource_->deallocate(ptr, n * sizeof(T), alignof(T));
+	}
+
+	inline Resource& resource() const noexcept { return *resource_; }
+
+private:
+	Resource* resource_;
+};
+
+template<class T, class U, class Resource>
+inline bool operator==(const resource_allocator<T, Resource>& lhs, const resource_allocator<U, Resource>& rhs) noexcept
+{
+	return &lhs.resource() == &rhs.resource();
+}
+
+template<class T, class U, class Resource>
+inline bool operator!=(const resource_allocator<T, Resource>& lhs, const resource_allocator<U, Resource>& rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+template<class T>
+using pool_allocator = resource_allocator<T, block_pool>;
+
+template<class T>
+using arena_allocator = resource_allocator<T, monotonic_arena>;
+
+#endif // !MATRIX_ALLOCATORS_HPP
@@ -0,0 +1,365 @@
+#pragma once
+
+#ifndef MATRIX_INSTRUMENTATION_HPP
+#define MATRIX_INSTRUMENTATION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Counters of allocations, element copies, range errors and kernel runs.
+//
+// Compiling with MATRIX_INSTRUMENTATION=1 (for the whole program) makes matrix
+// count the allocations of its rows and row tables, the elements it copies and
+// the out_of_range exceptions of its checked accessors, and makes the kernels
+// below count their runs and time. Without it the hooks compile to nothing.
+//
+// counting_allocator counts the allocations made through it in any build, it
+// can be the A parameter of a matrix or of any standard container:
+//
+//   matrix<double, counting_allocator<double>> m(rows, columns);
+//
+// Counters are kept per thread, without synchronization on the hot paths.
+// thread_snapshot() reads the counters of the calling thread, snapshot() the
+// sum over all threads, including the pool workers and the threads that have
+// exited. The work done for one request is the difference of two snapshots:
+//
+//   const auto before = matrix_instrumentation::snapshot();
+//   handle(request);
+//   const auto used = matrix_instrumentation::snapshot() - before;
+
+#ifndef MATRIX_INSTRUMENTATION
+#define MATRIX_INSTRUMENTATION 0
+#endif
+
+namespace matrix_instrumentation {
+
+	inline constexpr bool enabled = MATRIX_INSTRUMENTATION != 0;
+
+	// Timed kernels. Runs nest: a factorization or a Strassen product counts
+	// the gemm runs it makes, each with its own time.
+	enum class kernel { gemm, strassen, quantized_multiply, transpose, lu, cholesky, qr, count };
+
+	inline constexpr std::size_t kernel_count = static_cast<std::size_t>(kernel::count);
+
+	struct kernel_counters
+	{
+		std::uint64_t calls{ 0 };
+		std::uint64_t nanoseconds{ 0 };
+	};
+
+	struct counters
+	{
+		std::uint64_t allocations{ 0 };
+		std::uint64_t deallocations{ 0 };
+		std::uint64_t allocated_bytes{ 0 };
+		std::uint64_t deallocated_bytes{ 0 };
+		// Highest allocated_bytes - deallocated_bytes reached, by one thread in
+		// a thread snapshot, by the whole process in a snapshot().
+		std::uint64_t peak_bytes{ 0 };
+		std::uint64_t element_copies{ 0 };
+		std::uint64_t range_errors{ 0 };
+		kernel_counters kernels[kernel_count]{};
+
+		inline std::int64_t live_bytes() const noexcept
+		{
+			return static_cast<std::int64_t>(allocated_bytes - deallocated_bytes);
+		}
+
+		inline const kernel_counters& operator[](const kernel k) const noexcept { return kernels[static_cast<std::size_t>(k)]; }
+
+		counters& operator+=(const counters& other) noexcept
+		{
+			allocations += other.allocations;
+			deallocations += other.deallocations;
+			allocated_bytes += other.allocated_bytes;
+			deallocated_bytes += other.deallocated_bytes;
+			peak_bytes = std::max(peak_bytes, other.peak_bytes);
+			element_copies += other.element_copies;
+			range_errors += other.range_errors;
+			for (std::size_t i = 0; i < kernel_count; ++i) {
+				kernels[i].calls += other.kernels[i].calls;
+				kernels[i].nanoseconds += other.kernels[i].nanoseconds;
+			}
+			return *this;
+		}
+
+		// Counts between two snapshots, peak_bytes is the one of the later snapshot.
+		friend counters operator-(counters later, const counters& earlier) noexcept
+		{
+			later.allocations -= earlier.allocations;
+			later.deallocations -= earlier.deallocations;
+			later.allocated_bytes -= earlier.allocated_bytes;
+			later.deallocated_bytes -= earlier.deallocated_bytes;
+			later.element_copies -= earlier.element_copies;
+			later.range_errors -= earlier.range_errors;
+			for (std::size_t i = 0; i < kernel_count; ++i) {
+				later.kernels[i].calls -= earlier.kernels[i].calls;
+				later.kernels[i].nanoseconds -= earlier.kernels[i].nanoseconds;
+			}
+			return later;
+		}
+	};
+
+} // namespace matrix_instrumentation
+
+namespace matrix_detail {
+
+	// Counters of one thread. Only the owning thread writes them (a relaxed load
+	// and store, no read-modify-write), snapshots read them from any thread.
+	struct thread_counters
+	{
+		using counter = std::atomic<std::uint64_t>;
+
+		thread_counters();
+		~thread_counters();
+
+		inline static void increase(counter& c, const std::uint64_t value) noexcept
+		{
+			c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		matrix_instrumentation::counters load() const noexcept
+		{
+			matrix_instrumentation::counters result;
+			result.allocations = allocations.load(std::memory_order_relaxed);
+			result.deallocations = deallocations.load(std::memory_order_relaxed);
+			result.allocated_bytes = allocated_bytes.load(std::memory_order_relaxed);
+			result.deallocated_bytes = deallocated_bytes.load(std::memory_order_relaxed);
+			result.peak_bytes = peak_bytes.load(std::memory_order_relaxed);
+			result.element_copies = element_copies.load(std::memory_order_relaxed);
+			result.range_errors = range_errors.load(std::memory_order_relaxed);
+			for (std::size_t i = 0; i < matrix_instrumentation::kernel_count; ++i) {
+				result.kernels[i].calls = kernel_calls[i].load(std::memory_order_relaxed);
+				result.kernels[i].nanoseconds = kernel_nanoseconds[i].load(std::memory_order_relaxed);
+			}
+			return result;
+		}
+
+		counter allocations{ 0 };
+		counter deallocations{ 0 };
+		counter allocated_bytes{ 0 };
+		counter deallocated_bytes{ 0 };
+		counter peak_bytes{ 0 };
+		counter element_copies{ 0 };
+		counter range_errors{ 0 };
+		counter kernel_calls[matrix_instrumentation::kernel_count]{};
+		counter kernel_nanoseconds[matrix_instrumentation::kernel_count]{};
+		// Bytes allocated minus bytes deallocated by this thread, negative when it
+		// frees memory allocated by others.
+		std::int64_t live_bytes{ 0 };
+	};
+
+	// Counters of all threads. Never destroyed: pool workers may exit after
+	// the static objects are gone.
+	struct counters_registry
+	{
+		std::mutex mutex;
+		std::vector<const thread_counters*> threads;
+		matrix_instrumentation::counters exited;
+		std::atomic<std::int64_t> live_bytes{ 0 };
+		std::atomic<std::uint64_t> peak_bytes{ 0 };
+	};
+
+	inline counters_registry& instrumentation_registry()
+	{
+		static counters_registry* registry = new counters_registry;
+		return *registry;
+	}
+
+	inline thread_counters::thread_counters()
+	{
+		auto& registry = instrumentation_registry();
+		std::lock_guard<std::mutex> lock{ registry.mutex };
+		registry.threads.push_back(this);
+	}
+
+	inline thread_counters::~thread_counters()
+	{
+		auto& registry = instrumentation_registry();
+		std::lock_guard<std::mutex> lock{ registry.mutex };
+		registry.exited += load();
+		registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+	}
+
+	inline thread_counters& local_counters()
+	{
+		static thread_local thread_counters counters;
+		return counters;
+	}
+
+} // namespace matrix_detail
+
+namespace matrix_instrumentation {
+
+	inline counters thread_snapshot()
+	{
+		return matrix_detail::local_counters().load();
+	}
+
+	inline counters snapshot()
+	{
+		auto& registry = matrix_detail::instrumentation_registry();
+		std::lock_guard<std::mutex> lock{ registry.mutex };
+		counters result = registry.exited;
+		for (const auto* thread : registry.threads) {
+			result += thread->load();
+		}
+		result.peak_bytes = registry.peak_bytes.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	inline void record_allocation(const std::size_t bytes) noexcept
+	{
+		auto& local = matrix_detail::local_counters();
+		matrix_detail::thread_counters::increase(local.allocations, 1);
+		matrix_detail::thread_counters::increase(local.allocated_bytes, bytes);
+		local.live_bytes += static_cast<std::int64_t>(bytes);
+		if (local.live_bytes > 0 && static_cast<std::uint64_t>(local.live_bytes) > local.peak_bytes.load(std::memory_order_relaxed)) {
+			local.peak_bytes.store(static_cast<std::uint64_t>(local.live_bytes), std::memory_order_relaxed);
+		}
+
+		auto& registry = matrix_detail::instrumentation_registry();
+		const std::int64_t live = registry.live_bytes.fetch_add(static_cast<std::int64_t>(bytes), std::memory_order_relaxed) + static_cast<std::int64_t>(bytes);
+		std::uint64_t peak = registry.peak_bytes.load(std::memory_order_relaxed);
+		while (live > 0 && static_cast<std::uint64_t>(live) > peak
+			&& !registry.peak_bytes.compare_exchange_weak(peak, static_cast<std::uint64_t>(live), std::memory_order_relaxed)) {}
+	}
+
+	inline void record_deallocation(const std::size_t bytes) noexcept
+	{
+		auto& local = matrix_detail::local_counters();
+		matrix_detail::thread_counters::increase(local.deallocations, 1);
+		matrix_detail::thread_counters::increase(local.deallocated_bytes, bytes);
+		local.live_bytes -= static_cast<std::int64_t>(bytes);
+		matrix_detail::instrumentation_registry().live_bytes.fetch_sub(static_cast<std::int64_t>(bytes), std::memory_order_relaxed);
+	}
+
+	inline void record_element_copies(const std::size_t count) noexcept
+	{
+		matrix_detail::thread_counters::increase(matrix_detail::local_counters().element_copies, count);
+	}
+
+	inline void record_range_error() noexcept
+	{
+		matrix_detail::thread_counters::increase(matrix_detail::local_counters().range_errors, 1);
+	}
+
+	inline void record_kernel(const kernel k, const std::uint64_t nanoseconds) noexcept
+	{
+		auto& local = matrix_detail::local_counters();
+		const auto index = static_cast<std::size_t>(k);
+		matrix_detail::thread_counters::increase(local.kernel_calls[index], 1);
+		matrix_detail::thread_counters::increase(local.kernel_nanoseconds[index], nanoseconds);
+	}
+
+	// Counts one run of a kernel and its time, from construction to destruction.
+	// An empty object without MATRIX_INSTRUMENTATION.
+	template<bool Enabled = enabled>
+	struct basic_kernel_scope
+	{
+		explicit basic_kernel_scope(kernel) noexcept {}
+	};
+
+	template<>
+	struct basic_kernel_scope<true>
+	{
+		explicit basic_kernel_scope(const kernel k) noexcept
+			: kernel_{ k }
+			, start_{ std::chrono::steady_clock::now() }
+		{}
+		basic_kernel_scope(const basic_kernel_scope&) = delete;
+		basic_kernel_scope& operator=(const basic_kernel_scope&) = delete;
+		~basic_kernel_scope()
+		{
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+			record_kernel(kernel_, static_cast<std::uint64_t>(elapsed.count()));
+		}
+
+	private:
+		kernel kernel_;
+		std::chrono::steady_clock::time_point start_;
+	};
+
+	using kernel_scope = basic_kernel_scope<>;
+
+} // namespace matrix_instrumentation
+
+// Allocator counting the allocations and bytes it hands out (see above), the
+// memory comes from A.
+template<class T, class A = std::allocator<T>>
+struct counting_allocator
+{
+	using value_type = T;
+	using upstream_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
+	using propagate_on_container_copy_assignment = typename std::allocator_traits<upstream_type>::propagate_on_container_copy_assignment;
+	using propagate_on_container_move_assignment = typename std::allocator_traits<upstream_type>::propagate_on_container_move_assignment;
+	using propagate_on_container_swap = typename std::allocator_traits<upstream_type>::propagate_on_container_swap;
+	using is_always_equal = typename std::allocator_traits<upstream_type>::is_always_equal;
+
+	template<class U>
+	struct rebind { using other = counting_allocator<U, typename std::allocator_traits<A>::template rebind_alloc<U>>; };
+
+	counting_allocator() = default;
+	explicit counting_allocator(const upstream_type& upstream) : upstream_{ upstream } {}
+
+	template<class U, class B>
+	counting_allocator(const counting_allocator<U, B>& other) : upstream_{ other.upstream() } {}
+
+	inline T* allocate(const std::size_t n)
+	{
+		T* result = std::allocator_traits<upstream_type>::allocate(upstream_, n);
+		matrix_instrumentation::record_allocation(n * sizeof(T));
+		return result;
+	}
+
+	inline void deallocate(T* ptr, const std::size_t n) noexcept
+	{
+		matrix_instrumentation::record_deallocation(n * sizeof(T));
+		std::allocator_traits<upstream_type>::deallocate(upstream_, ptr, n);
+	}
+
+	inline const upstream_type& upstream() const noexcept { return upstream_; }
+
+	counting_allocator select_on_container_copy_construction() const
+	{
+		return counting_allocator{ std::allocator_traits<upstream_type>::select_on_container_copy_construction(upstream_) };
+	}
+
+private:
+	upstream_type upstream_;
+};
+
+template<class T, class A, class U, class B>
+inline bool operator==(const counting_allocator<T, A>& lhs, const counting_allocator<U, B>& rhs) noexcept
+{
+	return lhs.upstream() == rhs.upstream();
+}
+
+template<class T, class A, class U, class B>
+inline bool operator!=(const counting_allocator<T, A>& lhs, const counting_allocator<U, B>& rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+namespace matrix_detail {
+
+	template<class A>
+	struct is_counting_allocator : std::false_type {};
+
+	template<class T, class A>
+	struct is_counting_allocator<counting_allocator<T, A>> : std::true_type {};
+
+	// The matrix hooks count allocations unless the allocator counts them already.
+	template<class A>
+	inline constexpr bool counts_matrix_allocations = matrix_instrumentation::enabled && !is_counting_allocator<A>::value;
+
+} // namespace matrix_detail
+
+#endif // !MATRIX_INSTRUMENTATION_HPP
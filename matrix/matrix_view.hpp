@@ -0,0 +1,260 @@
+#pragma once
+#ifndef MATRIX_VIEW_HPP
+#define MATRIX_VIEW_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../matrix_ops/expression.hpp"
+
+// Non-owning views of a part of a matrix or fixed_matrix.
+//
+// A view refers to the elements of its container and is invalidated by anything
+// that reallocates them (push_row, resize, ...). The rows of a matrix_view are
+// contiguous runs of count_columns() elements, found either 'row_stride' elements
+// apart (fixed_matrix and contiguous storage) or through the row table of a
+// matrix with row storage. transposed_view swaps the indexes of a matrix_view.
+//
+// Views are accepted wherever the containers are read through count_rows(),
+// count_columns() and operator[]: element-wise expressions, multiply, save_matrix,
+// write_text. Assigning to a view writes the elements of the viewed part, so a
+// block of a container can be updated in place:
+//
+//   m.block(0, 0, 2, 2) = a.block(2, 2, 2, 2) * 3;
+//   m.row(1) += m.row(0);
+//
+// As for containers, the destination may be an operand of the expression, but
+// must not partially overlap one. An expression mixing a view and a transposed
+// view of the same elements is evaluated into a temporary before assignment.
+
+template<typename T>
+struct transposed_view;
+
+namespace matrix_detail {
+
+	template<class V, class E, class Op>
+	inline void evaluate_into_view(const V& view, const E& e, Op op)
+	{
+		static_assert(!std::is_const_v<typename V::element_type>, "Can't assign to a view of const elements");
+		V dst = view;
+		evaluate(matrix_execution::par, dst, make_operand(e), op);
+	}
+
+	inline void check_view_block(const std::size_t first, const std::size_t count, const std::size_t size)
+	{
+		if (first > size || count > size - first) {
+			throw std::out_of_range{ "Block is out of range of the view" };
+		}
+	}
+
+} // namespace matrix_detail
+
+template<typename T>
+struct matrix_view
+{
+	using value_type = std::remove_const_t<T>;
+	using element_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using pointer = T*;
+
+	constexpr matrix_view() noexcept = default;
+
+	// Rows of 'columns' elements, the first one at 'origin' and each next one
+	// 'row_stride' elements further.
+	constexpr matrix_view(T* origin, const size_type rows, const size_type columns, const size_type row_stride) noexcept
+		: origin_{ origin }
+		, count_rows_{ rows }
+		, count_columns_{ columns }
+		, step_{ row_stride }
+	{}
+
+	// Rows given by a table of row pointers, starting 'first_column' elements in.
+	constexpr matrix_view(T* const* row_table, const size_type rows, const size_type columns, const size_type first_column) noexcept
+		: table_{ row_table }
+		, count_rows_{ rows }
+		, count_columns_{ columns }
+		, step_{ first_column }
+	{}
+
+	// A view of const elements from a view of the same elements.
+	template<class U, class = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+	constexpr matrix_view(const matrix_view<U>& other) noexcept
+		: table_{ other.table_ }
+		, origin_{ other.origin_ }
+		, count_rows_{ other.count_rows_ }
+		, count_columns_{ other.count_columns_ }
+		, step_{ other.step_ }
+	{}
+
+	constexpr matrix_view(const matrix_view&) noexcept = default;
+
+	// Assignment copies the elements, it doesn't rebind the view.
+	matrix_view& operator=(const matrix_view& other)
+	{
+		matrix_detail::evaluate_into_view(*this, other, matrix_detail::assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const matrix_view& operator=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const matrix_view& operator+=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::add_assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const matrix_view& operator-=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::subtract_assign_op{});
+		return *this;
+	}
+
+	constexpr inline size_type count_rows() const noexcept { return count_rows_; }
+	constexpr inline size_type count_columns() const noexcept { return count_columns_; }
+	constexpr inline size_type count_elements() const noexcept { return count_rows_ * count_columns_; }
+
+	// True if the rows are row_stride() elements apart, false if they come from a row table.
+	constexpr inline bool is_strided() const noexcept { return table_ == nullptr; }
+	constexpr inline size_type row_stride() const noexcept { return is_strided() ? step_ : 0; }
+
+	constexpr inline T* operator[](const size_type row) const noexcept
+	{
+		return is_strided() ? origin_ + row * step_ : table_[row] + step_;
+	}
+
+	constexpr T& operator()(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+		return (*this)[row][column];
+	}
+
+	// 'rows' x 'columns' elements starting at (row, column).
+	constexpr matrix_view block(const size_type row, const size_type column, const size_type rows, const size_type columns) const
+	{
+		matrix_detail::check_view_block(row, rows, count_rows_);
+		matrix_detail::check_view_block(column, columns, count_columns_);
+		return is_strided()
+			? matrix_view(origin_ + row * step_ + column, rows, columns, step_)
+			: matrix_view(table_ + row, rows, columns, step_ + column);
+	}
+
+	constexpr inline matrix_view row(const size_type index) const { return block(index, 0, 1, count_columns_); }
+	constexpr inline matrix_view column(const size_type index) const { return block(0, index, count_rows_, 1); }
+	constexpr inline transposed_view<T> transposed() const noexcept { return transposed_view<T>{ *this }; }
+
+private:
+	template<typename U>
+	friend struct matrix_view;
+
+	T* const* table_{ nullptr };
+	T* origin_{ nullptr };
+	size_type count_rows_{ 0 };
+	size_type count_columns_{ 0 };
+	// Row stride of a strided view, first column in the rows of a table view.
+	size_type step_{ 0 };
+};
+
+template<typename T>
+using const_matrix_view = matrix_view<const T>;
+
+// matrix_view with rows and columns swapped. Its rows are columns of the
+// underlying view, so each one is read with a stride.
+template<typename T>
+struct transposed_view
+{
+	using value_type = std::remove_const_t<T>;
+	using element_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using pointer = T*;
+
+	struct column_reference
+	{
+		matrix_view<T> view;
+		size_type column;
+
+		constexpr inline T& operator[](const size_type row) const noexcept { return view[row][column]; }
+	};
+
+	constexpr transposed_view() noexcept = default;
+	constexpr explicit transposed_view(const matrix_view<T>& view) noexcept : view_{ view } {}
+
+	template<class U, class = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+	constexpr transposed_view(const transposed_view<U>& other) noexcept : view_{ other.transposed() } {}
+
+	constexpr transposed_view(const transposed_view&) noexcept = default;
+
+	// Assignment copies the elements, it doesn't rebind the view.
+	transposed_view& operator=(const transposed_view& other)
+	{
+		matrix_detail::evaluate_into_view(*this, other, matrix_detail::assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const transposed_view& operator=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const transposed_view& operator+=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::add_assign_op{});
+		return *this;
+	}
+
+	template<class E, class = std::enable_if_t<is_matrix_operand_v<E>>>
+	const transposed_view& operator-=(const E& e) const
+	{
+		matrix_detail::evaluate_into_view(*this, e, matrix_detail::subtract_assign_op{});
+		return *this;
+	}
+
+	constexpr inline size_type count_rows() const noexcept { return view_.count_columns(); }
+	constexpr inline size_type count_columns() const noexcept { return view_.count_rows(); }
+	constexpr inline size_type count_elements() const noexcept { return view_.count_elements(); }
+
+	constexpr inline column_reference operator[](const size_type row) const noexcept { return { view_, row }; }
+	constexpr inline T& operator()(const size_type row, const size_type column) const { return view_(column, row); }
+
+	constexpr transposed_view block(const size_type row, const size_type column, const size_type rows, const size_type columns) const
+	{
+		return transposed_view{ view_.block(column, row, columns, rows) };
+	}
+
+	constexpr inline transposed_view row(const size_type index) const { return transposed_view{ view_.column(index) }; }
+	constexpr inline transposed_view column(const size_type index) const { return transposed_view{ view_.row(index) }; }
+	constexpr inline matrix_view<T> transposed() const noexcept { return view_; }
+
+private:
+	matrix_view<T> view_;
+};
+
+template<typename T>
+struct is_matrix_container<matrix_view<T>> : std::true_type {};
+
+template<typename T>
+struct is_matrix_container<transposed_view<T>> : std::true_type {};
+
+template<typename T>
+struct is_transposed_container<transposed_view<T>> : std::true_type {};
+
+#endif // !MATRIX_VIEW_HPP
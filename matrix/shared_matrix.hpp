@@ -0,0 +1,328 @@
+#pragma once
+#ifndef MATRIX_SHARED_MATRIX_HPP
+#define MATRIX_SHARED_MATRIX_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix_view.hpp"
+
+// Copy-on-write snapshots of a matrix for concurrent readers.
+//
+// shared_matrix<T> is a matrix published to many reader threads and updated by
+// one writer. Its elements are held in chunks of rows_per_chunk() rows, shared
+// between the versions; rows are addressed through a table of row pointers as
+// in matrix with row storage.
+//
+//   readers (any thread)   snapshot() returns the last published version as a
+//                          matrix_snapshot, an immutable matrix that stays
+//                          valid, and unchanged, as long as it is held.
+//   writer (one thread)    row(), set() and assign_row() change a draft of the
+//                          next version, copying a chunk the first time one of
+//                          its rows is changed; publish() makes the draft the
+//                          current version.
+//
+//   shared_matrix<double> prices(rows, columns);
+//   // reader threads
+//   const auto current = prices.snapshot();
+//   use(current(i, j), sum(current), ...);
+//   // writer thread
+//   prices.assign_row(i, new_prices);
+//   prices.publish();
+//
+// Taking a snapshot locks nothing: the reader registers on one of two counters
+// while it takes a reference to the current version, and publish() waits until
+// the readers registered before the switch are done before it releases its own
+// reference to the previous version. Only the writer waits. Snapshots are
+// std::shared_ptr references, releasing the last one frees the version and the
+// chunks no other version uses.
+
+template<typename T>
+struct shared_matrix;
+
+namespace matrix_detail {
+
+	template<class T>
+	struct matrix_version : std::enable_shared_from_this<matrix_version<T>>
+	{
+		std::size_t count_rows{ 0 };
+		std::size_t count_columns{ 0 };
+		std::size_t rows_per_chunk{ 1 };
+		std::uint64_t number{ 0 };
+		std::vector<std::shared_ptr<T[]>> chunks;
+		std::vector<T*> rows;
+
+		matrix_version(const std::size_t rows_count, const std::size_t columns_count, const std::size_t chunk_rows)
+			: count_rows{ rows_count }
+			, count_columns{ columns_count }
+			, rows_per_chunk{ chunk_rows }
+			, chunks((rows_count + chunk_rows - 1) / chunk_rows)
+			, rows(rows_count)
+		{
+			for (std::size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+				chunks[chunk] = std::shared_ptr<T[]>(new T[chunk_size(chunk)]);
+				point_rows(chunk);
+			}
+		}
+
+		// The next version shares all the chunks of this one.
+		matrix_version(const matrix_version& other)
+			: std::enable_shared_from_this<matrix_version<T>>{}
+			, count_rows{ other.count_rows }
+			, count_columns{ other.count_columns }
+			, rows_per_chunk{ other.rows_per_chunk }
+			, number{ other.number }
+			, chunks{ other.chunks }
+			, rows{ other.rows }
+		{}
+
+		matrix_version& operator=(const matrix_version&) = delete;
+
+		inline std::size_t chunk_size(const std::size_t chunk) const noexcept
+		{
+			return (std::min(count_rows, (chunk + 1) * rows_per_chunk) - chunk * rows_per_chunk) * count_columns;
+		}
+
+		inline void point_rows(const std::size_t chunk) noexcept
+		{
+			T* data = chunks[chunk].get();
+			const std::size_t last = std::min(count_rows, (chunk + 1) * rows_per_chunk);
+			for (std::size_t row = chunk * rows_per_chunk; row < last; ++row, data += count_columns) {
+				rows[row] = data;
+			}
+		}
+
+		// A private copy of the chunk of 'row' if another version uses it. The
+		// use count only grows on the writer's thread, so it is never too low.
+		// use_count() is a relaxed load: when it shows the chunk is no longer
+		// shared, the fence orders the reads of the readers that released the
+		// other versions before the writes that follow.
+		inline void own_chunk_of(const std::size_t row)
+		{
+			const std::size_t chunk = row / rows_per_chunk;
+			if (chunks[chunk].use_count() > 1) {
+				const std::size_t size = chunk_size(chunk);
+				std::shared_ptr<T[]> copy(new T[size]);
+				std::copy_n(chunks[chunk].get(), size, copy.get());
+				chunks[chunk] = std::move(copy);
+				point_rows(chunk);
+			}
+			else {
+				std::atomic_thread_fence(std::memory_order_acquire);
+			}
+		}
+	};
+
+} // namespace matrix_detail
+
+// An immutable version of a shared_matrix, usable wherever a matrix is read
+// (views, element-wise operations, reductions, multiply operands, ...).
+template<typename T>
+struct matrix_snapshot
+{
+	using value_type = T;
+	using size_type = std::size_t;
+
+	matrix_snapshot() = default;
+
+	inline size_type count_rows() const noexcept { return data_ ? data_->count_rows : 0; }
+	inline size_type count_columns() const noexcept { return data_ ? data_->count_columns : 0; }
+	// Number of the version, counted by publish() from 0 for the initial one.
+	inline std::uint64_t version() const noexcept { return data_ ? data_->number : 0; }
+
+	inline const T* operator[](const size_type row) const noexcept { return data_->rows[row]; }
+
+	const T& operator()(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows()) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns()) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+		return data_->rows[row][column];
+	}
+
+	const_matrix_view<T> view() const noexcept
+	{
+		return data_ ? const_matrix_view<T>(data_->rows.data(), data_->count_rows, data_->count_columns, 0) : const_matrix_view<T>{};
+	}
+
+private:
+	friend struct shared_matrix<T>;
+
+	explicit matrix_snapshot(std::shared_ptr<const matrix_detail::matrix_version<T>> data) noexcept
+		: data_{ std::move(data) }
+	{}
+
+	std::shared_ptr<const matrix_detail::matrix_version<T>> data_;
+};
+
+template<typename T>
+struct shared_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+
+	shared_matrix(const size_type rows, const size_type columns, const T& value = T{}, const size_type rows_per_chunk = 1)
+	{
+		if (rows_per_chunk == 0) {
+			throw std::invalid_argument{ "Chunks must hold at least one row" };
+		}
+		auto initial = std::make_shared<version_type>(rows, columns, rows_per_chunk);
+		for (size_type row = 0; row < rows; ++row) {
+			std::fill_n(initial->rows[row], columns, value);
+		}
+		publish_initial(std::move(initial));
+	}
+
+	// The elements of m (matrix, view, fixed_matrix, ...), version 0.
+	template<class M, class = std::enable_if_t<!std::is_arithmetic_v<M>>>
+	explicit shared_matrix(const M& m, const size_type rows_per_chunk = 1)
+	{
+		if (rows_per_chunk == 0) {
+			throw std::invalid_argument{ "Chunks must hold at least one row" };
+		}
+		auto initial = std::make_shared<version_type>(m.count_rows(), m.count_columns(), rows_per_chunk);
+		for (size_type row = 0; row < m.count_rows(); ++row) {
+			const auto& src = m[row];
+			for (size_type column = 0; column < m.count_columns(); ++column) {
+				initial->rows[row][column] = src[column];
+			}
+		}
+		publish_initial(std::move(initial));
+	}
+
+	// Readers hold the address of the counters.
+	shared_matrix(const shared_matrix&) = delete;
+	shared_matrix& operator=(const shared_matrix&) = delete;
+
+	// The current version, from any thread.
+	matrix_snapshot<T> snapshot() const
+	{
+		for (;;) {
+			const unsigned side = side_.load();
+			readers_[side].count.fetch_add(1);
+			if (side_.load() == side) {
+				auto data = current_.load()->shared_from_this();
+				readers_[side].count.fetch_sub(1);
+				return matrix_snapshot<T>(std::move(data));
+			}
+			readers_[side].count.fetch_sub(1);
+		}
+	}
+
+	// The members below are for the writer: one thread at a time.
+
+	inline size_type count_rows() const noexcept { return published_->count_rows; }
+	inline size_type count_columns() const noexcept { return published_->count_columns; }
+	inline size_type rows_per_chunk() const noexcept { return published_->rows_per_chunk; }
+	inline std::uint64_t version() const noexcept { return published_->number; }
+	// True if rows were changed since the last publish().
+	inline bool has_changes() const noexcept { return draft_ != nullptr; }
+
+	// Rows of the next version, with the changes not published yet.
+	inline const T* operator[](const size_type row) const noexcept
+	{
+		return (draft_ ? draft_->rows : published_->rows)[row];
+	}
+
+	// The row to change in the next version, its chunk copied if shared.
+	T* row(const size_type index)
+	{
+		check_row_index(index);
+		version_type& next = draft();
+		next.own_chunk_of(index);
+		return next.rows[index];
+	}
+
+	void set(const size_type row_index, const size_type column, const T& value)
+	{
+		if (column >= count_columns()) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+		row(row_index)[column] = value;
+	}
+
+	// Replaces a row by the first count_columns() elements of 'values'.
+	template<class Row>
+	void assign_row(const size_type row_index, const Row& values)
+	{
+		T* dst = row(row_index);
+		for (size_type column = 0; column < count_columns(); ++column) {
+			dst[column] = values[column];
+		}
+	}
+
+	// Makes the changes visible to the next snapshots and returns the number
+	// of the current version. Waits for the readers taking a snapshot.
+	std::uint64_t publish()
+	{
+		if (!draft_) return version();
+		draft_->number = published_->number + 1;
+		std::shared_ptr<const version_type> next = std::move(draft_);
+		current_.store(next.get());
+		wait_for_readers();
+		published_ = std::move(next);
+		return version();
+	}
+
+private:
+	using version_type = matrix_detail::matrix_version<T>;
+
+	void publish_initial(std::shared_ptr<version_type> initial)
+	{
+		current_.store(initial.get());
+		published_ = std::move(initial);
+	}
+
+	inline void check_row_index(const size_type index) const
+	{
+		if (index >= count_rows()) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+	}
+
+	version_type& draft()
+	{
+		if (!draft_) {
+			draft_ = std::make_shared<version_type>(*published_);
+		}
+		return *draft_;
+	}
+
+	// A grace period as in the Left-Right technique: readers registered on the
+	// other side since the last switch leave first, then the side is switched
+	// and the readers of the old side leave. A reader registering after a check
+	// sees the switch and registers again, so none still reads the previous
+	// version afterwards.
+	void wait_for_readers() const noexcept
+	{
+		const unsigned previous = side_.load();
+		const unsigned next = previous ^ 1u;
+		while (readers_[next].count.load() != 0) std::this_thread::yield();
+		side_.store(next);
+		while (readers_[previous].count.load() != 0) std::this_thread::yield();
+	}
+
+	struct alignas(64) reader_count
+	{
+		std::atomic<std::size_t> count{ 0 };
+	};
+
+	std::shared_ptr<const version_type> published_;
+	std::shared_ptr<version_type> draft_;
+	std::atomic<const version_type*> current_{ nullptr };
+	mutable std::atomic<unsigned> side_{ 0 };
+	mutable reader_count readers_[2];
+};
+
+#endif // !MATRIX_SHARED_MATRIX_HPP
@@ -0,0 +1,460 @@
+#pragma once
+#ifndef MATRIX_BINARY_FORMAT_HPP
+#define MATRIX_BINARY_FORMAT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../matrix_ops/expression.hpp"
+
+// Binary matrix files.
+//
+// A file is a 64-byte header followed by the rows. Every row is padded to
+// 'stride' elements, so that with the data offset also a multiple of the
+// alignment, each row starts at an aligned offset and a memory-mapped file can be
+// used in place by mapped_matrix:
+//
+//   offset  size
+//        0     8  magic "MATRIXB\0"
+//        8     4  byte order mark, 0x01020304 in the byte order of the file
+//       12     2  format version
+//       14     1  element kind: 1 signed integer, 2 unsigned integer, 3 floating point
+//       15     1  element size in bytes
+//       16     8  rows
+//       24     8  columns
+//       32     8  stride, elements per row
+//       40     8  alignment of the rows in bytes
+//       48     8  offset of the first row
+//       56     8  reserved, 0
+//
+// load_matrix() converts files written on a machine of the other byte order,
+// mapped_matrix only opens files in the native byte order.
+
+struct matrix_file_error : std::runtime_error {
+	explicit matrix_file_error(const char* q) : std::runtime_error(q) {}
+	explicit matrix_file_error(const std::string& n) : std::runtime_error(n) {}
+};
+
+// Rows aligned to a cache line by default.
+constexpr std::size_t default_matrix_file_alignment = 64;
+
+namespace matrix_detail {
+
+	constexpr char matrix_file_magic[8] = { 'M', 'A', 'T', 'R', 'I', 'X', 'B', '\0' };
+	constexpr std::uint32_t matrix_file_byte_order = 0x01020304;
+	constexpr std::uint16_t matrix_file_version = 1;
+
+	enum class element_kind : std::uint8_t
+	{
+		signed_integer = 1,
+		unsigned_integer = 2,
+		floating_point = 3
+	};
+
+	template<class T>
+	constexpr element_kind element_kind_of() noexcept
+	{
+		static_assert(std::is_arithmetic_v<T>, "Only matrices of arithmetic types have a binary format");
+		if constexpr (std::is_floating_point_v<T>) return element_kind::floating_point;
+		else if constexpr (std::is_signed_v<T>) return element_kind::signed_integer;
+		else return element_kind::unsigned_integer;
+	}
+
+	struct matrix_file_header
+	{
+		char magic[8];
+		std::uint32_t byte_order;
+		std::uint16_t version;
+		std::uint8_t kind;
+		std::uint8_t element_size;
+		std::uint64_t rows;
+		std::uint64_t columns;
+		std::uint64_t stride;
+		std::uint64_t alignment;
+		std::uint64_t data_offset;
+		std::uint64_t reserved;
+	};
+	static_assert(sizeof(matrix_file_header) == 64 && std::is_trivially_copyable_v<matrix_file_header>);
+
+	template<class U>
+	inline U byte_swapped(const U value) noexcept
+	{
+		unsigned char bytes[sizeof(U)];
+		std::memcpy(bytes, &value, sizeof(U));
+		for (std::size_t i = 0; i < sizeof(U) / 2; ++i) {
+			std::swap(bytes[i], bytes[sizeof(U) - 1 - i]);
+		}
+		U result;
+		std::memcpy(&result, bytes, sizeof(U));
+		return result;
+	}
+
+	inline void swap_header_bytes(matrix_file_header& header) noexcept
+	{
+		header.byte_order = byte_swapped(header.byte_order);
+		header.version = byte_swapped(header.version);
+		header.rows = byte_swapped(header.rows);
+		header.columns = byte_swapped(header.columns);
+		header.stride = byte_swapped(header.stride);
+		header.alignment = byte_swapped(header.alignment);
+		header.data_offset = byte_swapped(header.data_offset);
+		header.reserved = byte_swapped(header.reserved);
+	}
+
+	template<class T>
+	matrix_file_header make_file_header(const std::size_t rows, const std::size_t columns, std::size_t alignment)
+	{
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+			throw std::invalid_argument{ "Alignment of a matrix file must be a power of two" };
+		}
+		// Element sizes are powers of two as well, so a stride in bytes aligned
+		// to at least sizeof(T) is a whole number of elements.
+		alignment = std::max(alignment, sizeof(T));
+		const std::size_t row_bytes = (columns * sizeof(T) + alignment - 1) / alignment * alignment;
+
+		matrix_file_header header{};
+		std::memcpy(header.magic, matrix_file_magic, sizeof(header.magic));
+		header.byte_order = matrix_file_byte_order;
+		header.version = matrix_file_version;
+		header.kind = static_cast<std::uint8_t>(element_kind_of<T>());
+		header.element_size = static_cast<std::uint8_t>(sizeof(T));
+		header.rows = rows;
+		header.columns = columns;
+		header.stride = row_bytes / sizeof(T);
+		header.alignment = alignment;
+		header.data_offset = (sizeof(matrix_file_header) + alignment - 1) / alignment * alignment;
+		return header;
+	}
+
+	// product = a * b, false if it does not fit std::size_t.
+	inline bool multiply_sizes(const std::uint64_t a, const std::uint64_t b, std::uint64_t& product) noexcept
+	{
+		constexpr std::uint64_t max = std::numeric_limits<std::size_t>::max();
+		if (a > max || b > max || (a != 0 && b > max / a)) {
+			return false;
+		}
+		product = a * b;
+		return true;
+	}
+
+	// Converts a header of the other byte order to the native one and checks the
+	// version, for every file format sharing the header. Returns true if swapped.
+	inline bool normalize_file_header(matrix_file_header& header)
+	{
+		const bool swapped = header.byte_order != matrix_file_byte_order;
+		if (swapped) {
+			swap_header_bytes(header);
+			if (header.byte_order != matrix_file_byte_order) {
+				throw matrix_file_error{ "Invalid byte order mark in matrix file" };
+			}
+		}
+		if (header.version > matrix_file_version) {
+			throw matrix_file_error{ "Unsupported matrix file version " + std::to_string(header.version) };
+		}
+		return swapped;
+	}
+
+	// Checks the header read from a file. Returns true if the file has the other byte
+	// order, the header is converted to the native one.
+	inline bool validate_file_header(matrix_file_header& header)
+	{
+		if (std::memcmp(header.magic, matrix_file_magic, sizeof(header.magic)) != 0) {
+			throw matrix_file_error{ "Not a matrix file" };
+		}
+		const bool swapped = normalize_file_header(header);
+		// rows * stride * element_size bytes of rows must be addressable.
+		std::uint64_t stride_bytes = 0;
+		std::uint64_t data_bytes = 0;
+		if (header.stride < header.columns || header.data_offset < sizeof(matrix_file_header)
+			|| !multiply_sizes(header.stride, header.element_size, stride_bytes)
+			|| !multiply_sizes(header.rows, stride_bytes, data_bytes)) {
+			throw matrix_file_error{ "Corrupted matrix file header" };
+		}
+		return swapped;
+	}
+
+	template<class T>
+	void check_element_type(const matrix_file_header& header)
+	{
+		if (header.kind != static_cast<std::uint8_t>(element_kind_of<T>()) || header.element_size != sizeof(T)) {
+			throw matrix_file_error{ "Element type of the matrix file does not match" };
+		}
+	}
+
+	template<class M, class = void>
+	struct has_resize : std::false_type {};
+	template<class M>
+	struct has_resize<M, std::void_t<decltype(std::declval<M&>().resize(std::size_t{}, std::size_t{}))>> : std::true_type {};
+
+	// Read-only mapping of a whole file.
+	struct mapped_file
+	{
+		mapped_file() = default;
+
+		explicit mapped_file(const std::string& path)
+		{
+#if defined(_WIN32)
+			const HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				throw matrix_file_error{ "Cannot open matrix file " + path };
+			}
+			LARGE_INTEGER file_size{};
+			const HANDLE mapping = ::GetFileSizeEx(file, &file_size) && file_size.QuadPart != 0
+				? ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+				: nullptr;
+			::CloseHandle(file);
+			if (mapping == nullptr) {
+				throw matrix_file_error{ "Cannot map matrix file " + path };
+			}
+			// The view keeps the mapping alive.
+			data_ = static_cast<const char*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			::CloseHandle(mapping);
+			if (data_ == nullptr) {
+				throw matrix_file_error{ "Cannot map matrix file " + path };
+			}
+			size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				throw matrix_file_error{ "Cannot open matrix file " + path };
+			}
+			struct stat file_stat {};
+			void* data = MAP_FAILED;
+			if (::fstat(fd, &file_stat) == 0 && file_stat.st_size != 0) {
+				data = ::mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			::close(fd);
+			if (data == MAP_FAILED) {
+				throw matrix_file_error{ "Cannot map matrix file " + path };
+			}
+			data_ = static_cast<const char*>(data);
+			size_ = static_cast<std::size_t>(file_stat.st_size);
+#endif
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		mapped_file(mapped_file&& other) noexcept
+			: data_{ std::exchange(other.data_, nullptr) }
+			, size_{ std::exchange(other.size_, 0) }
+		{}
+		mapped_file& operator=(mapped_file&& other) noexcept
+		{
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+
+		~mapped_file() { unmap(); }
+
+		inline const char* data() const noexcept { return data_; }
+		inline std::size_t size() const noexcept { return size_; }
+
+	private:
+		void unmap() noexcept
+		{
+			if (data_ == nullptr) return;
+#if defined(_WIN32)
+			::UnmapViewOfFile(data_);
+#else
+			::munmap(const_cast<char*>(data_), size_);
+#endif
+			data_ = nullptr;
+			size_ = 0;
+		}
+
+		const char* data_{ nullptr };
+		std::size_t size_{ 0 };
+	};
+
+} // namespace matrix_detail
+
+// Writes m (matrix, fixed_matrix, ...) with rows aligned to 'alignment' bytes.
+template<class M>
+void save_matrix(std::ostream& os, const M& m, const std::size_t alignment = default_matrix_file_alignment)
+{
+	using T = typename M::value_type;
+	const auto header = matrix_detail::make_file_header<T>(m.count_rows(), m.count_columns(), alignment);
+	const std::size_t row_bytes = m.count_columns() * sizeof(T);
+	const std::vector<char> padding(std::max<std::size_t>(header.data_offset - sizeof(header), header.stride * sizeof(T) - row_bytes), 0);
+
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	os.write(padding.data(), static_cast<std::streamsize>(header.data_offset - sizeof(header)));
+	for (std::size_t row = 0; row < m.count_rows() && row_bytes != 0 && os; ++row) {
+		os.write(reinterpret_cast<const char*>(&m[row][0]), static_cast<std::streamsize>(row_bytes));
+		os.write(padding.data(), static_cast<std::streamsize>(header.stride * sizeof(T) - row_bytes));
+	}
+	if (!os) {
+		throw matrix_file_error{ "Failed to write matrix" };
+	}
+}
+
+template<class M>
+void save_matrix(const std::string& path, const M& m, const std::size_t alignment = default_matrix_file_alignment)
+{
+	std::ofstream os(path, std::ios::binary | std::ios::trunc);
+	if (!os) {
+		throw matrix_file_error{ "Cannot create matrix file " + path };
+	}
+	save_matrix(os, m, alignment);
+	os.close();
+	if (!os) {
+		throw matrix_file_error{ "Failed to write matrix file " + path };
+	}
+}
+
+// Reads a matrix written by save_matrix into m. A matrix is resized to the shape of
+// the file, the shape of a fixed_matrix must match it. The element type must match
+// exactly, elements are not converted.
+template<class M>
+void load_matrix(std::istream& is, M& m)
+{
+	using T = typename M::value_type;
+
+	matrix_detail::matrix_file_header header{};
+	if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+		throw matrix_file_error{ "Unexpected end of matrix file" };
+	}
+	const bool swapped = matrix_detail::validate_file_header(header);
+	matrix_detail::check_element_type<T>(header);
+
+	const auto rows = static_cast<std::size_t>(header.rows);
+	const auto columns = static_cast<std::size_t>(header.columns);
+	if constexpr (matrix_detail::has_resize<M>::value) {
+		m.resize(rows, columns);
+	}
+	else if (m.count_rows() != rows || m.count_columns() != columns) {
+		throw matrix_file_error{ "Shape of the matrix file does not match" };
+	}
+
+	is.ignore(static_cast<std::streamsize>(header.data_offset - sizeof(header)));
+	const std::size_t row_bytes = columns * sizeof(T);
+	const auto padding_bytes = static_cast<std::streamsize>(header.stride * sizeof(T) - row_bytes);
+	for (std::size_t row = 0; row < rows && row_bytes != 0 && is; ++row) {
+		T* dst = &m[row][0];
+		is.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(row_bytes));
+		if (row + 1 < rows) {
+			is.ignore(padding_bytes);
+		}
+		if (swapped) {
+			for (std::size_t column = 0; column < columns; ++column) {
+				dst[column] = matrix_detail::byte_swapped(dst[column]);
+			}
+		}
+	}
+	if (!is) {
+		throw matrix_file_error{ "Unexpected end of matrix file" };
+	}
+}
+
+template<class M>
+void load_matrix(const std::string& path, M& m)
+{
+	std::ifstream is(path, std::ios::binary);
+	if (!is) {
+		throw matrix_file_error{ "Cannot open matrix file " + path };
+	}
+	load_matrix(is, m);
+}
+
+template<class M>
+M load_matrix(const std::string& path)
+{
+	M m;
+	load_matrix(path, m);
+	return m;
+}
+
+// Read-only matrix in a memory-mapped file written by save_matrix. Opening costs
+// one mapping whatever the size of the file, pages are read on first access.
+// Rows are used in place, so it works wherever a const matrix is expected by
+// element-wise expressions.
+template<typename T>
+struct mapped_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+	using const_pointer = const T*;
+	using const_reference = const T&;
+
+	explicit mapped_matrix(const std::string& path)
+		: file_{ path }
+	{
+		matrix_detail::matrix_file_header header{};
+		if (file_.size() < sizeof(header)) {
+			throw matrix_file_error{ "Unexpected end of matrix file" };
+		}
+		std::memcpy(&header, file_.data(), sizeof(header));
+		if (matrix_detail::validate_file_header(header)) {
+			throw matrix_file_error{ "Matrix file has a foreign byte order and cannot be mapped, use load_matrix" };
+		}
+		matrix_detail::check_element_type<T>(header);
+		if (header.data_offset % alignof(T) != 0) {
+			throw matrix_file_error{ "Matrix file rows are not aligned for the element type" };
+		}
+		// Cannot overflow, validate_file_header checked the product.
+		const std::uint64_t data_bytes = header.rows * header.stride * sizeof(T);
+		if (header.data_offset > file_.size() || data_bytes > file_.size() - header.data_offset) {
+			throw matrix_file_error{ "Unexpected end of matrix file" };
+		}
+
+		data_ = reinterpret_cast<const T*>(file_.data() + header.data_offset);
+		count_rows_ = static_cast<size_type>(header.rows);
+		count_columns_ = static_cast<size_type>(header.columns);
+		stride_ = static_cast<size_type>(header.stride);
+	}
+
+	inline size_type count_rows() const noexcept { return count_rows_; }
+	inline size_type count_columns() const noexcept { return count_columns_; }
+	// Distance between the starts of two rows, in elements.
+	inline size_type stride() const noexcept { return stride_; }
+	inline const_pointer data() const noexcept { return data_; }
+
+	inline const_pointer operator[](const size_type row) const noexcept { return data_ + row * stride_; }
+
+	const_reference operator()(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+		return data_[row * stride_ + column];
+	}
+
+private:
+	matrix_detail::mapped_file file_;
+	const T* data_{ nullptr };
+	size_type count_rows_{ 0 };
+	size_type count_columns_{ 0 };
+	size_type stride_{ 0 };
+};
+
+template<typename T>
+struct is_matrix_container<mapped_matrix<T>> : std::true_type {};
+
+#endif // !MATRIX_BINARY_FORMAT_HPP
@@ -0,0 +1,334 @@
+#pragma once
+#ifndef MATRIX_TEXT_FORMAT_HPP
+#define MATRIX_TEXT_FORMAT_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "../matrix_ops/thread_pool.hpp"
+
+// Text matrices: one row per line, elements separated by a delimiter (CSV) or by
+// spaces and tabs. Blank lines are skipped, spaces around elements and "\r\n" line
+// ends are accepted. The number of columns is taken from the first row.
+//
+// Numbers are converted with std::from_chars/std::to_chars, which don't depend on
+// the locale. Floating point values are written in the shortest form that reads
+// back to the same value.
+//
+// Streams are read in chunks of whole lines and the rows of every chunk are
+// appended to the matrix with push_row. A text already in memory can be parsed in
+// parallel: it is split at line boundaries, each part is parsed into its own
+// buffer and the parts are copied into the matrix at the end.
+
+struct matrix_text_error : std::runtime_error {
+	explicit matrix_text_error(const char* q) : std::runtime_error(q) {}
+	explicit matrix_text_error(const std::string& n) : std::runtime_error(n) {}
+};
+
+struct text_format
+{
+	// Separator of the elements of a row, '\0' for runs of spaces and tabs.
+	char delimiter;
+};
+
+inline constexpr text_format csv_format{ ',' };
+inline constexpr text_format whitespace_format{ '\0' };
+
+constexpr std::size_t default_text_chunk_size = 1024 * 1024;
+
+namespace matrix_detail {
+
+	constexpr std::size_t unknown_columns = std::numeric_limits<std::size_t>::max();
+
+	inline bool is_blank(const char c) noexcept { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* skip_blanks(const char* first, const char* last) noexcept
+	{
+		while (first != last && is_blank(*first)) ++first;
+		return first;
+	}
+
+	// Parses one element, returns nullptr if [first, last) doesn't start with a number of type T.
+	template<class T>
+	inline const char* parse_number(const char* first, const char* last, T& value) noexcept
+	{
+		// std::from_chars doesn't accept a plus sign.
+		if (first != last && *first == '+') ++first;
+		const auto [ptr, ec] = std::from_chars(first, last, value);
+		return (ec == std::errc{}) ? ptr : nullptr;
+	}
+
+	// Parses the lines of [first, last) and appends their elements to 'values'.
+	// 'columns' is the row size seen so far (unknown_columns before the first row),
+	// 'line' counts the lines from 0 and is passed to fail(line, message) on errors.
+	// Returns the number of rows parsed.
+	template<class T, class Fail>
+	std::size_t parse_lines(const char* first, const char* const last, const text_format& format,
+		std::vector<T>& values, std::size_t& columns, std::size_t& line, Fail&& fail)
+	{
+		std::size_t rows = 0;
+		while (first != last) {
+			const char* line_end = static_cast<const char*>(std::memchr(first, '\n', static_cast<std::size_t>(last - first)));
+			if (line_end == nullptr) line_end = last;
+
+			const std::size_t row_begin = values.size();
+			const char* p = skip_blanks(first, line_end);
+			while (p != line_end) {
+				T value{};
+				const char* next = parse_number(p, line_end, value);
+				if (next == nullptr) fail(line, "Invalid number");
+				values.push_back(value);
+
+				p = skip_blanks(next, line_end);
+				if (p == line_end) break;
+				if (format.delimiter != '\0') {
+					if (*p != format.delimiter) fail(line, "Expected a delimiter");
+					p = skip_blanks(p + 1, line_end);
+					if (p == line_end) fail(line, "Missing element after a delimiter");
+				}
+				else if (p == next) {
+					fail(line, "Expected a space between elements");
+				}
+			}
+
+			const std::size_t count = values.size() - row_begin;
+			if (count != 0) {
+				if (columns == unknown_columns) columns = count;
+				else if (count != columns) fail(line, "Row has a different number of elements");
+				++rows;
+			}
+			++line;
+			first = (line_end == last) ? last : line_end + 1;
+		}
+		return rows;
+	}
+
+	[[noreturn]] inline void throw_text_error(const std::size_t line, const char* message)
+	{
+		throw matrix_text_error{ std::string{ message } + " at line " + std::to_string(line + 1) };
+	}
+
+	// Range over the elements of a parsed row, for push_row.
+	template<class T>
+	struct parsed_row
+	{
+		const T* first;
+		std::size_t count;
+
+		inline const T* begin() const noexcept { return first; }
+		inline const T* end() const noexcept { return first + count; }
+		inline std::size_t size() const noexcept { return count; }
+	};
+
+	template<class M, class T>
+	void append_rows(M& m, const std::vector<T>& values, const std::size_t rows, const std::size_t columns)
+	{
+		for (std::size_t row = 0; row < rows; ++row) {
+			m.push_row(parsed_row<T>{ values.data() + row * columns, columns });
+		}
+	}
+
+	template<class T>
+	inline void append_number(std::string& out, const T value)
+	{
+		char digits[64];
+		const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+		out.append(digits, result.ptr);
+	}
+
+} // namespace matrix_detail
+
+// Replaces the contents of m (a matrix) with the rows read from the stream.
+template<class M>
+void read_text(std::istream& is, M& m, const text_format& format = csv_format, const std::size_t chunk_size = default_text_chunk_size)
+{
+	using T = typename M::value_type;
+
+	m.resize(0, 0);
+	std::vector<char> buffer(std::max<std::size_t>(chunk_size, 1));
+	std::vector<T> values;
+	std::size_t columns = matrix_detail::unknown_columns;
+	std::size_t line = 0;
+	std::size_t carry = 0;
+
+	for (bool at_end = false; !at_end;) {
+		is.read(buffer.data() + carry, static_cast<std::streamsize>(buffer.size() - carry));
+		const std::size_t filled = carry + static_cast<std::size_t>(is.gcount());
+		at_end = !is;
+		if (is.bad()) {
+			throw matrix_text_error{ "Failed to read matrix text" };
+		}
+
+		const char* const begin = buffer.data();
+		const char* const end = begin + filled;
+		const char* parse_end = end;
+		if (!at_end) {
+			const auto last_newline = std::find(std::make_reverse_iterator(end), std::make_reverse_iterator(begin), '\n');
+			parse_end = last_newline.base();
+			if (parse_end == begin) {
+				// A line longer than the buffer.
+				carry = filled;
+				buffer.resize(buffer.size() * 2);
+				continue;
+			}
+		}
+
+		const std::size_t rows = matrix_detail::parse_lines(begin, parse_end, format, values, columns, line, matrix_detail::throw_text_error);
+		matrix_detail::append_rows(m, values, rows, columns);
+		values.clear();
+
+		carry = static_cast<std::size_t>(end - parse_end);
+		std::memmove(buffer.data(), parse_end, carry);
+	}
+}
+
+template<class M>
+M read_text(const std::string& path, const text_format& format = csv_format)
+{
+	std::ifstream is(path, std::ios::binary);
+	if (!is) {
+		throw matrix_text_error{ "Cannot open matrix text file " + path };
+	}
+	M m;
+	read_text(is, m, format);
+	return m;
+}
+
+// Parses a text in memory. With matrix_execution::par the text is split at line
+// boundaries and the parts are parsed by the shared thread pool.
+template<class M, class ExecutionPolicy, class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+M parse_text(const ExecutionPolicy& policy, const std::string_view text, const text_format& format = csv_format)
+{
+	using T = typename M::value_type;
+
+	struct part
+	{
+		const char* first;
+		const char* last;
+		std::vector<T> values;
+		std::size_t rows;
+		std::size_t columns;
+	};
+
+	// Parts of at least a chunk, a few per thread to even out the load.
+	const std::size_t count = std::max<std::size_t>(1, std::min(4 * matrix_execution::thread_count(policy),
+		text.size() / default_text_chunk_size));
+	std::vector<part> parts;
+	const char* const text_begin = text.data();
+	const char* const text_end = text_begin + text.size();
+	const char* first = text_begin;
+	for (std::size_t index = 1; index <= count && first != text_end; ++index) {
+		const char* last = text_end;
+		if (index != count) {
+			last = std::max(first, text_begin + text.size() / count * index);
+			last = std::find(last, text_end, '\n');
+			if (last != text_end) ++last;
+		}
+		parts.push_back({ first, last, {}, 0, matrix_detail::unknown_columns });
+		first = last;
+	}
+
+	// Line numbers of the errors are counted only when one is reported.
+	const auto fail_in_part = [text_begin](const part& p) {
+		return [text_begin, &p](const std::size_t line, const char* message) {
+			matrix_detail::throw_text_error(static_cast<std::size_t>(std::count(text_begin, p.first, '\n')) + line, message);
+		};
+	};
+	matrix_execution::for_each_tile(policy, 0, parts.size(), 1, [&](const std::size_t first_part, const std::size_t last_part) {
+		for (std::size_t index = first_part; index < last_part; ++index) {
+			part& p = parts[index];
+			std::size_t line = 0;
+			p.rows = matrix_detail::parse_lines(p.first, p.last, format, p.values, p.columns, line, fail_in_part(p));
+		}
+	});
+
+	std::size_t rows = 0;
+	std::size_t columns = matrix_detail::unknown_columns;
+	std::vector<std::size_t> first_rows;
+	for (const part& p : parts) {
+		if (p.rows != 0 && columns != matrix_detail::unknown_columns && p.columns != columns) {
+			// Parses the part again expecting the row size of the previous parts
+			// to report the line of the first mismatch.
+			std::vector<T> values;
+			std::size_t line = 0;
+			std::size_t expected = columns;
+			matrix_detail::parse_lines(p.first, p.last, format, values, expected, line, fail_in_part(p));
+		}
+		if (p.rows != 0) columns = p.columns;
+		first_rows.push_back(rows);
+		rows += p.rows;
+	}
+	if (rows == 0) {
+		return M{};
+	}
+
+	M m(rows, columns);
+	matrix_execution::for_each_tile(policy, 0, parts.size(), 1, [&](const std::size_t first_part, const std::size_t last_part) {
+		for (std::size_t index = first_part; index < last_part; ++index) {
+			const part& p = parts[index];
+			for (std::size_t row = 0; row < p.rows; ++row) {
+				std::copy_n(p.values.data() + row * columns, columns, &m[first_rows[index] + row][0]);
+			}
+		}
+	});
+	return m;
+}
+
+template<class M>
+M parse_text(const std::string_view text, const text_format& format = csv_format)
+{
+	return parse_text<M>(matrix_execution::seq, text, format);
+}
+
+// Writes m (matrix, fixed_matrix, ...) one row per line, the output is formatted
+// in a buffer of about chunk_size characters.
+template<class M>
+void write_text(std::ostream& os, const M& m, const text_format& format = csv_format, const std::size_t chunk_size = default_text_chunk_size)
+{
+	const char delimiter = (format.delimiter != '\0') ? format.delimiter : ' ';
+	std::string buffer;
+	buffer.reserve(chunk_size + 128);
+	for (std::size_t row = 0; row < m.count_rows(); ++row) {
+		const auto& src = m[row];
+		for (std::size_t column = 0; column < m.count_columns(); ++column) {
+			if (column != 0) buffer.push_back(delimiter);
+			matrix_detail::append_number(buffer, src[column]);
+			if (buffer.size() >= chunk_size) {
+				os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				buffer.clear();
+			}
+		}
+		buffer.push_back('\n');
+	}
+	os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	if (!os) {
+		throw matrix_text_error{ "Failed to write matrix text" };
+	}
+}
+
+template<class M>
+void write_text(const std::string& path, const M& m, const text_format& format = csv_format)
+{
+	std::ofstream os(path, std::ios::binary | std::ios::trunc);
+	if (!os) {
+		throw matrix_text_error{ "Cannot create matrix text file " + path };
+	}
+	write_text(os, m, format);
+	os.close();
+	if (!os) {
+		throw matrix_text_error{ "Failed to write matrix text file " + path };
+	}
+}
+
+#endif // !MATRIX_TEXT_FORMAT_HPP
@@ -0,0 +1,1017 @@
+#pragma once
+#ifndef MATRIX_TILED_MATRIX_HPP
+#define MATRIX_TILED_MATRIX_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "binary_format.hpp"
+#include "../matrix/matrix.hpp"
+#include "../matrix_ops/multiply.hpp"
+#include "../matrix_ops/reductions.hpp"
+#include "../matrix_ops/simd.hpp"
+#include "../matrix_ops/transpose.hpp"
+
+// Out-of-core matrices.
+//
+// tiled_matrix<T> keeps its elements in a file as square tiles of tile_size() x
+// tile_size() elements, one after another in row-major order of the tiles, and
+// only a bounded number of tiles in memory. The tiles in memory form an LRU
+// cache, a tile that misses the cache evicts the least recently used one (and
+// writes it back if it was modified). A background thread reads the tiles that
+// follow a missed one, in row-major order, while the current one is processed;
+// algorithms walking the tiles in another order ask for them with prefetch().
+//
+// Elements are read and written through tiles: tile(i, j) pins the tile in the
+// cache and gives a matrix_view of it, which works with every algorithm taking
+// views. multiply() and transpose() of tiled matrices run the in-memory kernels
+// tile by tile, so operands and results may be larger than memory:
+//
+//   tiled_matrix<double> a("a.tiles", n, n), b("b.tiles", n, n), c("c.tiles", n, n);
+//   multiply(matrix_execution::par, a, b, c);
+//
+// The reductions of reductions.hpp (sum, dot, min_value, max_value, argmin,
+// argmax, the norms, row_sums and col_sums) also run tile by tile, the sums of
+// the tiles combined as those of the rows of one. row_reduce and col_reduce
+// have no tiled form, their 'init' enters once per row or column: apply them
+// to the views of the tiles.
+//
+// Element access (operator(), set) and blocks (block, set_block) go through the
+// tiles as well, they are meant for occasional access, not for loops over the
+// elements.
+//
+// File layout (native byte order only, a tiled file is working storage):
+//
+//   offset  size
+//        0    64  matrix file header (see binary_format.hpp), magic "MATRIXT\0",
+//                 stride = tile size, data offset = 4096
+//     4096     -  tiles of tile_size^2 elements, edge tiles padded
+
+struct tiled_matrix_options
+{
+	// Rows and columns of a tile, for a new file.
+	std::size_t tile_size{ 256 };
+	// Tiles kept in memory, at least 4.
+	std::size_t cache_tiles{ 64 };
+	// Tiles read ahead after a miss, 0 - no background reads.
+	std::size_t prefetch_tiles{ 2 };
+};
+
+struct tile_cache_statistics
+{
+	std::uint64_t hits{ 0 };
+	std::uint64_t misses{ 0 };
+	std::uint64_t prefetches{ 0 };
+	std::uint64_t evictions{ 0 };
+	std::uint64_t writes{ 0 };
+};
+
+namespace matrix_detail {
+
+	constexpr char tiled_file_magic[8] = { 'M', 'A', 'T', 'R', 'I', 'X', 'T', '\0' };
+	constexpr std::uint64_t tiled_file_data_offset = 4096;
+
+	// File read and written at explicit offsets, by several threads at once.
+	struct tile_file
+	{
+		tile_file() = default;
+
+		tile_file(const std::string& path, const bool create)
+		{
+#if defined(_WIN32)
+			handle_ = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+				create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (handle_ == INVALID_HANDLE_VALUE) {
+				throw matrix_file_error{ "Cannot open matrix file " + path };
+			}
+#else
+			fd_ = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+			if (fd_ < 0) {
+				throw matrix_file_error{ "Cannot open matrix file " + path };
+			}
+#endif
+		}
+
+		tile_file(const tile_file&) = delete;
+		tile_file& operator=(const tile_file&) = delete;
+#if defined(_WIN32)
+		tile_file(tile_file&& other) noexcept : handle_{ std::exchange(other.handle_, INVALID_HANDLE_VALUE) } {}
+#else
+		tile_file(tile_file&& other) noexcept : fd_{ std::exchange(other.fd_, -1) } {}
+#endif
+		tile_file& operator=(tile_file&&) = delete;
+
+		~tile_file()
+		{
+#if defined(_WIN32)
+			if (handle_ != INVALID_HANDLE_VALUE) ::CloseHandle(handle_);
+#else
+			if (fd_ >= 0) ::close(fd_);
+#endif
+		}
+
+		void read(std::uint64_t offset, void* data, std::size_t bytes) const
+		{
+			auto* dst = static_cast<char*>(data);
+			while (bytes != 0) {
+#if defined(_WIN32)
+				OVERLAPPED position{};
+				position.Offset = static_cast<DWORD>(offset);
+				position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD count = 0;
+				const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(bytes, 1u << 30));
+				if (!::ReadFile(handle_, dst, chunk, &count, &position) || count == 0) {
+					throw matrix_file_error{ "Failed to read tile of matrix file" };
+				}
+#else
+				const ::ssize_t count = ::pread(fd_, dst, bytes, static_cast<::off_t>(offset));
+				if (count <= 0) {
+					throw matrix_file_error{ "Failed to read tile of matrix file" };
+				}
+#endif
+				dst += count;
+				offset += static_cast<std::uint64_t>(count);
+				bytes -= static_cast<std::size_t>(count);
+			}
+		}
+
+		void write(std::uint64_t offset, const void* data, std::size_t bytes) const
+		{
+			const auto* src = static_cast<const char*>(data);
+			while (bytes != 0) {
+#if defined(_WIN32)
+				OVERLAPPED position{};
+				position.Offset = static_cast<DWORD>(offset);
+				position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD count = 0;
+				const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(bytes, 1u << 30));
+				if (!::WriteFile(handle_, src, chunk, &count, &position) || count == 0) {
+					throw matrix_file_error{ "Failed to write tile of matrix file" };
+				}
+#else
+				const ::ssize_t count = ::pwrite(fd_, src, bytes, static_cast<::off_t>(offset));
+				if (count <= 0) {
+					throw matrix_file_error{ "Failed to write tile of matrix file" };
+				}
+#endif
+				src += count;
+				offset += static_cast<std::uint64_t>(count);
+				bytes -= static_cast<std::size_t>(count);
+			}
+		}
+
+		std::uint64_t size() const
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER size{};
+			if (!::GetFileSizeEx(handle_, &size)) {
+				throw matrix_file_error{ "Cannot get the size of matrix file" };
+			}
+			return static_cast<std::uint64_t>(size.QuadPart);
+#else
+			struct ::stat file_stat{};
+			if (::fstat(fd_, &file_stat) != 0) {
+				throw matrix_file_error{ "Cannot get the size of matrix file" };
+			}
+			return static_cast<std::uint64_t>(file_stat.st_size);
+#endif
+		}
+
+		// Sets the size of the file, new bytes read as zeros.
+		void resize(const std::uint64_t bytes) const
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER size{};
+			size.QuadPart = static_cast<LONGLONG>(bytes);
+			if (!::SetFilePointerEx(handle_, size, nullptr, FILE_BEGIN) || !::SetEndOfFile(handle_)) {
+				throw matrix_file_error{ "Cannot resize matrix file" };
+			}
+#else
+			if (::ftruncate(fd_, static_cast<::off_t>(bytes)) != 0) {
+				throw matrix_file_error{ "Cannot resize matrix file" };
+			}
+#endif
+		}
+
+	private:
+#if defined(_WIN32)
+		HANDLE handle_{ INVALID_HANDLE_VALUE };
+#else
+		int fd_{ -1 };
+#endif
+	};
+
+	// LRU cache of the tiles of one file and the thread reading tiles ahead.
+	// All the bookkeeping is under one mutex; reads run outside of it, write-backs
+	// of evicted tiles inside, so a tile is never read while its newer contents
+	// are on their way to the file.
+	template<class T>
+	struct tile_cache
+	{
+		static constexpr std::size_t no_tile = static_cast<std::size_t>(-1);
+
+		struct entry
+		{
+			std::size_t index{ no_tile };
+			aligned_buffer<T> data;
+			std::size_t pins{ 0 };
+			bool loading{ false };
+			bool dirty{ false };
+		};
+		using iterator = typename std::list<entry>::iterator;
+
+		tile_cache(tile_file&& file, const std::size_t tile_count, const std::size_t tile_elements, const tiled_matrix_options& options)
+			: file_{ std::move(file) }
+			, tile_count_{ tile_count }
+			, tile_elements_{ tile_elements }
+			, capacity_{ options.cache_tiles }
+			, prefetch_tiles_{ options.prefetch_tiles }
+		{
+			if (prefetch_tiles_ != 0) {
+				reader_ = std::thread([this] { read_ahead(); });
+			}
+		}
+
+		tile_cache(const tile_cache&) = delete;
+		tile_cache& operator=(const tile_cache&) = delete;
+
+		~tile_cache()
+		{
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				stop_ = true;
+			}
+			requested_.notify_all();
+			if (reader_.joinable()) reader_.join();
+			try {
+				flush();
+			}
+			catch (...) {
+				// Destructors don't throw, flush() before to see write errors.
+			}
+		}
+
+		// The tile pinned in memory, marked as modified if 'write'.
+		entry& acquire(const std::size_t index, const bool write)
+		{
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			for (auto found = map_.find(index); found != map_.end(); found = map_.find(index)) {
+				const iterator tile = found->second;
+				if (tile->loading) {
+					loaded_.wait(lock);
+					continue;
+				}
+				lru_.splice(lru_.begin(), lru_, tile);
+				++tile->pins;
+				tile->dirty |= write;
+				++statistics_.hits;
+				return *tile;
+			}
+
+			++statistics_.misses;
+			const iterator tile = claim(index);
+			if (tile == lru_.end()) {
+				throw std::runtime_error{ "All tiles of the cache are in use, more cache tiles are needed" };
+			}
+			load(lock, tile);
+			tile->dirty = write;
+			for (std::size_t next = index + 1; next <= index + prefetch_tiles_ && next < tile_count_; ++next) {
+				request(next);
+			}
+			requested_.notify_one();
+			return *tile;
+		}
+
+		void release(entry& tile) noexcept
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			--tile.pins;
+		}
+
+		void prefetch(const std::size_t index)
+		{
+			if (prefetch_tiles_ == 0) return;
+			{
+				std::lock_guard<std::mutex> lock{ mutex_ };
+				request(index);
+			}
+			requested_.notify_one();
+		}
+
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			for (auto& tile : lru_) {
+				if (tile.dirty && !tile.loading) {
+					write_back(tile);
+				}
+			}
+		}
+
+		tile_cache_statistics statistics() const
+		{
+			std::lock_guard<std::mutex> lock{ mutex_ };
+			return statistics_;
+		}
+
+	private:
+		inline std::uint64_t offset(const std::size_t index) const noexcept
+		{
+			return tiled_file_data_offset + static_cast<std::uint64_t>(index) * tile_elements_ * sizeof(T);
+		}
+
+		void write_back(entry& tile)
+		{
+			file_.write(offset(tile.index), tile.data.data(), tile_elements_ * sizeof(T));
+			tile.dirty = false;
+			++statistics_.writes;
+		}
+
+		// An entry for 'index', pinned and marked as loading: a new one while the
+		// cache isn't full, otherwise the least recently used unpinned one, written
+		// back if modified. lru_.end() if all are pinned. The mutex is held.
+		iterator claim(const std::size_t index)
+		{
+			iterator tile;
+			if (lru_.size() < capacity_) {
+				lru_.emplace_front();
+				tile = lru_.begin();
+				tile->data = aligned_buffer<T>(tile_elements_);
+			}
+			else {
+				auto candidate = std::find_if(lru_.rbegin(), lru_.rend(), [](const entry& e) { return e.pins == 0 && !e.loading; });
+				if (candidate == lru_.rend()) return lru_.end();
+				tile = std::prev(candidate.base());
+				if (tile->dirty) {
+					write_back(*tile);
+				}
+				if (tile->index != no_tile) {
+					map_.erase(tile->index);
+					++statistics_.evictions;
+				}
+				lru_.splice(lru_.begin(), lru_, tile);
+			}
+			tile->index = index;
+			tile->pins = 1;
+			tile->loading = true;
+			tile->dirty = false;
+			map_[index] = tile;
+			return tile;
+		}
+
+		// Reads the claimed tile with the mutex released.
+		void load(std::unique_lock<std::mutex>& lock, const iterator tile)
+		{
+			lock.unlock();
+			try {
+				file_.read(offset(tile->index), tile->data.data(), tile_elements_ * sizeof(T));
+			}
+			catch (...) {
+				lock.lock();
+				map_.erase(tile->index);
+				tile->index = no_tile;
+				tile->pins = 0;
+				tile->loading = false;
+				loaded_.notify_all();
+				throw;
+			}
+			lock.lock();
+			tile->loading = false;
+			loaded_.notify_all();
+		}
+
+		// Queues a read ahead, the oldest requests are dropped beyond half the cache.
+		void request(const std::size_t index)
+		{
+			if (index >= tile_count_ || map_.count(index) != 0) return;
+			if (std::find(queue_.cbegin(), queue_.cend(), index) != queue_.cend()) return;
+			queue_.push_back(index);
+			while (queue_.size() > std::max<std::size_t>(1, capacity_ / 2)) {
+				queue_.pop_front();
+			}
+		}
+
+		void read_ahead()
+		{
+			std::unique_lock<std::mutex> lock{ mutex_ };
+			for (;;) {
+				requested_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+				if (stop_) return;
+				const std::size_t index = queue_.front();
+				queue_.pop_front();
+				if (map_.count(index) != 0) continue;
+				iterator tile;
+				try {
+					tile = claim(index);
+					if (tile == lru_.end()) continue;
+					load(lock, tile);
+				}
+				catch (...) {
+					// A failed read ahead is retried, and reported, by acquire().
+					continue;
+				}
+				--tile->pins;
+				++statistics_.prefetches;
+			}
+		}
+
+		tile_file file_;
+		const std::size_t tile_count_;
+		const std::size_t tile_elements_;
+		const std::size_t capacity_;
+		const std::size_t prefetch_tiles_;
+
+		mutable std::mutex mutex_;
+		std::condition_variable loaded_;
+		std::condition_variable requested_;
+		std::list<entry> lru_;
+		std::unordered_map<std::size_t, iterator> map_;
+		std::deque<std::size_t> queue_;
+		tile_cache_statistics statistics_;
+		bool stop_{ false };
+		std::thread reader_;
+	};
+
+} // namespace matrix_detail
+
+template<typename T>
+struct tiled_matrix;
+
+// A tile pinned in the cache, released on destruction. U is T or const T.
+template<typename U>
+struct tile_handle
+{
+	using value_type = std::remove_const_t<U>;
+	using size_type = std::size_t;
+
+	tile_handle(const tile_handle&) = delete;
+	tile_handle& operator=(const tile_handle&) = delete;
+	tile_handle(tile_handle&& other) noexcept
+		: cache_{ std::exchange(other.cache_, nullptr) }
+		, entry_{ other.entry_ }
+		, view_{ other.view_ }
+		, row_{ other.row_ }
+		, column_{ other.column_ }
+	{}
+	tile_handle& operator=(tile_handle&&) = delete;
+	~tile_handle()
+	{
+		if (cache_ != nullptr) cache_->release(*entry_);
+	}
+
+	// Elements of the tile, valid as long as the handle.
+	inline const matrix_view<U>& view() const noexcept { return view_; }
+	// Position of the first element of the tile in the matrix.
+	inline size_type row() const noexcept { return row_; }
+	inline size_type column() const noexcept { return column_; }
+
+private:
+	friend struct tiled_matrix<value_type>;
+	using cache_type = matrix_detail::tile_cache<value_type>;
+
+	tile_handle(cache_type* cache, typename cache_type::entry& entry, const matrix_view<U>& view, const size_type row, const size_type column) noexcept
+		: cache_{ cache }
+		, entry_{ &entry }
+		, view_{ view }
+		, row_{ row }
+		, column_{ column }
+	{}
+
+	cache_type* cache_;
+	typename cache_type::entry* entry_;
+	matrix_view<U> view_;
+	size_type row_;
+	size_type column_;
+};
+
+template<typename T>
+struct tiled_matrix
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Tiled matrices hold trivially copyable elements");
+
+	using value_type = T;
+	using size_type = std::size_t;
+
+	// Creates (or truncates) the file 'path' for a rows x columns matrix of zeros.
+	tiled_matrix(const std::string& path, const size_type rows, const size_type columns, const tiled_matrix_options& options = {})
+		: count_rows_{ rows }
+		, count_columns_{ columns }
+		, tile_size_{ options.tile_size }
+	{
+		if (tile_size_ == 0) {
+			throw std::invalid_argument{ "Tile size must not be zero" };
+		}
+		matrix_detail::tile_file file(path, true);
+		auto header = matrix_detail::make_file_header<T>(rows, columns, sizeof(T));
+		std::memcpy(header.magic, matrix_detail::tiled_file_magic, sizeof(header.magic));
+		header.stride = tile_size_;
+		header.data_offset = matrix_detail::tiled_file_data_offset;
+		file.write(0, &header, sizeof(header));
+		file.resize(header.data_offset + static_cast<std::uint64_t>(count_tile_rows() * count_tile_columns()) * tile_bytes());
+		open_cache(std::move(file), options);
+	}
+
+	// Opens a file created as above, the tile size is the one of the file.
+	explicit tiled_matrix(const std::string& path, const tiled_matrix_options& options = {})
+	{
+		matrix_detail::tile_file file(path, false);
+		const std::uint64_t file_size = file.size();
+		matrix_detail::matrix_file_header header{};
+		if (file_size < sizeof(header)) {
+			throw matrix_file_error{ "Unexpected end of matrix file" };
+		}
+		file.read(0, &header, sizeof(header));
+		if (std::memcmp(header.magic, matrix_detail::tiled_file_magic, sizeof(header.magic)) != 0) {
+			throw matrix_file_error{ "Not a tiled matrix file" };
+		}
+		if (matrix_detail::normalize_file_header(header)) {
+			throw matrix_file_error{ "Tiled matrix file has a foreign byte order" };
+		}
+		matrix_detail::check_element_type<T>(header);
+		if (header.stride == 0 || header.data_offset != matrix_detail::tiled_file_data_offset) {
+			throw matrix_file_error{ "Corrupted matrix file header" };
+		}
+		// Every tile, edge tiles included, is stride^2 elements in the file.
+		const std::uint64_t tile_rows = header.rows / header.stride + (header.rows % header.stride != 0);
+		const std::uint64_t tile_columns = header.columns / header.stride + (header.columns % header.stride != 0);
+		std::uint64_t tile_elements = 0;
+		std::uint64_t tile_bytes = 0;
+		std::uint64_t tile_count = 0;
+		std::uint64_t data_bytes = 0;
+		if (header.rows > std::numeric_limits<size_type>::max() || header.columns > std::numeric_limits<size_type>::max()
+			|| !matrix_detail::multiply_sizes(header.stride, header.stride, tile_elements)
+			|| !matrix_detail::multiply_sizes(tile_elements, sizeof(T), tile_bytes)
+			|| !matrix_detail::multiply_sizes(tile_rows, tile_columns, tile_count)
+			|| !matrix_detail::multiply_sizes(tile_count, tile_bytes, data_bytes)) {
+			throw matrix_file_error{ "Corrupted matrix file header" };
+		}
+		if (header.data_offset > file_size || data_bytes > file_size - header.data_offset) {
+			throw matrix_file_error{ "Unexpected end of matrix file" };
+		}
+		count_rows_ = static_cast<size_type>(header.rows);
+		count_columns_ = static_cast<size_type>(header.columns);
+		tile_size_ = static_cast<size_type>(header.stride);
+		open_cache(std::move(file), options);
+	}
+
+	inline size_type count_rows() const noexcept { return count_rows_; }
+	inline size_type count_columns() const noexcept { return count_columns_; }
+	inline size_type tile_size() const noexcept { return tile_size_; }
+	inline size_type count_tile_rows() const noexcept { return (count_rows_ + tile_size_ - 1) / tile_size_; }
+	inline size_type count_tile_columns() const noexcept { return (count_columns_ + tile_size_ - 1) / tile_size_; }
+
+	// The tile at (tile_row, tile_column) pinned in memory, see tile_handle.
+	// Tiles on the last row or column are cut to the size of the matrix.
+	tile_handle<T> tile(const size_type tile_row, const size_type tile_column)
+	{
+		return acquire<T>(tile_row, tile_column, true);
+	}
+	tile_handle<const T> tile(const size_type tile_row, const size_type tile_column) const
+	{
+		return acquire<const T>(tile_row, tile_column, false);
+	}
+
+	// Starts reading the tile in the background if it isn't in the cache.
+	void prefetch(const size_type tile_row, const size_type tile_column) const
+	{
+		if (tile_row < count_tile_rows() && tile_column < count_tile_columns()) {
+			cache_->prefetch(tile_row * count_tile_columns() + tile_column);
+		}
+	}
+
+	T operator()(const size_type row, const size_type column) const
+	{
+		check_indexes(row, column);
+		const auto handle = tile(row / tile_size_, column / tile_size_);
+		return handle.view()[row % tile_size_][column % tile_size_];
+	}
+
+	void set(const size_type row, const size_type column, const T& value)
+	{
+		check_indexes(row, column);
+		const auto handle = tile(row / tile_size_, column / tile_size_);
+		handle.view()[row % tile_size_][column % tile_size_] = value;
+	}
+
+	// Copy of 'rows' x 'columns' elements starting at (row, column).
+	matrix<T> block(const size_type row, const size_type column, const size_type rows, const size_type columns) const
+	{
+		matrix_detail::check_view_block(row, rows, count_rows_);
+		matrix_detail::check_view_block(column, columns, count_columns_);
+		matrix<T> result(rows, columns);
+		copy_blocks(row, column, rows, columns, false, [&](const auto& tile, const size_type i, const size_type j, const size_type tile_i, const size_type tile_j, const size_type count) {
+			std::copy_n(tile[tile_i] + tile_j, count, result[i] + j);
+		});
+		return result;
+	}
+
+	// Writes the elements of m (matrix, view, ...) starting at (row, column).
+	template<class M>
+	void set_block(const size_type row, const size_type column, const M& m)
+	{
+		matrix_detail::check_view_block(row, m.count_rows(), count_rows_);
+		matrix_detail::check_view_block(column, m.count_columns(), count_columns_);
+		copy_blocks(row, column, m.count_rows(), m.count_columns(), true, [&](const auto& tile, const size_type i, const size_type j, const size_type tile_i, const size_type tile_j, const size_type count) {
+			const auto& src = m[i];
+			for (size_type k = 0; k < count; ++k) tile[tile_i][tile_j + k] = src[j + k];
+		});
+	}
+
+	// Calls f(tile_handle<const T>) for every tile in row-major order, with the
+	// next tiles read meanwhile.
+	template<class F>
+	void visit_tiles(F&& f) const
+	{
+		for (size_type i = 0; i < count_tile_rows(); ++i) {
+			for (size_type j = 0; j < count_tile_columns(); ++j) {
+				f(tile(i, j));
+			}
+		}
+	}
+
+	// Writes the modified tiles to the file, also done on destruction.
+	void flush() { cache_->flush(); }
+
+	tile_cache_statistics cache_statistics() const { return cache_->statistics(); }
+
+private:
+	inline size_type tile_bytes() const noexcept { return tile_size_ * tile_size_ * sizeof(T); }
+
+	void open_cache(matrix_detail::tile_file&& file, const tiled_matrix_options& options)
+	{
+		if (options.cache_tiles < 4) {
+			throw std::invalid_argument{ "Tile cache needs at least 4 tiles" };
+		}
+		cache_ = std::make_unique<matrix_detail::tile_cache<T>>(std::move(file), count_tile_rows() * count_tile_columns(),
+			tile_size_ * tile_size_, options);
+	}
+
+	inline void check_indexes(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+	}
+
+	template<class U>
+	tile_handle<U> acquire(const size_type tile_row, const size_type tile_column, const bool write) const
+	{
+		if (tile_row >= count_tile_rows() || tile_column >= count_tile_columns()) {
+			throw std::out_of_range{ "Tile index is out of range" };
+		}
+		auto& entry = cache_->acquire(tile_row * count_tile_columns() + tile_column, write);
+		const size_type row = tile_row * tile_size_;
+		const size_type column = tile_column * tile_size_;
+		const matrix_view<U> view(entry.data.data(), std::min(tile_size_, count_rows_ - row), std::min(tile_size_, count_columns_ - column), tile_size_);
+		return tile_handle<U>(cache_.get(), entry, view, row, column);
+	}
+
+	// Calls copy(tile view, i, j, tile_i, tile_j, count) for the runs of the block
+	// starting at (row + i, column + j), one tile at a time, marking the tiles as
+	// modified if 'write'.
+	template<class F>
+	void copy_blocks(const size_type row, const size_type column, const size_type rows, const size_type columns, const bool write, F copy) const
+	{
+		if (rows == 0 || columns == 0) return;
+		for (size_type tile_row = row / tile_size_; tile_row * tile_size_ < row + rows; ++tile_row) {
+			for (size_type tile_column = column / tile_size_; tile_column * tile_size_ < column + columns; ++tile_column) {
+				const auto handle = acquire<T>(tile_row, tile_column, write);
+				const size_type first_row = std::max(row, handle.row());
+				const size_type last_row = std::min(row + rows, handle.row() + handle.view().count_rows());
+				const size_type first_column = std::max(column, handle.column());
+				const size_type last_column = std::min(column + columns, handle.column() + handle.view().count_columns());
+				for (size_type r = first_row; r < last_row; ++r) {
+					copy(handle.view(), r - row, first_column - column, r - handle.row(), first_column - handle.column(), last_column - first_column);
+				}
+			}
+		}
+	}
+
+	size_type count_rows_{ 0 };
+	size_type count_columns_{ 0 };
+	size_type tile_size_{ 0 };
+	std::unique_ptr<matrix_detail::tile_cache<T>> cache_;
+};
+
+// c = a * b tile by tile, the tiles of all three must be of the same size. The
+// tiles of the next step are read while the kernels run on the current ones.
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const tiled_matrix<T>& a, const tiled_matrix<T>& b, tiled_matrix<T>& c)
+{
+	if (a.count_columns() != b.count_rows() || c.count_rows() != a.count_rows() || c.count_columns() != b.count_columns()) {
+		throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+	}
+	if (&c == &a || &c == &b) {
+		throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+	}
+	if (a.tile_size() != c.tile_size() || b.tile_size() != c.tile_size()) {
+		throw std::invalid_argument{ "Tiled matrices must have the same tile size" };
+	}
+
+	const std::size_t threads = matrix_execution::thread_count(policy);
+	const std::size_t inner_tiles = a.count_tile_columns();
+	for (std::size_t i = 0; i < c.count_tile_rows(); ++i) {
+		for (std::size_t j = 0; j < c.count_tile_columns(); ++j) {
+			auto c_tile = c.tile(i, j);
+			auto c_view = c_tile.view();
+			if (inner_tiles == 0) {
+				for (std::size_t row = 0; row < c_view.count_rows(); ++row) {
+					std::fill_n(c_view[row], c_view.count_columns(), T{});
+				}
+			}
+			for (std::size_t k = 0; k < inner_tiles; ++k) {
+				if (k + 1 < inner_tiles) {
+					a.prefetch(i, k + 1);
+					b.prefetch(k + 1, j);
+				}
+				else {
+					b.prefetch(0, j + 1);
+				}
+				const auto a_tile = a.tile(i, k);
+				const auto b_tile = b.tile(k, j);
+				matrix_detail::gemm(a_tile.view(), b_tile.view(), c_view, threads,
+					(k == 0) ? matrix_detail::gemm_update::assign : matrix_detail::gemm_update::add);
+			}
+		}
+	}
+}
+
+template<class T>
+void multiply(const tiled_matrix<T>& a, const tiled_matrix<T>& b, tiled_matrix<T>& c)
+{
+	multiply(matrix_execution::seq, a, b, c);
+}
+
+// dst = transpose(src) tile by tile, the tiles of both must be of the same size.
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void transpose(const ExecutionPolicy& policy, const tiled_matrix<T>& src, tiled_matrix<T>& dst)
+{
+	if (dst.count_rows() != src.count_columns() || dst.count_columns() != src.count_rows()) {
+		throw std::invalid_argument{ "Matrix sizes do not match for transposition" };
+	}
+	if (&dst == &src) {
+		throw std::invalid_argument{ "Tiled matrices are not transposed in place" };
+	}
+	if (src.tile_size() != dst.tile_size()) {
+		throw std::invalid_argument{ "Tiled matrices must have the same tile size" };
+	}
+	src.visit_tiles([&](const tile_handle<const T>& tile) {
+		const auto dst_tile = dst.tile(tile.column() / dst.tile_size(), tile.row() / dst.tile_size());
+		transpose(policy, tile.view(), dst_tile.view());
+	});
+}
+
+template<class T>
+void transpose(const tiled_matrix<T>& src, tiled_matrix<T>& dst)
+{
+	transpose(matrix_execution::seq, src, dst);
+}
+
+namespace matrix_detail {
+
+	// Sum of sum_tile(tile) over the tiles, added as the blocks of a pairwise sum
+	// or compensated as the lanes of a Kahan sum.
+	template<class T, class F>
+	sum_type_t<T> sum_tiles(const tiled_matrix<T>& m, const summation method, F sum_tile)
+	{
+		using S = sum_type_t<T>;
+		pairwise_sum<S> pairwise;
+		compensated_sum<S> compensated;
+		m.visit_tiles([&](const tile_handle<const T>& tile) {
+			const S value = sum_tile(tile);
+			if (method == summation::kahan) {
+				compensated.add(value);
+			}
+			else {
+				pairwise.add_block(value);
+			}
+		});
+		return (method == summation::kahan) ? compensated.result() : pairwise.result();
+	}
+
+	// Value and (row, column) of the first element op picks in row-major order.
+	template<class ExecutionPolicy, class T, class Op>
+	std::pair<T, std::pair<std::size_t, std::size_t>> fold_tiles(const ExecutionPolicy& policy, const tiled_matrix<T>& m, Op op)
+	{
+		if (m.count_rows() == 0 || m.count_columns() == 0) {
+			throw std::invalid_argument{ "Reduction of an empty matrix" };
+		}
+		std::pair<T, std::pair<std::size_t, std::size_t>> result{};
+		bool first = true;
+		m.visit_tiles([&](const tile_handle<const T>& tile) {
+			const auto folded = fold_elements(policy, tile.view(), op);
+			const auto position = position_of_fold(tile.view(), folded);
+			const std::pair<std::size_t, std::size_t> at{ tile.row() + position.first, tile.column() + position.second };
+			// Tiles are not visited in the row-major order of the elements, ties
+			// go to the earlier position.
+			if (first || op(result.first, folded.first) != result.first || (folded.first == result.first && at < result.second)) {
+				result = { folded.first, at };
+				first = false;
+			}
+		});
+		return result;
+	}
+
+	// Per row (Rows) or per column of the matrix: the sums of g(a(i, j)) over the tiles.
+	template<bool Rows, class ExecutionPolicy, class T, class S, class G>
+	std::vector<S> sum_tile_lines(const ExecutionPolicy& policy, const tiled_matrix<T>& m, G g)
+	{
+		std::vector<S> result(Rows ? m.count_rows() : m.count_columns(), S{});
+		m.visit_tiles([&](const tile_handle<const T>& tile) {
+			const auto sums = Rows
+				? reduce_each_row(policy, tile.view(), S{}, g, std::plus<S>{}, true)
+				: reduce_each_column(policy, tile.view(), S{}, g, std::plus<S>{}, true);
+			const std::size_t offset = Rows ? tile.row() : tile.column();
+			for (std::size_t i = 0; i < sums.size(); ++i) {
+				result[offset + i] += sums[i];
+			}
+		});
+		return result;
+	}
+
+} // namespace matrix_detail
+
+// Reductions of reductions.hpp, tile by tile.
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::sum_type_t<T> sum(const ExecutionPolicy& policy, const tiled_matrix<T>& m, const summation method = summation::pairwise)
+{
+	return matrix_detail::sum_tiles(m, method, [&](const tile_handle<const T>& tile) {
+		return sum(policy, tile.view(), method);
+	});
+}
+
+template<class T>
+matrix_detail::sum_type_t<T> sum(const tiled_matrix<T>& m, const summation method = summation::pairwise)
+{
+	return sum(matrix_execution::seq, m, method);
+}
+
+// The tiles of both must be of the same size.
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::sum_type_t<T> dot(const ExecutionPolicy& policy, const tiled_matrix<T>& a, const tiled_matrix<T>& b, const summation method = summation::pairwise)
+{
+	matrix_detail::check_same_size(a, b);
+	if (a.tile_size() != b.tile_size()) {
+		throw std::invalid_argument{ "Tiled matrices must have the same tile size" };
+	}
+	return matrix_detail::sum_tiles(a, method, [&](const tile_handle<const T>& tile) {
+		const auto other = b.tile(tile.row() / b.tile_size(), tile.column() / b.tile_size());
+		return dot(policy, tile.view(), other.view(), method);
+	});
+}
+
+template<class T>
+matrix_detail::sum_type_t<T> dot(const tiled_matrix<T>& a, const tiled_matrix<T>& b, const summation method = summation::pairwise)
+{
+	return dot(matrix_execution::seq, a, b, method);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T min_value(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	return matrix_detail::fold_tiles(policy, m, matrix_detail::min_element_op<T>{}).first;
+}
+
+template<class T>
+T min_value(const tiled_matrix<T>& m)
+{
+	return min_value(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T max_value(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	return matrix_detail::fold_tiles(policy, m, matrix_detail::max_element_op<T>{}).first;
+}
+
+template<class T>
+T max_value(const tiled_matrix<T>& m)
+{
+	return max_value(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::pair<std::size_t, std::size_t> argmin(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	return matrix_detail::fold_tiles(policy, m, matrix_detail::min_element_op<T>{}).second;
+}
+
+template<class T>
+std::pair<std::size_t, std::size_t> argmin(const tiled_matrix<T>& m)
+{
+	return argmin(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::pair<std::size_t, std::size_t> argmax(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	return matrix_detail::fold_tiles(policy, m, matrix_detail::max_element_op<T>{}).second;
+}
+
+template<class T>
+std::pair<std::size_t, std::size_t> argmax(const tiled_matrix<T>& m)
+{
+	return argmax(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T norm_frobenius(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	using std::sqrt;
+	return sqrt(matrix_detail::sum_tiles(m, summation::pairwise, [&](const tile_handle<const T>& tile) {
+		using V = matrix_view<const T>;
+		return matrix_detail::sum_elements(policy, tile.view(), static_cast<const V*>(nullptr), summation::pairwise, matrix_detail::squared_element<T>{});
+	}));
+}
+
+template<class T>
+T norm_frobenius(const tiled_matrix<T>& m)
+{
+	return norm_frobenius(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T norm_l1(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	const auto sums = matrix_detail::sum_tile_lines<false, ExecutionPolicy, T, T>(policy, m, matrix_detail::absolute_element<T>{});
+	return sums.empty() ? T{} : *std::max_element(sums.cbegin(), sums.cend());
+}
+
+template<class T>
+T norm_l1(const tiled_matrix<T>& m)
+{
+	return norm_l1(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T norm_inf(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	const auto sums = matrix_detail::sum_tile_lines<true, ExecutionPolicy, T, T>(policy, m, matrix_detail::absolute_element<T>{});
+	return sums.empty() ? T{} : *std::max_element(sums.cbegin(), sums.cend());
+}
+
+template<class T>
+T norm_inf(const tiled_matrix<T>& m)
+{
+	return norm_inf(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<matrix_detail::sum_type_t<T>> row_sums(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	using S = matrix_detail::sum_type_t<T>;
+	return matrix_detail::sum_tile_lines<true, ExecutionPolicy, T, S>(policy, m, matrix_detail::identity_element<S>{});
+}
+
+template<class T>
+std::vector<matrix_detail::sum_type_t<T>> row_sums(const tiled_matrix<T>& m)
+{
+	return row_sums(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<matrix_detail::sum_type_t<T>> col_sums(const ExecutionPolicy& policy, const tiled_matrix<T>& m)
+{
+	using S = matrix_detail::sum_type_t<T>;
+	return matrix_detail::sum_tile_lines<false, ExecutionPolicy, T, S>(policy, m, matrix_detail::identity_element<S>{});
+}
+
+template<class T>
+std::vector<matrix_detail::sum_type_t<T>> col_sums(const tiled_matrix<T>& m)
+{
+	return col_sums(matrix_execution::seq, m);
+}
+
+#endif // !MATRIX_TILED_MATRIX_HPP
@@ -0,0 +1,139 @@
+#pragma once
+
+#ifndef MATRIX_ELEMENTWISE_HPP
+#define MATRIX_ELEMENTWISE_HPP
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Element-wise operations and reductions over matrix, fixed_matrix or any type
+// providing count_rows(), count_columns() and row access through operator[].
+// Work is split into tiles of whole rows.
+
+namespace matrix_detail {
+
+	template<class M1, class M2>
+	inline void check_same_size(const M1& a, const M2& b)
+	{
+		if (a.count_rows() != b.count_rows() || a.count_columns() != b.count_columns()) {
+			throw std::invalid_argument{ "Matrix sizes do not match" };
+		}
+	}
+
+	// Results of reduce_rows(first, last) for the tiles of rows, in row order:
+	// at least row_grain() rows per tile, at most four tiles per thread. Used by
+	// reduce() and the reductions of reductions.hpp, 'rows' must not be 0.
+	template<class R, class ExecutionPolicy, class F>
+	std::vector<R> reduce_row_tiles(const ExecutionPolicy& policy, const std::size_t rows, const std::size_t columns, F reduce_rows)
+	{
+		const std::size_t grain = matrix_execution::row_grain(columns);
+		const std::size_t tiles = std::max<std::size_t>(1, std::min((rows + grain - 1) / grain, 4 * matrix_execution::thread_count(policy)));
+		const std::size_t tile = (rows + tiles - 1) / tiles;
+		std::vector<R> partial((rows + tile - 1) / tile);
+		if (partial.size() == 1) {
+			partial[0] = reduce_rows(std::size_t{ 0 }, rows);
+			return partial;
+		}
+		matrix_execution::for_each_tile(policy, 0, partial.size(), 1, [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t index = first; index < last; ++index) {
+				partial[index] = reduce_rows(index * tile, std::min(rows, (index + 1) * tile));
+			}
+		});
+		return partial;
+	}
+
+} // namespace matrix_detail
+
+template<class ExecutionPolicy, class M, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void fill(const ExecutionPolicy& policy, M& m, const T& value)
+{
+	const std::size_t columns = m.count_columns();
+	matrix_execution::for_each_tile(policy, 0, m.count_rows(), matrix_execution::row_grain(columns),
+		[&m, &value, columns](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = first; row < last; ++row) {
+				auto&& dst = m[row];
+				for (std::size_t column = 0; column < columns; ++column) {
+					dst[column] = value;
+				}
+			}
+		});
+}
+
+// out(i, j) = f(a(i, j)), 'out' may be the same matrix as 'a'.
+template<class ExecutionPolicy, class MA, class MOut, class F,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void transform(const ExecutionPolicy& policy, const MA& a, MOut& out, F f)
+{
+	matrix_detail::check_same_size(a, out);
+
+	const std::size_t columns = a.count_columns();
+	matrix_execution::for_each_tile(policy, 0, a.count_rows(), matrix_execution::row_grain(columns),
+		[&a, &out, &f, columns](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = first; row < last; ++row) {
+				const auto& src = a[row];
+				auto&& dst = out[row];
+				for (std::size_t column = 0; column < columns; ++column) {
+					dst[column] = f(src[column]);
+				}
+			}
+		});
+}
+
+// out(i, j) = f(a(i, j), b(i, j)), 'out' may be the same matrix as 'a' or 'b'.
+template<class ExecutionPolicy, class MA, class MB, class MOut, class F,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void transform(const ExecutionPolicy& policy, const MA& a, const MB& b, MOut& out, F f)
+{
+	matrix_detail::check_same_size(a, b);
+	matrix_detail::check_same_size(a, out);
+
+	const std::size_t columns = a.count_columns();
+	matrix_execution::for_each_tile(policy, 0, a.count_rows(), matrix_execution::row_grain(columns),
+		[&a, &b, &out, &f, columns](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = first; row < last; ++row) {
+				const auto& lhs = a[row];
+				const auto& rhs = b[row];
+				auto&& dst = out[row];
+				for (std::size_t column = 0; column < columns; ++column) {
+					dst[column] = f(lhs[column], rhs[column]);
+				}
+			}
+		});
+}
+
+// Folds all elements with 'op', which must be associative: the rows are split
+// into tiles reduced separately, the partial results are combined in row order.
+template<class ExecutionPolicy, class M, class T, class BinaryOp,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+T reduce(const ExecutionPolicy& policy, const M& m, T init, BinaryOp op)
+{
+	const std::size_t rows = m.count_rows();
+	const std::size_t columns = m.count_columns();
+	if (rows == 0 || columns == 0) return init;
+
+	const auto reduce_rows = [&m, &op, columns](std::size_t first, std::size_t last) {
+		const auto& first_row = m[first];
+		T result = first_row[0];
+		for (std::size_t column = 1; column < columns; ++column) {
+			result = op(result, first_row[column]);
+		}
+		for (std::size_t row = first + 1; row < last; ++row) {
+			const auto& src = m[row];
+			for (std::size_t column = 0; column < columns; ++column) {
+				result = op(result, src[column]);
+			}
+		}
+		return result;
+	};
+
+	for (const T& value : matrix_detail::reduce_row_tiles<T>(policy, rows, columns, reduce_rows)) {
+		init = op(init, value);
+	}
+	return init;
+}
+
+#endif // !MATRIX_ELEMENTWISE_HPP
@@ -0,0 +1,402 @@
+#pragma once
+
+#ifndef MATRIX_EXPRESSION_HPP
+#define MATRIX_EXPRESSION_HPP
+
+#include "thread_pool.hpp"
+
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Lazy element-wise arithmetic.
+//
+// a + b * 2 - c builds a tree of lightweight nodes referring to the operands.
+// Nothing is computed until the tree is assigned to a matrix or fixed_matrix:
+// then every row of the destination is produced in one pass over the operand
+// rows, without temporary matrices. Large destinations are filled in parallel.
+//
+// Nodes keep references to the matrices they were built from, so an expression
+// must be evaluated before its operands go out of scope (don't keep it in an
+// 'auto' variable beyond the statement). A destination may be one of the
+// operands, since each element only depends on the elements at its own position.
+// That holds for operands read in the orientation of the destination only: when
+// a transposed view and the destination share storage (m = m + m.transposed(),
+// m.transposed() = m), the expression is evaluated into a temporary first.
+
+// Specialized for every container usable as a leaf of an expression.
+template<class M>
+struct is_matrix_container : std::false_type {};
+
+// Alignment in bytes of the first element of every row of a container, 0 if
+// nothing is known beyond the alignment of the element type.
+template<class M>
+struct row_alignment_of : std::integral_constant<std::size_t, 0> {};
+
+// True for containers whose rows are columns of the storage they refer to
+// (transposed_view), found through their transposed() member.
+template<class M>
+struct is_transposed_container : std::false_type {};
+
+template<class E>
+struct matrix_expression
+{
+	inline const E& self() const noexcept { return static_cast<const E&>(*this); }
+};
+
+template<class T>
+inline constexpr bool is_matrix_expression_v = std::is_class_v<T> && std::is_base_of_v<matrix_expression<T>, T>;
+
+template<class T>
+inline constexpr bool is_matrix_operand_v = is_matrix_container<std::decay_t<T>>::value || is_matrix_expression_v<std::decay_t<T>>;
+
+namespace matrix_detail {
+
+	// Lets the compiler use aligned accesses to a row known to be aligned.
+	template<std::size_t Alignment, class Row>
+	inline Row assume_aligned(Row row) noexcept
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		if constexpr (std::is_pointer_v<Row> && Alignment > alignof(std::remove_pointer_t<Row>)) {
+			return static_cast<Row>(__builtin_assume_aligned(row, Alignment));
+		}
+#endif
+		return row;
+	}
+
+	template<class M>
+	struct terminal_expression : matrix_expression<terminal_expression<M>>
+	{
+		using value_type = typename M::value_type;
+
+		explicit terminal_expression(const M& m) noexcept : m_{ m } {}
+
+		inline std::size_t count_rows() const noexcept { return m_.count_rows(); }
+		inline std::size_t count_columns() const noexcept { return m_.count_columns(); }
+		inline auto row(const std::size_t index) const noexcept { return m_[index]; }
+
+		template<class F>
+		inline void for_each_leaf(F&& f) const { f(m_); }
+
+	private:
+		const M& m_;
+	};
+
+	template<class T>
+	struct scalar_row
+	{
+		T value;
+		inline const T& operator[](std::size_t) const noexcept { return value; }
+	};
+
+	template<class T>
+	struct scalar_operand
+	{
+		using value_type = T;
+
+		T value;
+		inline scalar_row<T> row(std::size_t) const noexcept { return { value }; }
+
+		template<class F>
+		inline void for_each_leaf(F&&) const noexcept {}
+	};
+
+	template<class T>
+	struct is_scalar_operand : std::false_type {};
+	template<class T>
+	struct is_scalar_operand<scalar_operand<T>> : std::true_type {};
+
+	template<class T>
+	inline auto make_operand(const T& value)
+	{
+		if constexpr (is_matrix_expression_v<T>) {
+			return value;
+		}
+		else if constexpr (is_matrix_container<T>::value) {
+			return terminal_expression<T>{ value };
+		}
+		else {
+			return scalar_operand<T>{ value };
+		}
+	}
+
+	template<class Op, class Row>
+	struct unary_row
+	{
+		Row src;
+		inline auto operator[](const std::size_t index) const { return Op{}(src[index]); }
+	};
+
+	template<class Op, class E>
+	struct unary_expression : matrix_expression<unary_expression<Op, E>>
+	{
+		using value_type = std::decay_t<decltype(Op{}(std::declval<typename E::value_type>()))>;
+
+		explicit unary_expression(const E& e) : e_{ e } {}
+
+		inline std::size_t count_rows() const noexcept { return e_.count_rows(); }
+		inline std::size_t count_columns() const noexcept { return e_.count_columns(); }
+		inline auto row(const std::size_t index) const noexcept
+		{
+			return unary_row<Op, decltype(e_.row(index))>{ e_.row(index) };
+		}
+
+		template<class F>
+		inline void for_each_leaf(F&& f) const { e_.for_each_leaf(f); }
+
+	private:
+		E e_;
+	};
+
+	template<class Op, class LRow, class RRow>
+	struct binary_row
+	{
+		LRow lhs;
+		RRow rhs;
+		inline auto operator[](const std::size_t index) const { return Op{}(lhs[index], rhs[index]); }
+	};
+
+	// One of the operands may be a scalar_operand, the shape is taken from the other one.
+	template<class Op, class L, class R>
+	struct binary_expression : matrix_expression<binary_expression<Op, L, R>>
+	{
+		using value_type = std::decay_t<decltype(Op{}(std::declval<typename L::value_type>(), std::declval<typename R::value_type>()))>;
+
+		binary_expression(const L& lhs, const R& rhs)
+			: lhs_{ lhs }
+			, rhs_{ rhs }
+		{
+			if constexpr (!is_scalar_operand<L>::value && !is_scalar_operand<R>::value) {
+				if (lhs_.count_rows() != rhs_.count_rows() || lhs_.count_columns() != rhs_.count_columns()) {
+					throw std::invalid_argument{ "Matrix sizes do not match" };
+				}
+			}
+		}
+
+		inline std::size_t count_rows() const noexcept { return shape().count_rows(); }
+		inline std::size_t count_columns() const noexcept { return shape().count_columns(); }
+		inline auto row(const std::size_t index) const noexcept
+		{
+			return binary_row<Op, decltype(lhs_.row(index)), decltype(rhs_.row(index))>{ lhs_.row(index), rhs_.row(index) };
+		}
+
+		template<class F>
+		inline void for_each_leaf(F&& f) const
+		{
+			lhs_.for_each_leaf(f);
+			rhs_.for_each_leaf(f);
+		}
+
+	private:
+		inline const auto& shape() const noexcept
+		{
+			if constexpr (is_scalar_operand<L>::value) return rhs_;
+			else return lhs_;
+		}
+
+		L lhs_;
+		R rhs_;
+	};
+
+	template<class Op, class L, class R>
+	inline auto make_binary(const L& lhs, const R& rhs)
+	{
+		using lhs_type = decltype(make_operand(lhs));
+		using rhs_type = decltype(make_operand(rhs));
+		return binary_expression<Op, lhs_type, rhs_type>{ make_operand(lhs), make_operand(rhs) };
+	}
+
+	struct assign_op
+	{
+		template<class D, class V>
+		inline void operator()(D& dst, V&& value) const { dst = std::forward<V>(value); }
+	};
+
+	struct add_assign_op
+	{
+		template<class D, class V>
+		inline void operator()(D& dst, V&& value) const { dst += std::forward<V>(value); }
+	};
+
+	struct subtract_assign_op
+	{
+		template<class D, class V>
+		inline void operator()(D& dst, V&& value) const { dst -= std::forward<V>(value); }
+	};
+
+	// Constructs elements in uninitialized storage.
+	struct construct_op
+	{
+		template<class D, class V>
+		inline void operator()(D& dst, V&& value) const { ::new(static_cast<void*>(&dst)) D(std::forward<V>(value)); }
+	};
+
+	template<class E>
+	struct has_transposed_leaf : std::false_type {};
+	template<class M>
+	struct has_transposed_leaf<terminal_expression<M>> : is_transposed_container<M> {};
+	template<class Op, class E>
+	struct has_transposed_leaf<unary_expression<Op, E>> : has_transposed_leaf<E> {};
+	template<class Op, class L, class R>
+	struct has_transposed_leaf<binary_expression<Op, L, R>>
+		: std::bool_constant<has_transposed_leaf<L>::value || has_transposed_leaf<R>::value> {};
+
+	// Addresses spanned by the elements of a container, [first, last), empty for
+	// proxies and empty containers. Rows of a row table may lie anywhere in
+	// between, which only makes overlaps() pessimistic. Taken by non-const
+	// reference, the destination may not be initialized yet.
+	struct storage_span
+	{
+		const void* first{ nullptr };
+		const void* last{ nullptr };
+
+		inline bool overlaps(const storage_span& other) const noexcept
+		{
+			const std::less<const void*> less;
+			return less(first, other.last) && less(other.first, last);
+		}
+	};
+
+	template<class M>
+	storage_span storage_span_of(M& m) noexcept
+	{
+		if constexpr (is_transposed_container<std::remove_cv_t<M>>::value) {
+			const auto view = m.transposed();
+			return storage_span_of(view);
+		}
+		else if constexpr (std::is_lvalue_reference_v<decltype(m[0][0])>) {
+			const std::size_t columns = m.count_columns();
+			storage_span span;
+			if (columns == 0) return span;
+			const std::less<const void*> less;
+			for (std::size_t row = 0; row < m.count_rows(); ++row) {
+				const auto* first = &m[row][0];
+				const void* last = first + columns;
+				if (span.first == nullptr || less(first, span.first)) span.first = first;
+				if (span.last == nullptr || less(span.last, last)) span.last = last;
+			}
+			return span;
+		}
+		else {
+			return {};
+		}
+	}
+
+	// True if an operand read in the other orientation than 'dst' shares its storage.
+	template<class M, class E>
+	bool has_transposed_alias(M& dst, const E& e) noexcept
+	{
+		const storage_span dst_span = storage_span_of(dst);
+		bool alias = false;
+		e.for_each_leaf([&](const auto& leaf) {
+			using leaf_type = std::decay_t<decltype(leaf)>;
+			if (is_transposed_container<leaf_type>::value != is_transposed_container<std::remove_cv_t<M>>::value) {
+				alias = alias || dst_span.overlaps(storage_span_of(leaf));
+			}
+		});
+		return alias;
+	}
+
+	// Rows of a temporary holding the values of an expression.
+	template<class T>
+	struct evaluated_rows
+	{
+		std::vector<T> values;
+		std::size_t rows;
+		std::size_t columns;
+
+		inline std::size_t count_rows() const noexcept { return rows; }
+		inline std::size_t count_columns() const noexcept { return columns; }
+		inline T* operator[](const std::size_t index) noexcept { return values.data() + index * columns; }
+		inline const T* row(const std::size_t index) const noexcept { return values.data() + index * columns; }
+	};
+
+	template<class ExecutionPolicy, class M, class E, class Op>
+	void evaluate_rows(const ExecutionPolicy& policy, M& dst, const E& e, Op op, const std::size_t columns)
+	{
+		matrix_execution::for_each_tile(policy, 0, e.count_rows(), matrix_execution::row_grain(columns),
+			[&dst, &e, op, columns](const std::size_t first, const std::size_t last) {
+				for (std::size_t row = first; row < last; ++row) {
+					const auto src = e.row(row);
+					auto&& d = assume_aligned<row_alignment_of<std::remove_cv_t<M>>::value>(dst[row]);
+					for (std::size_t column = 0; column < columns; ++column) {
+						op(d[column], src[column]);
+					}
+				}
+			});
+	}
+
+	// Applies op(dst(i, j), e(i, j)) to every element, one row after another.
+	template<class ExecutionPolicy, class M, class E, class Op>
+	void evaluate(const ExecutionPolicy& policy, M& dst, const E& e, Op op)
+	{
+		if (dst.count_rows() != e.count_rows() || dst.count_columns() != e.count_columns()) {
+			throw std::invalid_argument{ "Matrix sizes do not match" };
+		}
+
+		const std::size_t columns = e.count_columns();
+		if (columns == 0) return;
+
+		if constexpr (is_transposed_container<std::remove_cv_t<M>>::value || has_transposed_leaf<E>::value) {
+			if (has_transposed_alias(dst, e)) {
+				using T = typename E::value_type;
+				evaluated_rows<T> values{ std::vector<T>(e.count_rows() * columns), e.count_rows(), columns };
+				evaluate_rows(policy, values, e, assign_op{}, columns);
+				evaluate_rows(policy, dst, values, op, columns);
+				return;
+			}
+		}
+		evaluate_rows(policy, dst, e, op, columns);
+	}
+
+} // namespace matrix_detail
+
+// dst = e with an explicit execution policy, dst must already have the shape of e.
+template<class ExecutionPolicy, class M, class E,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void assign(const ExecutionPolicy& policy, M& dst, const matrix_expression<E>& e)
+{
+	matrix_detail::evaluate(policy, dst, e.self(), matrix_detail::assign_op{});
+}
+
+template<class L, class R, std::enable_if_t<is_matrix_operand_v<L> && is_matrix_operand_v<R>, int> = 0>
+inline auto operator+(const L& lhs, const R& rhs)
+{
+	return matrix_detail::make_binary<std::plus<>>(lhs, rhs);
+}
+
+template<class L, class R, std::enable_if_t<is_matrix_operand_v<L> && is_matrix_operand_v<R>, int> = 0>
+inline auto operator-(const L& lhs, const R& rhs)
+{
+	return matrix_detail::make_binary<std::minus<>>(lhs, rhs);
+}
+
+template<class L, class S, std::enable_if_t<is_matrix_operand_v<L> && std::is_arithmetic_v<S>, int> = 0>
+inline auto operator*(const L& lhs, const S& rhs)
+{
+	return matrix_detail::make_binary<std::multiplies<>>(lhs, rhs);
+}
+
+template<class S, class R, std::enable_if_t<std::is_arithmetic_v<S> && is_matrix_operand_v<R>, int> = 0>
+inline auto operator*(const S& lhs, const R& rhs)
+{
+	return matrix_detail::make_binary<std::multiplies<>>(lhs, rhs);
+}
+
+template<class L, class S, std::enable_if_t<is_matrix_operand_v<L> && std::is_arithmetic_v<S>, int> = 0>
+inline auto operator/(const L& lhs, const S& rhs)
+{
+	return matrix_detail::make_binary<std::divides<>>(lhs, rhs);
+}
+
+template<class E, std::enable_if_t<is_matrix_operand_v<E>, int> = 0>
+inline auto operator-(const E& e)
+{
+	using operand_type = decltype(matrix_detail::make_operand(e));
+	return matrix_detail::unary_expression<std::negate<>, operand_type>{ matrix_detail::make_operand(e) };
+}
+
+#endif // !MATRIX_EXPRESSION_HPP
@@ -0,0 +1,822 @@
+#pragma once
+
+#ifndef MATRIX_FACTORIZATION_HPP
+#define MATRIX_FACTORIZATION_HPP
+
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include "multiply.hpp"
+#include "../matrix/matrix.hpp"
+#include "../matrix/matrix_instrumentation.hpp"
+#include "../fixed_matrix/fixed_matrix.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Dense factorizations: LU with partial pivoting, Cholesky and Householder QR,
+// and the solvers built on them.
+//
+// For matrix the factorizations are right-looking blocked algorithms. A panel of
+// factorization_block columns is factorized by plain loops, then the whole
+// trailing part of the matrix is updated by one product of blocks, which runs on
+// the packed SIMD kernels of multiply.hpp and is split between threads by the
+// execution policy. Most of the work is in these products. Matrices smaller than
+// factorization_blocked_size and fixed_matrix use the loops only; for
+// fixed_matrix lu() and solve() are constexpr.
+//
+// lu() succeeds for singular matrices: determinant() of the result is then zero,
+// solve() and inverse() throw matrix_factorization_error. cholesky() throws if
+// the matrix is not (numerically) positive definite.
+
+struct matrix_factorization_error : std::runtime_error {
+	explicit matrix_factorization_error(const char* q) : std::runtime_error(q) {}
+	explicit matrix_factorization_error(const std::string& n) : std::runtime_error(n) {}
+};
+
+namespace matrix_detail {
+
+	// Columns per panel of the blocked factorizations.
+	constexpr std::size_t factorization_block = 64;
+	// Smaller matrices are factorized by the unblocked loops.
+	constexpr std::size_t factorization_blocked_size = 2 * factorization_block;
+	// Fewer right-hand sides are solved by the unblocked loops.
+	constexpr std::size_t blocked_solve_columns = 8;
+
+	// Containers of the results: vectors and matrices of the same allocator for
+	// matrix, arrays and fixed_matrix of the right sizes for fixed_matrix.
+	template<class M>
+	struct factorization_types
+	{
+		using value_type = typename M::value_type;
+		using pivots = std::vector<std::size_t>;
+		using coefficients = std::vector<value_type>;
+		using q_matrix = M;
+		using r_matrix = M;
+
+		template<class Result>
+		static Result make_matrix(const M& like, const std::size_t rows, const std::size_t columns)
+		{
+			return Result(rows, columns, value_type{}, like.get_allocator());
+		}
+	};
+
+	template<class T, std::size_t RowsCount, std::size_t ColumnsCount>
+	struct factorization_types<fixed_matrix<T, RowsCount, ColumnsCount>>
+	{
+		static constexpr std::size_t diagonal = std::min(RowsCount, ColumnsCount);
+
+		using value_type = T;
+		using pivots = std::array<std::size_t, RowsCount>;
+		using coefficients = std::array<T, diagonal>;
+		using q_matrix = fixed_matrix<T, RowsCount, diagonal>;
+		using r_matrix = fixed_matrix<T, diagonal, ColumnsCount>;
+
+		template<class Result>
+		static constexpr Result make_matrix(const fixed_matrix<T, RowsCount, ColumnsCount>&, std::size_t, std::size_t)
+		{
+			return Result();
+		}
+	};
+
+	// A std::vector or std::array seen as a column, for the solvers.
+	template<class T>
+	struct column_of_values
+	{
+		using value_type = std::remove_const_t<T>;
+
+		T* first;
+		std::size_t size;
+
+		constexpr inline std::size_t count_rows() const noexcept { return size; }
+		constexpr inline std::size_t count_columns() const noexcept { return 1; }
+		constexpr inline T* operator[](const std::size_t row) const noexcept { return first + row; }
+	};
+
+	template<class M>
+	struct is_matrix_view : std::false_type {};
+
+	template<class T>
+	struct is_matrix_view<matrix_view<T>> : std::true_type {};
+
+	template<class M>
+	inline auto view_of(M& m)
+	{
+		if constexpr (is_matrix_view<M>::value) return m;
+		else return m.view();
+	}
+
+	template<class M>
+	constexpr void swap_rows(M& a, const std::size_t first, const std::size_t second, const std::size_t columns)
+	{
+		auto&& x = a[first];
+		auto&& y = a[second];
+		for (std::size_t column = 0; column < columns; ++column) {
+			auto value = x[column];
+			x[column] = y[column];
+			y[column] = value;
+		}
+	}
+
+	// LU
+
+	// Factorizes the columns [first, last) of the rows [first, n) with partial
+	// pivoting, L and U of the panel replace it. Rows are exchanged in full.
+	// A zero pivot leaves its column as is.
+	template<class M, class P>
+	constexpr void lu_panel(M& a, const std::size_t n, const std::size_t first, const std::size_t last, P& pivots, int& sign)
+	{
+		using T = typename M::value_type;
+		for (std::size_t j = first; j < last; ++j) {
+			std::size_t pivot = j;
+			for (std::size_t i = j + 1; i < n; ++i) {
+				if (abs_value(a[i][j]) > abs_value(a[pivot][j])) pivot = i;
+			}
+			pivots[j] = pivot;
+			if (pivot != j) {
+				swap_rows(a, j, pivot, n);
+				sign = -sign;
+			}
+
+			const T diagonal = a[j][j];
+			if (diagonal == T{}) continue;
+			const auto& pivot_row = a[j];
+			for (std::size_t i = j + 1; i < n; ++i) {
+				auto&& row = a[i];
+				const T l = row[j] / diagonal;
+				row[j] = l;
+				for (std::size_t column = j + 1; column < last; ++column) {
+					row[column] -= l * pivot_row[column];
+				}
+			}
+		}
+	}
+
+	template<class ExecutionPolicy, class V, class P>
+	void lu_blocked(const ExecutionPolicy& policy, V a, P& pivots, int& sign)
+	{
+		using T = typename V::value_type;
+		const std::size_t n = a.count_rows();
+		const std::size_t threads = matrix_execution::thread_count(policy);
+
+		for (std::size_t k = 0; k < n; k += factorization_block) {
+			const std::size_t kb = std::min(factorization_block, n - k);
+			lu_panel(a, n, k, k + kb, pivots, sign);
+			const std::size_t rest = n - k - kb;
+			if (rest == 0) break;
+
+			// U12 = L11^-1 A12
+			matrix_execution::for_each_tile(policy, k + kb, n, matrix_execution::row_grain(kb * kb),
+				[&a, k, kb](const std::size_t first, const std::size_t last) {
+					for (std::size_t i = k + 1; i < k + kb; ++i) {
+						T* row = a[i];
+						for (std::size_t p = k; p < i; ++p) {
+							const T l = row[p];
+							const T* u = a[p];
+							for (std::size_t column = first; column < last; ++column) {
+								row[column] -= l * u[column];
+							}
+						}
+					}
+				});
+
+			// A22 -= L21 U12
+			auto trailing = a.block(k + kb, k + kb, rest, rest);
+			gemm(a.block(k + kb, k, rest, kb), a.block(k, k + kb, kb, rest), trailing, threads, gemm_update::subtract);
+		}
+	}
+
+	// Solves L U X = P B for 'columns' right-hand sides, X replaces B.
+	template<class M, class P, class B>
+	constexpr void lu_solve_unblocked(const M& lu, const P& pivots, B& b, const std::size_t n, const std::size_t columns)
+	{
+		using T = typename M::value_type;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (pivots[i] != i) swap_rows(b, i, pivots[i], columns);
+		}
+		for (std::size_t i = 1; i < n; ++i) {
+			auto&& row = b[i];
+			for (std::size_t p = 0; p < i; ++p) {
+				const T l = lu[i][p];
+				if (l == T{}) continue;
+				const auto& y = b[p];
+				for (std::size_t column = 0; column < columns; ++column) row[column] -= l * y[column];
+			}
+		}
+		for (std::size_t i = n; i-- > 0;) {
+			auto&& row = b[i];
+			for (std::size_t p = i + 1; p < n; ++p) {
+				const T u = lu[i][p];
+				if (u == T{}) continue;
+				const auto& x = b[p];
+				for (std::size_t column = 0; column < columns; ++column) row[column] -= u * x[column];
+			}
+			const T diagonal = lu[i][i];
+			for (std::size_t column = 0; column < columns; ++column) row[column] /= diagonal;
+		}
+	}
+
+	// Blocked version of lu_solve_unblocked: the triangular solves run on blocks of
+	// rows, the rest of the right-hand sides is updated by products of blocks.
+	template<class ExecutionPolicy, class L, class P, class B>
+	void lu_solve_blocked(const ExecutionPolicy& policy, const L& lu, const P& pivots, B b)
+	{
+		using T = typename B::value_type;
+		const std::size_t n = lu.count_rows();
+		const std::size_t columns = b.count_columns();
+		const std::size_t threads = matrix_execution::thread_count(policy);
+		const std::size_t grain = matrix_execution::row_grain(factorization_block * factorization_block);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			if (pivots[i] != i) swap_rows(b, i, pivots[i], columns);
+		}
+
+		for (std::size_t k = 0; k < n; k += factorization_block) {
+			const std::size_t kb = std::min(factorization_block, n - k);
+			matrix_execution::for_each_tile(policy, 0, columns, grain, [&lu, &b, k, kb](const std::size_t first, const std::size_t last) {
+				for (std::size_t i = k + 1; i < k + kb; ++i) {
+					T* row = b[i];
+					for (std::size_t p = k; p < i; ++p) {
+						const T l = lu[i][p];
+						const T* y = b[p];
+						for (std::size_t column = first; column < last; ++column) row[column] -= l * y[column];
+					}
+				}
+			});
+			if (k + kb < n) {
+				auto rest = b.block(k + kb, 0, n - k - kb, columns);
+				gemm(lu.block(k + kb, k, n - k - kb, kb), b.block(k, 0, kb, columns), rest, threads, gemm_update::subtract);
+			}
+		}
+
+		for (std::size_t end = n; end > 0;) {
+			const std::size_t k = (end - 1) / factorization_block * factorization_block;
+			matrix_execution::for_each_tile(policy, 0, columns, grain, [&lu, &b, k, end](const std::size_t first, const std::size_t last) {
+				for (std::size_t i = end; i-- > k;) {
+					T* row = b[i];
+					for (std::size_t p = i + 1; p < end; ++p) {
+						const T u = lu[i][p];
+						const T* x = b[p];
+						for (std::size_t column = first; column < last; ++column) row[column] -= u * x[column];
+					}
+					const T diagonal = lu[i][i];
+					for (std::size_t column = first; column < last; ++column) row[column] /= diagonal;
+				}
+			});
+			if (k > 0) {
+				auto top = b.block(0, 0, k, columns);
+				gemm(lu.block(0, k, k, end - k), b.block(k, 0, end - k, columns), top, threads, gemm_update::subtract);
+			}
+			end = k;
+		}
+	}
+
+	// Cholesky
+
+	// Factorizes the diagonal block [first, last) in place (lower triangle),
+	// the updates from the previous blocks must have been applied.
+	template<class M>
+	void cholesky_diagonal_block(M& a, const std::size_t first, const std::size_t last)
+	{
+		using T = typename M::value_type;
+		using std::sqrt;
+		for (std::size_t j = first; j < last; ++j) {
+			const auto& row_j = a[j];
+			T diagonal = row_j[j];
+			for (std::size_t p = first; p < j; ++p) diagonal -= row_j[p] * row_j[p];
+			if (!(diagonal > T{})) {
+				throw matrix_factorization_error{ "cholesky error: matrix is not positive definite" };
+			}
+			diagonal = sqrt(diagonal);
+			a[j][j] = diagonal;
+			for (std::size_t i = j + 1; i < last; ++i) {
+				auto&& row_i = a[i];
+				T sum = row_i[j];
+				for (std::size_t p = first; p < j; ++p) sum -= row_i[p] * row_j[p];
+				row_i[j] = sum / diagonal;
+			}
+		}
+	}
+
+	template<class M>
+	constexpr void clear_upper_triangle(M& a, const std::size_t first, const std::size_t last, const std::size_t n)
+	{
+		using T = typename M::value_type;
+		for (std::size_t i = first; i < last; ++i) {
+			auto&& row = a[i];
+			for (std::size_t j = i + 1; j < n; ++j) row[j] = T{};
+		}
+	}
+
+	template<class ExecutionPolicy, class V>
+	void cholesky_blocked(const ExecutionPolicy& policy, V a)
+	{
+		using T = typename V::value_type;
+		const std::size_t n = a.count_rows();
+		const std::size_t threads = matrix_execution::thread_count(policy);
+
+		for (std::size_t k = 0; k < n; k += factorization_block) {
+			const std::size_t kb = std::min(factorization_block, n - k);
+			cholesky_diagonal_block(a, k, k + kb);
+			const std::size_t rest = n - k - kb;
+			if (rest == 0) break;
+
+			// L21 = A21 L11^-T
+			matrix_execution::for_each_tile(policy, k + kb, n, matrix_execution::row_grain(kb * kb),
+				[&a, k, kb](const std::size_t first, const std::size_t last) {
+					for (std::size_t i = first; i < last; ++i) {
+						T* row = a[i];
+						for (std::size_t j = k; j < k + kb; ++j) {
+							const T* l = a[j];
+							T sum = row[j];
+							for (std::size_t p = k; p < j; ++p) sum -= row[p] * l[p];
+							row[j] = sum / l[j];
+						}
+					}
+				});
+
+			// A22 -= L21 L21^T, only the lower part is needed: the columns are
+			// updated in a few strips, each from its diagonal down.
+			const auto l21 = a.block(k + kb, k, rest, kb);
+			const std::size_t width = round_up(std::max(factorization_block, (rest + 7) / 8), factorization_block);
+			for (std::size_t j = 0; j < rest; j += width) {
+				const std::size_t w = std::min(width, rest - j);
+				auto strip = a.block(k + kb + j, k + kb + j, rest - j, w);
+				gemm(l21.block(j, 0, rest - j, kb), l21.block(j, 0, w, kb).transposed(), strip, threads, gemm_update::subtract);
+			}
+		}
+
+		matrix_execution::for_each_tile(policy, 0, n, matrix_execution::row_grain(n), [&a, n](const std::size_t first, const std::size_t last) {
+			clear_upper_triangle(a, first, last, n);
+		});
+	}
+
+	// QR
+
+	// Householder reflector H = I - tau v v^T zeroing the column j below the row j
+	// of the rows [j, rows). v (v[j] = 1 implied) replaces the zeroed elements,
+	// the new diagonal element replaces a[j][j]. Returns tau, 0 if H = I.
+	template<class M>
+	typename M::value_type make_reflector(M& a, const std::size_t j, const std::size_t rows)
+	{
+		using T = typename M::value_type;
+		using std::sqrt;
+		const T alpha = a[j][j];
+		T norm2{};
+		for (std::size_t i = j + 1; i < rows; ++i) norm2 += a[i][j] * a[i][j];
+		if (norm2 == T{}) return T{};
+
+		const T norm = sqrt(alpha * alpha + norm2);
+		const T beta = (alpha < T{}) ? norm : -norm;
+		const T scale = T{ 1 } / (alpha - beta);
+		for (std::size_t i = j + 1; i < rows; ++i) a[i][j] *= scale;
+		a[j][j] = beta;
+		return (beta - alpha) / beta;
+	}
+
+	// Applies the reflector stored in the column j of 'v' to the columns
+	// [first, last) of c from the left. 'w' holds last - first elements.
+	template<class MV, class MC, class T>
+	void apply_reflector(const MV& v, const std::size_t j, const std::size_t rows, const T tau,
+		MC& c, const std::size_t first, const std::size_t last, T* w)
+	{
+		if (tau == T{}) return;
+		const std::size_t count = last - first;
+		const auto& head = c[j];
+		for (std::size_t column = 0; column < count; ++column) w[column] = head[first + column];
+		for (std::size_t i = j + 1; i < rows; ++i) {
+			const T vi = v[i][j];
+			const auto& row = c[i];
+			for (std::size_t column = 0; column < count; ++column) w[column] += vi * row[first + column];
+		}
+		for (std::size_t column = 0; column < count; ++column) w[column] *= tau;
+
+		auto&& head_row = c[j];
+		for (std::size_t column = 0; column < count; ++column) head_row[first + column] -= w[column];
+		for (std::size_t i = j + 1; i < rows; ++i) {
+			const T vi = v[i][j];
+			auto&& row = c[i];
+			for (std::size_t column = 0; column < count; ++column) row[first + column] -= vi * w[column];
+		}
+	}
+
+	// Householder QR of the columns [first, last), applied to the panel only.
+	template<class M, class C>
+	void qr_panel(M& a, const std::size_t rows, const std::size_t first, const std::size_t last, C& tau,
+		std::vector<typename M::value_type>& w)
+	{
+		for (std::size_t j = first; j < last; ++j) {
+			tau[j] = make_reflector(a, j, rows);
+			apply_reflector(a, j, rows, tau[j], a, j + 1, last, w.data());
+		}
+	}
+
+	// Householder QR of the whole matrix by the unblocked loops.
+	template<class M, class C>
+	void qr_unblocked(M& a, const std::size_t rows, const std::size_t columns, C& tau)
+	{
+		const std::size_t diagonal = std::min(rows, columns);
+		std::vector<typename M::value_type> w(columns);
+		qr_panel(a, rows, 0, diagonal, tau, w);
+		for (std::size_t j = 0; j < diagonal; ++j) {
+			apply_reflector(a, j, rows, tau[j], a, diagonal, columns, w.data());
+		}
+	}
+
+	template<class ExecutionPolicy, class V, class C>
+	void qr_blocked(const ExecutionPolicy& policy, V a, C& tau)
+	{
+		using T = typename V::value_type;
+		using block_matrix = matrix<T, std::allocator<T>, contiguous_storage<>>;
+		const std::size_t rows = a.count_rows();
+		const std::size_t columns = a.count_columns();
+		const std::size_t diagonal = std::min(rows, columns);
+		const std::size_t threads = matrix_execution::thread_count(policy);
+		std::vector<T> w(columns);
+
+		for (std::size_t k = 0; k < diagonal; k += factorization_block) {
+			const std::size_t kb = std::min(factorization_block, diagonal - k);
+			qr_panel(a, rows, k, k + kb, tau, w);
+			const std::size_t rest = columns - k - kb;
+			if (rest == 0) continue;
+
+			// The reflectors of the panel make Q = I - V T V^T (compact WY form):
+			// V is unit lower trapezoidal, T upper triangular.
+			const std::size_t height = rows - k;
+			block_matrix v(height, kb, T{});
+			for (std::size_t i = 0; i < height; ++i) {
+				const T* src = a[k + i];
+				T* dst = v[i];
+				for (std::size_t j = 0; j < kb && j <= i; ++j) dst[j] = (i == j) ? T{ 1 } : src[k + j];
+			}
+			block_matrix t(kb, kb, T{});
+			std::vector<T> z(kb);
+			for (std::size_t j = 0; j < kb; ++j) {
+				// z = V(:, 0..j)^T v_j, T(0..j, j) = -tau_j T(0..j, 0..j) z
+				std::fill(z.begin(), z.end(), T{});
+				for (std::size_t i = j; i < height; ++i) {
+					const T* row = v[i];
+					for (std::size_t p = 0; p < j; ++p) z[p] += row[p] * row[j];
+				}
+				for (std::size_t i = 0; i < j; ++i) {
+					T sum{};
+					for (std::size_t p = i; p < j; ++p) sum += t[i][p] * z[p];
+					t[i][j] = -tau[k + j] * sum;
+				}
+				t[j][j] = tau[k + j];
+			}
+
+			// A2 -= V (T^T (V^T A2))
+			auto trailing = a.block(k, k + kb, height, rest);
+			block_matrix product(kb, rest);
+			const block_matrix& cv = v;
+			gemm(cv.transposed(), trailing, product, threads);
+			for (std::size_t i = kb; i-- > 0;) {
+				T* row = product[i];
+				for (std::size_t column = 0; column < rest; ++column) row[column] *= t[i][i];
+				for (std::size_t p = 0; p < i; ++p) {
+					const T f = t[p][i];
+					const T* src = product[p];
+					for (std::size_t column = 0; column < rest; ++column) row[column] += f * src[column];
+				}
+			}
+			gemm(v, product, trailing, threads, gemm_update::subtract);
+		}
+	}
+
+	template<class M>
+	inline void check_square(const M& m, const char* message)
+	{
+		if (m.count_rows() != m.count_columns()) {
+			throw std::invalid_argument{ message };
+		}
+	}
+
+} // namespace matrix_detail
+
+template<class M>
+struct lu_factorization
+{
+	using value_type = typename M::value_type;
+	using pivot_array = typename matrix_detail::factorization_types<M>::pivots;
+
+	// L below the diagonal (its unit diagonal is implied), U on and above it.
+	M factors;
+	// Row i was exchanged with row pivots[i] >= i, for i from 0 up.
+	pivot_array pivots;
+	// Sign of the row permutation, 1 or -1.
+	int sign{ 1 };
+
+	constexpr std::size_t size() const noexcept { return factors.count_rows(); }
+
+	constexpr bool is_singular() const
+	{
+		for (std::size_t i = 0; i < size(); ++i) {
+			if (factors[i][i] == value_type{}) return true;
+		}
+		return false;
+	}
+
+	constexpr value_type determinant() const
+	{
+		value_type result = static_cast<value_type>(sign);
+		for (std::size_t i = 0; i < size(); ++i) {
+			result *= factors[i][i];
+		}
+		return result;
+	}
+
+	// x with A x = b. b is a std::vector or std::array of size() values, or a
+	// matrix with a right-hand side in each column.
+	template<class B>
+	constexpr B solve(B b) const
+	{
+		solve_in_place(matrix_execution::seq, b);
+		return b;
+	}
+
+	template<class ExecutionPolicy, class B, class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+	B solve(const ExecutionPolicy& policy, B b) const
+	{
+		solve_in_place(policy, b);
+		return b;
+	}
+
+	template<class ExecutionPolicy, class B>
+	constexpr void solve_in_place(const ExecutionPolicy& policy, B& b) const
+	{
+		if (is_singular()) {
+			throw matrix_factorization_error{ "solve error: matrix is singular" };
+		}
+		const std::size_t n = size();
+		if constexpr (is_matrix_container<B>::value) {
+			if (b.count_rows() != n) {
+				throw std::invalid_argument{ "Matrix sizes do not match for solve" };
+			}
+			const std::size_t columns = b.count_columns();
+			if (!MATRIX_IS_CONSTANT_EVALUATED() && n >= matrix_detail::factorization_blocked_size
+				&& columns >= matrix_detail::blocked_solve_columns) {
+				matrix_detail::lu_solve_blocked(policy, factors.view(), pivots, matrix_detail::view_of(b));
+				return;
+			}
+			matrix_detail::lu_solve_unblocked(factors, pivots, b, n, columns);
+		}
+		else {
+			if (std::size(b) != n) {
+				throw std::invalid_argument{ "Vector size does not match for solve" };
+			}
+			matrix_detail::column_of_values<value_type> column{ std::data(b), n };
+			matrix_detail::lu_solve_unblocked(factors, pivots, column, n, 1);
+		}
+	}
+
+	constexpr M inverse() const { return inverse(matrix_execution::seq); }
+
+	template<class ExecutionPolicy>
+	constexpr M inverse(const ExecutionPolicy& policy) const
+	{
+		M result = factors;
+		for (std::size_t i = 0; i < size(); ++i) {
+			for (std::size_t j = 0; j < size(); ++j) {
+				result[i][j] = (i == j) ? value_type{ 1 } : value_type{};
+			}
+		}
+		solve_in_place(policy, result);
+		return result;
+	}
+};
+
+// A = Q R: the Householder vectors below the diagonal of 'factors', R on and
+// above it.
+template<class M>
+struct qr_factorization
+{
+	using types = matrix_detail::factorization_types<M>;
+	using value_type = typename M::value_type;
+	using q_matrix = typename types::q_matrix;
+	using r_matrix = typename types::r_matrix;
+
+	M factors;
+	typename types::coefficients tau;
+
+	constexpr std::size_t count_rows() const noexcept { return factors.count_rows(); }
+	constexpr std::size_t count_columns() const noexcept { return factors.count_columns(); }
+	constexpr std::size_t count_reflectors() const noexcept { return std::min(count_rows(), count_columns()); }
+
+	// Thin Q: count_rows() x min(count_rows(), count_columns()), orthonormal columns.
+	q_matrix q() const
+	{
+		const std::size_t rows = count_rows();
+		const std::size_t k = count_reflectors();
+		q_matrix result = types::template make_matrix<q_matrix>(factors, rows, k);
+		for (std::size_t i = 0; i < k; ++i) result[i][i] = value_type{ 1 };
+		std::vector<value_type> w(k);
+		for (std::size_t j = k; j-- > 0;) {
+			matrix_detail::apply_reflector(factors, j, rows, tau[j], result, j, k, w.data());
+		}
+		return result;
+	}
+
+	// min(count_rows(), count_columns()) x count_columns(), upper triangular.
+	r_matrix r() const
+	{
+		const std::size_t k = count_reflectors();
+		r_matrix result = types::template make_matrix<r_matrix>(factors, k, count_columns());
+		for (std::size_t i = 0; i < k; ++i) {
+			for (std::size_t j = i; j < count_columns(); ++j) {
+				result[i][j] = factors[i][j];
+			}
+		}
+		return result;
+	}
+
+	// Least squares solution of A x = b (count_rows() >= count_columns()), b is a
+	// std::vector or std::array of count_rows() values. Returns count_columns() values.
+	template<class V>
+	auto solve(V b) const
+	{
+		const std::size_t rows = count_rows();
+		const std::size_t columns = count_columns();
+		if (rows < columns) {
+			throw std::invalid_argument{ "Least squares solve requires at least as many rows as columns" };
+		}
+		if (std::size(b) != rows) {
+			throw std::invalid_argument{ "Vector size does not match for solve" };
+		}
+
+		matrix_detail::column_of_values<value_type> column{ std::data(b), rows };
+		value_type w[1];
+		for (std::size_t j = 0; j < columns; ++j) {
+			matrix_detail::apply_reflector(factors, j, rows, tau[j], column, 0, 1, w);
+		}
+		for (std::size_t i = columns; i-- > 0;) {
+			if (factors[i][i] == value_type{}) {
+				throw matrix_factorization_error{ "solve error: matrix is rank deficient" };
+			}
+			value_type sum = b[i];
+			for (std::size_t j = i + 1; j < columns; ++j) sum -= factors[i][j] * b[j];
+			b[i] = sum / factors[i][i];
+		}
+
+		if constexpr (std::is_same_v<V, std::vector<value_type>>) {
+			b.resize(columns);
+			return b;
+		}
+		else {
+			std::array<value_type, std::tuple_size_v<typename types::coefficients>> x{};
+			std::copy_n(b.begin(), x.size(), x.begin());
+			return x;
+		}
+	}
+};
+
+// matrix
+
+template<class ExecutionPolicy, class T, class A, class S,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+lu_factorization<matrix<T, A, S>> lu(const ExecutionPolicy& policy, const matrix<T, A, S>& m)
+{
+	static_assert(!std::is_integral_v<T>, "lu() requires non-integer elements");
+	matrix_detail::check_square(m, "Matrix must be square for LU factorization");
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::lu };
+
+	lu_factorization<matrix<T, A, S>> result{ m, std::vector<std::size_t>(m.count_rows()), 1 };
+	if (m.count_rows() >= matrix_detail::factorization_blocked_size) {
+		matrix_detail::lu_blocked(policy, result.factors.view(), result.pivots, result.sign);
+	}
+	else {
+		matrix_detail::lu_panel(result.factors, m.count_rows(), 0, m.count_rows(), result.pivots, result.sign);
+	}
+	return result;
+}
+
+// The blocked algorithms run on the shared thread pool when no policy is given.
+template<class T, class A, class S>
+lu_factorization<matrix<T, A, S>> lu(const matrix<T, A, S>& m)
+{
+	return lu(matrix_execution::par, m);
+}
+
+// Lower triangular L with A = L L^T, only the lower triangle of A is read.
+template<class ExecutionPolicy, class T, class A, class S,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix<T, A, S> cholesky(const ExecutionPolicy& policy, const matrix<T, A, S>& m)
+{
+	static_assert(!std::is_integral_v<T>, "cholesky() requires non-integer elements");
+	matrix_detail::check_square(m, "Matrix must be square for Cholesky factorization");
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::cholesky };
+
+	matrix<T, A, S> result = m;
+	const std::size_t n = m.count_rows();
+	if (n >= matrix_detail::factorization_blocked_size) {
+		matrix_detail::cholesky_blocked(policy, result.view());
+	}
+	else {
+		matrix_detail::cholesky_diagonal_block(result, 0, n);
+		matrix_detail::clear_upper_triangle(result, 0, n, n);
+	}
+	return result;
+}
+
+template<class T, class A, class S>
+matrix<T, A, S> cholesky(const matrix<T, A, S>& m)
+{
+	return cholesky(matrix_execution::par, m);
+}
+
+template<class ExecutionPolicy, class T, class A, class S,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+qr_factorization<matrix<T, A, S>> qr(const ExecutionPolicy& policy, const matrix<T, A, S>& m)
+{
+	static_assert(!std::is_integral_v<T>, "qr() requires non-integer elements");
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::qr };
+
+	const std::size_t k = std::min(m.count_rows(), m.count_columns());
+	qr_factorization<matrix<T, A, S>> result{ m, std::vector<T>(k) };
+	if (std::min(m.count_rows(), m.count_columns()) >= matrix_detail::factorization_blocked_size) {
+		matrix_detail::qr_blocked(policy, result.factors.view(), result.tau);
+	}
+	else {
+		matrix_detail::qr_unblocked(result.factors, m.count_rows(), m.count_columns(), result.tau);
+	}
+	return result;
+}
+
+template<class T, class A, class S>
+qr_factorization<matrix<T, A, S>> qr(const matrix<T, A, S>& m)
+{
+	return qr(matrix_execution::par, m);
+}
+
+// x with a x = b, b is a std::vector or a matrix of right-hand sides (see lu_factorization::solve).
+template<class ExecutionPolicy, class T, class A, class S, class B,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+B solve(const ExecutionPolicy& policy, const matrix<T, A, S>& a, B b)
+{
+	lu(policy, a).solve_in_place(policy, b);
+	return b;
+}
+
+template<class T, class A, class S, class B>
+B solve(const matrix<T, A, S>& a, B b)
+{
+	return solve(matrix_execution::par, a, std::move(b));
+}
+
+template<class T, class A, class S>
+matrix<T, A, S> inverse(const matrix<T, A, S>& m)
+{
+	return lu(matrix_execution::par, m).inverse(matrix_execution::par);
+}
+
+template<class T, class A, class S>
+T determinant(const matrix<T, A, S>& m)
+{
+	return lu(matrix_execution::par, m).determinant();
+}
+
+// fixed_matrix
+
+template<class T, std::size_t Size>
+constexpr lu_factorization<fixed_matrix<T, Size, Size>> lu(const fixed_matrix<T, Size, Size>& m)
+{
+	static_assert(!std::is_integral_v<T>, "lu() requires non-integer elements");
+	lu_factorization<fixed_matrix<T, Size, Size>> result{ m, {}, 1 };
+	matrix_detail::lu_panel(result.factors, Size, 0, Size, result.pivots, result.sign);
+	return result;
+}
+
+template<class T, std::size_t Size>
+fixed_matrix<T, Size, Size> cholesky(const fixed_matrix<T, Size, Size>& m)
+{
+	static_assert(!std::is_integral_v<T>, "cholesky() requires non-integer elements");
+	fixed_matrix<T, Size, Size> result = m;
+	matrix_detail::cholesky_diagonal_block(result, 0, Size);
+	matrix_detail::clear_upper_triangle(result, 0, Size, Size);
+	return result;
+}
+
+template<class T, std::size_t RowsCount, std::size_t ColumnsCount>
+qr_factorization<fixed_matrix<T, RowsCount, ColumnsCount>> qr(const fixed_matrix<T, RowsCount, ColumnsCount>& m)
+{
+	static_assert(!std::is_integral_v<T>, "qr() requires non-integer elements");
+	qr_factorization<fixed_matrix<T, RowsCount, ColumnsCount>> result{ m, {} };
+	matrix_detail::qr_unblocked(result.factors, RowsCount, ColumnsCount, result.tau);
+	return result;
+}
+
+// x with a x = b, b is a std::array of Size values or a fixed_matrix of right-hand sides.
+template<class T, std::size_t Size, class B>
+constexpr B solve(const fixed_matrix<T, Size, Size>& a, B b)
+{
+	lu(a).solve_in_place(matrix_execution::seq, b);
+	return b;
+}
+
+#endif // !MATRIX_FACTORIZATION_HPP
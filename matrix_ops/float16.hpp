@@ -0,0 +1,224 @@
+#pragma once
+
+#ifndef MATRIX_FLOAT16_HPP
+#define MATRIX_FLOAT16_HPP
+
+#include "simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 16-bit floating-point storage types.
+//
+// float16 is IEEE 754 binary16 (5 exponent bits, 10 mantissa bits), bfloat16
+// keeps the 8 exponent bits of float and 7 mantissa bits. Both only store
+// values: they convert to and from float (rounding to nearest, ties to even)
+// and all arithmetic is done in float. A matrix<float16> or matrix<bfloat16>
+// takes half the memory and bandwidth of a matrix<float>; multiply() with a
+// float result converts the elements while packing them for the float kernels,
+// e.g.
+//
+//   matrix<float16> a = ..., b = ...;
+//   matrix<float> c(a.count_rows(), b.count_columns());
+//   multiply(matrix_execution::par, a, b, c);
+//
+// convert_elements() converts runs of elements, with F16C for float16 when
+// available.
+
+namespace matrix_detail {
+
+	inline std::uint32_t float_bits(const float value) noexcept
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline float float_from_bits(const std::uint32_t bits) noexcept
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	inline std::uint16_t float_to_half_bits(const float value) noexcept
+	{
+		std::uint32_t x = float_bits(value);
+		const auto sign = static_cast<std::uint16_t>((x >> 16) & 0x8000u);
+		x &= 0x7fffffffu;
+
+		if (x >= 0x7f800000u) {
+			// Infinity, or NaN kept quiet with the top of its payload.
+			return static_cast<std::uint16_t>(sign | 0x7c00u | (x > 0x7f800000u ? 0x0200u | ((x >> 13) & 0x03ffu) : 0u));
+		}
+		if (x >= 0x477ff000u) {
+			// 65520 and above round to infinity.
+			return static_cast<std::uint16_t>(sign | 0x7c00u);
+		}
+		if (x < 0x38800000u) {
+			// Below 2^-14: subnormal in half precision, or zero below 2^-25.
+			if (x <= 0x33000000u) {
+				return sign;
+			}
+			const std::uint32_t exponent = x >> 23;
+			const std::uint32_t mantissa = (x & 0x007fffffu) | 0x00800000u;
+			const std::uint32_t shift = 126 - exponent;
+			std::uint32_t half = mantissa >> shift;
+			const std::uint32_t rest = mantissa & ((1u << shift) - 1);
+			const std::uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half & 1u) != 0)) {
+				++half;
+			}
+			return static_cast<std::uint16_t>(sign | half);
+		}
+
+		// Normal: rebias the exponent, a carry of the rounding moves to the exponent.
+		std::uint32_t half = (x - 0x38000000u) >> 13;
+		const std::uint32_t rest = x & 0x1fffu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u) != 0)) {
+			++half;
+		}
+		return static_cast<std::uint16_t>(sign | half);
+	}
+
+	inline float half_bits_to_float(const std::uint16_t half) noexcept
+	{
+		const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+		const std::uint32_t exponent = (half >> 10) & 0x1fu;
+		const std::uint32_t mantissa = half & 0x03ffu;
+
+		if (exponent == 0x1fu) {
+			return float_from_bits(sign | 0x7f800000u | (mantissa << 13));
+		}
+		if (exponent == 0) {
+			// Zero or subnormal: mantissa * 2^-24.
+			const float magnitude = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+			return sign != 0 ? -magnitude : magnitude;
+		}
+		return float_from_bits(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	inline std::uint16_t float_to_bfloat16_bits(const float value) noexcept
+	{
+		const std::uint32_t x = float_bits(value);
+		if ((x & 0x7fffffffu) > 0x7f800000u) {
+			return static_cast<std::uint16_t>((x >> 16) | 0x0040u);
+		}
+		return static_cast<std::uint16_t>((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+	}
+
+	inline float bfloat16_bits_to_float(const std::uint16_t bits) noexcept
+	{
+		return float_from_bits(static_cast<std::uint32_t>(bits) << 16);
+	}
+
+} // namespace matrix_detail
+
+struct float16
+{
+	float16() noexcept = default;
+	float16(const float value) noexcept : bits{ matrix_detail::float_to_half_bits(value) } {}
+
+	static float16 from_bits(const std::uint16_t bits) noexcept
+	{
+		float16 result;
+		result.bits = bits;
+		return result;
+	}
+
+	operator float() const noexcept { return matrix_detail::half_bits_to_float(bits); }
+
+	std::uint16_t bits{ 0 };
+};
+
+struct bfloat16
+{
+	bfloat16() noexcept = default;
+	bfloat16(const float value) noexcept : bits{ matrix_detail::float_to_bfloat16_bits(value) } {}
+
+	static bfloat16 from_bits(const std::uint16_t bits) noexcept
+	{
+		bfloat16 result;
+		result.bits = bits;
+		return result;
+	}
+
+	operator float() const noexcept { return matrix_detail::bfloat16_bits_to_float(bits); }
+
+	std::uint16_t bits{ 0 };
+};
+
+namespace matrix_detail {
+
+	template<class T>
+	constexpr bool is_float16_v = std::is_same_v<T, float16> || std::is_same_v<T, bfloat16>;
+
+#if MATRIX_X86
+	MATRIX_TARGET("avx2,f16c") inline std::size_t convert_half_to_float_f16c(const float16* src, const std::size_t count, float* dst) noexcept
+	{
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+		}
+		return i;
+	}
+
+	MATRIX_TARGET("avx2,f16c") inline std::size_t convert_float_to_half_f16c(const float* src, const std::size_t count, float16* dst) noexcept
+	{
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+		}
+		return i;
+	}
+#endif
+
+} // namespace matrix_detail
+
+// dst[i] = src[i] for i < count, between float and the 16-bit types.
+inline void convert_elements(const float16* src, const std::size_t count, float* dst) noexcept
+{
+	std::size_t i = 0;
+#if MATRIX_X86
+	if (has_f16c()) {
+		i = matrix_detail::convert_half_to_float_f16c(src, count, dst);
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = src[i];
+	}
+}
+
+inline void convert_elements(const float* src, const std::size_t count, float16* dst) noexcept
+{
+	std::size_t i = 0;
+#if MATRIX_X86
+	if (has_f16c()) {
+		i = matrix_detail::convert_float_to_half_f16c(src, count, dst);
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = src[i];
+	}
+}
+
+// bfloat16 is the upper half of a float: plain loops vectorize.
+inline void convert_elements(const bfloat16* src, const std::size_t count, float* dst) noexcept
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		dst[i] = matrix_detail::float_from_bits(static_cast<std::uint32_t>(src[i].bits) << 16);
+	}
+}
+
+inline void convert_elements(const float* src, const std::size_t count, bfloat16* dst) noexcept
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		dst[i] = src[i];
+	}
+}
+
+#endif // !MATRIX_FLOAT16_HPP
@@ -0,0 +1,532 @@
+#pragma once
+
+#ifndef MATRIX_MULTIPLY_HPP
+#define MATRIX_MULTIPLY_HPP
+
+#include "simd.hpp"
+#include "float16.hpp"
+#include "thread_pool.hpp"
+#include "../matrix/matrix.hpp"
+#include "../matrix/matrix_instrumentation.hpp"
+#include "../fixed_matrix/fixed_matrix.hpp"
+#include "../fixed_matrix/fixed_matrix_kernels.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+namespace matrix_detail {
+
+	// Micro-kernels compute an MR x NR tile of the product from packed panels:
+	// 'a' holds kc columns of MR elements, 'b' holds kc rows of NR elements.
+	// The tile is written row-major and overwritten, not accumulated.
+	template<class T>
+	struct gemm_kernel
+	{
+		using function = void(*)(std::size_t kc, const T* a, const T* b, T* tile);
+
+		std::size_t mr;
+		std::size_t nr;
+		function compute;
+	};
+
+	template<class T, std::size_t MR, std::size_t NR>
+	void gemm_micro_scalar(const std::size_t kc, const T* a, const T* b, T* tile)
+	{
+		T acc[MR][NR] = {};
+		for (std::size_t k = 0; k < kc; ++k) {
+			for (std::size_t i = 0; i < MR; ++i) {
+				const T ai = a[i];
+				for (std::size_t j = 0; j < NR; ++j) {
+					acc[i][j] += ai * b[j];
+				}
+			}
+			a += MR;
+			b += NR;
+		}
+		for (std::size_t i = 0; i < MR; ++i) {
+			for (std::size_t j = 0; j < NR; ++j) {
+				tile[i * NR + j] = acc[i][j];
+			}
+		}
+	}
+
+#if MATRIX_X86
+	struct sse2_f64
+	{
+		using value_type = double;
+		using reg = __m128d;
+		static constexpr std::size_t width = 2;
+
+		MATRIX_TARGET("sse2") static inline reg zero() noexcept { return _mm_setzero_pd(); }
+		MATRIX_TARGET("sse2") static inline reg load(const double* p) noexcept { return _mm_loadu_pd(p); }
+		MATRIX_TARGET("sse2") static inline void store(double* p, reg v) noexcept { _mm_storeu_pd(p, v); }
+		MATRIX_TARGET("sse2") static inline reg broadcast(const double* p) noexcept { return _mm_set1_pd(*p); }
+		MATRIX_TARGET("sse2") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+	};
+
+	struct sse2_f32
+	{
+		using value_type = float;
+		using reg = __m128;
+		static constexpr std::size_t width = 4;
+
+		MATRIX_TARGET("sse2") static inline reg zero() noexcept { return _mm_setzero_ps(); }
+		MATRIX_TARGET("sse2") static inline reg load(const float* p) noexcept { return _mm_loadu_ps(p); }
+		MATRIX_TARGET("sse2") static inline void store(float* p, reg v) noexcept { _mm_storeu_ps(p, v); }
+		MATRIX_TARGET("sse2") static inline reg broadcast(const float* p) noexcept { return _mm_set1_ps(*p); }
+		MATRIX_TARGET("sse2") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	};
+
+	struct avx2_f64
+	{
+		using value_type = double;
+		using reg = __m256d;
+		static constexpr std::size_t width = 4;
+
+		MATRIX_TARGET("avx2,fma") static inline reg zero() noexcept { return _mm256_setzero_pd(); }
+		MATRIX_TARGET("avx2,fma") static inline reg load(const double* p) noexcept { return _mm256_loadu_pd(p); }
+		MATRIX_TARGET("avx2,fma") static inline void store(double* p, reg v) noexcept { _mm256_storeu_pd(p, v); }
+		MATRIX_TARGET("avx2,fma") static inline reg broadcast(const double* p) noexcept { return _mm256_broadcast_sd(p); }
+		MATRIX_TARGET("avx2,fma") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm256_fmadd_pd(a, b, c); }
+	};
+
+	struct avx2_f32
+	{
+		using value_type = float;
+		using reg = __m256;
+		static constexpr std::size_t width = 8;
+
+		MATRIX_TARGET("avx2,fma") static inline reg zero() noexcept { return _mm256_setzero_ps(); }
+		MATRIX_TARGET("avx2,fma") static inline reg load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+		MATRIX_TARGET("avx2,fma") static inline void store(float* p, reg v) noexcept { _mm256_storeu_ps(p, v); }
+		MATRIX_TARGET("avx2,fma") static inline reg broadcast(const float* p) noexcept { return _mm256_broadcast_ss(p); }
+		MATRIX_TARGET("avx2,fma") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm256_fmadd_ps(a, b, c); }
+	};
+
+	struct avx2_i32
+	{
+		using value_type = std::int32_t;
+		using reg = __m256i;
+		static constexpr std::size_t width = 8;
+
+		MATRIX_TARGET("avx2,fma") static inline reg zero() noexcept { return _mm256_setzero_si256(); }
+		MATRIX_TARGET("avx2,fma") static inline reg load(const std::int32_t* p) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		MATRIX_TARGET("avx2,fma") static inline void store(std::int32_t* p, reg v) noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		MATRIX_TARGET("avx2,fma") static inline reg broadcast(const std::int32_t* p) noexcept { return _mm256_set1_epi32(*p); }
+		MATRIX_TARGET("avx2,fma") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm256_add_epi32(_mm256_mullo_epi32(a, b), c); }
+	};
+
+	struct avx512_f64
+	{
+		using value_type = double;
+		using reg = __m512d;
+		static constexpr std::size_t width = 8;
+
+		MATRIX_TARGET("avx512f") static inline reg zero() noexcept { return _mm512_setzero_pd(); }
+		MATRIX_TARGET("avx512f") static inline reg load(const double* p) noexcept { return _mm512_loadu_pd(p); }
+		MATRIX_TARGET("avx512f") static inline void store(double* p, reg v) noexcept { _mm512_storeu_pd(p, v); }
+		MATRIX_TARGET("avx512f") static inline reg broadcast(const double* p) noexcept { return _mm512_set1_pd(*p); }
+		MATRIX_TARGET("avx512f") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm512_fmadd_pd(a, b, c); }
+	};
+
+	struct avx512_f32
+	{
+		using value_type = float;
+		using reg = __m512;
+		static constexpr std::size_t width = 16;
+
+		MATRIX_TARGET("avx512f") static inline reg zero() noexcept { return _mm512_setzero_ps(); }
+		MATRIX_TARGET("avx512f") static inline reg load(const float* p) noexcept { return _mm512_loadu_ps(p); }
+		MATRIX_TARGET("avx512f") static inline void store(float* p, reg v) noexcept { _mm512_storeu_ps(p, v); }
+		MATRIX_TARGET("avx512f") static inline reg broadcast(const float* p) noexcept { return _mm512_set1_ps(*p); }
+		MATRIX_TARGET("avx512f") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm512_fmadd_ps(a, b, c); }
+	};
+
+	struct avx512_i32
+	{
+		using value_type = std::int32_t;
+		using reg = __m512i;
+		static constexpr std::size_t width = 16;
+
+		MATRIX_TARGET("avx512f") static inline reg zero() noexcept { return _mm512_setzero_si512(); }
+		MATRIX_TARGET("avx512f") static inline reg load(const std::int32_t* p) noexcept { return _mm512_loadu_si512(p); }
+		MATRIX_TARGET("avx512f") static inline void store(std::int32_t* p, reg v) noexcept { _mm512_storeu_si512(p, v); }
+		MATRIX_TARGET("avx512f") static inline reg broadcast(const std::int32_t* p) noexcept { return _mm512_set1_epi32(*p); }
+		MATRIX_TARGET("avx512f") static inline reg madd(reg a, reg b, reg c) noexcept { return _mm512_add_epi32(_mm512_mullo_epi32(a, b), c); }
+	};
+
+	// The register-tiled kernel is the same for every instruction set, but each
+	// copy has to be compiled for its own target, hence the three definitions.
+#define MATRIX_GEMM_MICRO_KERNEL_BODY                                                 \
+	using reg = typename Ops::reg;                                                    \
+	constexpr std::size_t NR = NRV * Ops::width;                                      \
+	reg acc[MR][NRV];                                                                 \
+	MATRIX_UNROLL                                                                     \
+	for (std::size_t i = 0; i < MR; ++i) {                                            \
+		MATRIX_UNROLL                                                                 \
+		for (std::size_t j = 0; j < NRV; ++j) acc[i][j] = Ops::zero();                \
+	}                                                                                 \
+	for (std::size_t k = 0; k < kc; ++k) {                                            \
+		reg bv[NRV];                                                                  \
+		MATRIX_UNROLL                                                                 \
+		for (std::size_t j = 0; j < NRV; ++j) bv[j] = Ops::load(b + j * Ops::width);  \
+		MATRIX_UNROLL                                                                 \
+		for (std::size_t i = 0; i < MR; ++i) {                                        \
+			const reg av = Ops::broadcast(a + i);                                     \
+			MATRIX_UNROLL                                                             \
+			for (std::size_t j = 0; j < NRV; ++j) acc[i][j] = Ops::madd(av, bv[j], acc[i][j]); \
+		}                                                                             \
+		a += MR;                                                                      \
+		b += NR;                                                                      \
+	}                                                                                 \
+	MATRIX_UNROLL                                                                     \
+	for (std::size_t i = 0; i < MR; ++i) {                                            \
+		MATRIX_UNROLL                                                                 \
+		for (std::size_t j = 0; j < NRV; ++j) Ops::store(tile + i * NR + j * Ops::width, acc[i][j]); \
+	}
+
+	template<class Ops, std::size_t MR, std::size_t NRV>
+	MATRIX_TARGET("sse2") void gemm_micro_sse2(const std::size_t kc,
+		const typename Ops::value_type* a, const typename Ops::value_type* b, typename Ops::value_type* tile)
+	{
+		MATRIX_GEMM_MICRO_KERNEL_BODY
+	}
+
+	template<class Ops, std::size_t MR, std::size_t NRV>
+	MATRIX_TARGET("avx2,fma") void gemm_micro_avx2(const std::size_t kc,
+		const typename Ops::value_type* a, const typename Ops::value_type* b, typename Ops::value_type* tile)
+	{
+		MATRIX_GEMM_MICRO_KERNEL_BODY
+	}
+
+	template<class Ops, std::size_t MR, std::size_t NRV>
+	MATRIX_TARGET("avx512f") void gemm_micro_avx512(const std::size_t kc,
+		const typename Ops::value_type* a, const typename Ops::value_type* b, typename Ops::value_type* tile)
+	{
+		MATRIX_GEMM_MICRO_KERNEL_BODY
+	}
+
+#undef MATRIX_GEMM_MICRO_KERNEL_BODY
+#endif // MATRIX_X86
+
+	template<class T>
+	inline gemm_kernel<T> select_gemm_kernel(const simd_level level) noexcept
+	{
+#if MATRIX_X86
+		if constexpr (std::is_same_v<T, double>) {
+			switch (level) {
+			case simd_level::avx512: return { 8, 16, &gemm_micro_avx512<avx512_f64, 8, 2> };
+			case simd_level::avx2: return { 6, 8, &gemm_micro_avx2<avx2_f64, 6, 2> };
+			case simd_level::sse2: return { 4, 4, &gemm_micro_sse2<sse2_f64, 4, 2> };
+			default: break;
+			}
+		}
+		else if constexpr (std::is_same_v<T, float>) {
+			switch (level) {
+			case simd_level::avx512: return { 8, 32, &gemm_micro_avx512<avx512_f32, 8, 2> };
+			case simd_level::avx2: return { 6, 16, &gemm_micro_avx2<avx2_f32, 6, 2> };
+			case simd_level::sse2: return { 4, 8, &gemm_micro_sse2<sse2_f32, 4, 2> };
+			default: break;
+			}
+		}
+		else if constexpr (std::is_same_v<T, std::int32_t>) {
+			switch (level) {
+			case simd_level::avx512: return { 8, 32, &gemm_micro_avx512<avx512_i32, 8, 2> };
+			case simd_level::avx2: return { 4, 16, &gemm_micro_avx2<avx2_i32, 4, 2> };
+			default: break;
+			}
+		}
+#endif
+		(void)level;
+		return { 4, 4, &gemm_micro_scalar<T, 4, 4> };
+	}
+
+	struct gemm_blocking
+	{
+		std::size_t mc;
+		std::size_t kc;
+		std::size_t nc;
+	};
+
+	// kc x nr panel of B stays in L1, mc x kc block of A in L2, kc x nc panel of B in L3.
+	// A panels are streamed through L1 too, so the L2 block only takes a quarter of 
+	// L2: the rest is left for the B panel and the C tiles.
+	template<class T>
+	inline gemm_blocking compute_gemm_blocking(const gemm_kernel<T>& kernel) noexcept
+	{
+		const auto& caches = cpu_cache_sizes();
+
+		std::size_t kc = caches.l1 / (kernel.nr * sizeof(T));
+		kc = std::clamp<std::size_t>(kc / 8 * 8, 64, 512);
+
+		std::size_t mc = caches.l2 / 4 / (kc * sizeof(T));
+		mc = std::clamp<std::size_t>(mc / kernel.mr * kernel.mr, kernel.mr, 1024 / kernel.mr * kernel.mr);
+
+		std::size_t nc = caches.l3 / 2 / (kc * sizeof(T));
+		nc = std::clamp<std::size_t>(nc / kernel.nr * kernel.nr, kernel.nr, 8192 / kernel.nr * kernel.nr);
+
+		return { mc, kc, nc };
+	}
+
+	inline std::size_t round_up(const std::size_t value, const std::size_t step) noexcept
+	{
+		return (value + step - 1) / step * step;
+	}
+
+	// Rows of 16-bit floats packed for the float kernels are converted in runs.
+	template<class T, class Row>
+	constexpr bool is_converted_row_v = std::is_same_v<T, float> && std::is_pointer_v<Row>
+		&& is_float16_v<std::remove_cv_t<std::remove_pointer_t<Row>>>;
+
+	// Packs rows [row, row + rows) and columns [col, col + cols) of 'src' into
+	// panels of mr rows stored column by column. Missing rows are zero-filled.
+	template<class T, class M>
+	void pack_a(const M& src, const std::size_t row, const std::size_t rows,
+		const std::size_t col, const std::size_t cols, const std::size_t mr, T* dst)
+	{
+		for (std::size_t panel = 0; panel < rows; panel += mr) {
+			const std::size_t height = std::min(mr, rows - panel);
+			for (std::size_t r = 0; r < height; ++r) {
+				const auto& src_row = src[row + panel + r];
+				if constexpr (is_converted_row_v<T, std::decay_t<decltype(src_row)>>) {
+					constexpr std::size_t run = 256;
+					alignas(64) float converted[run];
+					for (std::size_t first = 0; first < cols; first += run) {
+						const std::size_t count = std::min(run, cols - first);
+						convert_elements(src_row + col + first, count, converted);
+						for (std::size_t k = 0; k < count; ++k) {
+							dst[(first + k) * mr + r] = converted[k];
+						}
+					}
+				}
+				else {
+					for (std::size_t k = 0; k < cols; ++k) {
+						dst[k * mr + r] = static_cast<T>(src_row[col + k]);
+					}
+				}
+			}
+			for (std::size_t r = height; r < mr; ++r) {
+				for (std::size_t k = 0; k < cols; ++k) {
+					dst[k * mr + r] = T{};
+				}
+			}
+			dst += mr * cols;
+		}
+	}
+
+	// Packs rows [row, row + rows) and columns [col, col + cols) of 'src' into
+	// panels of nr columns stored row by row. Missing columns are zero-filled.
+	template<class T, class M>
+	void pack_b(const M& src, const std::size_t row, const std::size_t rows,
+		const std::size_t col, const std::size_t cols, const std::size_t nr, T* dst)
+	{
+		for (std::size_t k = 0; k < rows; ++k) {
+			const auto& src_row = src[row + k];
+			T* panel_dst = dst + k * nr;
+			for (std::size_t panel = 0; panel < cols; panel += nr) {
+				const std::size_t width = std::min(nr, cols - panel);
+				if constexpr (is_converted_row_v<T, std::decay_t<decltype(src_row)>>) {
+					convert_elements(src_row + col + panel, width, panel_dst);
+				}
+				else {
+					for (std::size_t c = 0; c < width; ++c) {
+						panel_dst[c] = static_cast<T>(src_row[col + panel + c]);
+					}
+				}
+				for (std::size_t c = width; c < nr; ++c) {
+					panel_dst[c] = T{};
+				}
+				panel_dst += nr * rows;
+			}
+		}
+	}
+
+	// How the product is stored into c: c = a * b, c += a * b or c -= a * b.
+	enum class gemm_update { assign, add, subtract };
+
+	template<class T, class M>
+	inline void store_tile(M& c, const std::size_t row, const std::size_t rows, const std::size_t col, const std::size_t cols,
+		const T* tile, const std::size_t nr, const gemm_update update)
+	{
+		for (std::size_t r = 0; r < rows; ++r) {
+			auto&& dst = c[row + r];
+			const T* src = tile + r * nr;
+			if (update == gemm_update::add) {
+				for (std::size_t j = 0; j < cols; ++j) dst[col + j] += src[j];
+			}
+			else if (update == gemm_update::subtract) {
+				for (std::size_t j = 0; j < cols; ++j) dst[col + j] -= src[j];
+			}
+			else {
+				for (std::size_t j = 0; j < cols; ++j) dst[col + j] = src[j];
+			}
+		}
+	}
+
+	template<class MA, class MB, class MC>
+	void gemm_naive(const MA& a, const MB& b, MC& c, const gemm_update update = gemm_update::assign)
+	{
+		using T = typename MC::value_type;
+		const std::size_t m = a.count_rows();
+		const std::size_t n = b.count_columns();
+		const std::size_t k = a.count_columns();
+
+		for (std::size_t i = 0; i < m; ++i) {
+			auto&& c_row = c[i];
+			const auto& a_row = a[i];
+			if (update == gemm_update::assign) {
+				for (std::size_t j = 0; j < n; ++j) c_row[j] = T{};
+			}
+			for (std::size_t p = 0; p < k; ++p) {
+				const T aip = (update == gemm_update::subtract) ? -static_cast<T>(a_row[p]) : static_cast<T>(a_row[p]);
+				const auto& b_row = b[p];
+				for (std::size_t j = 0; j < n; ++j) {
+					c_row[j] += aip * static_cast<T>(b_row[j]);
+				}
+			}
+		}
+	}
+
+	// Products with fewer multiply-adds than this are not worth packing.
+	constexpr std::size_t gemm_small_size = 32 * 32 * 32;
+	// Products with fewer multiply-adds than this are not worth splitting between threads.
+	constexpr std::size_t gemm_parallel_size = 128 * 128 * 128;
+
+	// Largest MR x NR tile of the kernels above.
+	constexpr std::size_t gemm_max_tile = 8 * 32;
+
+	// c = a * b (or c += / c -= a * b, see gemm_update) on at most 'threads'
+	// threads, sizes are expected to be checked by the caller.
+	//
+	// For every kc x nc panel of B, the product is split into tasks of mc rows and
+	// a range of nr-column panels. Each task packs its own mc x kc block of A, so
+	// tasks never wait for each other inside one panel.
+	template<class MA, class MB, class MC>
+	void gemm(const MA& a, const MB& b, MC& c, const std::size_t threads, const gemm_update update = gemm_update::assign)
+	{
+		using T = typename MC::value_type;
+		const std::size_t m = a.count_rows();
+		const std::size_t n = b.count_columns();
+		const std::size_t k = a.count_columns();
+		const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::gemm };
+
+		if (!std::is_arithmetic_v<T> || m * n * k <= gemm_small_size) {
+			gemm_naive(a, b, c, update);
+			return;
+		}
+
+		const auto kernel = select_gemm_kernel<T>(active_simd_level());
+		const auto blocking = compute_gemm_blocking(kernel);
+		const bool parallel = threads > 1 && m * n * k >= gemm_parallel_size;
+		const matrix_execution::parallel_policy policy{ threads };
+
+		aligned_buffer<T> packed_b(round_up(std::min(blocking.nc, n), kernel.nr) * blocking.kc);
+		const std::size_t m_blocks = (m + blocking.mc - 1) / blocking.mc;
+
+		for (std::size_t jc = 0; jc < n; jc += blocking.nc) {
+			const std::size_t nc = std::min(blocking.nc, n - jc);
+			const std::size_t b_panels = (nc + kernel.nr - 1) / kernel.nr;
+			const std::size_t n_chunks = parallel ? std::min(b_panels, (4 * threads + m_blocks - 1) / m_blocks) : 1;
+			const std::size_t chunk_panels = (b_panels + n_chunks - 1) / n_chunks;
+
+			for (std::size_t pc = 0; pc < k; pc += blocking.kc) {
+				const std::size_t kc = std::min(blocking.kc, k - pc);
+
+				const auto pack_panels = [&](std::size_t first, std::size_t last) {
+					const std::size_t col = first * kernel.nr;
+					pack_b(b, pc, kc, jc + col, std::min(nc, last * kernel.nr) - col, kernel.nr, packed_b.data() + col * kc);
+				};
+				const auto compute_blocks = [&](std::size_t first, std::size_t last) {
+					alignas(64) T tile[gemm_max_tile];
+					thread_scratch<T> packed_a(blocking.mc * kc);
+					std::size_t packed_block = m_blocks;
+
+					for (std::size_t task = first; task < last; ++task) {
+						const std::size_t block = task / n_chunks;
+						const std::size_t ic = block * blocking.mc;
+						const std::size_t mc = std::min(blocking.mc, m - ic);
+						if (block != packed_block) {
+							pack_a(a, ic, mc, pc, kc, kernel.mr, packed_a.data());
+							packed_block = block;
+						}
+
+						const std::size_t first_panel = (task % n_chunks) * chunk_panels;
+						const std::size_t last_panel = std::min(b_panels, first_panel + chunk_panels);
+						for (std::size_t jr = first_panel * kernel.nr; jr < last_panel * kernel.nr; jr += kernel.nr) {
+							const T* b_panel = packed_b.data() + jr * kc;
+							for (std::size_t ir = 0; ir < mc; ir += kernel.mr) {
+								kernel.compute(kc, packed_a.data() + ir * kc, b_panel, tile);
+								store_tile(c, ic + ir, std::min(kernel.mr, mc - ir), jc + jr, std::min(kernel.nr, nc - jr),
+									tile, kernel.nr, (pc != 0 && update == gemm_update::assign) ? gemm_update::add : update);
+							}
+						}
+					}
+				};
+
+				if (parallel) {
+					matrix_execution::for_each_tile(policy, 0, b_panels, 1, pack_panels);
+					matrix_execution::for_each_tile(policy, 0, m_blocks * n_chunks, 1, compute_blocks);
+				}
+				else {
+					pack_panels(0, b_panels);
+					compute_blocks(0, m_blocks);
+				}
+			}
+		}
+	}
+
+	template<class MA, class MB, class MC>
+	inline void check_multiplication(const MA& a, const MB& b, const MC& c)
+	{
+		if (a.count_columns() != b.count_rows() || c.count_rows() != a.count_rows() || c.count_columns() != b.count_columns()) {
+			throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+		}
+		if (static_cast<const void*>(&c) == static_cast<const void*>(&a) || static_cast<const void*>(&c) == static_cast<const void*>(&b)) {
+			throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+		}
+	}
+
+} // namespace matrix_detail
+
+// c = a * b
+//
+// Works with any operands that provide count_rows(), count_columns() and row
+// access through operator[]: matrix, fixed_matrix or a mix of them. Elements of
+// 'a' and 'b' are converted to the value type of 'c'. Products of float, double
+// and int32 matrices run on packed, cache-blocked SIMD kernels, the instruction
+// set is chosen at runtime (see active_simd_level()).
+template<class ExecutionPolicy, class MA, class MB, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const MA& a, const MB& b, MC& c)
+{
+	matrix_detail::check_multiplication(a, b, c);
+	matrix_detail::gemm(a, b, c, matrix_execution::thread_count(policy));
+}
+
+template<class MA, class MB, class MC>
+void multiply(const MA& a, const MB& b, MC& c)
+{
+	multiply(matrix_execution::seq, a, b, c);
+}
+
+template<class T, const std::size_t RowsCount, const std::size_t InnerCount, const std::size_t ColumnsCount>
+void multiply(const fixed_matrix<T, RowsCount, InnerCount>& a, const fixed_matrix<T, InnerCount, ColumnsCount>& b,
+	fixed_matrix<T, RowsCount, ColumnsCount>& c)
+{
+	multiply(matrix_execution::seq, a, b, c);
+}
+
+// Runs on the shared thread pool when the product is large enough.
+template<class T, class A, class S>
+matrix<T, A, S> operator*(const matrix<T, A, S>& a, const matrix<T, A, S>& b)
+{
+	if (a.count_columns() != b.count_rows()) {
+		throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+	}
+	matrix<T, A, S> result(a.count_rows(), b.count_columns(), T{}, a.get_allocator());
+	matrix_detail::gemm(a, b, result, matrix_execution::thread_count(matrix_execution::par));
+	return result;
+}
+
+#endif // !MATRIX_MULTIPLY_HPP
@@ -0,0 +1,385 @@
+#pragma once
+
+#ifndef MATRIX_QUANTIZED_HPP
+#define MATRIX_QUANTIZED_HPP
+
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include "../matrix/matrix.hpp"
+#include "../matrix/matrix_instrumentation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Quantized matrices.
+//
+// quantized_matrix<Q> stores int8_t or int16_t values with float scale factors,
+// one for the whole matrix (quantization::per_tensor) or one per row
+// (quantization::per_row): element (i, j) stands for values()[i][j] * scale(i).
+// Quantization is symmetric, values lie in [-max, max] with max = 127 or 32767,
+// so an int8 matrix takes a quarter of the memory of a matrix<float>.
+//
+// multiply_transposed(a, b, c) computes c = a * transpose(b), the product of a
+// layer with its weights stored one output per row: every element is the dot
+// product of two rows, accumulated exactly in int32 for int8 (up to 133144
+// columns, std::invalid_argument beyond) and in int64 for int16, then scaled by scale(i) of 'a' and
+// scale(j) of 'b'. The dot products use AVX-512 VNNI or AVX2 (pmaddubsw and
+// pmaddwd) when available, portable loops otherwise. multiply(a, b, c) is
+// the plain product, it needs a per-tensor scale for 'b'.
+//
+//   const auto weights = quantize<std::int8_t>(w);
+//   const auto input = quantize<std::int8_t>(x);
+//   matrix<float> y(x.count_rows(), w.count_rows());
+//   multiply_transposed(matrix_execution::par, input, weights, y);
+
+enum class quantization { per_tensor, per_row };
+
+template<typename Q>
+struct quantized_matrix
+{
+	static_assert(std::is_same_v<Q, std::int8_t> || std::is_same_v<Q, std::int16_t>,
+		"quantized_matrix holds int8_t or int16_t values");
+
+	using value_type = Q;
+	using size_type = std::size_t;
+	using values_type = matrix<Q, std::allocator<Q>, contiguous_storage<64>>;
+
+	static constexpr Q max_value = std::numeric_limits<Q>::max();
+
+	quantized_matrix() = default;
+
+	// 'scales' holds one scale (per tensor) or one per row. Throws
+	// std::invalid_argument for other counts or a value out of [-max_value, max_value].
+	quantized_matrix(values_type values, std::vector<float> scales)
+		: values_{ std::move(values) }
+		, scales_{ std::move(scales) }
+		, mode_{ scales_.size() == 1 ? quantization::per_tensor : quantization::per_row }
+	{
+		if (scales_.size() != 1 && scales_.size() != values_.count_rows()) {
+			throw std::invalid_argument{ "Quantized matrix needs one scale or one per row" };
+		}
+		if (std::find(std::cbegin(values_), std::cend(values_), std::numeric_limits<Q>::min()) != std::cend(values_)) {
+			throw std::invalid_argument{ "Quantized values must lie in [-max_value, max_value]" };
+		}
+	}
+
+	inline size_type count_rows() const noexcept { return values_.count_rows(); }
+	inline size_type count_columns() const noexcept { return values_.count_columns(); }
+	inline quantization mode() const noexcept { return mode_; }
+
+	inline float scale(const size_type row) const noexcept { return scales_[mode_ == quantization::per_row ? row : 0]; }
+	inline const std::vector<float>& scales() const noexcept { return scales_; }
+	inline const values_type& values() const noexcept { return values_; }
+
+	inline const Q* operator[](const size_type row) const noexcept { return values_[row]; }
+
+	// Dequantized element.
+	inline float operator()(const size_type row, const size_type column) const
+	{
+		return static_cast<float>(values_(row, column)) * scale(row);
+	}
+
+private:
+	values_type values_;
+	std::vector<float> scales_{ 1.0f };
+	quantization mode_{ quantization::per_tensor };
+};
+
+namespace matrix_detail {
+
+	template<class Q>
+	using quantized_accumulator_t = std::conditional_t<std::is_same_v<Q, std::int8_t>, std::int32_t, std::int64_t>;
+
+	// sums[r] = dot product of the first 'count' elements of 'a' and b[r], r < 4.
+	template<class Q>
+	using quantized_dot4 = void(*)(const Q* a, const Q* const* b, std::size_t count, quantized_accumulator_t<Q>* sums);
+
+	template<class Q>
+	void quantized_dot4_scalar(const Q* a, const Q* const* b, const std::size_t count, quantized_accumulator_t<Q>* sums)
+	{
+		using acc = quantized_accumulator_t<Q>;
+		acc s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		for (std::size_t k = 0; k < count; ++k) {
+			const acc ak = a[k];
+			s0 += ak * b[0][k];
+			s1 += ak * b[1][k];
+			s2 += ak * b[2][k];
+			s3 += ak * b[3][k];
+		}
+		sums[0] = s0;
+		sums[1] = s1;
+		sums[2] = s2;
+		sums[3] = s3;
+	}
+
+	template<class Q>
+	inline void quantized_dot4_tail(const Q* a, const Q* const* b, const std::size_t first, const std::size_t count,
+		quantized_accumulator_t<Q>* sums)
+	{
+		for (std::size_t k = first; k < count; ++k) {
+			for (std::size_t r = 0; r < 4; ++r) {
+				sums[r] += static_cast<quantized_accumulator_t<Q>>(a[k]) * b[r][k];
+			}
+		}
+	}
+
+#if MATRIX_X86
+	MATRIX_TARGET("avx2,fma") inline std::int32_t horizontal_sum_epi32(const __m256i v) noexcept
+	{
+		__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(sum);
+	}
+
+	// |a| * (b with the sign of a) = a * b, in unsigned x signed byte products
+	// summed in pairs (pmaddubsw) and then in fours (pmaddwd).
+	MATRIX_TARGET("avx2,fma") inline void quantized_dot4_avx2(const std::int8_t* a, const std::int8_t* const* b, const std::size_t count,
+		std::int32_t* sums)
+	{
+		const __m256i ones = _mm256_set1_epi16(1);
+		__m256i acc[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+		std::size_t k = 0;
+		for (; k + 32 <= count; k += 32) {
+			const __m256i av = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+			const __m256i a_abs = _mm256_abs_epi8(av);
+			for (std::size_t r = 0; r < 4; ++r) {
+				const __m256i bv = _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b[r] + k)), av);
+				acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(_mm256_maddubs_epi16(a_abs, bv), ones));
+			}
+		}
+		for (std::size_t r = 0; r < 4; ++r) {
+			sums[r] = horizontal_sum_epi32(acc[r]);
+		}
+		quantized_dot4_tail(a, b, k, count, sums);
+	}
+
+	// Pairs of int16 products in int32 (pmaddwd), widened to int64 sums.
+	MATRIX_TARGET("avx2,fma") inline void quantized_dot4_avx2(const std::int16_t* a, const std::int16_t* const* b, const std::size_t count,
+		std::int64_t* sums)
+	{
+		__m256i acc[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+		std::size_t k = 0;
+		for (; k + 16 <= count; k += 16) {
+			const __m256i av = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k));
+			for (std::size_t r = 0; r < 4; ++r) {
+				const __m256i pairs = _mm256_madd_epi16(av, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b[r] + k)));
+				acc[r] = _mm256_add_epi64(acc[r], _mm256_cvtepi32_epi64(_mm256_castsi256_si128(pairs)));
+				acc[r] = _mm256_add_epi64(acc[r], _mm256_cvtepi32_epi64(_mm256_extracti128_si256(pairs, 1)));
+			}
+		}
+		for (std::size_t r = 0; r < 4; ++r) {
+			alignas(32) std::int64_t lanes[4];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc[r]);
+			sums[r] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		}
+		quantized_dot4_tail(a, b, k, count, sums);
+	}
+
+	// Unsigned x signed byte products summed in fours (vpdpbusd), with the sign
+	// of a moved to b as in the AVX2 kernel.
+	MATRIX_TARGET("avx2,fma,avx512f,avx512bw,avx512vnni") inline void quantized_dot4_vnni(const std::int8_t* a, const std::int8_t* const* b,
+		const std::size_t count, std::int32_t* sums)
+	{
+		const __m512i zero = _mm512_setzero_si512();
+		__m512i acc[4] = { zero, zero, zero, zero };
+		std::size_t k = 0;
+		for (; k + 64 <= count; k += 64) {
+			const __m512i av = _mm512_loadu_si512(a + k);
+			const __m512i a_abs = _mm512_abs_epi8(av);
+			const __mmask64 negative = _mm512_movepi8_mask(av);
+			for (std::size_t r = 0; r < 4; ++r) {
+				const __m512i bv = _mm512_loadu_si512(b[r] + k);
+				acc[r] = _mm512_dpbusd_epi32(acc[r], a_abs, _mm512_mask_sub_epi8(bv, negative, zero, bv));
+			}
+		}
+		// Added as two 256-bit halves. The zero-masked extracts avoid the undefined
+		// registers in GCC's _mm512_reduce_add_epi32 and _mm512_castsi512_si256,
+		// which warn -Wmaybe-uninitialized.
+		for (std::size_t r = 0; r < 4; ++r) {
+			const __m256i low = _mm512_maskz_extracti64x4_epi64(0xff, acc[r], 0);
+			const __m256i high = _mm512_maskz_extracti64x4_epi64(0xff, acc[r], 1);
+			sums[r] = horizontal_sum_epi32(_mm256_add_epi32(low, high));
+		}
+		quantized_dot4_tail(a, b, k, count, sums);
+	}
+#endif // MATRIX_X86
+
+	template<class Q>
+	inline quantized_dot4<Q> select_quantized_dot4() noexcept
+	{
+#if MATRIX_X86
+		if constexpr (std::is_same_v<Q, std::int8_t>) {
+			if (has_avx512_vnni()) return &quantized_dot4_vnni;
+		}
+		if (active_simd_level() >= simd_level::avx2) {
+			return static_cast<quantized_dot4<Q>>(&quantized_dot4_avx2);
+		}
+#endif
+		return &quantized_dot4_scalar<Q>;
+	}
+
+	// Longest dot product whose sum of max_value^2 terms fits the accumulator:
+	// 133144 for int8, far more than memory for int16.
+	template<class Q>
+	constexpr std::size_t max_quantized_dot_length = static_cast<std::size_t>(
+		std::numeric_limits<quantized_accumulator_t<Q>>::max()
+		/ (quantized_accumulator_t<Q>{ quantized_matrix<Q>::max_value } * quantized_matrix<Q>::max_value));
+
+	template<class Q, class MC>
+	inline void check_quantized_multiplication(const quantized_matrix<Q>& a, const quantized_matrix<Q>& b_transposed, const MC& c)
+	{
+		if (a.count_columns() != b_transposed.count_columns() || c.count_rows() != a.count_rows()
+			|| c.count_columns() != b_transposed.count_rows()) {
+			throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+		}
+		if (a.count_columns() > max_quantized_dot_length<Q>) {
+			throw std::invalid_argument{ "Quantized dot products too long for the accumulator" };
+		}
+	}
+
+} // namespace matrix_detail
+
+// Quantizes the elements of any container, symmetrically: scale = max |x| / max_value
+// over each row or over the whole matrix, values rounded to nearest. Throws
+// std::invalid_argument for NaN, infinite elements or elements beyond the float range.
+template<class Q, class M>
+quantized_matrix<Q> quantize(const M& m, const quantization mode = quantization::per_row)
+{
+	using values_type = typename quantized_matrix<Q>::values_type;
+	constexpr float max_value = quantized_matrix<Q>::max_value;
+	const std::size_t rows = m.count_rows();
+	const std::size_t columns = m.count_columns();
+
+	std::vector<float> max_abs(rows, 0.0f);
+	for (std::size_t i = 0; i < rows; ++i) {
+		const auto& row = m[i];
+		for (std::size_t j = 0; j < columns; ++j) {
+			const float x = static_cast<float>(row[j]);
+			if (!std::isfinite(x)) {
+				throw std::invalid_argument{ "Quantized elements must be finite floats" };
+			}
+			max_abs[i] = std::max(max_abs[i], std::abs(x));
+		}
+	}
+	if (mode == quantization::per_tensor) {
+		max_abs.assign(1, rows == 0 ? 0.0f : *std::max_element(max_abs.cbegin(), max_abs.cend()));
+	}
+
+	std::vector<float> scales(max_abs.size());
+	std::transform(max_abs.cbegin(), max_abs.cend(), scales.begin(), [max_value](const float x) { return x / max_value; });
+
+	values_type values(rows, columns);
+	for (std::size_t i = 0; i < rows; ++i) {
+		const float scale = scales[mode == quantization::per_row ? i : 0];
+		// In double, 1 / scale of a denormal scale overflows a float.
+		const double inverse_scale = (scale > 0.0f) ? 1.0 / scale : 0.0;
+		const auto& row = m[i];
+		Q* dst = values[i];
+		for (std::size_t j = 0; j < columns; ++j) {
+			const double q = std::nearbyint(static_cast<float>(row[j]) * inverse_scale);
+			dst[j] = static_cast<Q>(std::clamp<double>(q, -max_value, max_value));
+		}
+	}
+	return quantized_matrix<Q>(std::move(values), std::move(scales));
+}
+
+// out(i, j) = q(i, j), 'out' must have the size of 'q'.
+template<class Q, class M>
+void dequantize(const quantized_matrix<Q>& q, M& out)
+{
+	if (out.count_rows() != q.count_rows() || out.count_columns() != q.count_columns()) {
+		throw std::invalid_argument{ "Matrix sizes do not match" };
+	}
+	using T = std::decay_t<decltype(out[0][0])>;
+	for (std::size_t i = 0; i < q.count_rows(); ++i) {
+		const float scale = q.scale(i);
+		const Q* src = q[i];
+		auto&& dst = out[i];
+		for (std::size_t j = 0; j < q.count_columns(); ++j) {
+			dst[j] = static_cast<T>(static_cast<float>(src[j]) * scale);
+		}
+	}
+}
+
+template<class Q>
+matrix<float> dequantize(const quantized_matrix<Q>& q)
+{
+	matrix<float> result(q.count_rows(), q.count_columns());
+	dequantize(q, result);
+	return result;
+}
+
+// c = a * transpose(b), see above. 'c' is any container of floating-point elements.
+template<class ExecutionPolicy, class Q, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_transposed(const ExecutionPolicy& policy, const quantized_matrix<Q>& a, const quantized_matrix<Q>& b, MC& c)
+{
+	matrix_detail::check_quantized_multiplication(a, b, c);
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::quantized_multiply };
+
+	using T = std::decay_t<decltype(c[0][0])>;
+	const std::size_t m = a.count_rows();
+	const std::size_t n = b.count_rows();
+	const std::size_t k = a.count_columns();
+	const auto dot4 = matrix_detail::select_quantized_dot4<Q>();
+
+	// Rows of b are taken in blocks that stay in L2 while all the rows of a go past them.
+	const std::size_t block_rows = std::max<std::size_t>(4, cpu_cache_sizes().l2 / 2 / std::max<std::size_t>(k * sizeof(Q), 1) / 4 * 4);
+
+	for (std::size_t block = 0; block < n; block += block_rows) {
+		const std::size_t last_row = std::min(n, block + block_rows);
+		matrix_execution::for_each_tile(policy, 0, m, matrix_execution::row_grain((last_row - block) * k),
+			[&](const std::size_t first, const std::size_t last) {
+				matrix_detail::quantized_accumulator_t<Q> sums[4];
+				for (std::size_t i = first; i < last; ++i) {
+					const Q* a_row = a[i];
+					const float a_scale = a.scale(i);
+					auto&& c_row = c[i];
+					for (std::size_t j = block; j < last_row; j += 4) {
+						// The last group repeats its last row instead of reading past b.
+						const std::size_t count = std::min<std::size_t>(4, last_row - j);
+						const Q* b_rows[4] = { b[j], b[j + std::min<std::size_t>(1, count - 1)],
+							b[j + std::min<std::size_t>(2, count - 1)], b[j + std::min<std::size_t>(3, count - 1)] };
+						dot4(a_row, b_rows, k, sums);
+						for (std::size_t r = 0; r < count; ++r) {
+							c_row[j + r] = static_cast<T>(static_cast<float>(sums[r]) * (a_scale * b.scale(j + r)));
+						}
+					}
+				}
+			});
+	}
+}
+
+template<class Q, class MC>
+void multiply_transposed(const quantized_matrix<Q>& a, const quantized_matrix<Q>& b, MC& c)
+{
+	multiply_transposed(matrix_execution::seq, a, b, c);
+}
+
+// c = a * b. The columns of 'b' are combined from all its rows, so 'b' needs a
+// per-tensor scale (std::invalid_argument otherwise).
+template<class ExecutionPolicy, class Q, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply(const ExecutionPolicy& policy, const quantized_matrix<Q>& a, const quantized_matrix<Q>& b, MC& c)
+{
+	if (b.mode() != quantization::per_tensor) {
+		throw std::invalid_argument{ "Right operand of a quantized product needs a per-tensor scale" };
+	}
+	const quantized_matrix<Q> b_transposed(transpose(b.values()), b.scales());
+	multiply_transposed(policy, a, b_transposed, c);
+}
+
+template<class Q, class MC>
+void multiply(const quantized_matrix<Q>& a, const quantized_matrix<Q>& b, MC& c)
+{
+	multiply(matrix_execution::seq, a, b, c);
+}
+
+#endif // !MATRIX_QUANTIZED_HPP
@@ -0,0 +1,792 @@
+#pragma once
+
+#ifndef MATRIX_REDUCTIONS_HPP
+#define MATRIX_REDUCTIONS_HPP
+
+#include "elementwise.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Reductions over matrix, fixed_matrix, views or any type providing
+// count_rows(), count_columns() and operator[] to rows:
+//
+//   sum, dot                 all elements, pairwise or compensated (Kahan) sums
+//   min_value, max_value     smallest and largest element
+//   argmin, argmax           (row, column) of the first smallest/largest element
+//   norm_frobenius, norm_l1, norm_inf
+//   row_reduce, row_sums     one value per row
+//   col_reduce, col_sums     one value per column
+//
+// Rows are reduced with several independent partial results ("lanes") so that
+// the loops vectorize, with a copy of the kernels for each instruction set (see
+// active_simd_level()). The operations passed to row_reduce/col_reduce must then
+// be associative and commutative. Work is split into tiles of whole rows, the
+// results of the tiles are combined pairwise. Column reductions walk the rows
+// in panels of columns which fit in L1, not down the columns.
+//
+// Accuracy: summation::pairwise adds each lane over at most 16 elements and the
+// partial sums in a binary tree, the error grows as O(log n) rather than O(n)
+// for a running sum. summation::kahan compensates the rounding of every lane,
+// the error no longer depends on n; it takes four times the arithmetic, which
+// memory bandwidth hides for large matrices, and like any compensated sum is
+// undone by -ffast-math. The min/max reductions of a matrix
+// with NaNs are unspecified.
+//
+// Sums of integers (sum, dot, row_sums, col_sums) are accumulated and returned
+// as std::int64_t, or std::uint64_t for unsigned elements.
+
+enum class summation { pairwise, kahan };
+
+namespace matrix_detail {
+
+	template<class M>
+	using element_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<const M&>()[0][0])>>;
+
+	// Type of the sums: integers are added in 64 bits, elements of 8 or 16 bits
+	// (quantized matrices) would overflow their own type after a few hundred.
+	template<class T>
+	using sum_type_t = std::conditional_t<std::is_integral_v<T>,
+		std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>, T>;
+
+	template<class M>
+	using sum_t = sum_type_t<element_t<M>>;
+
+	template<class M>
+	constexpr bool has_pointer_rows_v = std::is_pointer_v<std::decay_t<decltype(std::declval<const M&>()[0])>>;
+
+	// Rows as pointers: directly for matrix and views, through a copy for types
+	// whose rows are proxies (transposed views, ...).
+	template<class M>
+	struct row_reader
+	{
+		using value_type = element_t<M>;
+
+		explicit row_reader(const M& m) : m_{ m }
+		{
+			if constexpr (!has_pointer_rows_v<M>) {
+				buffer_.resize(m.count_columns());
+			}
+		}
+
+		inline const value_type* operator()(const std::size_t row)
+		{
+			if constexpr (has_pointer_rows_v<M>) {
+				return m_[row];
+			}
+			else {
+				const auto& src = m_[row];
+				for (std::size_t column = 0; column < buffer_.size(); ++column) {
+					buffer_[column] = src[column];
+				}
+				return buffer_.data();
+			}
+		}
+
+	private:
+		const M& m_;
+		std::vector<value_type> buffer_;
+	};
+
+	constexpr std::size_t max_reduction_lanes = 64;
+
+	template<class T>
+	constexpr std::size_t reduction_lanes(const std::size_t bytes) noexcept
+	{
+		if constexpr (std::is_arithmetic_v<T>) {
+			return std::min(max_reduction_lanes, std::max<std::size_t>(1, bytes / sizeof(T)));
+		}
+		else {
+			return 1;
+		}
+	}
+
+	template<std::size_t Lanes, class T, class Op>
+	MATRIX_FORCE_INLINE T combine_lanes(T* lanes, Op op)
+	{
+		for (std::size_t width = Lanes / 2; width != 0; width /= 2) {
+			for (std::size_t j = 0; j < width; ++j) lanes[j] = op(lanes[j], lanes[j + width]);
+		}
+		return lanes[0];
+	}
+
+	// Pairwise sum: the lanes add up to 16 elements each, their sum makes a block
+	// and the blocks are added in a binary tree, level k holding the sum of 2^k
+	// blocks while bit k of the count is set, as in the carries of a binary
+	// counter. The lanes carry over from one row to the next.
+	template<class T>
+	struct pairwise_sum
+	{
+		static constexpr std::size_t block_rounds = 16;
+
+		inline void add_block(T value)
+		{
+			std::size_t level = 0;
+			for (; (blocks_ >> level) & 1u; ++level) {
+				value = levels_[level] + value;
+			}
+			levels_[level] = value;
+			++blocks_;
+		}
+
+		template<std::size_t Lanes>
+		inline void end_block()
+		{
+			add_block(combine_lanes<Lanes>(lanes, [](const T a, const T b) { return a + b; }));
+			std::fill_n(lanes, Lanes, T{});
+			rounds = 0;
+		}
+
+		inline T result() const
+		{
+			pairwise_sum rest = *this;
+			rest.template end_block<max_reduction_lanes>();
+			T total{};
+			for (std::size_t level = 0; level < 64; ++level) {
+				if ((rest.blocks_ >> level) & 1u) total = rest.levels_[level] + total;
+			}
+			return total;
+		}
+
+		T lanes[max_reduction_lanes]{};
+		std::size_t rounds{ 0 };
+
+	private:
+		T levels_[64]{};
+		std::uint64_t blocks_{ 0 };
+	};
+
+	// Kahan summation in each lane; the lanes and the sums of other tiles are
+	// added with Neumaier's variant, also exact for an addend larger than the sum.
+	template<class T>
+	struct compensated_sum
+	{
+		inline void add(const T value)
+		{
+			if constexpr (std::is_floating_point_v<T>) {
+				const T total = sum_ + value;
+				if (std::abs(sum_) >= std::abs(value)) {
+					compensation_ += (sum_ - total) + value;
+				}
+				else {
+					compensation_ += (value - total) + sum_;
+				}
+				sum_ = total;
+			}
+			else {
+				sum_ += value;
+			}
+		}
+
+		inline void merge(const compensated_sum& other)
+		{
+			add(other.result());
+		}
+
+		inline T result() const
+		{
+			compensated_sum rest = *this;
+			for (std::size_t j = 0; j < max_reduction_lanes; ++j) {
+				rest.add(lanes[j]);
+				rest.add(-compensations[j]);
+			}
+			return rest.sum_ + rest.compensation_;
+		}
+
+		T lanes[max_reduction_lanes]{};
+		T compensations[max_reduction_lanes]{};
+
+	private:
+		T sum_{};
+		T compensation_{};
+	};
+
+	// total += f(0) + ... + f(count - 1); the tail shorter than the lanes goes to
+	// the first lanes as one more round.
+	template<std::size_t Lanes, class T, class F>
+	MATRIX_FORCE_INLINE void sum_lanes(const std::size_t count, F f, pairwise_sum<T>& total)
+	{
+		std::size_t i = 0;
+		while (i < count) {
+			const std::size_t rounds = std::min(pairwise_sum<T>::block_rounds - total.rounds, (count - i) / Lanes);
+			if (rounds == 0) {
+				for (std::size_t j = 0; i + j < count; ++j) total.lanes[j] += f(i + j);
+				i = count;
+				++total.rounds;
+			}
+			else {
+				T lanes[Lanes];
+				MATRIX_UNROLL
+				for (std::size_t j = 0; j < Lanes; ++j) lanes[j] = total.lanes[j];
+				for (const std::size_t end = i + rounds * Lanes; i < end; i += Lanes) {
+					MATRIX_UNROLL
+					for (std::size_t j = 0; j < Lanes; ++j) lanes[j] += f(i + j);
+				}
+				MATRIX_UNROLL
+				for (std::size_t j = 0; j < Lanes; ++j) total.lanes[j] = lanes[j];
+				total.rounds += rounds;
+			}
+			if (total.rounds >= pairwise_sum<T>::block_rounds) {
+				total.template end_block<Lanes>();
+			}
+		}
+	}
+
+	template<std::size_t Lanes, class T, class F>
+	MATRIX_FORCE_INLINE void kahan_lanes(const std::size_t count, F f, compensated_sum<T>& total)
+	{
+		T sum[Lanes];
+		T compensation[Lanes];
+		MATRIX_UNROLL
+		for (std::size_t j = 0; j < Lanes; ++j) {
+			sum[j] = total.lanes[j];
+			compensation[j] = total.compensations[j];
+		}
+		const auto add = [&](const std::size_t j, const T value) {
+			const T y = value - compensation[j];
+			const T t = sum[j] + y;
+			compensation[j] = (t - sum[j]) - y;
+			sum[j] = t;
+		};
+		std::size_t i = 0;
+		for (; count - i >= Lanes; i += Lanes) {
+			MATRIX_UNROLL
+			for (std::size_t j = 0; j < Lanes; ++j) add(j, f(i + j));
+		}
+		for (std::size_t j = 0; i + j < count; ++j) add(j, f(i + j));
+		MATRIX_UNROLL
+		for (std::size_t j = 0; j < Lanes; ++j) {
+			total.lanes[j] = sum[j];
+			total.compensations[j] = compensation[j];
+		}
+	}
+
+	// op(...op(f(0), f(1))..., f(count - 1)) in lanes, count > 0.
+	template<std::size_t Lanes, class T, class F, class Op>
+	MATRIX_FORCE_INLINE T fold_lanes(const std::size_t count, F f, Op op)
+	{
+		// Every index read is below i + Lanes <= count or below count.
+		std::size_t i = Lanes;
+		T result;
+		if (i <= count) {
+			T lanes[Lanes];
+			MATRIX_UNROLL
+			for (std::size_t j = 0; j < Lanes; ++j) lanes[j] = f(j);
+			for (; i + Lanes <= count; i += Lanes) {
+				MATRIX_UNROLL
+				for (std::size_t j = 0; j < Lanes; ++j) lanes[j] = op(lanes[j], f(i + j));
+			}
+			result = combine_lanes<Lanes>(lanes, op);
+		}
+		else {
+			result = f(0);
+			i = 1;
+		}
+		for (; i < count; ++i) result = op(result, f(i));
+		return result;
+	}
+
+	// out[j] = op(out[j], f(j)) for j < count.
+	template<class T, class F, class Op>
+	MATRIX_FORCE_INLINE void apply_elements(const std::size_t count, T* out, F f, Op op)
+	{
+		for (std::size_t j = 0; j < count; ++j) out[j] = op(out[j], f(j));
+	}
+
+	// The kernels above compiled for one instruction set, with 'bytes' of lanes:
+	// four registers.
+#define MATRIX_REDUCTION_KERNELS(name, target, bytes)                                                       \
+	struct name                                                                                             \
+	{                                                                                                       \
+		template<class T, class F>                                                                          \
+		target static void sum(const std::size_t count, F f, pairwise_sum<T>& total)                        \
+		{                                                                                                   \
+			sum_lanes<reduction_lanes<T>(bytes)>(count, f, total);                                          \
+		}                                                                                                   \
+		template<class T, class F>                                                                          \
+		target static void sum(const std::size_t count, F f, compensated_sum<T>& total)                     \
+		{                                                                                                   \
+			kahan_lanes<reduction_lanes<T>(bytes)>(count, f, total);                                        \
+		}                                                                                                   \
+		template<class T, class F, class Op>                                                                \
+		target static T fold(const std::size_t count, F f, Op op)                                           \
+		{                                                                                                   \
+			return fold_lanes<reduction_lanes<T>(bytes), T>(count, f, op);                                  \
+		}                                                                                                   \
+		template<class T, class F, class Op>                                                                \
+		target static void apply(const std::size_t count, T* out, F f, Op op)                               \
+		{                                                                                                   \
+			apply_elements(count, out, f, op);                                                              \
+		}                                                                                                   \
+	};
+
+	MATRIX_REDUCTION_KERNELS(reduction_kernels_generic, , 64)
+#if MATRIX_X86
+	MATRIX_REDUCTION_KERNELS(reduction_kernels_avx2, MATRIX_TARGET("avx2"), 128)
+	MATRIX_REDUCTION_KERNELS(reduction_kernels_avx512, MATRIX_TARGET("avx512f"), 256)
+#endif
+
+#undef MATRIX_REDUCTION_KERNELS
+
+	// Calls v(kernels) with the kernels of the active instruction set.
+	template<class Visitor>
+	inline decltype(auto) with_reduction_kernels(Visitor&& v)
+	{
+#if MATRIX_X86
+		switch (active_simd_level()) {
+		case simd_level::avx512: return v(reduction_kernels_avx512{});
+		case simd_level::avx2: return v(reduction_kernels_avx2{});
+		default: break;
+		}
+#endif
+		return v(reduction_kernels_generic{});
+	}
+
+	// Combines neighbouring results, then neighbouring pairs, ... 'partial' is not empty.
+	template<class R, class Op>
+	R combine_tree(std::vector<R>& partial, Op op)
+	{
+		for (std::size_t width = 1; width < partial.size(); width *= 2) {
+			for (std::size_t i = 0; i + width < partial.size(); i += 2 * width) {
+				partial[i] = op(std::move(partial[i]), std::move(partial[i + width]));
+			}
+		}
+		return std::move(partial[0]);
+	}
+
+	template<class T>
+	struct identity_element
+	{
+		inline T operator()(const T x) const noexcept { return x; }
+	};
+
+	template<class T>
+	struct absolute_element
+	{
+		inline T operator()(const T x) const noexcept { return std::abs(x); }
+	};
+
+	template<class T>
+	struct squared_element
+	{
+		inline T operator()(const T x) const noexcept { return x * x; }
+	};
+
+	// Sum of g(a(i, j)) * g(b(i, j)), or of g(a(i, j)) when b is null.
+	template<class ExecutionPolicy, class MA, class MB, class G>
+	sum_t<MA> sum_elements(const ExecutionPolicy& policy, const MA& a, const MB* b, const summation method, G g)
+	{
+		using E = element_t<MA>;
+		using T = sum_t<MA>;
+		const std::size_t rows = a.count_rows();
+		const std::size_t columns = a.count_columns();
+		if (rows == 0 || columns == 0) return T{};
+
+		const auto sum_rows = [&](auto& total, const std::size_t first, const std::size_t last) {
+			row_reader<MA> a_rows(a);
+			with_reduction_kernels([&](auto kernels) {
+				using kernels_type = decltype(kernels);
+				if (b == nullptr) {
+					for (std::size_t row = first; row < last; ++row) {
+						const E* p = a_rows(row);
+						kernels_type::sum(columns, [p, &g](const std::size_t i) { return g(p[i]); }, total);
+					}
+				}
+				else {
+					row_reader<MB> b_rows(*b);
+					for (std::size_t row = first; row < last; ++row) {
+						const E* p = a_rows(row);
+						const E* q = b_rows(row);
+						kernels_type::sum(columns, [p, q, &g](const std::size_t i) { return g(p[i]) * g(q[i]); }, total);
+					}
+				}
+			});
+		};
+
+		if (method == summation::kahan) {
+			auto partial = reduce_row_tiles<compensated_sum<T>>(policy, rows, columns, [&](const std::size_t first, const std::size_t last) {
+				compensated_sum<T> total;
+				sum_rows(total, first, last);
+				return total;
+			});
+			return combine_tree(partial, [](compensated_sum<T> x, const compensated_sum<T>& y) { x.merge(y); return x; }).result();
+		}
+		std::vector<T> partial;
+		for (const auto& tile : reduce_row_tiles<pairwise_sum<T>>(policy, rows, columns, [&](const std::size_t first, const std::size_t last) {
+				pairwise_sum<T> total;
+				sum_rows(total, first, last);
+				return total;
+			})) {
+			partial.push_back(tile.result());
+		}
+		return combine_tree(partial, [](const T x, const T y) { return x + y; });
+	}
+
+	// op(...op(a(0, 0), a(0, 1))...) over all elements, with the row of the result
+	// of each tile to find argmin/argmax.
+	template<class ExecutionPolicy, class M, class Op>
+	std::pair<element_t<M>, std::size_t> fold_elements(const ExecutionPolicy& policy, const M& m, Op op)
+	{
+		using T = element_t<M>;
+		const std::size_t rows = m.count_rows();
+		const std::size_t columns = m.count_columns();
+		if (rows == 0 || columns == 0) {
+			throw std::invalid_argument{ "Reduction of an empty matrix" };
+		}
+
+		auto partial = reduce_row_tiles<std::pair<T, std::size_t>>(policy, rows, columns, [&](const std::size_t first, const std::size_t last) {
+			row_reader<M> reader(m);
+			return with_reduction_kernels([&](auto kernels) {
+				// Read again rather than captured, so that a constant row length
+				// (fixed_matrix) is seen inside the kernel.
+				const std::size_t count = m.count_columns();
+				std::pair<T, std::size_t> result{};
+				for (std::size_t row = first; row < last; ++row) {
+					const T* p = reader(row);
+					const T value = decltype(kernels)::template fold<T>(count, [p](const std::size_t i) { return p[i]; }, op);
+					// A later row only wins if op picks its value, so ties keep the first row.
+					if (row == first || op(result.first, value) != result.first) {
+						result = { value, row };
+					}
+				}
+				return result;
+			});
+		});
+		return combine_tree(partial, [&op](const std::pair<T, std::size_t>& x, const std::pair<T, std::size_t>& y) {
+			return (op(x.first, y.first) != x.first) ? y : x;
+		});
+	}
+
+	template<class M>
+	std::pair<std::size_t, std::size_t> position_of_fold(const M& m, const std::pair<element_t<M>, std::size_t>& folded)
+	{
+		row_reader<M> reader(m);
+		const auto* p = reader(folded.second);
+		const auto* found = std::find(p, p + m.count_columns(), folded.first);
+		return { folded.second, (found == p + m.count_columns()) ? 0 : static_cast<std::size_t>(found - p) };
+	}
+
+	template<class T>
+	struct min_element_op
+	{
+		inline T operator()(const T a, const T b) const noexcept { return b < a ? b : a; }
+	};
+
+	template<class T>
+	struct max_element_op
+	{
+		inline T operator()(const T a, const T b) const noexcept { return a < b ? b : a; }
+	};
+
+	// Per row: op(init, fold of g(a(row, j))) or the pairwise sum of g(a(row, j)).
+	template<class ExecutionPolicy, class M, class T, class G, class Op>
+	std::vector<T> reduce_each_row(const ExecutionPolicy& policy, const M& m, const T& init, G g, Op op, const bool sum)
+	{
+		const std::size_t rows = m.count_rows();
+		const std::size_t columns = m.count_columns();
+		std::vector<T> result(rows, init);
+		if (columns == 0) return result;
+
+		matrix_execution::for_each_tile(policy, 0, rows, matrix_execution::row_grain(columns), [&](const std::size_t first, const std::size_t last) {
+			row_reader<M> reader(m);
+			with_reduction_kernels([&](auto kernels) {
+				using kernels_type = decltype(kernels);
+				for (std::size_t row = first; row < last; ++row) {
+					const element_t<M>* p = reader(row);
+					const auto f = [p, &g](const std::size_t i) { return g(p[i]); };
+					if (sum) {
+						pairwise_sum<T> total;
+						kernels_type::sum(columns, f, total);
+						result[row] = total.result();
+					}
+					else {
+						result[row] = op(init, kernels_type::template fold<T>(columns, f, op));
+					}
+				}
+			});
+		});
+		return result;
+	}
+
+	// Per column, rows [first, last) of a panel of 'width' columns from 'column':
+	// a fold with op, or pairwise sums of blocks of 16 rows.
+	template<class M, class T, class G, class Op>
+	void reduce_panel(row_reader<M>& reader, const std::size_t first, const std::size_t last, const std::size_t column,
+		const std::size_t width, T* out, G g, Op op, const bool sum, std::vector<T>& levels)
+	{
+		with_reduction_kernels([&](auto kernels) {
+			using kernels_type = decltype(kernels);
+			const auto load = [&](const std::size_t row, T* dst) {
+				const auto* p = reader(row) + column;
+				for (std::size_t j = 0; j < width; ++j) dst[j] = g(p[j]);
+			};
+			const auto accumulate = [&](const std::size_t row, T* dst) {
+				const auto* p = reader(row) + column;
+				kernels_type::apply(width, dst, [p, &g](const std::size_t j) { return g(p[j]); }, op);
+			};
+			if (!sum) {
+				load(first, out);
+				for (std::size_t row = first + 1; row < last; ++row) accumulate(row, out);
+				return;
+			}
+
+			const auto plus = [](const T a, const T b) { return a + b; };
+			std::uint64_t count = 0;
+			for (std::size_t block = first; block < last; block += 16) {
+				load(block, out);
+				for (std::size_t row = block + 1; row < std::min(last, block + 16); ++row) accumulate(row, out);
+				std::size_t level = 0;
+				for (; (count >> level) & 1u; ++level) {
+					kernels_type::apply(width, out, [&levels, level, width](const std::size_t j) { return levels[level * width + j]; }, plus);
+				}
+				if (levels.size() < (level + 1) * width) levels.resize((level + 1) * width);
+				std::copy_n(out, width, levels.data() + level * width);
+				++count;
+			}
+			std::fill_n(out, width, T{});
+			for (std::size_t level = 0; level < 64; ++level) {
+				if ((count >> level) & 1u) {
+					kernels_type::apply(width, out, [&levels, level, width](const std::size_t j) { return levels[level * width + j]; }, plus);
+				}
+			}
+		});
+	}
+
+	template<class ExecutionPolicy, class M, class T, class G, class Op>
+	std::vector<T> reduce_each_column(const ExecutionPolicy& policy, const M& m, const T& init, G g, Op op, const bool sum)
+	{
+		const std::size_t rows = m.count_rows();
+		const std::size_t columns = m.count_columns();
+		if (rows == 0 || columns == 0) return std::vector<T>(columns, sum ? T{} : init);
+
+		// Rows copied for proxies are read once, whole.
+		const std::size_t panel = has_pointer_rows_v<M>
+			? std::max<std::size_t>(64, cpu_cache_sizes().l1 / 2 / sizeof(T))
+			: columns;
+		auto partial = reduce_row_tiles<std::vector<T>>(policy, rows, columns, [&](const std::size_t first, const std::size_t last) {
+			row_reader<M> reader(m);
+			std::vector<T> result(columns);
+			std::vector<T> levels;
+			for (std::size_t column = 0; column < columns; column += panel) {
+				reduce_panel(reader, first, last, column, std::min(panel, columns - column), result.data() + column, g, op, sum, levels);
+			}
+			return result;
+		});
+		auto result = combine_tree(partial, [&](std::vector<T> x, const std::vector<T>& y) {
+			for (std::size_t j = 0; j < columns; ++j) x[j] = sum ? x[j] + y[j] : op(x[j], y[j]);
+			return x;
+		});
+		if (!sum) {
+			for (auto& value : result) value = op(init, value);
+		}
+		return result;
+	}
+
+} // namespace matrix_detail
+
+// Sum of all elements, 0 for an empty matrix.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::sum_t<M> sum(const ExecutionPolicy& policy, const M& m, const summation method = summation::pairwise)
+{
+	using T = matrix_detail::sum_t<M>;
+	return matrix_detail::sum_elements(policy, m, static_cast<const M*>(nullptr), method, matrix_detail::identity_element<T>{});
+}
+
+template<class M, class = std::enable_if_t<!matrix_execution::is_execution_policy_v<M>>>
+matrix_detail::sum_t<M> sum(const M& m, const summation method = summation::pairwise)
+{
+	return sum(matrix_execution::seq, m, method);
+}
+
+// Sum of a(i, j) * b(i, j), the Frobenius inner product.
+template<class ExecutionPolicy, class MA, class MB,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::sum_t<MA> dot(const ExecutionPolicy& policy, const MA& a, const MB& b, const summation method = summation::pairwise)
+{
+	static_assert(std::is_same_v<matrix_detail::element_t<MA>, matrix_detail::element_t<MB>>, "Matrices of different element types");
+	matrix_detail::check_same_size(a, b);
+	using T = matrix_detail::sum_t<MA>;
+	return matrix_detail::sum_elements(policy, a, &b, method, matrix_detail::identity_element<T>{});
+}
+
+template<class MA, class MB, class = std::enable_if_t<!matrix_execution::is_execution_policy_v<MA>>>
+matrix_detail::sum_t<MA> dot(const MA& a, const MB& b, const summation method = summation::pairwise)
+{
+	return dot(matrix_execution::seq, a, b, method);
+}
+
+// Smallest and largest elements, std::invalid_argument for an empty matrix.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::element_t<M> min_value(const ExecutionPolicy& policy, const M& m)
+{
+	return matrix_detail::fold_elements(policy, m, matrix_detail::min_element_op<matrix_detail::element_t<M>>{}).first;
+}
+
+template<class M>
+matrix_detail::element_t<M> min_value(const M& m)
+{
+	return min_value(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::element_t<M> max_value(const ExecutionPolicy& policy, const M& m)
+{
+	return matrix_detail::fold_elements(policy, m, matrix_detail::max_element_op<matrix_detail::element_t<M>>{}).first;
+}
+
+template<class M>
+matrix_detail::element_t<M> max_value(const M& m)
+{
+	return max_value(matrix_execution::seq, m);
+}
+
+// (row, column) of the first smallest/largest element in row-major order.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::pair<std::size_t, std::size_t> argmin(const ExecutionPolicy& policy, const M& m)
+{
+	const auto folded = matrix_detail::fold_elements(policy, m, matrix_detail::min_element_op<matrix_detail::element_t<M>>{});
+	return matrix_detail::position_of_fold(m, folded);
+}
+
+template<class M>
+std::pair<std::size_t, std::size_t> argmin(const M& m)
+{
+	return argmin(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::pair<std::size_t, std::size_t> argmax(const ExecutionPolicy& policy, const M& m)
+{
+	const auto folded = matrix_detail::fold_elements(policy, m, matrix_detail::max_element_op<matrix_detail::element_t<M>>{});
+	return matrix_detail::position_of_fold(m, folded);
+}
+
+template<class M>
+std::pair<std::size_t, std::size_t> argmax(const M& m)
+{
+	return argmax(matrix_execution::seq, m);
+}
+
+// sqrt of the sum of squares, without scaling: it overflows where the squares do.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::element_t<M> norm_frobenius(const ExecutionPolicy& policy, const M& m)
+{
+	using T = matrix_detail::element_t<M>;
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	using std::sqrt;
+	return sqrt(matrix_detail::sum_elements(policy, m, static_cast<const M*>(nullptr), summation::pairwise, matrix_detail::squared_element<T>{}));
+}
+
+template<class M>
+matrix_detail::element_t<M> norm_frobenius(const M& m)
+{
+	return norm_frobenius(matrix_execution::seq, m);
+}
+
+// Largest sum of the absolute values of a column.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::element_t<M> norm_l1(const ExecutionPolicy& policy, const M& m)
+{
+	using T = matrix_detail::element_t<M>;
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	const auto sums = matrix_detail::reduce_each_column(policy, m, T{}, matrix_detail::absolute_element<T>{}, std::plus<T>{}, true);
+	return sums.empty() ? T{} : *std::max_element(sums.cbegin(), sums.cend());
+}
+
+template<class M>
+matrix_detail::element_t<M> norm_l1(const M& m)
+{
+	return norm_l1(matrix_execution::seq, m);
+}
+
+// Largest sum of the absolute values of a row.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+matrix_detail::element_t<M> norm_inf(const ExecutionPolicy& policy, const M& m)
+{
+	using T = matrix_detail::element_t<M>;
+	static_assert(std::is_floating_point_v<T>, "Norms are computed for floating-point elements");
+	const auto sums = matrix_detail::reduce_each_row(policy, m, T{}, matrix_detail::absolute_element<T>{}, std::plus<T>{}, true);
+	return sums.empty() ? T{} : *std::max_element(sums.cbegin(), sums.cend());
+}
+
+template<class M>
+matrix_detail::element_t<M> norm_inf(const M& m)
+{
+	return norm_inf(matrix_execution::seq, m);
+}
+
+// result[i] = op(init, op(...op(a(i, 0), a(i, 1))...)), 'op' associative and commutative.
+template<class ExecutionPolicy, class M, class T, class BinaryOp,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<T> row_reduce(const ExecutionPolicy& policy, const M& m, const T& init, BinaryOp op)
+{
+	return matrix_detail::reduce_each_row(policy, m, init, matrix_detail::identity_element<T>{}, op, false);
+}
+
+template<class M, class T, class BinaryOp, class = std::enable_if_t<!matrix_execution::is_execution_policy_v<M>>>
+std::vector<T> row_reduce(const M& m, const T& init, BinaryOp op)
+{
+	return row_reduce(matrix_execution::seq, m, init, op);
+}
+
+// result[j] = op(init, op(...op(a(0, j), a(1, j))...)), 'op' associative and commutative.
+template<class ExecutionPolicy, class M, class T, class BinaryOp,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<T> col_reduce(const ExecutionPolicy& policy, const M& m, const T& init, BinaryOp op)
+{
+	return matrix_detail::reduce_each_column(policy, m, init, matrix_detail::identity_element<T>{}, op, false);
+}
+
+template<class M, class T, class BinaryOp, class = std::enable_if_t<!matrix_execution::is_execution_policy_v<M>>>
+std::vector<T> col_reduce(const M& m, const T& init, BinaryOp op)
+{
+	return col_reduce(matrix_execution::seq, m, init, op);
+}
+
+// Pairwise sums of each row and of each column.
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<matrix_detail::sum_t<M>> row_sums(const ExecutionPolicy& policy, const M& m)
+{
+	using T = matrix_detail::sum_t<M>;
+	return matrix_detail::reduce_each_row(policy, m, T{}, matrix_detail::identity_element<T>{}, std::plus<T>{}, true);
+}
+
+template<class M>
+std::vector<matrix_detail::sum_t<M>> row_sums(const M& m)
+{
+	return row_sums(matrix_execution::seq, m);
+}
+
+template<class ExecutionPolicy, class M,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+std::vector<matrix_detail::sum_t<M>> col_sums(const ExecutionPolicy& policy, const M& m)
+{
+	using T = matrix_detail::sum_t<M>;
+	return matrix_detail::reduce_each_column(policy, m, T{}, matrix_detail::identity_element<T>{}, std::plus<T>{}, true);
+}
+
+template<class M>
+std::vector<matrix_detail::sum_t<M>> col_sums(const M& m)
+{
+	return col_sums(matrix_execution::seq, m);
+}
+
+#endif // !MATRIX_REDUCTIONS_HPP
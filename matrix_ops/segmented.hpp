@@ -0,0 +1,221 @@
+#pragma once
+
+#ifndef MATRIX_SEGMENTED_HPP
+#define MATRIX_SEGMENTED_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Segmented iteration.
+//
+// The iterators of matrix walk the elements row after row, but the rows are
+// separate contiguous runs, so every step has to check for the end of a row.
+// Such an iterator is segmented: besides the usual operations it provides
+//
+//   it.segment()       identifies the run (row) 'it' is in, comparable with ==
+//   it.local()         pointer to the element 'it' refers to
+//   it.segment_end()   pointer past the last element of that run
+//   it.next_segment()  iterator to the first element of the next run
+//
+// The algorithms of matrix_segmented split a range into runs of pointers and
+// process each one with a plain loop, memset or memcpy, so they vectorize
+// where the same std algorithm over the elements wouldn't. They take any
+// iterators and forward the non-segmented ones to std.
+//
+//   matrix_segmented::fill(m.begin(), m.end(), 0.0);
+//   matrix_segmented::copy(a.begin(), a.end(), b.begin());
+
+template<class It, class = void>
+struct is_segmented_iterator : std::false_type {};
+
+template<class It>
+struct is_segmented_iterator<It, std::void_t<
+	decltype(std::declval<const It&>().segment()),
+	decltype(std::declval<const It&>().local()),
+	decltype(std::declval<const It&>().segment_end()),
+	decltype(std::declval<const It&>().next_segment())>> : std::true_type {};
+
+template<class It>
+constexpr bool is_segmented_iterator_v = is_segmented_iterator<It>::value;
+
+namespace matrix_detail {
+
+	// Runs of elements: memset/memcpy for trivially copyable types, plain loops otherwise.
+
+	template<class T>
+	inline void fill_elements(T* first, const std::size_t count, const T& value)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (count == 0) return;
+			unsigned char bytes[sizeof(T)];
+			std::memcpy(bytes, std::addressof(value), sizeof(T));
+			if (std::all_of(bytes, bytes + sizeof(T), [&bytes](const unsigned char b) { return b == bytes[0]; })) {
+				std::memset(first, bytes[0], count * sizeof(T));
+				return;
+			}
+		}
+		std::fill_n(first, count, value);
+	}
+
+	// The runs must not overlap.
+	template<class T>
+	inline void copy_elements(const T* src, const std::size_t count, T* dst)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (count != 0) {
+				std::memcpy(dst, src, count * sizeof(T));
+			}
+		}
+		else {
+			std::copy_n(src, count, dst);
+		}
+	}
+
+	template<class T>
+	inline void uninitialized_fill_elements(T* first, const std::size_t count, const T& value)
+	{
+		if constexpr (std::is_trivial_v<T>) {
+			fill_elements(first, count, value);
+		}
+		else {
+			std::uninitialized_fill_n(first, count, value);
+		}
+	}
+
+	template<class T>
+	inline void uninitialized_copy_elements(const T* src, const std::size_t count, T* dst)
+	{
+		if constexpr (std::is_trivial_v<T>) {
+			copy_elements(src, count, dst);
+		}
+		else {
+			std::uninitialized_copy_n(src, count, dst);
+		}
+	}
+
+} // namespace matrix_detail
+
+namespace matrix_segmented {
+
+	// Calls f(first_pointer, last_pointer) for each run of [first, last), in order.
+	template<class It, class F>
+	inline void for_each_segment(It first, const It last, F f)
+	{
+		static_assert(is_segmented_iterator_v<It>, "for_each_segment requires a segmented iterator");
+		while (first != last) {
+			if (first.segment() == last.segment()) {
+				const auto local = first.local();
+				f(local, local + (last - first));
+				return;
+			}
+			f(first.local(), first.segment_end());
+			first = first.next_segment();
+		}
+	}
+
+	// As for_each_segment over [first, first + count), returns first + count.
+	template<class It, class F>
+	inline It for_each_segment_n(It first, std::size_t count, F f)
+	{
+		static_assert(is_segmented_iterator_v<It>, "for_each_segment_n requires a segmented iterator");
+		while (count != 0) {
+			const auto local = first.local();
+			const auto available = static_cast<std::size_t>(first.segment_end() - local);
+			if (count < available) {
+				f(local, local + count);
+				return first + static_cast<typename std::iterator_traits<It>::difference_type>(count);
+			}
+			f(local, local + available);
+			count -= available;
+			first = first.next_segment();
+		}
+		return first;
+	}
+
+	template<class It, class T>
+	inline void fill(const It first, const It last, const T& value)
+	{
+		if constexpr (is_segmented_iterator_v<It>) {
+			using value_type = typename std::iterator_traits<It>::value_type;
+			const value_type v = value;
+			for_each_segment(first, last, [&v](value_type* begin, value_type* end) {
+				matrix_detail::fill_elements(begin, static_cast<std::size_t>(end - begin), v);
+			});
+		}
+		else {
+			std::fill(first, last, value);
+		}
+	}
+
+	// Like std::copy, the destination must not begin inside [first, last).
+	template<class InputIt, class OutputIt>
+	inline OutputIt copy(const InputIt first, const InputIt last, OutputIt out)
+	{
+		if constexpr (is_segmented_iterator_v<InputIt>) {
+			for_each_segment(first, last, [&out](const auto* begin, const auto* end) {
+				if constexpr (is_segmented_iterator_v<OutputIt>) {
+					out = for_each_segment_n(out, static_cast<std::size_t>(end - begin), [&begin](auto* dst, auto* dst_end) {
+						// Same-matrix copies may overlap with a lower destination.
+						std::copy(begin, begin + (dst_end - dst), dst);
+						begin += dst_end - dst;
+					});
+				}
+				else {
+					out = std::copy(begin, end, out);
+				}
+			});
+			return out;
+		}
+		else if constexpr (is_segmented_iterator_v<OutputIt>) {
+			auto src = first;
+			return for_each_segment_n(out, static_cast<std::size_t>(std::distance(first, last)), [&src](auto* dst, auto* dst_end) {
+				for (; dst != dst_end; ++dst, ++src) {
+					*dst = *src;
+				}
+			});
+		}
+		else {
+			return std::copy(first, last, out);
+		}
+	}
+
+	// Constructs copies of 'value' in raw storage. If a constructor throws, the
+	// elements constructed so far are destroyed.
+	template<class It, class T>
+	inline void uninitialized_fill(const It first, const It last, const T& value)
+	{
+		if constexpr (is_segmented_iterator_v<It>) {
+			using value_type = typename std::iterator_traits<It>::value_type;
+			const value_type v = value;
+			if constexpr (std::is_nothrow_copy_constructible_v<value_type>) {
+				for_each_segment(first, last, [&v](value_type* begin, value_type* end) {
+					matrix_detail::uninitialized_fill_elements(begin, static_cast<std::size_t>(end - begin), v);
+				});
+			}
+			else {
+				auto constructed = first;
+				try {
+					for_each_segment(first, last, [&v, &constructed](value_type* begin, value_type* end) {
+						std::uninitialized_fill(begin, end, v);
+						constructed += end - begin;
+					});
+				}
+				catch (...) {
+					for_each_segment(first, constructed, [](value_type* begin, value_type* end) { std::destroy(begin, end); });
+					throw;
+				}
+			}
+		}
+		else {
+			std::uninitialized_fill(first, last, value);
+		}
+	}
+
+} // namespace matrix_segmented
+
+#endif // !MATRIX_SEGMENTED_HPP
@@ -0,0 +1,298 @@
+#pragma once
+
+#ifndef MATRIX_SIMD_HPP
+#define MATRIX_SIMD_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MATRIX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define MATRIX_X86 0
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Functions using instructions above the baseline ISA are compiled with
+// MATRIX_TARGET and only called after the corresponding runtime check.
+#if defined(__GNUC__) || defined(__clang__)
+#define MATRIX_TARGET(isa) __attribute__((target(isa)))
+#define MATRIX_UNROLL _Pragma("GCC unroll 32")
+#define MATRIX_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define MATRIX_TARGET(isa)
+#define MATRIX_UNROLL
+#define MATRIX_FORCE_INLINE __forceinline
+#endif
+
+// Lets constexpr functions take a SIMD path when evaluated at runtime.
+#if defined(__GNUC__) && __GNUC__ >= 9 || defined(__clang__) && __clang_major__ >= 9 || defined(_MSC_VER) && _MSC_VER >= 1925
+#define MATRIX_HAS_CONSTANT_EVALUATED 1
+#define MATRIX_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define MATRIX_HAS_CONSTANT_EVALUATED 0
+#define MATRIX_IS_CONSTANT_EVALUATED() true
+#endif
+
+// SSE2 is part of the baseline ISA on x86-64.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATRIX_SSE2_BASELINE 1
+#else
+#define MATRIX_SSE2_BASELINE 0
+#endif
+
+enum class simd_level { scalar = 0, sse2, avx2, avx512 };
+
+namespace matrix_detail {
+
+	inline simd_level detect_simd_level() noexcept
+	{
+#if MATRIX_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4]{};
+		__cpuid(info, 0);
+		const int max_leaf = info[0];
+		__cpuid(info, 1);
+		const bool sse2 = (info[3] & (1 << 26)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool avx2 = false;
+		bool avx512 = false;
+		if (max_leaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0 && fma && (xcr0 & 0x06) == 0x06;
+			avx512 = (info[1] & (1 << 16)) != 0 && avx2 && (xcr0 & 0xE6) == 0xE6;
+		}
+		if (avx512) return simd_level::avx512;
+		if (avx2) return simd_level::avx2;
+		if (sse2) return simd_level::sse2;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return simd_level::avx512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return simd_level::avx2;
+		if (__builtin_cpu_supports("sse2"))
+			return simd_level::sse2;
+#endif
+#endif
+		return simd_level::scalar;
+	}
+
+	// Extensions used by some kernels on top of a simd_level.
+	struct simd_extensions
+	{
+		bool f16c{ false };
+		bool avx512_vnni{ false };
+	};
+
+	inline simd_extensions detect_simd_extensions() noexcept
+	{
+		simd_extensions extensions;
+#if MATRIX_X86
+		unsigned int leaf1_ecx = 0;
+		unsigned int leaf7_ecx = 0;
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4]{};
+		__cpuid(info, 0);
+		const int max_leaf = info[0];
+		__cpuid(info, 1);
+		leaf1_ecx = static_cast<unsigned int>(info[2]);
+		if (max_leaf >= 7) {
+			__cpuidex(info, 7, 0);
+			leaf7_ecx = static_cast<unsigned int>(info[2]);
+		}
+#else
+		unsigned int eax = 0, ebx = 0, edx = 0;
+		__get_cpuid(1, &eax, &ebx, &leaf1_ecx, &edx);
+		__get_cpuid_count(7, 0, &eax, &ebx, &leaf7_ecx, &edx);
+#endif
+		extensions.f16c = (leaf1_ecx & (1u << 29)) != 0;
+		extensions.avx512_vnni = (leaf7_ecx & (1u << 11)) != 0;
+#endif
+		return extensions;
+	}
+
+	inline std::atomic<simd_level>& simd_level_limit() noexcept
+	{
+		static std::atomic<simd_level> limit{ simd_level::avx512 };
+		return limit;
+	}
+
+	struct cache_sizes
+	{
+		std::size_t l1{ 32 * 1024 };
+		std::size_t l2{ 1024 * 1024 };
+		std::size_t l3{ 8 * 1024 * 1024 };
+	};
+
+	inline cache_sizes detect_cache_sizes() noexcept
+	{
+		cache_sizes sizes;
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+		const auto query = [](int name, std::size_t fallback) {
+			const long value = ::sysconf(name);
+			return (value > 0) ? static_cast<std::size_t>(value) : fallback;
+		};
+		sizes.l1 = query(_SC_LEVEL1_DCACHE_SIZE, sizes.l1);
+		sizes.l2 = query(_SC_LEVEL2_CACHE_SIZE, sizes.l2);
+		sizes.l3 = query(_SC_LEVEL3_CACHE_SIZE, sizes.l3);
+#endif
+		return sizes;
+	}
+
+	// Uninitialized buffer of trivial elements aligned to a cache line.
+	template<class T>
+	struct aligned_buffer
+	{
+		static constexpr std::size_t alignment = 64;
+
+		aligned_buffer() noexcept = default;
+		explicit aligned_buffer(const std::size_t size)
+			: data_{ static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t{ alignment })) }
+			, size_{ size }
+		{}
+		aligned_buffer(const aligned_buffer&) = delete;
+		aligned_buffer& operator=(const aligned_buffer&) = delete;
+		aligned_buffer(aligned_buffer&& other) noexcept
+			: data_{ std::exchange(other.data_, nullptr) }
+			, size_{ std::exchange(other.size_, 0) }
+		{}
+		aligned_buffer& operator=(aligned_buffer&& other) noexcept
+		{
+			if (this != &other) {
+				release();
+				data_ = std::exchange(other.data_, nullptr);
+				size_ = std::exchange(other.size_, 0);
+			}
+			return *this;
+		}
+		~aligned_buffer() { release(); }
+
+		inline void reserve(const std::size_t size)
+		{
+			if (size <= size_) return;
+			release();
+			data_ = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t{ alignment }));
+			size_ = size;
+		}
+
+		inline T* data() noexcept { return data_; }
+		inline const T* data() const noexcept { return data_; }
+		inline std::size_t size() const noexcept { return size_; }
+
+	private:
+		inline void release() noexcept
+		{
+			if (data_ != nullptr) {
+				::operator delete(data_, std::align_val_t{ alignment });
+			}
+			data_ = nullptr;
+			size_ = 0;
+		}
+
+		T* data_{ nullptr };
+		std::size_t size_{ 0 };
+	};
+
+	// Per-thread buffer reused between calls. A nested user on the same thread
+	// (e.g. a task run while waiting for other tasks) gets its own allocation.
+	template<class T>
+	struct thread_scratch
+	{
+		explicit thread_scratch(const std::size_t size)
+		{
+			auto& cached = local();
+			if (!cached.in_use) {
+				cached.buffer.reserve(size);
+				cached.in_use = true;
+				slot_ = &cached;
+				data_ = cached.buffer.data();
+			}
+			else {
+				own_.reserve(size);
+				data_ = own_.data();
+			}
+		}
+		thread_scratch(const thread_scratch&) = delete;
+		thread_scratch& operator=(const thread_scratch&) = delete;
+		~thread_scratch() 
+		{
+			if (slot_ != nullptr) slot_->in_use = false;
+		}
+
+		inline T* data() noexcept { return data_; }
+
+	private:
+		struct slot
+		{
+			aligned_buffer<T> buffer;
+			bool in_use{ false };
+		};
+
+		static slot& local()
+		{
+			static thread_local slot cached;
+			return cached;
+		}
+
+		slot* slot_{ nullptr };
+		aligned_buffer<T> own_;
+		T* data_{ nullptr };
+	};
+
+} // namespace matrix_detail
+
+// Instruction set detected on this machine.
+inline simd_level detected_simd_level() noexcept
+{
+	static const simd_level level = matrix_detail::detect_simd_level();
+	return level;
+}
+
+// Instruction set used by the kernels: the detected one, optionally lowered
+// by limit_simd_level() (e.g. to compare kernels or to get reproducible results).
+inline simd_level active_simd_level() noexcept
+{
+	return std::min(detected_simd_level(), matrix_detail::simd_level_limit().load(std::memory_order_relaxed));
+}
+
+inline void limit_simd_level(const simd_level level) noexcept
+{
+	matrix_detail::simd_level_limit().store(level, std::memory_order_relaxed);
+}
+
+// F16C conversions, used with AVX2 and above.
+inline bool has_f16c() noexcept
+{
+	static const bool detected = matrix_detail::detect_simd_extensions().f16c;
+	return detected && active_simd_level() >= simd_level::avx2;
+}
+
+// AVX-512 VNNI 8-bit dot products, used with AVX-512.
+inline bool has_avx512_vnni() noexcept
+{
+	static const bool detected = matrix_detail::detect_simd_extensions().avx512_vnni;
+	return detected && active_simd_level() >= simd_level::avx512;
+}
+
+inline const matrix_detail::cache_sizes& cpu_cache_sizes() noexcept
+{
+	static const matrix_detail::cache_sizes sizes = matrix_detail::detect_cache_sizes();
+	return sizes;
+}
+
+#endif // !MATRIX_SIMD_HPP
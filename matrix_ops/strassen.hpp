@@ -0,0 +1,335 @@
+#pragma once
+
+#ifndef MATRIX_STRASSEN_HPP
+#define MATRIX_STRASSEN_HPP
+
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include "multiply.hpp"
+#include "../matrix/matrix.hpp"
+#include "../matrix/matrix_instrumentation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+// Strassen-Winograd multiplication.
+//
+// multiply_strassen() splits the operands in 2 x 2 blocks and forms the product
+// from 7 block products and 15 block additions instead of 8 products, as long
+// as all three sides (m, k and n) are above the cutoff. A product with any side
+// at most the cutoff runs on the blocked kernels of multiply(): splitting a
+// thin side saves too few multiply-adds to pay for the additions. An odd row
+// or column is left out of the split and added by a classic product of one row
+// or column ("dynamic peeling"). The cost is about O(n^2.81) for n much larger
+// than the cutoff: each level saves 1/8 of the multiply-adds of the level below.
+//
+// With parallel_policy the 7 products of the first level run as parallel
+// tasks, each of them on a share of the threads. The temporaries of all the
+// levels are carved from a strassen_workspace, reserved once; a workspace
+// passed by the caller is reused between calls, so the product doesn't
+// allocate at all.
+//
+// Error bounds, with u the unit roundoff, n0 the cutoff and n = 2^l * n0 the
+// side of square operands (Higham, Accuracy and Stability of Numerical
+// Algorithms, 23.2):
+//
+//   classic:   |C - fl(C)| <= n u |A| |B|                      element-wise
+//   Winograd:  max|C - fl(C)| <= ((n / n0)^log2(18) (n0^2 + 6 n0) - 6 n) u max|A| max|B|
+//
+// The Winograd bound is norm-wise only: small elements of C may have large
+// relative errors when A or B have elements of very different magnitudes. The
+// exponent log2(18) ~ 4.17 makes it grow with every level, a larger cutoff
+// trades speed for accuracy. force_classic_multiply(true) makes multiply_strassen()
+// run the classic product, e.g. to reproduce the results of multiply().
+
+namespace matrix_detail {
+
+	inline std::atomic<bool>& classic_multiply_flag() noexcept
+	{
+		static std::atomic<bool> classic{ false };
+		return classic;
+	}
+
+	inline bool is_strassen_product(const std::size_t m, const std::size_t k, const std::size_t n, const std::size_t cutoff) noexcept
+	{
+		return std::min({ m, k, n }) > std::max<std::size_t>(cutoff, 1);
+	}
+
+	// Elements of the temporaries of the sequential schedule for an m x k by k x n product.
+	inline std::size_t strassen_sequential_size(const std::size_t m, const std::size_t k, const std::size_t n, const std::size_t cutoff) noexcept
+	{
+		if (!is_strassen_product(m, k, n, cutoff)) return 0;
+		const std::size_t m2 = m / 2, k2 = k / 2, n2 = n / 2;
+		return m2 * std::max(k2, n2) + k2 * n2 + strassen_sequential_size(m2, k2, n2, cutoff);
+	}
+
+	// Elements of the temporaries of the parallel first level and of the 7 tasks below it.
+	inline std::size_t strassen_parallel_size(const std::size_t m, const std::size_t k, const std::size_t n, const std::size_t cutoff) noexcept
+	{
+		if (!is_strassen_product(m, k, n, cutoff)) return 0;
+		const std::size_t m2 = m / 2, k2 = k / 2, n2 = n / 2;
+		return 4 * m2 * k2 + 4 * k2 * n2 + 3 * m2 * n2 + 7 * strassen_sequential_size(m2, k2, n2, cutoff);
+	}
+
+	template<class T>
+	inline matrix_view<T> workspace_view(T* data, const std::size_t rows, const std::size_t columns) noexcept
+	{
+		return matrix_view<T>(data, rows, columns, columns);
+	}
+
+	// out = op(x, y), 'out' may be 'x' or 'y'.
+	template<class T, class X, class Y, class Op>
+	void strassen_combine(const matrix_view<T>& out, const X& x, const Y& y, Op op)
+	{
+		const std::size_t columns = out.count_columns();
+		for (std::size_t i = 0; i < out.count_rows(); ++i) {
+			T* out_row = out[i];
+			const T* x_row = x[i];
+			const T* y_row = y[i];
+			for (std::size_t j = 0; j < columns; ++j) {
+				out_row[j] = op(x_row[j], y_row[j]);
+			}
+		}
+	}
+
+	// Adds the last column of 'a' and row of 'b' left out of the split (odd k), then
+	// computes the last column and row of 'c' left out of it (odd n and m).
+	template<class T>
+	void strassen_peel(const matrix_view<const T>& a, const matrix_view<const T>& b, const matrix_view<T>& c, const std::size_t threads)
+	{
+		const std::size_t m = a.count_rows(), k = a.count_columns(), n = b.count_columns();
+		const std::size_t me = m & ~std::size_t{ 1 }, ke = k & ~std::size_t{ 1 }, ne = n & ~std::size_t{ 1 };
+		if (ke != k) {
+			auto even = c.block(0, 0, me, ne);
+			gemm(a.block(0, ke, me, 1), b.block(ke, 0, 1, ne), even, threads, gemm_update::add);
+		}
+		if (ne != n) {
+			auto column = c.block(0, ne, me, 1);
+			gemm(a.block(0, 0, me, k), b.block(0, ne, k, 1), column, threads);
+		}
+		if (me != m) {
+			auto row = c.block(me, 0, 1, n);
+			gemm(a.block(me, 0, 1, k), b, row, threads);
+		}
+	}
+
+	// Block products in an order that needs two temporaries per level, X (m/2 x
+	// max(k/2, n/2)) and Y (k/2 x n/2), the rest of the workspace goes to the
+	// level below (Douglas et al., GEMMW: a portable level 3 BLAS Winograd variant
+	// of Strassen's matrix-matrix multiply algorithm, 1994).
+	template<class T>
+	void strassen_sequential(const matrix_view<const T>& a, const matrix_view<const T>& b, const matrix_view<T>& c,
+		T* workspace, const std::size_t cutoff, const std::size_t threads)
+	{
+		const std::size_t m = a.count_rows(), k = a.count_columns(), n = b.count_columns();
+		if (!is_strassen_product(m, k, n, cutoff)) {
+			auto result = c;
+			gemm(a, b, result, threads);
+			return;
+		}
+
+		const std::size_t m2 = m / 2, k2 = k / 2, n2 = n / 2;
+		const matrix_view<const T> a11 = a.block(0, 0, m2, k2), a12 = a.block(0, k2, m2, k2);
+		const matrix_view<const T> a21 = a.block(m2, 0, m2, k2), a22 = a.block(m2, k2, m2, k2);
+		const matrix_view<const T> b11 = b.block(0, 0, k2, n2), b12 = b.block(0, n2, k2, n2);
+		const matrix_view<const T> b21 = b.block(k2, 0, k2, n2), b22 = b.block(k2, n2, k2, n2);
+		const matrix_view<T> c11 = c.block(0, 0, m2, n2), c12 = c.block(0, n2, m2, n2);
+		const matrix_view<T> c21 = c.block(m2, 0, m2, n2), c22 = c.block(m2, n2, m2, n2);
+
+		const matrix_view<T> x = workspace_view(workspace, m2, k2);
+		const matrix_view<T> p1 = workspace_view(workspace, m2, n2);
+		const matrix_view<T> y = workspace_view(workspace + m2 * std::max(k2, n2), k2, n2);
+		T* below = workspace + m2 * std::max(k2, n2) + k2 * n2;
+		const auto product = [&](const matrix_view<const T>& lhs, const matrix_view<const T>& rhs, const matrix_view<T>& out) {
+			strassen_sequential(lhs, rhs, out, below, cutoff, threads);
+		};
+
+		strassen_combine(x, a11, a21, std::minus<>{});    // S3
+		strassen_combine(y, b22, b12, std::minus<>{});    // T3
+		product(x, y, c21);                               // P7
+		strassen_combine(x, a21, a22, std::plus<>{});     // S1
+		strassen_combine(y, b12, b11, std::minus<>{});    // T1
+		product(x, y, c22);                               // P5
+		strassen_combine(x, x, a11, std::minus<>{});      // S2 = S1 - A11
+		strassen_combine(y, b22, y, std::minus<>{});      // T2 = B22 - T1
+		product(x, y, c12);                               // P6
+		strassen_combine(x, a12, x, std::minus<>{});      // S4 = A12 - S2
+		product(x, b22, c11);                             // P3
+		product(a11, b11, p1);                            // P1
+		strassen_combine(c12, p1, c12, std::plus<>{});    // U2 = P1 + P6
+		strassen_combine(c21, c12, c21, std::plus<>{});   // U3 = U2 + P7
+		strassen_combine(c12, c12, c22, std::plus<>{});   // U4 = U2 + P5
+		strassen_combine(c22, c21, c22, std::plus<>{});   // U7 = U3 + P5
+		strassen_combine(c12, c12, c11, std::plus<>{});   // U5 = U4 + P3
+		strassen_combine(y, y, b21, std::minus<>{});      // T4 = T2 - B21
+		product(a22, y, c11);                             // P4
+		strassen_combine(c21, c21, c11, std::minus<>{});  // U6 = U3 - P4
+		product(a12, b21, c11);                           // P2
+		strassen_combine(c11, p1, c11, std::plus<>{});    // U1 = P1 + P2
+
+		strassen_peel(a, b, c, threads);
+	}
+
+	// First level with its 7 products as parallel tasks, each with its own
+	// operands and the same sums as strassen_sequential(), so the results don't
+	// depend on the number of threads.
+	template<class T>
+	void strassen_parallel(const matrix_view<const T>& a, const matrix_view<const T>& b, const matrix_view<T>& c,
+		T* workspace, const std::size_t cutoff, const std::size_t threads)
+	{
+		const std::size_t m = a.count_rows(), k = a.count_columns(), n = b.count_columns();
+		if (threads < 2 || !is_strassen_product(m, k, n, cutoff)) {
+			strassen_sequential(a, b, c, workspace, cutoff, threads);
+			return;
+		}
+
+		const std::size_t m2 = m / 2, k2 = k / 2, n2 = n / 2;
+		const matrix_view<const T> a11 = a.block(0, 0, m2, k2), a12 = a.block(0, k2, m2, k2);
+		const matrix_view<const T> a21 = a.block(m2, 0, m2, k2), a22 = a.block(m2, k2, m2, k2);
+		const matrix_view<const T> b11 = b.block(0, 0, k2, n2), b12 = b.block(0, n2, k2, n2);
+		const matrix_view<const T> b21 = b.block(k2, 0, k2, n2), b22 = b.block(k2, n2, k2, n2);
+		const matrix_view<T> c11 = c.block(0, 0, m2, n2), c12 = c.block(0, n2, m2, n2);
+		const matrix_view<T> c21 = c.block(m2, 0, m2, n2), c22 = c.block(m2, n2, m2, n2);
+
+		T* const s_data = workspace;
+		T* const t_data = s_data + 4 * m2 * k2;
+		T* const p_data = t_data + 4 * k2 * n2;
+		T* const below = p_data + 3 * m2 * n2;
+		const matrix_view<T> s[4] = { workspace_view(s_data, m2, k2), workspace_view(s_data + m2 * k2, m2, k2),
+			workspace_view(s_data + 2 * m2 * k2, m2, k2), workspace_view(s_data + 3 * m2 * k2, m2, k2) };
+		const matrix_view<T> t[4] = { workspace_view(t_data, k2, n2), workspace_view(t_data + k2 * n2, k2, n2),
+			workspace_view(t_data + 2 * k2 * n2, k2, n2), workspace_view(t_data + 3 * k2 * n2, k2, n2) };
+		const matrix_view<T> p[3] = { workspace_view(p_data, m2, n2), workspace_view(p_data + m2 * n2, m2, n2),
+			workspace_view(p_data + 2 * m2 * n2, m2, n2) };
+		const std::size_t below_size = strassen_sequential_size(m2, k2, n2, cutoff);
+
+		strassen_combine(s[0], a21, a22, std::plus<>{});   // S1
+		strassen_combine(s[1], s[0], a11, std::minus<>{}); // S2
+		strassen_combine(s[2], a11, a21, std::minus<>{});  // S3
+		strassen_combine(s[3], a12, s[1], std::minus<>{}); // S4
+		strassen_combine(t[0], b12, b11, std::minus<>{});  // T1
+		strassen_combine(t[1], b22, t[0], std::minus<>{}); // T2
+		strassen_combine(t[2], b22, b12, std::minus<>{});  // T3
+		strassen_combine(t[3], t[1], b21, std::minus<>{}); // T4
+
+		// P1 .. P7, the results of P2 .. P5 go to the blocks of C.
+		const struct { matrix_view<const T> lhs, rhs; matrix_view<T> out; } products[7] = {
+			{ a11, b11, p[0] }, { a12, b21, c11 }, { s[3], b22, c12 }, { a22, t[3], c21 },
+			{ s[0], t[0], c22 }, { s[1], t[1], p[1] }, { s[2], t[2], p[2] } };
+		const std::size_t task_threads = std::max<std::size_t>(1, threads / 7);
+		matrix_execution::for_each_tile(matrix_execution::parallel_policy{ threads }, 0, 7, 1, [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t i = first; i < last; ++i) {
+				strassen_sequential(products[i].lhs, products[i].rhs, products[i].out, below + i * below_size, cutoff, task_threads);
+			}
+		});
+
+		matrix_execution::for_each_tile(matrix_execution::parallel_policy{ threads }, 0, m2, matrix_execution::row_grain(n2),
+			[&](const std::size_t first, const std::size_t last) {
+				for (std::size_t i = first; i < last; ++i) {
+					const T* p1 = p[0][i];
+					const T* p6 = p[1][i];
+					const T* p7 = p[2][i];
+					T* r11 = c11[i];
+					T* r12 = c12[i];
+					T* r21 = c21[i];
+					T* r22 = c22[i];
+					for (std::size_t j = 0; j < n2; ++j) {
+						const T u2 = p1[j] + p6[j];
+						const T u3 = u2 + p7[j];
+						r12[j] = (u2 + r22[j]) + r12[j];
+						r11[j] = p1[j] + r11[j];
+						r21[j] = u3 - r21[j];
+						r22[j] = u3 + r22[j];
+					}
+				}
+			});
+
+		strassen_peel(a, b, c, threads);
+	}
+
+} // namespace matrix_detail
+
+// Products with any side at most this run on the classic kernels, tuned
+// for double. The classic kernels run close to peak from a few hundred elements
+// per side, the 15 additions of a level only pay off above that.
+constexpr std::size_t default_strassen_cutoff = 1024;
+
+inline void force_classic_multiply(const bool classic) noexcept
+{
+	matrix_detail::classic_multiply_flag().store(classic, std::memory_order_relaxed);
+}
+
+inline bool classic_multiply_forced() noexcept
+{
+	return matrix_detail::classic_multiply_flag().load(std::memory_order_relaxed);
+}
+
+// Temporaries of multiply_strassen(), kept between products.
+template<class T>
+struct strassen_workspace
+{
+	explicit strassen_workspace(const std::size_t cutoff = default_strassen_cutoff) noexcept
+		: cutoff_{ cutoff }
+	{}
+
+	inline std::size_t cutoff() const noexcept { return cutoff_; }
+	inline std::size_t size() const noexcept { return buffer_.size(); }
+
+	// Makes room for an m x k by k x n product on 'threads' threads.
+	void reserve(const std::size_t m, const std::size_t k, const std::size_t n, const std::size_t threads = 1)
+	{
+		buffer_.reserve((threads > 1)
+			? matrix_detail::strassen_parallel_size(m, k, n, cutoff_)
+			: matrix_detail::strassen_sequential_size(m, k, n, cutoff_));
+	}
+
+	inline T* data() noexcept { return buffer_.data(); }
+
+private:
+	std::size_t cutoff_;
+	matrix_detail::aligned_buffer<T> buffer_;
+};
+
+// c = a * b by Strassen-Winograd, see above. The operands are matrices or views
+// with elements of the same arithmetic type.
+template<class ExecutionPolicy, class MA, class MB, class MC, class T,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_strassen(const ExecutionPolicy& policy, const MA& a, const MB& b, MC& c, strassen_workspace<T>& workspace)
+{
+	static_assert(std::is_arithmetic_v<T>, "Strassen multiplication needs arithmetic elements");
+	matrix_detail::check_multiplication(a, b, c);
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::strassen };
+
+	const std::size_t threads = matrix_execution::thread_count(policy);
+	if (classic_multiply_forced()) {
+		matrix_detail::gemm(a, b, c, threads);
+		return;
+	}
+
+	const std::size_t m = a.count_rows(), k = a.count_columns(), n = b.count_columns();
+	const matrix_view<const T> a_view = a.block(0, 0, m, k);
+	const matrix_view<const T> b_view = b.block(0, 0, k, n);
+	const matrix_view<T> c_view = c.block(0, 0, m, n);
+	workspace.reserve(m, k, n, threads);
+	matrix_detail::strassen_parallel(a_view, b_view, c_view, workspace.data(), workspace.cutoff(), threads);
+}
+
+template<class ExecutionPolicy, class MA, class MB, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_strassen(const ExecutionPolicy& policy, const MA& a, const MB& b, MC& c)
+{
+	strassen_workspace<typename MC::value_type> workspace;
+	multiply_strassen(policy, a, b, c, workspace);
+}
+
+template<class MA, class MB, class MC>
+void multiply_strassen(const MA& a, const MB& b, MC& c)
+{
+	multiply_strassen(matrix_execution::seq, a, b, c);
+}
+
+#endif // !MATRIX_STRASSEN_HPP
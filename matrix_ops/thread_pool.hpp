@@ -0,0 +1,312 @@
+#pragma once
+
+#ifndef MATRIX_THREAD_POOL_HPP
+#define MATRIX_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace matrix_execution {
+
+	struct sequenced_policy {};
+
+	// threads - upper bound of threads taking part in one operation, 0 - the whole pool.
+	struct parallel_policy
+	{
+		std::size_t threads{ 0 };
+	};
+
+	inline constexpr sequenced_policy seq{};
+	inline constexpr parallel_policy par{};
+
+	template<class P>
+	struct is_execution_policy : std::bool_constant<
+		std::is_same_v<std::decay_t<P>, sequenced_policy> || std::is_same_v<std::decay_t<P>, parallel_policy>> {};
+
+	template<class P>
+	inline constexpr bool is_execution_policy_v = is_execution_policy<P>::value;
+
+} // namespace matrix_execution
+
+// Pool of worker threads with one task deque per worker. A worker takes tasks
+// from the back of its own deque and steals from the front of the others.
+// A thread waiting for its tasks to complete runs pending tasks meanwhile, so
+// parallel operations may be nested.
+class thread_pool
+{
+public:
+	struct task
+	{
+		void(*run)(void* context, std::size_t begin, std::size_t end);
+		void* context;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	// threads - number of threads running tasks including the calling one.
+	explicit thread_pool(const std::size_t threads = default_thread_count()) { start(threads); }
+	~thread_pool() { stop(); }
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	// Pool shared by all matrix operations. The size is taken from the MATRIX_THREADS
+	// environment variable if it is set, otherwise from the hardware concurrency.
+	static thread_pool& instance()
+	{
+		static thread_pool pool;
+		return pool;
+	}
+
+	static std::size_t default_thread_count() noexcept
+	{
+		if (const char* env = std::getenv("MATRIX_THREADS")) {
+			const long value = std::strtol(env, nullptr, 10);
+			if (value > 0) return static_cast<std::size_t>(value);
+		}
+		return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	inline std::size_t thread_count() const noexcept { return workers_.size() + 1; }
+
+	// Must not be called while the pool runs tasks.
+	void resize(const std::size_t threads)
+	{
+		stop();
+		start(threads);
+	}
+
+	// Calls f(begin, end) for consecutive subranges of [first, last) of at least
+	// 'grain' indexes, using at most 'max_threads' threads (0 - all of them).
+	// Returns when all subranges are processed, the first exception thrown by f
+	// is rethrown.
+	template<class F>
+	void parallel_for(const std::size_t first, const std::size_t last, std::size_t grain, F&& f, const std::size_t max_threads = 0)
+	{
+		if (last <= first) return;
+
+		const std::size_t count = last - first;
+		const std::size_t threads = (max_threads == 0) ? thread_count() : std::min(max_threads, thread_count());
+		grain = std::max<std::size_t>(grain, 1);
+		if (threads < 2 || count <= grain) {
+			f(first, last);
+			return;
+		}
+
+		// A few tiles per thread let the stealing even out uneven tiles.
+		const std::size_t tiles = std::min((count + grain - 1) / grain, (threads == thread_count()) ? threads * 4 : threads);
+		const std::size_t tile = (count + tiles - 1) / tiles;
+
+		using function_type = std::remove_reference_t<F>;
+		struct job
+		{
+			function_type* f;
+			std::atomic<std::size_t> remaining;
+			std::exception_ptr error;
+			std::mutex error_mutex;
+		};
+		job current{ &f, {0}, nullptr, {} };
+
+		const auto run = [](void* context, std::size_t begin, std::size_t end) {
+			auto& j = *static_cast<job*>(context);
+			try {
+				(*j.f)(begin, end);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock{ j.error_mutex };
+				if (!j.error) j.error = std::current_exception();
+			}
+			j.remaining.fetch_sub(1, std::memory_order_acq_rel);
+		};
+
+		std::vector<task> tasks;
+		for (std::size_t begin = first + tile; begin < last; begin += tile) {
+			tasks.push_back({ run, &current, begin, std::min(begin + tile, last) });
+		}
+		current.remaining.store(tasks.size() + 1, std::memory_order_relaxed);
+		push(tasks);
+
+		run(&current, first, std::min(first + tile, last));
+		while (current.remaining.load(std::memory_order_acquire) != 0) {
+			task next;
+			if (try_take(next)) {
+				next.run(next.context, next.begin, next.end);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+
+		if (current.error) {
+			std::rethrow_exception(current.error);
+		}
+	}
+
+private:
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::deque<task> tasks;
+	};
+
+	void start(const std::size_t threads)
+	{
+		stopping_ = false;
+		const std::size_t workers = std::max<std::size_t>(threads, 1) - 1;
+		queues_.clear();
+		for (std::size_t i = 0; i < workers; ++i) {
+			queues_.push_back(std::make_unique<worker_queue>());
+		}
+		for (std::size_t i = 0; i < workers; ++i) {
+			workers_.emplace_back([this, i] { worker_loop(i); });
+		}
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ sleep_mutex_ };
+			stopping_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+		workers_.clear();
+	}
+
+	void push(const std::vector<task>& tasks)
+	{
+		if (tasks.empty()) return;
+
+		if (current_pool_ == this) {
+			auto& queue = *queues_[current_index_];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			queue.tasks.insert(queue.tasks.end(), tasks.begin(), tasks.end());
+		}
+		else {
+			for (std::size_t i = 0; i < tasks.size(); ++i) {
+				auto& queue = *queues_[i % queues_.size()];
+				std::lock_guard<std::mutex> lock{ queue.mutex };
+				queue.tasks.push_back(tasks[i]);
+			}
+		}
+
+		pending_.fetch_add(tasks.size(), std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock{ sleep_mutex_ };
+		}
+		wake_.notify_all();
+	}
+
+	bool try_take(task& result)
+	{
+		if (pending_.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+
+		const bool own_queue = (current_pool_ == this);
+		if (own_queue) {
+			auto& queue = *queues_[current_index_];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			if (!queue.tasks.empty()) {
+				result = queue.tasks.back();
+				queue.tasks.pop_back();
+				pending_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		const std::size_t start = own_queue ? current_index_ + 1 : 0;
+		for (std::size_t i = 0; i < queues_.size(); ++i) {
+			auto& queue = *queues_[(start + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			if (!queue.tasks.empty()) {
+				result = queue.tasks.front();
+				queue.tasks.pop_front();
+				pending_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void worker_loop(const std::size_t index)
+	{
+		current_pool_ = this;
+		current_index_ = index;
+
+		for (;;) {
+			task next;
+			if (try_take(next)) {
+				next.run(next.context, next.begin, next.end);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ sleep_mutex_ };
+			wake_.wait(lock, [this] { return stopping_ || pending_.load(std::memory_order_acquire) != 0; });
+			if (stopping_ && pending_.load(std::memory_order_acquire) == 0) {
+				break;
+			}
+		}
+
+		current_pool_ = nullptr;
+	}
+
+	static inline thread_local thread_pool* current_pool_{ nullptr };
+	static inline thread_local std::size_t current_index_{ 0 };
+
+	std::vector<std::unique_ptr<worker_queue>> queues_;
+	std::vector<std::thread> workers_;
+
+	std::atomic<std::size_t> pending_{ 0 };
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;
+	bool stopping_{ false };
+};
+
+namespace matrix_execution {
+
+	// Runs f(begin, end) over [first, last) according to the policy: in one call
+	// for sequenced_policy, split into tiles of at least 'grain' indexes for
+	// parallel_policy.
+	template<class F>
+	inline void for_each_tile(const sequenced_policy&, const std::size_t first, const std::size_t last, std::size_t, F&& f)
+	{
+		if (first < last) f(first, last);
+	}
+
+	template<class F>
+	inline void for_each_tile(const parallel_policy& policy, const std::size_t first, const std::size_t last, const std::size_t grain, F&& f)
+	{
+		thread_pool::instance().parallel_for(first, last, grain, std::forward<F>(f), policy.threads);
+	}
+
+	inline std::size_t thread_count(const sequenced_policy&) noexcept { return 1; }
+	inline std::size_t thread_count(const parallel_policy& policy) noexcept
+	{
+		const std::size_t pool_threads = thread_pool::instance().thread_count();
+		return (policy.threads == 0) ? pool_threads : std::min(policy.threads, pool_threads);
+	}
+
+	// Operations on fewer elements than this are not split between threads.
+	constexpr std::size_t min_parallel_elements = 64 * 1024;
+
+	// Number of rows of 'columns' elements in one parallel tile.
+	inline std::size_t row_grain(const std::size_t columns) noexcept
+	{
+		return std::max<std::size_t>(1, min_parallel_elements / std::max<std::size_t>(columns, 1));
+	}
+
+} // namespace matrix_execution
+
+#endif // !MATRIX_THREAD_POOL_HPP
@@ -0,0 +1,352 @@
+#pragma once
+
+#ifndef MATRIX_TRANSPOSE_HPP
+#define MATRIX_TRANSPOSE_HPP
+
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include "../matrix/matrix_instrumentation.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Blocked transposition.
+//
+// Out of place, the matrix is split recursively along its longer side until the
+// pieces are at most transpose_tile x transpose_tile elements. This is
+// cache-oblivious: at some depth of the recursion the pieces fit in each cache
+// level and the TLB, whatever their sizes. Each tile is transposed in register
+// blocks by SSE2 or AVX2 kernels (4x4/8x8 for 4-byte elements, 2x2/4x4 for
+// 8-byte ones) when the elements are trivially copyable, by plain loops
+// otherwise.
+//
+// In place, a square matrix swaps pairs of tiles across the diagonal through a
+// buffer of one tile. A packed non-square buffer (row stride == columns) is
+// permuted by following the cycles of the permutation, with one bit of
+// bookkeeping per element instead of a copy of the matrix.
+
+namespace matrix_detail {
+
+	constexpr std::size_t transpose_tile = 32;
+
+	// dst[j][i] = src[i][j] for i < rows, j < columns. Rows are given as pointers
+	// to the first element of the block in them.
+	template<class T>
+	using transpose_block_function = void(*)(const T* const* src, T* const* dst, std::size_t rows, std::size_t columns);
+
+	template<class T>
+	void transpose_block_scalar(const T* const* src, T* const* dst, const std::size_t rows, const std::size_t columns)
+	{
+		for (std::size_t i = 0; i < rows; ++i) {
+			for (std::size_t j = 0; j < columns; ++j) {
+				dst[j][i] = src[i][j];
+			}
+		}
+	}
+
+#if MATRIX_X86
+	// Register kernels transpose the K x K block at (i, j) of the source. Elements
+	// of 4 and 8 bytes are moved as float and double lanes, their bits unchanged.
+	template<class T>
+	MATRIX_TARGET("sse2") inline void transpose_registers_sse(const T* const* s, T* const* d, const std::size_t i, const std::size_t j) noexcept
+	{
+		if constexpr (sizeof(T) == 4) {
+			__m128 r0 = _mm_loadu_ps(reinterpret_cast<const float*>(s[i] + j));
+			__m128 r1 = _mm_loadu_ps(reinterpret_cast<const float*>(s[i + 1] + j));
+			__m128 r2 = _mm_loadu_ps(reinterpret_cast<const float*>(s[i + 2] + j));
+			__m128 r3 = _mm_loadu_ps(reinterpret_cast<const float*>(s[i + 3] + j));
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(reinterpret_cast<float*>(d[j] + i), r0);
+			_mm_storeu_ps(reinterpret_cast<float*>(d[j + 1] + i), r1);
+			_mm_storeu_ps(reinterpret_cast<float*>(d[j + 2] + i), r2);
+			_mm_storeu_ps(reinterpret_cast<float*>(d[j + 3] + i), r3);
+		}
+		else {
+			const __m128d r0 = _mm_loadu_pd(reinterpret_cast<const double*>(s[i] + j));
+			const __m128d r1 = _mm_loadu_pd(reinterpret_cast<const double*>(s[i + 1] + j));
+			_mm_storeu_pd(reinterpret_cast<double*>(d[j] + i), _mm_unpacklo_pd(r0, r1));
+			_mm_storeu_pd(reinterpret_cast<double*>(d[j + 1] + i), _mm_unpackhi_pd(r0, r1));
+		}
+	}
+
+	template<class T>
+	MATRIX_TARGET("avx2") inline void transpose_registers_avx(const T* const* s, T* const* d, const std::size_t i, const std::size_t j) noexcept
+	{
+		if constexpr (sizeof(T) == 4) {
+			__m256 r[8];
+			for (std::size_t k = 0; k < 8; ++k) {
+				r[k] = _mm256_loadu_ps(reinterpret_cast<const float*>(s[i + k] + j));
+			}
+			const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+			const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+			const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+			const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+			const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+			const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+			const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+			const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+			const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+			const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j] + i), _mm256_permute2f128_ps(u0, u4, 0x20));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 1] + i), _mm256_permute2f128_ps(u1, u5, 0x20));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 2] + i), _mm256_permute2f128_ps(u2, u6, 0x20));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 3] + i), _mm256_permute2f128_ps(u3, u7, 0x20));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 4] + i), _mm256_permute2f128_ps(u0, u4, 0x31));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 5] + i), _mm256_permute2f128_ps(u1, u5, 0x31));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 6] + i), _mm256_permute2f128_ps(u2, u6, 0x31));
+			_mm256_storeu_ps(reinterpret_cast<float*>(d[j + 7] + i), _mm256_permute2f128_ps(u3, u7, 0x31));
+		}
+		else {
+			const __m256d r0 = _mm256_loadu_pd(reinterpret_cast<const double*>(s[i] + j));
+			const __m256d r1 = _mm256_loadu_pd(reinterpret_cast<const double*>(s[i + 1] + j));
+			const __m256d r2 = _mm256_loadu_pd(reinterpret_cast<const double*>(s[i + 2] + j));
+			const __m256d r3 = _mm256_loadu_pd(reinterpret_cast<const double*>(s[i + 3] + j));
+			const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+			const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+			const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+			const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+			_mm256_storeu_pd(reinterpret_cast<double*>(d[j] + i), _mm256_permute2f128_pd(t0, t2, 0x20));
+			_mm256_storeu_pd(reinterpret_cast<double*>(d[j + 1] + i), _mm256_permute2f128_pd(t1, t3, 0x20));
+			_mm256_storeu_pd(reinterpret_cast<double*>(d[j + 2] + i), _mm256_permute2f128_pd(t0, t2, 0x31));
+			_mm256_storeu_pd(reinterpret_cast<double*>(d[j + 3] + i), _mm256_permute2f128_pd(t1, t3, 0x31));
+		}
+	}
+
+	// A tile in register blocks of K = Bytes / sizeof(T), the edges element by element.
+#define MATRIX_TRANSPOSE_BLOCK(name, isa, bytes, kernel)                                                           \
+	template<class T>                                                                                              \
+	MATRIX_TARGET(isa) void name(const T* const* src, T* const* dst, const std::size_t rows, const std::size_t columns) \
+	{                                                                                                              \
+		constexpr std::size_t K = (bytes) / sizeof(T);                                                             \
+		const std::size_t rows_k = rows / K * K;                                                                   \
+		const std::size_t columns_k = columns / K * K;                                                             \
+		for (std::size_t i = 0; i < rows_k; i += K) {                                                              \
+			for (std::size_t j = 0; j < columns_k; j += K) {                                                       \
+				kernel(src, dst, i, j);                                                                            \
+			}                                                                                                      \
+			for (std::size_t j = columns_k; j < columns; ++j) {                                                    \
+				for (std::size_t k = 0; k < K; ++k) dst[j][i + k] = src[i + k][j];                                 \
+			}                                                                                                      \
+		}                                                                                                          \
+		for (std::size_t i = rows_k; i < rows; ++i) {                                                              \
+			for (std::size_t j = 0; j < columns; ++j) dst[j][i] = src[i][j];                                       \
+		}                                                                                                          \
+	}
+
+	MATRIX_TRANSPOSE_BLOCK(transpose_block_sse, "sse2", 16, transpose_registers_sse)
+	MATRIX_TRANSPOSE_BLOCK(transpose_block_avx, "avx2", 32, transpose_registers_avx)
+
+#undef MATRIX_TRANSPOSE_BLOCK
+#endif
+
+	template<class T>
+	inline constexpr bool has_transpose_kernels_v = std::is_trivially_copyable_v<T> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+	template<class T>
+	transpose_block_function<T> select_transpose_block() noexcept
+	{
+#if MATRIX_X86
+		if constexpr (has_transpose_kernels_v<T>) {
+			const simd_level level = active_simd_level();
+			if (level >= simd_level::avx2) return &transpose_block_avx<T>;
+			if (level >= simd_level::sse2) return &transpose_block_sse<T>;
+		}
+#endif
+		return &transpose_block_scalar<T>;
+	}
+
+	// Element type of a container (or const container) whose rows are pointers,
+	// void for other ones.
+	template<class M>
+	using row_element_t = std::conditional_t<std::is_pointer_v<decltype(std::declval<M&>()[0])>,
+		std::remove_pointer_t<decltype(std::declval<M&>()[0])>, void>;
+
+	// Transposes the block of src at (row, column) of rows x columns elements into dst.
+	template<class Src, class Dst, class T>
+	void transpose_recursive(const Src& src, Dst& dst, const std::size_t row, const std::size_t column,
+		const std::size_t rows, const std::size_t columns, const transpose_block_function<T> block)
+	{
+		if (rows > transpose_tile || columns > transpose_tile) {
+			if (rows >= columns) {
+				const std::size_t half = rows / 2;
+				transpose_recursive(src, dst, row, column, half, columns, block);
+				transpose_recursive(src, dst, row + half, column, rows - half, columns, block);
+			}
+			else {
+				const std::size_t half = columns / 2;
+				transpose_recursive(src, dst, row, column, rows, half, block);
+				transpose_recursive(src, dst, row, column + half, rows, columns - half, block);
+			}
+			return;
+		}
+
+		const T* s[transpose_tile];
+		T* d[transpose_tile];
+		for (std::size_t i = 0; i < rows; ++i) s[i] = src[row + i] + column;
+		for (std::size_t j = 0; j < columns; ++j) d[j] = dst[column + j] + row;
+		block(s, d, rows, columns);
+	}
+
+	// Swaps the tiles above the diagonal of the square matrix m with the ones
+	// below it, for tile rows [first, last).
+	template<class M>
+	void transpose_square_tiles(const M& m, const std::size_t n, const std::size_t first, const std::size_t last)
+	{
+		using T = row_element_t<const M>;
+		constexpr std::size_t tile = transpose_tile;
+
+		if constexpr (has_transpose_kernels_v<T>) {
+			const auto block = select_transpose_block<T>();
+			alignas(64) unsigned char storage[tile * tile * sizeof(T)];
+			T* const buffer = reinterpret_cast<T*>(storage);
+			const T* s[tile];
+			T* d[tile];
+			T* b[tile];
+			for (std::size_t k = 0; k < tile; ++k) b[k] = buffer + k * tile;
+
+			for (std::size_t ti = first; ti < last; ++ti) {
+				const std::size_t i0 = ti * tile;
+				const std::size_t rows = std::min(tile, n - i0);
+				for (std::size_t j0 = i0; j0 < n; j0 += tile) {
+					const std::size_t columns = std::min(tile, n - j0);
+					// buffer = transpose of the tile (j0, i0)
+					for (std::size_t k = 0; k < columns; ++k) s[k] = m[j0 + k] + i0;
+					block(s, b, columns, rows);
+					// tile (j0, i0) = transpose of the tile (i0, j0)
+					if (j0 != i0) {
+						for (std::size_t k = 0; k < rows; ++k) s[k] = m[i0 + k] + j0;
+						for (std::size_t k = 0; k < columns; ++k) d[k] = m[j0 + k] + i0;
+						block(s, d, rows, columns);
+					}
+					// tile (i0, j0) = buffer
+					for (std::size_t k = 0; k < rows; ++k) {
+						std::copy_n(b[k], columns, m[i0 + k] + j0);
+					}
+				}
+			}
+		}
+		else {
+			for (std::size_t ti = first; ti < last; ++ti) {
+				const std::size_t i0 = ti * tile;
+				const std::size_t i1 = std::min(i0 + tile, n);
+				for (std::size_t j0 = i0; j0 < n; j0 += tile) {
+					const std::size_t j1 = std::min(j0 + tile, n);
+					for (std::size_t i = i0; i < i1; ++i) {
+						for (std::size_t j = std::max(j0, i + 1); j < j1; ++j) {
+							using std::swap;
+							swap(m[i][j], m[j][i]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Transposes a square matrix or view with pointer rows in place.
+	template<class ExecutionPolicy, class M>
+	void transpose_square_inplace(const ExecutionPolicy& policy, const M& m)
+	{
+		const std::size_t n = m.count_rows();
+		const std::size_t tiles = (n + transpose_tile - 1) / transpose_tile;
+		const std::size_t grain = std::max<std::size_t>(1, matrix_execution::min_parallel_elements / std::max<std::size_t>(n * transpose_tile, 1));
+		matrix_execution::for_each_tile(policy, 0, tiles, grain, [&m, n](const std::size_t first, const std::size_t last) {
+			transpose_square_tiles(m, n, first, last);
+		});
+	}
+
+	// Transposes a packed rows x columns array in place: the element (i, j) at
+	// i * columns + j moves to j * rows + i. 'moved' must hold rows * columns false
+	// values, it is allocated by the caller so that nothing can fail once elements
+	// start moving.
+	template<class T>
+	void transpose_packed_inplace(T* data, const std::size_t rows, const std::size_t columns, std::vector<bool>& moved)
+	{
+		const std::size_t n = rows * columns;
+		if (rows < 2 || columns < 2) return;
+
+		// The element in the destination position p comes from p * columns mod (n - 1),
+		// positions 0 and n - 1 don't move.
+		for (std::size_t start = 1; start < n - 1; ++start) {
+			if (moved[start]) continue;
+			T value = std::move(data[start]);
+			std::size_t p = start;
+			for (std::size_t q = p * columns % (n - 1); q != start; q = p * columns % (n - 1)) {
+				data[p] = std::move(data[q]);
+				moved[p] = true;
+				p = q;
+			}
+			data[p] = std::move(value);
+			moved[p] = true;
+		}
+	}
+
+	template<class Src, class Dst>
+	inline void check_transposition(const Src& src, const Dst& dst)
+	{
+		if (dst.count_rows() != src.count_columns() || dst.count_columns() != src.count_rows()) {
+			throw std::invalid_argument{ "Matrix sizes do not match for transposition" };
+		}
+		if (static_cast<const void*>(&src) == static_cast<const void*>(&dst)) {
+			throw std::invalid_argument{ "Result of transposition must not refer to the operand, use transpose_inplace" };
+		}
+	}
+
+} // namespace matrix_detail
+
+// dst = transposed src, for containers and views (dst must have the transposed
+// shape and must not overlap src). Operands with pointer rows (matrix,
+// fixed_matrix, matrix_view) go through the blocked kernels, the columns of src
+// are split between threads according to the policy.
+template<class ExecutionPolicy, class Src, class Dst,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void transpose(const ExecutionPolicy& policy, const Src& src, Dst&& dst)
+{
+	matrix_detail::check_transposition(src, dst);
+	const matrix_instrumentation::kernel_scope instrumentation{ matrix_instrumentation::kernel::transpose };
+	const std::size_t rows = src.count_rows();
+	const std::size_t columns = src.count_columns();
+	if (rows == 0 || columns == 0) return;
+
+	using S = matrix_detail::row_element_t<const Src>;
+	using D = matrix_detail::row_element_t<std::remove_reference_t<Dst>>;
+	if constexpr (!std::is_void_v<S> && std::is_same_v<std::remove_const_t<S>, D>) {
+		const auto block = matrix_detail::select_transpose_block<D>();
+		const std::size_t grain = std::max(matrix_detail::transpose_tile,
+			matrix_execution::min_parallel_elements / rows / matrix_detail::transpose_tile * matrix_detail::transpose_tile);
+		matrix_execution::for_each_tile(policy, 0, columns, grain, [&](const std::size_t first, const std::size_t last) {
+			matrix_detail::transpose_recursive(src, dst, 0, first, rows, last - first, block);
+		});
+	}
+	else {
+		matrix_execution::for_each_tile(policy, 0, columns, matrix_execution::row_grain(rows), [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t i0 = 0; i0 < rows; i0 += matrix_detail::transpose_tile) {
+				const std::size_t i1 = std::min(i0 + matrix_detail::transpose_tile, rows);
+				for (std::size_t j = first; j < last; ++j) {
+					auto&& d = dst[j];
+					for (std::size_t i = i0; i < i1; ++i) {
+						d[i] = src[i][j];
+					}
+				}
+			}
+		});
+	}
+}
+
+template<class Src, class Dst, class = std::enable_if_t<!matrix_execution::is_execution_policy_v<Src>>>
+void transpose(const Src& src, Dst&& dst)
+{
+	transpose(matrix_execution::seq, src, std::forward<Dst>(dst));
+}
+
+#endif // !MATRIX_TRANSPOSE_HPP
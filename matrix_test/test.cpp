@@ -0,0 +1,1975 @@
+#include "pch.h"
+#include "../matrix/matrix.hpp"
+#include "../matrix/matrix_allocators.hpp"
+#include "../matrix/shared_matrix.hpp"
+#include "../matrix_ops/multiply.hpp"
+#include "../matrix_ops/elementwise.hpp"
+#include "../matrix_ops/factorization.hpp"
+#include "../matrix_ops/quantized.hpp"
+#include "../matrix_ops/reductions.hpp"
+#include "../matrix_ops/strassen.hpp"
+#include "../matrix_io/binary_format.hpp"
+#include "../matrix_io/text_format.hpp"
+#include "../matrix_io/tiled_matrix.hpp"
+#include "../packed_matrix/packed_matrix.hpp"
+#include "../sparse_matrix/sparse_matrix.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<class T, class M>
+matrix<T> naive_product(const M& a, const M& b)
+{
+	matrix<T> result(a.count_rows(), b.count_columns());
+	for (std::size_t i = 0; i < a.count_rows(); ++i) {
+		for (std::size_t j = 0; j < b.count_columns(); ++j) {
+			for (std::size_t k = 0; k < a.count_columns(); ++k) {
+				result(i, j) += a(i, k) * b(k, j);
+			}
+		}
+	}
+	return result;
+}
+
+// Uniform values in [-1, 1).
+template<class M>
+M random_matrix(std::mt19937& g, const std::size_t rows, const std::size_t columns)
+{
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	M m(rows, columns);
+	std::generate(std::begin(m), std::end(m), [&] { return static_cast<typename M::value_type>(dist(g)); });
+	return m;
+}
+
+// Integers in [low, high], whose products and sums are exact.
+template<class M>
+M random_matrix(std::mt19937& g, const std::size_t rows, const std::size_t columns, const int low, const int high)
+{
+	std::uniform_int_distribution<> dist(low, high);
+	M m(rows, columns);
+	std::generate(std::begin(m), std::end(m), [&] { return static_cast<typename M::value_type>(dist(g)); });
+	return m;
+}
+
+// Sets the number of threads of the shared pool for the lifetime of the object,
+// then restores the default.
+struct pool_threads
+{
+	explicit pool_threads(const std::size_t threads) { thread_pool::instance().resize(threads); }
+	~pool_threads() { thread_pool::instance().resize(thread_pool::default_thread_count()); }
+	pool_threads(const pool_threads&) = delete;
+	pool_threads& operator=(const pool_threads&) = delete;
+};
+
+TEST(MatrixConstruction, ConstructorWithValueToFill) {
+	constexpr int rowsCount = 3;
+	constexpr int columnsCount = 4;
+	const std::string defaultValue = "value";
+
+	matrix<std::string> mtx(rowsCount, columnsCount, defaultValue);
+
+	EXPECT_EQ(mtx.count_rows(), rowsCount);
+	EXPECT_EQ(mtx.count_columns(), columnsCount);
+	EXPECT_EQ(std::count(std::begin(mtx), std::end(mtx), defaultValue), rowsCount * columnsCount);
+}
+
+TEST(MatrixConstruction, EmptyMatrix) {
+	matrix<int> mtx;
+	EXPECT_EQ(mtx.count_rows(), 0);
+	EXPECT_EQ(mtx.count_columns(), 0);
+
+	contiguous_matrix<int> contiguous_mtx(0, 5);
+	EXPECT_EQ(contiguous_mtx.data(), nullptr);
+}
+
+TEST(MatrixStorage, ContiguousRowsAreAdjacent) {
+	constexpr int rowsCount = 5;
+	constexpr int columnsCount = 7;
+
+	contiguous_matrix<int> mtx(rowsCount, columnsCount, 1);
+	EXPECT_EQ(mtx.space_columns(), columnsCount);
+
+	for (int row = 0; row < rowsCount; ++row) {
+		EXPECT_EQ(&mtx(row, 0), mtx.data() + row * mtx.space_columns());
+		EXPECT_EQ(mtx[row], mtx.data() + row * mtx.space_columns());
+	}
+
+	std::fill(mtx.data(), mtx.data() + rowsCount * columnsCount, 2);
+	EXPECT_TRUE(std::all_of(std::cbegin(mtx), std::cend(mtx), [](int val) { return val == 2; }));
+}
+
+TEST(MatrixStorage, PaddedRowStride) {
+	constexpr int rowsCount = 3;
+	constexpr int columnsCount = 5;
+
+	matrix<double, std::allocator<double>, contiguous_storage<64>> mtx(rowsCount, columnsCount, 1.5);
+	EXPECT_EQ(mtx.count_columns(), columnsCount);
+	EXPECT_EQ(mtx.space_columns(), 8);
+	EXPECT_EQ(&mtx(2, 0), mtx.data() + 2 * 8);
+	EXPECT_EQ(std::count(std::cbegin(mtx), std::cend(mtx), 1.5), rowsCount * columnsCount);
+
+	matrix<float, std::allocator<float>, row_storage<64>> rows_mtx(rowsCount, columnsCount);
+	EXPECT_EQ(rows_mtx.space_columns(), 16);
+	EXPECT_EQ(std::count(std::cbegin(rows_mtx), std::cend(rows_mtx), 0.0f), rowsCount * columnsCount);
+}
+
+TEST(MatrixStorage, RowsStartOnAlignment) {
+	const auto all_rows_aligned = [](const auto& mtx) {
+		for (std::size_t row = 0; row < mtx.count_rows(); ++row) {
+			if (reinterpret_cast<std::uintptr_t>(mtx[row]) % 64 != 0) return false;
+		}
+		return true;
+	};
+
+	aligned_matrix<float> mtx(7, 5, 1.0f);
+	EXPECT_TRUE(all_rows_aligned(mtx));
+	mtx.push_row({ 1.0f, 2.0f, 3.0f, 4.0f, 5.0f });
+	mtx.resize(9, 21);
+	EXPECT_TRUE(all_rows_aligned(mtx));
+	EXPECT_EQ(mtx.space_columns(), 32);
+	EXPECT_EQ(mtx(7, 4), 5.0f);
+
+	matrix<double, std::allocator<double>, row_storage<64>> rows_mtx(5, 3, 2.0);
+	for (int i = 0; i < 20; ++i) {
+		rows_mtx.push_row({ 1.0, 2.0, 3.0 });
+	}
+	EXPECT_TRUE(all_rows_aligned(rows_mtx));
+	rows_mtx.fill(4.0);
+	EXPECT_EQ(std::count(std::cbegin(rows_mtx), std::cend(rows_mtx), 4.0), 25 * 3);
+
+	block_pool pool;
+	using pool_matrix = aligned_matrix<double, pool_allocator<double>>;
+	const pool_matrix a(10, 3, 1.0, pool_allocator<double>{ pool });
+	const pool_matrix b(a * 2.0 + a, pool_allocator<double>{ pool });
+	EXPECT_TRUE(all_rows_aligned(a));
+	EXPECT_TRUE(all_rows_aligned(b));
+	EXPECT_EQ(b(9, 2), 3.0);
+}
+
+TEST(MatrixConstruction, CopyIsIndependent) {
+	matrix<std::string> mtx(2, 3, "value");
+	matrix<std::string> copy = mtx;
+	copy(1, 2) = "changed";
+
+	EXPECT_EQ(mtx(1, 2), "value");
+	EXPECT_EQ(std::count(std::cbegin(copy), std::cend(copy), "value"), 5);
+
+	matrix<std::string> assigned(4, 4);
+	assigned = copy;
+	EXPECT_EQ(assigned.count_rows(), 2);
+	EXPECT_EQ(assigned(1, 2), "changed");
+	EXPECT_NE(assigned[0], copy[0]);
+}
+
+TEST(MatrixConstruction, MoveTakesStorage) {
+	static_assert(std::is_nothrow_move_constructible_v<matrix<double>>);
+	static_assert(std::is_nothrow_move_assignable_v<matrix<std::string>>);
+	static_assert(std::is_nothrow_move_constructible_v<contiguous_matrix<int>>);
+
+	contiguous_matrix<std::string> mtx(3, 4, "value");
+	const std::string* data = mtx.data();
+
+	contiguous_matrix<std::string> moved = std::move(mtx);
+	EXPECT_EQ(moved.data(), data);
+	EXPECT_EQ(mtx.count_rows(), 0);
+	EXPECT_EQ(mtx.data(), nullptr);
+
+	contiguous_matrix<std::string> assigned(1, 1);
+	assigned = std::move(moved);
+	EXPECT_EQ(assigned.data(), data);
+	EXPECT_EQ(assigned.count_columns(), 4);
+	EXPECT_EQ(moved.count_columns(), 0);
+
+	swap(assigned, mtx);
+	EXPECT_EQ(mtx.data(), data);
+	EXPECT_EQ(assigned.data(), nullptr);
+}
+
+TEST(MatrixConstruction, VectorRelocatesWithoutCopying) {
+	std::vector<matrix<double>> matrices;
+	std::vector<const double*> rows;
+	for (int i = 0; i < 20; ++i) {
+		matrices.emplace_back(3, 3, static_cast<double>(i));
+		rows.push_back(matrices.back()[0]);
+	}
+
+	for (int i = 0; i < 20; ++i) {
+		EXPECT_EQ(matrices[i][0], rows[i]);
+		EXPECT_EQ(matrices[i](2, 2), i);
+	}
+}
+
+TEST(MatrixGrowth, PushRowKeepsRowsInPlace) {
+	matrix<int> mtx;
+	mtx.push_row({ 1, 2, 3 });
+	const int* first_row = mtx[0];
+
+	std::size_t reallocations = 0;
+	for (int i = 1; i < 1000; ++i) {
+		const std::size_t space = mtx.space_rows();
+		mtx.push_row(std::vector<int>{ i, i, i });
+		reallocations += (space != mtx.space_rows());
+	}
+
+	EXPECT_EQ(mtx.count_rows(), 1000);
+	EXPECT_EQ(mtx.count_columns(), 3);
+	EXPECT_EQ(mtx[0], first_row);
+	EXPECT_LE(reallocations, 10);
+	EXPECT_EQ(mtx(999, 2), 999);
+	EXPECT_THROW(mtx.push_row({ 1, 2 }), std::invalid_argument);
+}
+
+TEST(MatrixGrowth, ContiguousPushRowAndColumn) {
+	contiguous_matrix<std::string> mtx;
+	mtx.push_column({ "a", "b" });
+	mtx.push_column({ "c", "d" });
+	mtx.push_row({ "e", "f" });
+	*mtx.emplace_row(3, 'x') = "g";
+
+	ASSERT_EQ(mtx.count_rows(), 4);
+	ASSERT_EQ(mtx.count_columns(), 2);
+	const auto expected = { "a", "c", "b", "d", "e", "f", "g", "xxx" };
+	EXPECT_TRUE(std::equal(std::cbegin(mtx), std::cend(mtx), std::cbegin(expected)));
+	EXPECT_EQ(mtx[3], mtx.data() + 3 * mtx.space_columns());
+	EXPECT_THROW(mtx.push_column({ "h" }), std::invalid_argument);
+}
+
+TEST(MatrixGrowth, ResizeReserveShrink) {
+	matrix<int, std::allocator<int>, contiguous_storage<>> mtx(2, 2, 1);
+	mtx.reserve(10, 8);
+	EXPECT_EQ(mtx.space_rows(), 10);
+	EXPECT_EQ(mtx.space_columns(), 8);
+	const int* data = mtx.data();
+
+	mtx.resize(3, 4, 7);
+	EXPECT_EQ(mtx.data(), data);
+	const auto expected = { 1, 1, 7, 7, 1, 1, 7, 7, 7, 7, 7, 7 };
+	EXPECT_TRUE(std::equal(std::cbegin(mtx), std::cend(mtx), std::cbegin(expected)));
+
+	mtx.resize(2, 1);
+	EXPECT_EQ(mtx(1, 0), 1);
+	mtx.shrink_to_fit();
+	EXPECT_EQ(mtx.space_rows(), 2);
+	EXPECT_EQ(mtx.space_columns(), 1);
+	EXPECT_EQ(mtx(1, 0), 1);
+
+	mtx.resize(0, 0);
+	mtx.shrink_to_fit();
+	EXPECT_EQ(mtx.data(), nullptr);
+}
+
+template<class S>
+void check_insert_erase_rows()
+{
+	matrix<std::string, std::allocator<std::string>, S> mtx;
+	mtx.push_row({ "1", "1" });
+	mtx.push_row({ "3", "3" });
+	mtx.insert_row(1, { "2", "2" });
+	mtx.insert_row(0, { "0", "0" });
+	EXPECT_THROW(mtx.insert_row(5, { "5", "5" }), std::out_of_range);
+
+	const auto inserted = { "0", "0", "1", "1", "2", "2", "3", "3" };
+	EXPECT_TRUE(std::equal(std::cbegin(mtx), std::cend(mtx), std::cbegin(inserted)));
+
+	mtx.erase_row(0);
+	mtx.erase_row(1);
+	const auto erased = { "1", "1", "3", "3" };
+	ASSERT_EQ(mtx.count_rows(), 2);
+	EXPECT_TRUE(std::equal(std::cbegin(mtx), std::cend(mtx), std::cbegin(erased)));
+	EXPECT_THROW(mtx.erase_row(2), std::out_of_range);
+}
+
+TEST(MatrixGrowth, InsertAndEraseRows) {
+	check_insert_erase_rows<row_storage<>>();
+	check_insert_erase_rows<contiguous_storage<>>();
+}
+
+// Copy constructor throws once the global budget of copies is used up.
+struct throwing_copy
+{
+	static inline int copies_left = 1000;
+
+	throwing_copy(int v = 0) : value{ v } {}
+	throwing_copy(const throwing_copy& other) : value{ other.value }
+	{
+		if (copies_left-- == 0) throw std::runtime_error{ "copy failed" };
+	}
+	throwing_copy& operator=(const throwing_copy&) = default;
+
+	int value;
+};
+
+TEST(MatrixGrowth, StrongExceptionGuarantee) {
+	contiguous_matrix<throwing_copy> mtx(3, 3, throwing_copy{ 5 });
+	mtx(1, 1).value = 9;
+
+	throwing_copy::copies_left = 4;
+	EXPECT_THROW(mtx.push_column(std::vector<throwing_copy>(3)), std::runtime_error);
+	throwing_copy::copies_left = 10;
+	EXPECT_THROW(mtx.insert_row(0, std::vector<throwing_copy>(3)), std::runtime_error);
+	throwing_copy::copies_left = 2;
+	EXPECT_THROW(mtx.resize(4, 4, throwing_copy{ 1 }), std::runtime_error);
+	throwing_copy::copies_left = 1000;
+
+	ASSERT_EQ(mtx.count_rows(), 3);
+	ASSERT_EQ(mtx.count_columns(), 3);
+	EXPECT_EQ(mtx(1, 1).value, 9);
+	EXPECT_EQ(std::count_if(std::cbegin(mtx), std::cend(mtx), [](const throwing_copy& x) { return x.value == 5; }), 8);
+}
+
+TEST(MatrixAllocators, PoolRecyclesRowBlocks) {
+	block_pool pool;
+	const pool_allocator<double> alloc{ pool };
+	using pool_matrix = matrix<double, pool_allocator<double>>;
+
+	{
+		pool_matrix warm_up(64, 100, 1.0, alloc);
+		pool_matrix other_warm_up(64, 100, 1.0, alloc);
+	}
+	const std::size_t allocations = pool.upstream_allocations();
+
+	for (int i = 0; i < 50; ++i) {
+		const pool_matrix a(64, 100, 2.0, alloc);
+		pool_matrix b = a;
+		b += a;
+		EXPECT_EQ(b(63, 99), 4.0);
+		EXPECT_EQ(b.get_allocator(), alloc);
+	}
+	EXPECT_EQ(pool.upstream_allocations(), allocations);
+
+	const pool_matrix zeros(7, 5, alloc);
+	EXPECT_EQ(std::count(std::cbegin(zeros), std::cend(zeros), 0.0), 35);
+	const matrix<double, pool_allocator<double>, contiguous_storage<>> contiguous_zeros(7, 5, alloc);
+	EXPECT_EQ(contiguous_zeros(6, 4), 0.0);
+
+	pool_matrix grown(0, 0, 0.0, alloc);
+	for (int i = 0; i < 100; ++i) {
+		grown.push_row({ 1.0, 2.0 });
+	}
+	EXPECT_EQ(grown(99, 1), 2.0);
+
+	block_pool other_pool;
+	other_pool.deallocate(nullptr, 3 * sizeof(double), alignof(double));
+	EXPECT_EQ(other_pool.upstream_allocations(), 0);
+}
+
+TEST(MatrixAllocators, ArenaForTemporaries) {
+	alignas(64) char buffer[16 * 1024];
+	monotonic_arena arena(buffer, sizeof(buffer));
+	const arena_allocator<float> alloc{ arena };
+	using arena_matrix = matrix<float, arena_allocator<float>, contiguous_storage<>>;
+
+	const arena_matrix a(20, 20, 1.0f, alloc);
+	const arena_matrix b(a * 3.0f + a, alloc);
+	const arena_matrix product = a * b;
+	EXPECT_EQ(product(19, 19), 80.0f);
+	EXPECT_EQ(reinterpret_cast<std::uintptr_t>(product.data()) % alignof(std::max_align_t), 0);
+	EXPECT_EQ(arena.upstream_allocations(), 0);
+
+	const arena_matrix large(100, 100, 0.0f, alloc);
+	EXPECT_GT(arena.upstream_allocations(), 0);
+}
+
+TEST(MatrixAllocators, CountingAllocator) {
+	using counting_matrix = matrix<double, counting_allocator<double>>;
+	using counting_block = matrix<float, counting_allocator<float>, contiguous_storage<64>>;
+
+	auto before = matrix_instrumentation::thread_snapshot();
+	{
+		const counting_matrix rows(10, 20, 1.0);
+		const auto used = matrix_instrumentation::thread_snapshot() - before;
+		EXPECT_EQ(used.allocations, 11);
+		EXPECT_EQ(used.allocated_bytes, 10 * sizeof(double*) + 10 * 20 * sizeof(double));
+		EXPECT_EQ(used.live_bytes(), static_cast<std::int64_t>(used.allocated_bytes));
+		EXPECT_GE(used.peak_bytes, used.allocated_bytes);
+	}
+	auto used = matrix_instrumentation::thread_snapshot() - before;
+	EXPECT_EQ(used.deallocations, 11);
+	EXPECT_EQ(used.live_bytes(), 0);
+
+	before = matrix_instrumentation::thread_snapshot();
+	{
+		// Rows of 5 floats padded to 64 bytes, in one block.
+		const counting_block block(3, 5, 1.0f);
+		const counting_block copy = block;
+		EXPECT_TRUE(std::equal(std::cbegin(copy), std::cend(copy), std::cbegin(block)));
+	}
+	used = matrix_instrumentation::thread_snapshot() - before;
+	EXPECT_EQ(used.allocations, 4);
+	EXPECT_EQ(used.allocated_bytes, 2 * (3 * sizeof(float*) + 3 * 64));
+	EXPECT_EQ(used.live_bytes(), 0);
+
+	// Counters of other threads show in snapshot(), also after they exit.
+	const auto process_before = matrix_instrumentation::snapshot();
+	std::thread([] { std::vector<int, counting_allocator<int>> values(1000); }).join();
+	const auto process_used = matrix_instrumentation::snapshot() - process_before;
+	EXPECT_EQ(process_used.allocations, 1);
+	EXPECT_EQ(process_used.allocated_bytes, 1000 * sizeof(int));
+	EXPECT_EQ(process_used.live_bytes(), 0);
+}
+
+TEST(MatrixAllocators, InstrumentationHooks) {
+	if constexpr (!matrix_instrumentation::enabled) {
+		GTEST_SKIP() << "Built without MATRIX_INSTRUMENTATION";
+	}
+	else {
+		using matrix_instrumentation::kernel;
+		const auto before = matrix_instrumentation::thread_snapshot();
+		{
+			matrix<double> a(64, 64, 1.0);
+			const matrix<double> copy = a;
+			EXPECT_THROW(a(64, 0), std::out_of_range);
+			EXPECT_THROW(copy(0, 64), std::out_of_range);
+			const matrix<double> product = a * copy;
+			lu(product);
+		}
+		const auto used = matrix_instrumentation::thread_snapshot() - before;
+		EXPECT_GE(used.allocations, 3 * 65);
+		EXPECT_EQ(used.live_bytes(), 0);
+		EXPECT_GE(used.element_copies, 64 * 64);
+		EXPECT_EQ(used.range_errors, 2);
+		EXPECT_GE(used[kernel::gemm].calls, 1);
+		EXPECT_GT(used[kernel::gemm].nanoseconds, 0);
+		EXPECT_EQ(used[kernel::lu].calls, 1);
+
+		// Counted once, by the allocator.
+		const auto counted_before = matrix_instrumentation::thread_snapshot();
+		matrix<double, counting_allocator<double>> counted(2, 2);
+		EXPECT_EQ((matrix_instrumentation::thread_snapshot() - counted_before).allocations, 3);
+	}
+}
+
+TEST(MatrixSnapshots, CopyOnWrite) {
+	matrix<double> initial(20, 6);
+	std::iota(std::begin(initial), std::end(initial), 0.0);
+	shared_matrix<double> shared(initial);
+	const auto first = shared.snapshot();
+	EXPECT_EQ(first.version(), 0);
+	EXPECT_EQ(first(19, 5), 119.0);
+
+	shared.set(3, 2, -1.0);
+	shared.assign_row(7, std::vector<double>(6, 8.0));
+	EXPECT_TRUE(shared.has_changes());
+	EXPECT_EQ(shared[3][2], -1.0);
+	EXPECT_EQ(shared.snapshot()(3, 2), 20.0);
+
+	EXPECT_EQ(shared.publish(), 1);
+	EXPECT_FALSE(shared.has_changes());
+	EXPECT_EQ(shared.publish(), 1);
+	const auto second = shared.snapshot();
+	EXPECT_EQ(second.version(), 1);
+	EXPECT_EQ(second(3, 2), -1.0);
+	EXPECT_EQ(second(7, 0), 8.0);
+	EXPECT_EQ(first(3, 2), 20.0);
+	EXPECT_EQ(first(7, 0), 42.0);
+
+	// Only the changed rows were copied.
+	EXPECT_NE(second[3], first[3]);
+	EXPECT_NE(second[7], first[7]);
+	EXPECT_EQ(second[4], first[4]);
+	EXPECT_EQ(second.view().block(10, 0, 1, 6)[0], first[10]);
+	EXPECT_EQ(std::accumulate(second[7], second[7] + 6, 0.0), 48.0);
+
+	EXPECT_THROW(first(20, 0), std::out_of_range);
+	EXPECT_THROW(shared.set(0, 6, 1.0), std::out_of_range);
+	EXPECT_THROW(shared.row(20), std::out_of_range);
+
+	// Chunks of rows are copied whole.
+	shared_matrix<int> chunked(10, 3, 1, 4);
+	const auto before = chunked.snapshot();
+	chunked.set(5, 0, 2);
+	chunked.publish();
+	const auto after = chunked.snapshot();
+	EXPECT_NE(after[4], before[4]);
+	EXPECT_NE(after[7], before[7]);
+	EXPECT_EQ(after[3], before[3]);
+	EXPECT_EQ(after[8], before[8]);
+	EXPECT_EQ(after(5, 0), 2);
+	EXPECT_EQ(before(5, 0), 1);
+	EXPECT_THROW(shared_matrix<int>(2, 2, 0, 0), std::invalid_argument);
+}
+
+TEST(MatrixSnapshots, ConcurrentReaders) {
+	// Each version v has row 0 and row v % rows filled with v.
+	constexpr std::size_t rows = 64, columns = 32;
+	constexpr std::uint64_t versions = 300;
+	shared_matrix<std::uint64_t> shared(rows, columns, 0);
+	std::atomic<bool> done{ false };
+	std::atomic<std::size_t> errors{ 0 };
+
+	std::vector<std::thread> readers;
+	for (int reader = 0; reader < 4; ++reader) {
+		readers.emplace_back([&]() {
+			std::uint64_t last = 0;
+			while (!done.load()) {
+				const auto current = shared.snapshot();
+				const std::uint64_t v = current.version();
+				const auto* changed = current[v % rows];
+				if (v < last || std::count(current[0], current[0] + columns, v) != columns || std::count(changed, changed + columns, v) != columns) {
+					++errors;
+				}
+				last = v;
+			}
+		});
+	}
+	for (std::uint64_t v = 1; v <= versions; ++v) {
+		shared.assign_row(0, std::vector<std::uint64_t>(columns, v));
+		std::fill_n(shared.row(v % rows), columns, v);
+		EXPECT_EQ(shared.publish(), v);
+	}
+	done = true;
+	for (auto& reader : readers) reader.join();
+	EXPECT_EQ(errors.load(), 0);
+	EXPECT_EQ(shared.snapshot().version(), versions);
+}
+
+TEST(MatrixUsage, Indexing) {
+	matrix<int> mtx(3, 4, 7);
+
+	mtx(1, 2) = 5;
+	EXPECT_EQ(mtx[1][2], 5);
+	EXPECT_EQ(mtx(1, 2), 5);
+
+	EXPECT_THROW(mtx(3, 0), std::out_of_range);
+	EXPECT_THROW(mtx(0, 4), std::out_of_range);
+}
+
+TEST(MatrixUsage, RandomAccessIterators) {
+	matrix<int> mtx(3, 4);
+	std::iota(std::begin(mtx), std::end(mtx), 0);
+	EXPECT_EQ(mtx(2, 3), 11);
+
+	const auto first = std::cbegin(mtx);
+	EXPECT_EQ(std::cend(mtx) - first, 12);
+	EXPECT_EQ(first[5], 5);
+	EXPECT_EQ(*(first + 7), 7);
+	EXPECT_EQ(*(std::cend(mtx) - 5), 7);
+	EXPECT_EQ((first + 9) - (first + 2), 7);
+	EXPECT_EQ((first + 2) - (first + 9), -7);
+	EXPECT_EQ(*(first + 9 - 6), 3);
+	EXPECT_TRUE(first + 3 < first + 4);
+	EXPECT_TRUE(first + 4 > first + 3);
+	EXPECT_EQ(*std::prev(std::end(mtx)), 11);
+
+	std::reverse(std::begin(mtx), std::end(mtx));
+	EXPECT_EQ(mtx(0, 0), 11);
+	std::sort(std::begin(mtx), std::end(mtx));
+	EXPECT_TRUE(std::is_sorted(std::cbegin(mtx), std::cend(mtx)));
+	EXPECT_EQ(*std::lower_bound(std::cbegin(mtx), std::cend(mtx), 6), 6);
+	EXPECT_EQ(*std::crbegin(mtx), 11);
+
+	const matrix<int> no_columns(4, 0);
+	EXPECT_EQ(std::cbegin(no_columns), std::cend(no_columns));
+	auto it = std::cbegin(no_columns);
+	it += 0;
+	std::advance(it, 0);
+	EXPECT_EQ(it, std::cend(no_columns));
+	EXPECT_EQ(std::cbegin(no_columns) - 0, std::cend(no_columns));
+	EXPECT_EQ(std::cend(no_columns) - std::cbegin(no_columns), 0);
+	EXPECT_EQ(std::count(std::cbegin(no_columns), std::cend(no_columns), 0), 0);
+}
+
+TEST(MatrixUsage, SegmentedAlgorithms) {
+	static_assert(is_segmented_iterator_v<matrix<int>::iterator>);
+	static_assert(!is_segmented_iterator_v<std::vector<int>::iterator>);
+
+	matrix<int> rows_mtx(5, 6, 1);
+	matrix_segmented::fill(std::begin(rows_mtx) + 4, std::end(rows_mtx) - 3, 0);
+	EXPECT_EQ(std::count(std::cbegin(rows_mtx), std::cend(rows_mtx), 0), 23);
+	EXPECT_EQ(rows_mtx(0, 3), 1);
+	EXPECT_EQ(rows_mtx(0, 4), 0);
+	EXPECT_EQ(rows_mtx(4, 2), 0);
+	EXPECT_EQ(rows_mtx(4, 3), 1);
+
+	std::iota(std::begin(rows_mtx), std::end(rows_mtx), 0);
+	aligned_matrix<int> other(3, 10, -1);
+	const auto out = matrix_segmented::copy(std::cbegin(rows_mtx) + 1, std::cend(rows_mtx), std::begin(other));
+	EXPECT_EQ(out - std::begin(other), 29);
+	EXPECT_TRUE(std::equal(std::cbegin(other), std::cend(other) - 1, std::cbegin(rows_mtx) + 1));
+	EXPECT_EQ(other(2, 9), -1);
+
+	std::vector<int> values(30);
+	matrix_segmented::copy(std::cbegin(rows_mtx), std::cend(rows_mtx), values.begin());
+	EXPECT_TRUE(std::equal(values.cbegin(), values.cend(), std::cbegin(rows_mtx)));
+	matrix_segmented::copy(values.crbegin(), values.crend(), std::begin(rows_mtx));
+	EXPECT_EQ(rows_mtx(0, 0), 29);
+	EXPECT_EQ(rows_mtx(4, 5), 0);
+
+	matrix<double, std::allocator<double>, row_storage<64>> doubles(4, 3, 1.0);
+	matrix_segmented::fill(std::begin(doubles), std::end(doubles), 2.5);
+	EXPECT_EQ(std::count(std::cbegin(doubles), std::cend(doubles), 2.5), 12);
+	matrix_segmented::fill(std::begin(doubles), std::end(doubles), 0.0);
+	EXPECT_EQ(std::count(std::cbegin(doubles), std::cend(doubles), 0.0), 12);
+
+	const matrix<std::string> strings(3, 2, "a");
+	matrix<std::string> copied(2, 3);
+	matrix_segmented::copy(std::cbegin(strings), std::cend(strings), std::begin(copied));
+	EXPECT_EQ(copied(1, 2), "a");
+}
+
+template<class T, class S>
+void check_multiplication_on_all_kernels(const std::size_t rows, const std::size_t inner, const std::size_t columns)
+{
+	using M = matrix<T, std::allocator<T>, S>;
+	std::mt19937 g(42);
+	const auto a = random_matrix<M>(g, rows, inner, -8, 8);
+	const auto b = random_matrix<M>(g, inner, columns, -8, 8);
+	const auto expected = naive_product<T>(a, b);
+
+	for (auto level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512 }) {
+		limit_simd_level(level);
+		const auto product = a * b;
+		ASSERT_EQ(product.count_rows(), rows);
+		ASSERT_EQ(product.count_columns(), columns);
+		EXPECT_TRUE(std::equal(std::cbegin(product), std::cend(product), std::cbegin(expected)));
+	}
+	limit_simd_level(simd_level::avx512);
+}
+
+TEST(MatrixArithmetic, Multiply) {
+	check_multiplication_on_all_kernels<double, row_storage<>>(67, 129, 45);
+	check_multiplication_on_all_kernels<float, contiguous_storage<>>(130, 70, 75);
+	check_multiplication_on_all_kernels<int, contiguous_storage<64>>(33, 300, 17);
+	check_multiplication_on_all_kernels<long, row_storage<>>(5, 3, 4);
+}
+
+TEST(MatrixArithmetic, MultiplyChecksSizes) {
+	matrix<double> a(3, 4, 1.0);
+	matrix<double> b(3, 4, 1.0);
+	matrix<double> c(3, 4);
+
+	EXPECT_THROW(a * b, std::invalid_argument);
+	EXPECT_THROW(multiply(a, b, c), std::invalid_argument);
+
+	matrix<double> square(4, 4, 1.0);
+	EXPECT_THROW(multiply(square, square, square), std::invalid_argument);
+}
+
+TEST(MatrixParallel, ThreadPoolCoversRangeOnce) {
+	thread_pool pool(4);
+	std::vector<std::atomic<int>> visits(10000);
+
+	pool.parallel_for(0, visits.size(), 7, [&](std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; ++i) ++visits[i];
+		pool.parallel_for(0, 4, 1, [](std::size_t, std::size_t) {});
+	});
+	EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](const std::atomic<int>& v) { return v == 1; }));
+
+	EXPECT_THROW(pool.parallel_for(0, 100, 1, [](std::size_t first, std::size_t) {
+		if (first > 50) throw std::runtime_error{ "task failed" };
+	}), std::runtime_error);
+}
+
+TEST(MatrixParallel, ConstructionFillTransformReduce) {
+	const pool_threads threads(4);
+
+	matrix<double> mtx(matrix_execution::par, 700, 300, 2.0);
+	EXPECT_EQ(std::count(std::cbegin(mtx), std::cend(mtx), 2.0), 700 * 300);
+
+	mtx.fill(matrix_execution::par, 3.0);
+	EXPECT_EQ(std::count(std::cbegin(mtx), std::cend(mtx), 3.0), 700 * 300);
+
+	matrix<double> doubled(700, 300);
+	transform(matrix_execution::par, mtx, doubled, [](double v) { return v * 2; });
+	transform(matrix_execution::par, mtx, doubled, doubled, [](double a, double b) { return a + b; });
+	EXPECT_EQ(std::count(std::cbegin(doubled), std::cend(doubled), 9.0), 700 * 300);
+
+	EXPECT_EQ(reduce(matrix_execution::par, doubled, 1.0, std::plus<>{}), 1.0 + 9.0 * 700 * 300);
+	EXPECT_EQ(reduce(matrix_execution::seq, doubled, 1.0, std::plus<>{}), 1.0 + 9.0 * 700 * 300);
+}
+
+TEST(MatrixReductions, SumsAndDot) {
+	const pool_threads threads(4);
+
+	std::mt19937 g(5);
+	const auto a = random_matrix<matrix<double>>(g, 300, 517);
+	const auto b = random_matrix<matrix<double>>(g, 300, 517);
+	long double expected_sum = 0, expected_dot = 0;
+	for (std::size_t row = 0; row < a.count_rows(); ++row) {
+		for (std::size_t column = 0; column < a.count_columns(); ++column) {
+			expected_sum += a(row, column);
+			expected_dot += static_cast<long double>(a(row, column)) * b(row, column);
+		}
+	}
+	EXPECT_NEAR(sum(a), static_cast<double>(expected_sum), 1e-11);
+	EXPECT_NEAR(sum(matrix_execution::par, a), static_cast<double>(expected_sum), 1e-11);
+	EXPECT_NEAR(sum(matrix_execution::par, a, summation::kahan), static_cast<double>(expected_sum), 1e-13);
+	EXPECT_NEAR(dot(a, b), static_cast<double>(expected_dot), 1e-11);
+	EXPECT_NEAR(dot(matrix_execution::par, a, b, summation::kahan), static_cast<double>(expected_dot), 1e-13);
+	EXPECT_NEAR(sum(a.view().transposed()), static_cast<double>(expected_sum), 1e-11);
+	EXPECT_THROW(dot(a, matrix<double>(517, 300)), std::invalid_argument);
+
+	// 2 * 10^6 additions of 0.1f: a running float sum is off by percents.
+	const matrix<float> tenths(2000, 1000, 0.1f);
+	const double exact = 2e6 * static_cast<double>(0.1f);
+	EXPECT_NEAR(sum(tenths), exact, exact * 1e-6);
+	EXPECT_NEAR(sum(matrix_execution::par, tenths, summation::kahan), exact, exact * 1e-7);
+
+	matrix<int> integers(37, 29);
+	std::iota(std::begin(integers), std::end(integers), -500);
+	EXPECT_EQ(sum(integers), std::accumulate(std::cbegin(integers), std::cend(integers), 0));
+	EXPECT_EQ(sum(matrix<unsigned>(3, 70, 2u), summation::kahan), 420u);
+	EXPECT_EQ(sum(matrix<double>(0, 5)), 0.0);
+
+	// Small integers are summed in 64 bits, past the range of the element type.
+	const matrix<std::int8_t> bytes(300, 400, std::int8_t{ 100 });
+	static_assert(std::is_same_v<decltype(sum(bytes)), std::int64_t>);
+	EXPECT_EQ(sum(bytes), 12000000);
+	EXPECT_EQ(sum(matrix_execution::par, bytes, summation::kahan), 12000000);
+	EXPECT_EQ(dot(matrix_execution::par, bytes, bytes), 1200000000);
+	EXPECT_EQ(sum(matrix<std::uint16_t>(10, 10, std::uint16_t{ 60000 })), 6000000u);
+	const auto byte_rows = row_sums(matrix_execution::par, bytes);
+	EXPECT_TRUE(std::all_of(byte_rows.begin(), byte_rows.end(), [](const std::int64_t s) { return s == 40000; }));
+	const auto byte_columns = col_sums(bytes);
+	ASSERT_EQ(byte_columns.size(), 400u);
+	EXPECT_TRUE(std::all_of(byte_columns.begin(), byte_columns.end(), [](const std::int64_t s) { return s == 30000; }));
+}
+
+TEST(MatrixReductions, MinMaxAndPositions) {
+	const pool_threads threads(4);
+
+	matrix<int> m(400, 150);
+	std::iota(std::begin(m), std::end(m), 0);
+	std::transform(std::cbegin(m), std::cend(m), std::begin(m), [](const int x) { return (x * 7919) % 10007; });
+	m(123, 45) = 20000;
+	m(321, 7) = 20000;
+	m(50, 149) = -3;
+	EXPECT_EQ(max_value(m), 20000);
+	EXPECT_EQ(min_value(matrix_execution::par, m), -3);
+	EXPECT_EQ(argmax(m), std::make_pair(std::size_t{ 123 }, std::size_t{ 45 }));
+	EXPECT_EQ(argmax(matrix_execution::par, m), std::make_pair(std::size_t{ 123 }, std::size_t{ 45 }));
+	EXPECT_EQ(argmin(matrix_execution::par, m), std::make_pair(std::size_t{ 50 }, std::size_t{ 149 }));
+	EXPECT_EQ(argmax(m.view().transposed()), std::make_pair(std::size_t{ 7 }, std::size_t{ 321 }));
+	EXPECT_THROW(max_value(matrix<int>(3, 0)), std::invalid_argument);
+}
+
+TEST(MatrixReductions, RowsColumnsAndNorms) {
+	const pool_threads threads(4);
+
+	// Wider than a panel of columns and taller than a block of rows.
+	std::mt19937 g(9);
+	const auto m = random_matrix<matrix<double>>(g, 70, 5000, -50, 50);
+	std::vector<double> rows(m.count_rows()), columns(m.count_columns()), column_max(m.count_columns(), -1000.0);
+	for (std::size_t row = 0; row < m.count_rows(); ++row) {
+		for (std::size_t column = 0; column < m.count_columns(); ++column) {
+			rows[row] += m(row, column);
+			columns[column] += m(row, column);
+			column_max[column] = std::max(column_max[column], m(row, column));
+		}
+	}
+	EXPECT_EQ(row_sums(m), rows);
+	EXPECT_EQ(row_sums(matrix_execution::par, m.view().transposed()), columns);
+	EXPECT_EQ(col_sums(matrix_execution::par, m), columns);
+	EXPECT_EQ(col_sums(m.view().transposed()), rows);
+	EXPECT_EQ(col_reduce(matrix_execution::par, m, -1000.0, [](double x, double y) { return std::max(x, y); }), column_max);
+	EXPECT_EQ(col_reduce(m, 45.0, [](double x, double y) { return std::max(x, y); })[0], std::max(45.0, column_max[0]));
+	const auto row_min = row_reduce(matrix_execution::par, m, 0.0, [](double x, double y) { return std::min(x, y); });
+	EXPECT_EQ(row_min[3], std::min(0.0, *std::min_element(m[3], m[3] + m.count_columns())));
+	EXPECT_EQ(col_sums(matrix<double>(0, 3)), std::vector<double>(3, 0.0));
+	EXPECT_EQ(row_reduce(matrix<double>(2, 0), 1.0, std::plus<>{}), std::vector<double>(2, 1.0));
+
+	matrix<double> small(2, 2);
+	small(0, 0) = 1.0;
+	small(0, 1) = -2.0;
+	small(1, 0) = 3.0;
+	small(1, 1) = 4.0;
+	EXPECT_DOUBLE_EQ(norm_frobenius(small), std::sqrt(30.0));
+	EXPECT_EQ(norm_l1(small), 6.0);
+	EXPECT_EQ(norm_inf(small), 7.0);
+	EXPECT_EQ(norm_inf(matrix_execution::par, m), norm_l1(m.view().transposed()));
+}
+
+TEST(MatrixParallel, Multiply) {
+	const pool_threads threads(4);
+
+	std::mt19937 g(7);
+	const auto a = random_matrix<matrix<double>>(g, 190, 150, -8, 8);
+	const auto b = random_matrix<matrix<double>>(g, 150, 170, -8, 8);
+
+	matrix<double> sequential(190, 170);
+	matrix<double> parallel(190, 170);
+	multiply(matrix_execution::seq, a, b, sequential);
+	multiply(matrix_execution::parallel_policy{ 3 }, a, b, parallel);
+	EXPECT_TRUE(std::equal(std::cbegin(sequential), std::cend(sequential), std::cbegin(parallel)));
+
+	const auto expected = naive_product<double>(a, b);
+	EXPECT_TRUE(std::equal(std::cbegin(sequential), std::cend(sequential), std::cbegin(expected)));
+}
+
+template<class M>
+void check_strassen(const std::size_t rows, const std::size_t inner, const std::size_t columns, const std::size_t cutoff)
+{
+	using T = typename M::value_type;
+	std::mt19937 g(11);
+	const auto a = random_matrix<M>(g, rows, inner, -8, 8);
+	const auto b = random_matrix<M>(g, inner, columns, -8, 8);
+	const auto expected = naive_product<T>(a, b);
+
+	strassen_workspace<T> workspace(cutoff);
+	M sequential(rows, columns);
+	multiply_strassen(matrix_execution::seq, a, b, sequential, workspace);
+	EXPECT_TRUE(std::equal(std::cbegin(sequential), std::cend(sequential), std::cbegin(expected)));
+
+	M parallel(rows, columns);
+	multiply_strassen(matrix_execution::parallel_policy{ 3 }, a, b, parallel, workspace);
+	EXPECT_TRUE(std::equal(std::cbegin(parallel), std::cend(parallel), std::cbegin(expected)));
+	const std::size_t reserved = workspace.size();
+	multiply_strassen(matrix_execution::parallel_policy{ 3 }, a, b, parallel, workspace);
+	EXPECT_EQ(workspace.size(), reserved);
+}
+
+TEST(MatrixParallel, Strassen) {
+	const pool_threads threads(4);
+
+	check_strassen<matrix<double>>(128, 128, 128, 16);
+	check_strassen<contiguous_matrix<double>>(101, 77, 93, 8);
+	check_strassen<matrix<float>>(64, 200, 50, 10);
+	check_strassen<matrix<int>>(90, 91, 92, 20);
+
+	// Rounded sums don't depend on the number of threads, the classic product is
+	// taken when forced.
+	std::mt19937 g(3);
+	const auto a = random_matrix<matrix<double>>(g, 150, 140);
+	const auto b = random_matrix<matrix<double>>(g, 140, 130);
+	strassen_workspace<double> workspace(32);
+	matrix<double> sequential(150, 130);
+	matrix<double> parallel(150, 130);
+	multiply_strassen(matrix_execution::seq, a, b, sequential, workspace);
+	multiply_strassen(matrix_execution::par, a, b, parallel, workspace);
+	EXPECT_TRUE(std::equal(std::cbegin(sequential), std::cend(sequential), std::cbegin(parallel)));
+
+	matrix<double> classic(150, 130);
+	multiply(a, b, classic);
+	double max_error = 0.0;
+	for (std::size_t i = 0; i < classic.count_rows(); ++i) {
+		for (std::size_t j = 0; j < classic.count_columns(); ++j) {
+			max_error = std::max(max_error, std::abs(classic(i, j) - sequential(i, j)));
+		}
+	}
+	EXPECT_LT(max_error, 1e-12);
+
+	force_classic_multiply(true);
+	multiply_strassen(matrix_execution::par, a, b, parallel, workspace);
+	force_classic_multiply(false);
+	EXPECT_TRUE(std::equal(std::cbegin(classic), std::cend(classic), std::cbegin(parallel)));
+
+	EXPECT_THROW(multiply_strassen(a, a, parallel), std::invalid_argument);
+}
+
+TEST(MatrixArithmetic, FusedExpressions) {
+	matrix<double> a(4, 5, 1.0);
+	matrix<double> b(4, 5, 2.0);
+	contiguous_matrix<double> c(4, 5, 3.0);
+
+	const matrix<double> result = a + b * 2 - c;
+	EXPECT_EQ(result.count_rows(), 4);
+	EXPECT_EQ(result.count_columns(), 5);
+	EXPECT_EQ(std::count(std::cbegin(result), std::cend(result), 2.0), 20);
+
+	a = a + 0.5 * b - -c / 3;
+	EXPECT_EQ(std::count(std::cbegin(a), std::cend(a), 3.0), 20);
+
+	a += b;
+	a -= c * 2;
+	EXPECT_EQ(std::count(std::cbegin(a), std::cend(a), -1.0), 20);
+
+	matrix<double> resized;
+	resized = b + c;
+	EXPECT_EQ(resized.count_rows(), 4);
+	EXPECT_EQ(std::count(std::cbegin(resized), std::cend(resized), 5.0), 20);
+
+	const matrix<double> other(5, 4);
+	EXPECT_THROW(a + other, std::invalid_argument);
+	EXPECT_THROW(a += other, std::invalid_argument);
+}
+
+TEST(MatrixParallel, FusedExpressions) {
+	const pool_threads threads(4);
+
+	matrix<float> a(600, 500, 1.0f);
+	matrix<float> b(600, 500, 2.0f);
+	const matrix<float> result = (a - b) * 3 + a;
+	EXPECT_EQ(std::count(std::cbegin(result), std::cend(result), -2.0f), 600 * 500);
+}
+
+TEST(SparseMatrix, BuildFromTriplets) {
+	const csr_matrix<double> a(3, 4, {
+		{ 2, 1, 5.0 }, { 0, 3, 1.0 }, { 0, 0, 2.0 }, { 2, 1, -1.0 }, { 0, 3, 0.5 } });
+	EXPECT_EQ(a.count_rows(), 3);
+	EXPECT_EQ(a.count_columns(), 4);
+	EXPECT_EQ(a.count_nonzeros(), 3);
+	EXPECT_EQ(a(0, 0), 2.0);
+	EXPECT_EQ(a(0, 3), 1.5);
+	EXPECT_EQ(a(2, 1), 4.0);
+	EXPECT_EQ(a(1, 2), 0.0);
+	EXPECT_EQ(std::vector<std::size_t>(a.offsets().begin(), a.offsets().end()), (std::vector<std::size_t>{ 0, 2, 2, 3 }));
+	EXPECT_EQ(std::vector<std::size_t>(a.indices().begin(), a.indices().end()), (std::vector<std::size_t>{ 0, 3, 1 }));
+	EXPECT_THROW(a(3, 0), std::out_of_range);
+
+	const csc_matrix<double> b(3, 4, std::vector<sparse_triplet<double>>{ { 2, 1, 5.0 }, { 0, 3, 1.0 }, { 1, 1, 2.0 } });
+	EXPECT_EQ(b.offsets().size(), 5);
+	EXPECT_EQ(b(1, 1), 2.0);
+	EXPECT_EQ(b(2, 1), 5.0);
+
+	EXPECT_THROW(csr_matrix<double>(2, 2, { { 2, 0, 1.0 } }), std::out_of_range);
+}
+
+TEST(SparseMatrix, DenseAndFormatConversions) {
+	matrix<int> dense(4, 5);
+	dense(0, 1) = 3;
+	dense(2, 0) = -1;
+	dense(2, 4) = 7;
+	dense(3, 3) = 2;
+
+	const csr_matrix<int> csr(dense);
+	EXPECT_EQ(csr.count_nonzeros(), 4);
+	const csc_matrix<int> csc(csr);
+	EXPECT_EQ(csc.count_nonzeros(), 4);
+	EXPECT_EQ(std::vector<std::size_t>(csc.indices().begin(), csc.indices().end()), (std::vector<std::size_t>{ 2, 0, 3, 2 }));
+
+	const auto from_csr = csr.to_dense();
+	const auto from_csc = csr_matrix<int>(csc).to_dense<contiguous_matrix<int>>();
+	EXPECT_TRUE(std::equal(std::cbegin(dense), std::cend(dense), std::cbegin(from_csr)));
+	EXPECT_TRUE(std::equal(std::cbegin(dense), std::cend(dense), std::cbegin(from_csc)));
+}
+
+template<class F>
+void check_sparse_products(const std::size_t rows, const std::size_t columns, const std::size_t nonzeros)
+{
+	std::mt19937 g(11);
+	std::uniform_int_distribution<std::size_t> row_dist(0, rows - 1);
+	std::uniform_int_distribution<std::size_t> column_dist(0, columns - 1);
+	std::uniform_int_distribution<> value_dist(-8, 8);
+
+	std::vector<sparse_triplet<double>> triplets;
+	for (std::size_t k = 0; k < nonzeros; ++k) {
+		triplets.push_back({ row_dist(g), column_dist(g), static_cast<double>(value_dist(g)) });
+	}
+	const sparse_matrix<double, F> a(rows, columns, triplets);
+	const matrix<double> dense = a.to_dense();
+
+	std::vector<double> x(columns);
+	std::generate(x.begin(), x.end(), [&]() { return static_cast<double>(value_dist(g)); });
+	std::vector<double> expected(rows, 0.0);
+	for (std::size_t i = 0; i < rows; ++i) {
+		for (std::size_t j = 0; j < columns; ++j) {
+			expected[i] += dense(i, j) * x[j];
+		}
+	}
+	std::vector<double> y(rows, 1.0);
+	multiply_vector(a, x, y);
+	EXPECT_EQ(y, expected);
+	EXPECT_EQ(a * x, expected);
+	EXPECT_THROW(multiply_vector(a, y, x), std::invalid_argument);
+
+	const auto b = random_matrix<matrix<double>>(g, columns, 7, -8, 8);
+	const auto expected_product = naive_product<double>(dense, b);
+	matrix<double> sequential(rows, 7);
+	multiply(matrix_execution::seq, a, b, sequential);
+	const matrix<double> parallel = a * b;
+	EXPECT_TRUE(std::equal(std::cbegin(expected_product), std::cend(expected_product), std::cbegin(sequential)));
+	EXPECT_TRUE(std::equal(std::cbegin(expected_product), std::cend(expected_product), std::cbegin(parallel)));
+}
+
+TEST(SparseMatrix, ProductsMatchDense) {
+	check_sparse_products<csr_format>(5, 4, 9);
+	check_sparse_products<csc_format>(5, 4, 9);
+
+	const pool_threads threads(4);
+	check_sparse_products<csr_format>(3000, 400, 200000);
+	check_sparse_products<csc_format>(3000, 400, 200000);
+}
+
+TEST(PackedMatrix, ElementsAndConversions) {
+	matrix<int> dense(4, 4);
+	std::iota(std::begin(dense), std::end(dense), 1);
+
+	symmetric_matrix<int> s(dense);
+	EXPECT_EQ(s.values().size(), 10);
+	EXPECT_EQ(s(2, 1), 10);
+	EXPECT_EQ(s(1, 2), 10);
+	s(0, 3) = -1;
+	EXPECT_EQ(s(3, 0), -1);
+	EXPECT_THROW(s(4, 0), std::out_of_range);
+	const matrix<int> symmetric = s.to_dense();
+	EXPECT_EQ(symmetric(3, 0), -1);
+	EXPECT_EQ(symmetric(0, 3), -1);
+	EXPECT_EQ(symmetric(3, 2), 15);
+	EXPECT_EQ(symmetric(2, 3), 15);
+
+	const lower_triangular_matrix<int> lower(dense);
+	upper_triangular_matrix<int> upper(dense);
+	EXPECT_EQ(lower.values(), (std::vector<int>{ 1, 5, 6, 9, 10, 11, 13, 14, 15, 16 }));
+	EXPECT_EQ(upper.values(), (std::vector<int>{ 1, 2, 3, 4, 6, 7, 8, 11, 12, 16 }));
+	EXPECT_EQ(lower(3, 1), 14);
+	EXPECT_EQ(lower(1, 3), 0);
+	EXPECT_EQ(upper(1, 3), 8);
+	EXPECT_EQ(upper(3, 1), 0);
+	upper.set(2, 3, 20);
+	EXPECT_EQ(upper(2, 3), 20);
+	EXPECT_THROW(upper.set(3, 2, 1), std::out_of_range);
+	const auto from_upper = upper.to_dense<contiguous_matrix<int>>();
+	EXPECT_EQ(from_upper(2, 3), 20);
+	EXPECT_EQ(from_upper(3, 2), 0);
+	EXPECT_EQ(from_upper(0, 3), 4);
+
+	matrix<int> wide(3, 5);
+	std::iota(std::begin(wide), std::end(wide), 1);
+	banded_matrix<int> band(wide, 1, 2);
+	EXPECT_EQ(band.row_width(), 4);
+	EXPECT_EQ(band.values(), (std::vector<int>{ 0, 1, 2, 3, 6, 7, 8, 9, 12, 13, 14, 15 }));
+	EXPECT_EQ(band(1, 0), 6);
+	EXPECT_EQ(band(2, 0), 0);
+	EXPECT_EQ(band(0, 3), 0);
+	EXPECT_EQ(band(2, 4), 15);
+	band.set(2, 1, -2);
+	EXPECT_EQ(band(2, 1), -2);
+	EXPECT_THROW(band.set(0, 3, 1), std::out_of_range);
+	EXPECT_THROW(band(3, 0), std::out_of_range);
+	const matrix<int> from_band = band.to_dense();
+	for (std::size_t i = 0; i < 3; ++i) {
+		for (std::size_t j = 0; j < 5; ++j) {
+			EXPECT_EQ(from_band(i, j), band(i, j));
+		}
+	}
+
+	EXPECT_THROW(symmetric_matrix<int>{ wide }, std::invalid_argument);
+	EXPECT_THROW(lower_triangular_matrix<int>{ wide }, std::invalid_argument);
+}
+
+void check_packed_products(const std::size_t n)
+{
+	std::mt19937 g(13);
+	std::uniform_int_distribution<> value_dist(-8, 8);
+	const auto dense_product = [](const matrix<double>& a, const std::vector<double>& x) {
+		std::vector<double> y(a.count_rows(), 0.0);
+		for (std::size_t i = 0; i < a.count_rows(); ++i) {
+			for (std::size_t j = 0; j < a.count_columns(); ++j) y[i] += a(i, j) * x[j];
+		}
+		return y;
+	};
+
+	std::vector<double> x(n);
+	std::generate(x.begin(), x.end(), [&]() { return static_cast<double>(value_dist(g)); });
+
+	const symmetric_matrix<double> s(random_matrix<matrix<double>>(g, n, n, -8, 8));
+	const matrix<double> symmetric = s.to_dense();
+	const auto expected = dense_product(symmetric, x);
+	std::vector<double> y(n, 1.0);
+	multiply_vector(s, x, y);
+	EXPECT_EQ(y, expected);
+	EXPECT_EQ(s * x, expected);
+	EXPECT_THROW(multiply_vector(s, x, x), std::invalid_argument);
+
+	const auto b = random_matrix<matrix<double>>(g, n, 7, -8, 8);
+	const auto expected_product = naive_product<double>(symmetric, b);
+	matrix<double> sequential(n, 7);
+	multiply(matrix_execution::seq, s, b, sequential);
+	const matrix<double> parallel = s * b;
+	EXPECT_TRUE(std::equal(std::cbegin(expected_product), std::cend(expected_product), std::cbegin(sequential)));
+	EXPECT_TRUE(std::equal(std::cbegin(expected_product), std::cend(expected_product), std::cbegin(parallel)));
+
+	const banded_matrix<double> band(random_matrix<matrix<double>>(g, n, n + 3, -8, 8), 2, 5);
+	const auto expected_band = dense_product(band.to_dense(), std::vector<double>(n + 3, 2.0));
+	EXPECT_EQ(band * std::vector<double>(n + 3, 2.0), expected_band);
+	EXPECT_THROW(multiply_vector(band, x, y), std::invalid_argument);
+}
+
+TEST(PackedMatrix, ProductsMatchDense) {
+	check_packed_products(5);
+	check_packed_products(70);
+
+	const pool_threads threads(4);
+	check_packed_products(1500);
+}
+
+template<class Tri>
+void check_triangular_solve(const std::size_t n, const std::size_t columns)
+{
+	std::mt19937 g(17);
+	std::uniform_real_distribution<> value_dist(-1.0, 1.0);
+	auto dense = random_matrix<matrix<double>>(g, n, n);
+	for (std::size_t i = 0; i < n; ++i) dense(i, i) = 4.0 + value_dist(g);
+	const triangular_matrix<double, Tri> t(dense);
+	const matrix<double> a = t.to_dense();
+
+	const auto x = random_matrix<matrix<double>>(g, n, columns);
+	const auto b = naive_product<double>(a, x);
+	const auto solved = solve(t, b);
+	const auto sequential = solve(matrix_execution::seq, t, b);
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t j = 0; j < columns; ++j) {
+			EXPECT_NEAR(solved(i, j), x(i, j), 1e-10);
+			EXPECT_NEAR(sequential(i, j), x(i, j), 1e-10);
+		}
+	}
+
+	std::vector<double> column(n);
+	for (std::size_t i = 0; i < n; ++i) column[i] = b(i, 0);
+	const auto solved_column = solve(t, column);
+	for (std::size_t i = 0; i < n; ++i) {
+		EXPECT_NEAR(solved_column[i], x(i, 0), 1e-10);
+	}
+}
+
+TEST(PackedMatrix, TriangularSolve) {
+	check_triangular_solve<lower_triangle>(6, 2);
+	check_triangular_solve<upper_triangle>(6, 2);
+	check_triangular_solve<lower_triangle>(40, 9);
+	check_triangular_solve<upper_triangle>(40, 9);
+	check_triangular_solve<lower_triangle>(300, 20);
+	check_triangular_solve<upper_triangle>(300, 20);
+
+	lower_triangular_matrix<double> singular(3, 1.0);
+	singular.set(1, 1, 0.0);
+	EXPECT_THROW(solve(singular, std::vector<double>(3, 1.0)), matrix_factorization_error);
+	EXPECT_THROW(solve(lower_triangular_matrix<double>(3, 1.0), std::vector<double>(2, 1.0)), std::invalid_argument);
+}
+
+
+TEST(MatrixBinaryFile, SaveAndLoad) {
+	const std::string path = ::testing::TempDir() + "matrix_binary_save_load.bin";
+
+	matrix<double> a(5, 7);
+	std::iota(std::begin(a), std::end(a), -3.5);
+	save_matrix(path, a);
+	const auto loaded = load_matrix<contiguous_matrix<double>>(path);
+	EXPECT_EQ(loaded.count_rows(), 5);
+	EXPECT_EQ(loaded.count_columns(), 7);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(loaded)));
+
+	// Loading into an existing matrix replaces its shape.
+	matrix<double> existing(2, 2, 1.0);
+	load_matrix(path, existing);
+	EXPECT_EQ(existing.count_rows(), 5);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(existing)));
+
+	save_matrix(path, matrix<std::uint16_t>());
+	EXPECT_EQ(load_matrix<matrix<std::uint16_t>>(path).count_rows(), 0);
+
+	EXPECT_THROW(load_matrix<matrix<float>>(path), matrix_file_error);
+	EXPECT_THROW(load_matrix<matrix<std::int16_t>>(path), matrix_file_error);
+	EXPECT_THROW(load_matrix<matrix<double>>(path + ".missing"), matrix_file_error);
+	EXPECT_THROW(save_matrix(path, a, 48), std::invalid_argument);
+}
+
+TEST(MatrixBinaryFile, MappedMatrix) {
+	const std::string path = ::testing::TempDir() + "matrix_binary_mapped.bin";
+
+	matrix<float> a(33, 10);
+	std::iota(std::begin(a), std::end(a), 1.0f);
+	save_matrix(path, a, 128);
+
+	const mapped_matrix<float> view(path);
+	EXPECT_EQ(view.count_rows(), 33);
+	EXPECT_EQ(view.count_columns(), 10);
+	EXPECT_EQ(view.stride(), 32);
+	for (std::size_t row = 0; row < view.count_rows(); ++row) {
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(view[row]) % 128, 0);
+	}
+	EXPECT_EQ(view(32, 9), a(32, 9));
+	EXPECT_THROW(view(33, 0), std::out_of_range);
+
+	const matrix<float> twice = view * 2;
+	EXPECT_EQ(twice(3, 4), 2 * a(3, 4));
+	EXPECT_THROW(mapped_matrix<double>{ path }, matrix_file_error);
+
+	// rows * stride * sizeof(T) wraps around to 0 in 64 bits.
+	auto header = matrix_detail::make_file_header<float>(2, 3, 16);
+	header.rows = std::uint64_t{ 1 } << 32;
+	header.stride = std::uint64_t{ 1 } << 30;
+	{
+		std::ofstream os(path, std::ios::binary);
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+	EXPECT_THROW(mapped_matrix<float>{ path }, matrix_file_error);
+	EXPECT_THROW(load_matrix<matrix<float>>(path), matrix_file_error);
+}
+
+TEST(MatrixBinaryFile, ForeignByteOrder) {
+	const std::string path = ::testing::TempDir() + "matrix_binary_foreign.bin";
+
+	// A 2 x 3 matrix of int32 as written by a machine of the other byte order.
+	auto header = matrix_detail::make_file_header<std::int32_t>(2, 3, 16);
+	matrix_detail::swap_header_bytes(header);
+	{
+		std::ofstream os(path, std::ios::binary);
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (std::int32_t value = 1; value <= 8; ++value) {
+			const std::int32_t swapped = matrix_detail::byte_swapped(value * 1000);
+			os.write(reinterpret_cast<const char*>(&swapped), sizeof(swapped));
+		}
+	}
+
+	const auto loaded = load_matrix<matrix<std::int32_t>>(path);
+	EXPECT_EQ(loaded(0, 0), 1000);
+	EXPECT_EQ(loaded(0, 2), 3000);
+	EXPECT_EQ(loaded(1, 0), 5000);
+	EXPECT_EQ(loaded(1, 2), 7000);
+	EXPECT_THROW(mapped_matrix<std::int32_t>{ path }, matrix_file_error);
+}
+
+TEST(MatrixTiledFile, ElementsAndBlocks) {
+	const std::string path = ::testing::TempDir() + "matrix_tiled_elements.tiles";
+
+	matrix<double> a(70, 45);
+	std::iota(std::begin(a), std::end(a), 0.5);
+	{
+		tiled_matrix<double> tiled(path, 70, 45, { 16, 4, 1 });
+		EXPECT_EQ(tiled.count_tile_rows(), 5);
+		EXPECT_EQ(tiled.count_tile_columns(), 3);
+		EXPECT_EQ(tiled(69, 44), 0.0);
+
+		tiled.set_block(0, 0, a);
+		tiled.set(3, 40, -1.0);
+		a(3, 40) = -1.0;
+		EXPECT_EQ(tiled(3, 40), -1.0);
+		EXPECT_THROW(tiled(70, 0), std::out_of_range);
+		EXPECT_THROW(tiled.set(0, 45, 1.0), std::out_of_range);
+		EXPECT_THROW(tiled.block(60, 0, 11, 1), std::out_of_range);
+
+		const auto edge = tiled.tile(4, 2);
+		EXPECT_EQ(edge.view().count_rows(), 6);
+		EXPECT_EQ(edge.view().count_columns(), 13);
+		EXPECT_EQ(edge.view()[5][12], a(69, 44));
+
+		const auto statistics = tiled.cache_statistics();
+		EXPECT_GT(statistics.evictions, 0);
+		EXPECT_GT(statistics.writes, 0);
+	}
+
+	// Reopened with another cache, the tile size is the one of the file.
+	const tiled_matrix<double> reopened(path, { 256, 6, 0 });
+	EXPECT_EQ(reopened.tile_size(), 16);
+	const auto all = reopened.block(0, 0, 70, 45);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(all)));
+	const auto inner = reopened.block(10, 7, 30, 20);
+	EXPECT_EQ(inner(0, 0), a(10, 7));
+	EXPECT_EQ(inner(29, 19), a(39, 26));
+
+	EXPECT_THROW(tiled_matrix<float>{ path }, matrix_file_error);
+	EXPECT_THROW(tiled_matrix<double>(path + ".missing"), matrix_file_error);
+	EXPECT_THROW(tiled_matrix<double>(path, 4, 4, { 16, 3, 1 }), std::invalid_argument);
+	save_matrix(path, a);
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+}
+
+TEST(MatrixTiledFile, CorruptedOrTruncatedFile) {
+	const std::string path = ::testing::TempDir() + "matrix_tiled_corrupted.tiles";
+	{
+		tiled_matrix<double> tiled(path, 40, 40, { 16, 4, 0 });
+		tiled.set(39, 39, 1.0);
+	}
+	std::string contents;
+	{
+		std::ifstream is(path, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+	}
+	// 3 x 3 tiles of 16 x 16 elements after the 4096 bytes of header.
+	ASSERT_EQ(contents.size(), 4096 + 9 * 16 * 16 * sizeof(double));
+	matrix_detail::matrix_file_header header{};
+	std::memcpy(&header, contents.data(), sizeof(header));
+
+	const auto write_file = [&](const matrix_detail::matrix_file_header& h, const std::size_t bytes) {
+		std::string changed = contents.substr(0, bytes);
+		std::memcpy(changed.data(), &h, std::min(sizeof(h), bytes));
+		std::ofstream os(path, std::ios::binary | std::ios::trunc);
+		os.write(changed.data(), static_cast<std::streamsize>(changed.size()));
+	};
+
+	write_file(header, contents.size() - 1);
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+	write_file(header, 10);
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+
+	auto larger = header;
+	larger.rows = 49;
+	write_file(larger, contents.size());
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+	larger.rows = std::uint64_t{ 1 } << 62;
+	larger.columns = std::uint64_t{ 1 } << 62;
+	write_file(larger, contents.size());
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+
+	auto no_tiles = header;
+	no_tiles.stride = 0;
+	write_file(no_tiles, contents.size());
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+
+	auto newer = header;
+	newer.version = matrix_detail::matrix_file_version + 1;
+	write_file(newer, contents.size());
+	EXPECT_THROW(tiled_matrix<double>{ path }, matrix_file_error);
+
+	write_file(header, contents.size());
+	const tiled_matrix<double> reopened(path);
+	EXPECT_EQ(reopened(39, 39), 1.0);
+}
+
+TEST(MatrixTiledFile, MultiplyAndTranspose) {
+	const std::string path = ::testing::TempDir() + "matrix_tiled_";
+	std::mt19937 g(11);
+	const auto a = random_matrix<matrix<double>>(g, 150, 97);
+	const auto b = random_matrix<matrix<double>>(g, 97, 130);
+	const matrix<double> expected = a * b;
+
+	// Caches far smaller than the matrices.
+	const tiled_matrix_options options{ 32, 6, 2 };
+	tiled_matrix<double> ta(path + "a.tiles", 150, 97, options);
+	tiled_matrix<double> tb(path + "b.tiles", 97, 130, options);
+	tiled_matrix<double> tc(path + "c.tiles", 150, 130, options);
+	ta.set_block(0, 0, a);
+	tb.set_block(0, 0, b);
+
+	multiply(matrix_execution::par, ta, tb, tc);
+	const auto product = tc.block(0, 0, 150, 130);
+	for (std::size_t row = 0; row < product.count_rows(); ++row) {
+		for (std::size_t column = 0; column < product.count_columns(); ++column) {
+			EXPECT_NEAR(product(row, column), expected(row, column), 1e-12);
+		}
+	}
+	EXPECT_GT(ta.cache_statistics().misses + tb.cache_statistics().misses, 0);
+
+	tiled_matrix<double> tt(path + "t.tiles", 97, 150, options);
+	transpose(ta, tt);
+	const auto transposed = tt.block(0, 0, 97, 150);
+	for (std::size_t row = 0; row < a.count_rows(); ++row) {
+		for (std::size_t column = 0; column < a.count_columns(); ++column) {
+			EXPECT_EQ(transposed(column, row), a(row, column));
+		}
+	}
+
+	tiled_matrix<double> other(path + "o.tiles", 97, 130, { 16, 6, 2 });
+	EXPECT_THROW(multiply(ta, other, tc), std::invalid_argument);
+	EXPECT_THROW(multiply(ta, ta, tc), std::invalid_argument);
+	EXPECT_THROW(transpose(ta, tc), std::invalid_argument);
+}
+
+TEST(MatrixTiledFile, Reductions) {
+	const std::string path = ::testing::TempDir() + "matrix_tiled_reductions_";
+	std::mt19937 g(13);
+	auto a = random_matrix<matrix<double>>(g, 75, 41);
+	const auto b = random_matrix<matrix<double>>(g, 75, 41);
+	// The extremes twice, the second occurrence in a tile visited before the
+	// tile of the first.
+	a(17, 40) = -5.0;
+	a(18, 0) = -5.0;
+	a(20, 33) = 5.0;
+	a(30, 5) = 5.0;
+
+	const tiled_matrix_options options{ 16, 4, 2 };
+	tiled_matrix<double> ta(path + "a.tiles", 75, 41, options);
+	tiled_matrix<double> tb(path + "b.tiles", 75, 41, options);
+	ta.set_block(0, 0, a);
+	tb.set_block(0, 0, b);
+
+	EXPECT_NEAR(sum(ta), sum(a), 1e-12);
+	EXPECT_NEAR(sum(matrix_execution::par, ta, summation::kahan), sum(a, summation::kahan), 1e-12);
+	EXPECT_NEAR(dot(ta, tb), dot(a, b), 1e-12);
+	EXPECT_EQ(min_value(ta), -5.0);
+	EXPECT_EQ(max_value(matrix_execution::par, ta), 5.0);
+	EXPECT_EQ(argmin(ta), argmin(a));
+	EXPECT_EQ(argmin(ta), std::make_pair(std::size_t{ 17 }, std::size_t{ 40 }));
+	EXPECT_EQ(argmax(ta), std::make_pair(std::size_t{ 20 }, std::size_t{ 33 }));
+	EXPECT_NEAR(norm_frobenius(ta), norm_frobenius(a), 1e-12);
+	EXPECT_NEAR(norm_l1(ta), norm_l1(a), 1e-12);
+	EXPECT_NEAR(norm_inf(matrix_execution::par, ta), norm_inf(a), 1e-12);
+	const auto rows = row_sums(ta);
+	const auto expected_rows = row_sums(a);
+	ASSERT_EQ(rows.size(), expected_rows.size());
+	for (std::size_t row = 0; row < rows.size(); ++row) {
+		EXPECT_NEAR(rows[row], expected_rows[row], 1e-12);
+	}
+	const auto columns = col_sums(ta);
+	const auto expected_columns = col_sums(a);
+	ASSERT_EQ(columns.size(), expected_columns.size());
+	for (std::size_t column = 0; column < columns.size(); ++column) {
+		EXPECT_NEAR(columns[column], expected_columns[column], 1e-12);
+	}
+
+	tiled_matrix<std::int8_t> small(path + "i.tiles", 20, 20, options);
+	small.set(19, 19, 100);
+	small.set(0, 0, 100);
+	EXPECT_EQ(sum(small), 200);
+	EXPECT_EQ(row_sums(small)[19], 100);
+
+	tiled_matrix<double> other(path + "o.tiles", 75, 41, { 32, 4, 2 });
+	EXPECT_THROW(dot(ta, other), std::invalid_argument);
+	tiled_matrix<double> empty(path + "e.tiles", 0, 41, options);
+	EXPECT_EQ(sum(empty), 0.0);
+	EXPECT_THROW(min_value(empty), std::invalid_argument);
+}
+
+TEST(MatrixTextFile, ReadCsvAndWhitespace) {
+	matrix<double> csv;
+	std::istringstream csv_text(" 1, 2.5,3\r\n\n-4,+5 ,6e1\n");
+	read_text(csv_text, csv);
+	EXPECT_EQ(csv.count_rows(), 2);
+	EXPECT_EQ(csv.count_columns(), 3);
+	EXPECT_EQ(csv(0, 1), 2.5);
+	EXPECT_EQ(csv(1, 1), 5.0);
+	EXPECT_EQ(csv(1, 2), 60.0);
+
+	// Chunks shorter than a line.
+	contiguous_matrix<int> spaces;
+	std::istringstream spaces_text("10 20\t30\n 40  50 60\n70 80 90");
+	read_text(spaces_text, spaces, whitespace_format, 4);
+	EXPECT_EQ(spaces.count_rows(), 3);
+	EXPECT_EQ(spaces(2, 2), 90);
+	EXPECT_EQ(std::accumulate(std::cbegin(spaces), std::cend(spaces), 0), 450);
+
+	const auto error_message = [](const std::string& text, const text_format& format) -> std::string {
+		try {
+			parse_text<matrix<int>>(text, format);
+		}
+		catch (const matrix_text_error& e) {
+			return e.what();
+		}
+		return {};
+	};
+	EXPECT_EQ(error_message("1,2\n3\n", csv_format), "Row has a different number of elements at line 2");
+	EXPECT_EQ(error_message("1,2\n\n3,x\n", csv_format), "Invalid number at line 3");
+	EXPECT_EQ(error_message("1,2,\n", csv_format), "Missing element after a delimiter at line 1");
+	EXPECT_EQ(error_message("1;2\n", csv_format), "Expected a delimiter at line 1");
+	EXPECT_EQ(error_message("1.5 2\n", whitespace_format), "Expected a space between elements at line 1");
+	EXPECT_EQ(parse_text<matrix<int>>("\n \n").count_rows(), 0);
+}
+
+TEST(MatrixTextFile, WriteAndReadBack) {
+	std::mt19937 g(3);
+	std::normal_distribution<double> dist(0.0, 1e6);
+	matrix<double> a(40, 9);
+	std::generate(std::begin(a), std::end(a), [&]() { return dist(g); });
+
+	std::ostringstream os;
+	write_text(os, a, whitespace_format, 256);
+	const auto b = parse_text<matrix<double>>(os.str(), whitespace_format);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(b)));
+
+	const std::string path = ::testing::TempDir() + "matrix_text.csv";
+	write_text(path, a);
+	const auto c = read_text<matrix<double>>(path);
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(c)));
+}
+
+TEST(MatrixTextFile, ParallelParse) {
+	const pool_threads threads(4);
+
+	matrix<std::int64_t> a(20000, 30);
+	std::iota(std::begin(a), std::end(a), std::int64_t{ -100000 });
+	std::ostringstream os;
+	write_text(os, a);
+	std::string text = os.str();
+	ASSERT_GT(text.size(), 2 * default_text_chunk_size);
+
+	const auto parsed = parse_text<contiguous_matrix<std::int64_t>>(matrix_execution::par, text);
+	EXPECT_EQ(parsed.count_rows(), a.count_rows());
+	EXPECT_EQ(parsed.count_columns(), a.count_columns());
+	EXPECT_TRUE(std::equal(std::cbegin(a), std::cend(a), std::cbegin(parsed)));
+
+	// The line of an error is the same as in sequential parsing.
+	const std::size_t line_start = text.size() - 10;
+	text.insert(text.begin() + static_cast<std::ptrdiff_t>(text.rfind('\n', line_start) + 1), '#');
+	EXPECT_THROW(
+		try {
+			parse_text<matrix<std::int64_t>>(matrix_execution::par, text);
+		}
+		catch (const matrix_text_error& e) {
+			EXPECT_EQ(std::string{ e.what() }, "Invalid number at line 20000");
+			throw;
+		},
+		matrix_text_error);
+}
+
+template<class M>
+void check_views()
+{
+	M m(4, 5);
+	std::iota(std::begin(m), std::end(m), 0);
+	const M& cm = m;
+
+	const auto b = cm.block(1, 2, 2, 3);
+	EXPECT_EQ(b.count_rows(), 2);
+	EXPECT_EQ(b.count_columns(), 3);
+	EXPECT_EQ(b(0, 0), 7);
+	EXPECT_EQ(b(1, 2), 14);
+	EXPECT_EQ(b.block(1, 1, 1, 2)(0, 1), 14);
+	EXPECT_THROW(b(2, 0), std::out_of_range);
+	EXPECT_THROW(cm.block(3, 0, 2, 1), std::out_of_range);
+	EXPECT_EQ(cm.row(2)(0, 4), 14);
+	EXPECT_EQ(cm.column(3).count_rows(), 4);
+	EXPECT_EQ(cm.column(3)(2, 0), 13);
+
+	const auto t = cm.transposed();
+	EXPECT_EQ(t.count_rows(), 5);
+	EXPECT_EQ(t.count_columns(), 4);
+	EXPECT_EQ(t(4, 1), 9);
+	EXPECT_EQ(t.block(1, 2, 3, 2)(2, 1), 18);
+	EXPECT_EQ(t.transposed()(1, 4), 9);
+
+	// Updates of a part in place.
+	m.block(0, 0, 2, 2) = cm.block(2, 3, 2, 2) * 10;
+	EXPECT_EQ(m(0, 0), 130);
+	EXPECT_EQ(m(1, 1), 190);
+	EXPECT_EQ(m(2, 0), 10);
+	m.row(3) += m.row(2);
+	EXPECT_EQ(m(3, 4), 33);
+	m.column(4) -= m.column(4);
+	EXPECT_EQ(m(3, 4), 0);
+	m.transposed().row(2) = M(1, 4, 7);
+	EXPECT_EQ(m(0, 2), 7);
+	EXPECT_EQ(m(3, 2), 7);
+	EXPECT_THROW(m.row(0) = cm.column(0), std::invalid_argument);
+
+	matrix_view<int> v = m.block(2, 0, 2, 2);
+	v = cm.block(0, 3, 2, 2);
+	EXPECT_EQ(m(2, 0), 3);
+	EXPECT_EQ(m(3, 0), 8);
+	EXPECT_EQ(m(3, 1), 0);
+}
+
+// A transposed view of the destination is read from a temporary, elements of
+// the destination are not overwritten before they are read at their transposed position.
+template<class M>
+void check_transposed_alias()
+{
+	M m(3, 3);
+	std::iota(std::begin(m), std::end(m), 0);
+	const int expected_sum[] = { 0, 4, 8, 4, 8, 12, 8, 12, 16 };
+	const int expected_transpose[] = { 0, 3, 6, 1, 4, 7, 2, 5, 8 };
+
+	m = m + m.view().transposed();
+	EXPECT_TRUE(std::equal(std::cbegin(m), std::cend(m), std::cbegin(expected_sum)));
+
+	std::iota(std::begin(m), std::end(m), 0);
+	m.view().transposed() = m;
+	EXPECT_TRUE(std::equal(std::cbegin(m), std::cend(m), std::cbegin(expected_transpose)));
+
+	std::iota(std::begin(m), std::end(m), 0);
+	m += m.transposed();
+	EXPECT_TRUE(std::equal(std::cbegin(m), std::cend(m), std::cbegin(expected_sum)));
+
+	std::iota(std::begin(m), std::end(m), 0);
+	m.transposed() = m.transposed() * 2;
+	EXPECT_EQ(m(0, 1), 2);
+	m.block(0, 0, 2, 2) = m.block(1, 1, 2, 2).transposed();
+	EXPECT_EQ(m(0, 1), 14);
+	EXPECT_EQ(m(1, 0), 10);
+}
+
+TEST(MatrixView, TransposedOperandOfItsDestination) {
+	check_transposed_alias<matrix<int>>();
+	check_transposed_alias<contiguous_matrix<int>>();
+}
+
+TEST(MatrixView, BlocksRowsColumnsTransposed) {
+	check_views<matrix<int>>();
+	check_views<contiguous_matrix<int>>();
+	check_views<matrix<int, std::allocator<int>, contiguous_storage<32>>>();
+}
+
+TEST(MatrixView, OperandsOfAlgorithms) {
+	matrix<double> a(6, 6);
+	std::iota(std::begin(a), std::end(a), 1.0);
+
+	// Multiply of blocks into a block, without copies of the operands.
+	contiguous_matrix<double> c(4, 4, 0.0);
+	auto c_block = c.block(1, 1, 3, 3);
+	multiply(a.block(0, 0, 3, 2), a.transposed().block(1, 1, 2, 3), c_block);
+	const matrix<double> a_block = a.block(0, 0, 3, 2) * 1.0;
+	const matrix<double> at_block = a.transposed().block(1, 1, 2, 3) * 1.0;
+	const auto expected = naive_product<double>(a_block, at_block);
+	EXPECT_EQ(c(0, 0), 0.0);
+	EXPECT_EQ(c(1, 1), expected(0, 0));
+	EXPECT_EQ(c(3, 3), expected(2, 2));
+
+	std::ostringstream os;
+	write_text(os, a.block(4, 4, 2, 2));
+	EXPECT_EQ(os.str(), "29,30\n35,36\n");
+
+	const std::string path = ::testing::TempDir() + "matrix_view_block.bin";
+	save_matrix(path, a.column(5));
+	const auto column = load_matrix<matrix<double>>(path);
+	EXPECT_EQ(column.count_rows(), 6);
+	EXPECT_EQ(column(5, 0), 36.0);
+	auto first_row = a.transposed().column(0);
+	load_matrix(path, first_row);
+	EXPECT_EQ(a(0, 5), 36.0);
+}
+
+template<class M>
+void check_transpose(const std::size_t rows, const std::size_t columns)
+{
+	using T = typename M::value_type;
+	M m(rows, columns);
+	std::iota(std::begin(m), std::end(m), T(1));
+
+	const M t = transpose(m);
+	ASSERT_EQ(t.count_rows(), columns);
+	ASSERT_EQ(t.count_columns(), rows);
+	M in_place = m;
+	in_place.transpose_inplace();
+	ASSERT_EQ(in_place.count_rows(), columns);
+	ASSERT_EQ(in_place.count_columns(), rows);
+	for (std::size_t i = 0; i < rows; ++i) {
+		for (std::size_t j = 0; j < columns; ++j) {
+			ASSERT_EQ(t(j, i), m(i, j));
+			ASSERT_EQ(in_place(j, i), m(i, j));
+		}
+	}
+}
+
+template<class T>
+void check_transpose_sizes()
+{
+	for (const auto& [rows, columns] : { std::pair<std::size_t, std::size_t>{ 1, 1 }, { 1, 7 }, { 9, 1 },
+		{ 4, 4 }, { 8, 8 }, { 37, 70 }, { 70, 37 }, { 64, 64 }, { 129, 130 }, { 300, 17 } }) {
+		check_transpose<matrix<T>>(rows, columns);
+		check_transpose<contiguous_matrix<T>>(rows, columns);
+		check_transpose<matrix<T, std::allocator<T>, contiguous_storage<64>>>(rows, columns);
+	}
+}
+
+TEST(MatrixTranspose, KernelsMatchScalar) {
+	for (const simd_level level : { simd_level::scalar, simd_level::sse2, simd_level::avx2 }) {
+		limit_simd_level(level);
+		check_transpose_sizes<float>();
+		check_transpose_sizes<double>();
+		check_transpose_sizes<std::int32_t>();
+		check_transpose_sizes<std::int16_t>();
+	}
+	limit_simd_level(simd_level::avx512);
+	check_transpose_sizes<std::int64_t>();
+	check_transpose<matrix<long double>>(33, 31);
+
+	// Big enough to be split between threads.
+	check_transpose<contiguous_matrix<float>>(700, 900);
+}
+
+TEST(MatrixTranspose, InPlaceKeepsStorage) {
+	contiguous_matrix<double> m(60, 20);
+	std::iota(std::begin(m), std::end(m), 0.0);
+	const double* data = m.data();
+	m.transpose_inplace();
+	EXPECT_EQ(m.data(), data);
+	EXPECT_EQ(m.count_rows(), 20);
+	EXPECT_EQ(m(19, 59), 59 * 20 + 19.0);
+	transpose_inplace(m);
+	EXPECT_EQ(m.data(), data);
+	EXPECT_EQ(m(59, 19), 59 * 20 + 19.0);
+
+	matrix<std::string> s(2, 3);
+	s(0, 2) = "a";
+	s(1, 0) = "b";
+	s.transpose_inplace();
+	EXPECT_EQ(s.count_rows(), 3);
+	EXPECT_EQ(s(2, 0), "a");
+	EXPECT_EQ(s(0, 1), "b");
+	matrix<std::string> square(3, 3, "x");
+	square(0, 2) = "y";
+	transpose_inplace(square);
+	EXPECT_EQ(square(2, 0), "y");
+	EXPECT_EQ(transpose(square)(0, 2), "y");
+}
+
+TEST(MatrixTranspose, IntoViews) {
+	matrix<float> a(50, 40);
+	std::iota(std::begin(a), std::end(a), 0.f);
+	contiguous_matrix<float> c(45, 45, -1.f);
+	transpose(matrix_execution::par, a.block(5, 3, 33, 35), c.block(2, 4, 35, 33));
+	EXPECT_EQ(c(2, 4), a(5, 3));
+	EXPECT_EQ(c(36, 36), a(37, 37));
+	EXPECT_EQ(c(1, 4), -1.f);
+	EXPECT_EQ(c(2, 37), -1.f);
+
+	// Operands without pointer rows.
+	matrix<float> b(40, 50);
+	transpose(a.transposed(), b.transposed());
+	EXPECT_EQ(b(0, 0), a(0, 0));
+	EXPECT_EQ(b(39, 49), a(49, 39));
+	EXPECT_EQ(b(10, 3), a(3, 10));
+	EXPECT_THROW(transpose(a, a), std::invalid_argument);
+}
+
+template<class MA, class MB>
+double max_difference(const MA& a, const MB& b)
+{
+	double result = 0.0;
+	for (std::size_t i = 0; i < a.count_rows(); ++i) {
+		for (std::size_t j = 0; j < a.count_columns(); ++j) {
+			result = std::max(result, std::abs(a[i][j] - b[i][j]));
+		}
+	}
+	return result;
+}
+
+template<class M>
+void check_factorizations(const std::size_t n)
+{
+	std::mt19937 g(static_cast<unsigned>(n));
+	const M a = random_matrix<M>(g, n, n);
+	const double tolerance = 1e-10 * static_cast<double>(n);
+
+	// P A = L U
+	const auto f = lu(a);
+	M l(n, n, 0.0), u(n, n, 0.0), pa = a;
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t j = 0; j < n; ++j) {
+			if (j < i) l[i][j] = f.factors[i][j];
+			else u[i][j] = f.factors[i][j];
+		}
+		l[i][i] = 1.0;
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		std::swap_ranges(pa[i], pa[i] + n, pa[f.pivots[i]]);
+	}
+	EXPECT_LT(max_difference(pa, naive_product<double>(l, u)), tolerance);
+
+	// Several right-hand sides, then a vector.
+	const M b = random_matrix<M>(g, n, 10);
+	const M x = solve(a, b);
+	EXPECT_LT(max_difference(naive_product<double>(a, x), b), tolerance);
+	std::vector<double> v(n, 1.0);
+	const auto y = f.solve(v);
+	for (std::size_t i = 0; i < n; ++i) {
+		double sum = 0.0;
+		for (std::size_t j = 0; j < n; ++j) sum += a[i][j] * y[j];
+		EXPECT_NEAR(sum, 1.0, tolerance);
+	}
+	const auto identity = naive_product<double>(a, inverse(a));
+	for (std::size_t i = 0; i < n; ++i) {
+		EXPECT_NEAR(identity[i][i], 1.0, tolerance);
+	}
+
+	// A = L L^T for a symmetric positive definite A.
+	M spd = naive_product<double>(a, transpose(a)) * 1.0;
+	for (std::size_t i = 0; i < n; ++i) spd[i][i] += static_cast<double>(n);
+	const M c = cholesky(spd);
+	EXPECT_EQ(c[0][n - 1], 0.0);
+	EXPECT_LT(max_difference(naive_product<double>(c, transpose(c)), spd), tolerance * n);
+
+	// A = Q R, Q^T Q = I, tall and wide.
+	for (const auto& [rows, columns] : { std::pair<std::size_t, std::size_t>{ n + 30, n }, { n, n + 30 } }) {
+		const M r_input = random_matrix<M>(g, rows, columns);
+		const auto qr_f = qr(r_input);
+		const M q = qr_f.q();
+		const M r = qr_f.r();
+		EXPECT_EQ(q.count_columns(), std::min(rows, columns));
+		EXPECT_LT(max_difference(naive_product<double>(q, r), r_input), tolerance);
+		const auto qtq = naive_product<double>(transpose(q), q);
+		for (std::size_t i = 0; i < qtq.count_rows(); ++i) {
+			EXPECT_NEAR(qtq[i][i], 1.0, tolerance);
+			if (i + 1 < qtq.count_rows()) {
+				EXPECT_NEAR(qtq[i][i + 1], 0.0, tolerance);
+			}
+		}
+	}
+}
+
+TEST(MatrixFactorization, SmallAndBlocked) {
+	check_factorizations<matrix<double>>(37);
+	check_factorizations<contiguous_matrix<double>>(100);
+	check_factorizations<matrix<double>>(300);
+	check_factorizations<contiguous_matrix<double>>(333);
+}
+
+matrix<double> from_rows(std::initializer_list<std::initializer_list<double>> rows)
+{
+	matrix<double> m;
+	for (const auto& row : rows) m.push_row(row);
+	return m;
+}
+
+TEST(MatrixFactorization, Errors) {
+	const matrix<double> singular = from_rows({ { 1.0, 2.0 }, { 2.0, 4.0 } });
+	EXPECT_EQ(determinant(singular), 0.0);
+	EXPECT_THROW(solve(singular, std::vector<double>{ 1.0, 1.0 }), matrix_factorization_error);
+	EXPECT_THROW(inverse(singular), matrix_factorization_error);
+	EXPECT_THROW(cholesky(singular), matrix_factorization_error);
+	EXPECT_THROW(lu(matrix<double>(2, 3)), std::invalid_argument);
+
+	const matrix<double> m = from_rows({ { 2.0, 1.0 }, { 1.0, 3.0 } });
+	EXPECT_THROW(solve(m, std::vector<double>(3)), std::invalid_argument);
+	EXPECT_NEAR(determinant(m), 5.0, 1e-14);
+	const auto x = qr(from_rows({ { 1.0, 0.0 }, { 0.0, 1.0 }, { 1.0, 1.0 } })).solve(std::vector<double>{ 1.0, 1.0, 0.0 });
+	EXPECT_EQ(x.size(), 2);
+	EXPECT_NEAR(x[0], 1.0 / 3.0, 1e-14);
+	EXPECT_NEAR(x[1], 1.0 / 3.0, 1e-14);
+}
+
+TEST(MatrixFloat16, Conversions) {
+	EXPECT_EQ(float16(1.0f).bits, 0x3c00);
+	EXPECT_EQ(float16(-2.0f).bits, 0xc000);
+	EXPECT_EQ(float16(65504.0f).bits, 0x7bff);
+	EXPECT_EQ(float16(65520.0f).bits, 0x7c00);
+	EXPECT_EQ(float16(1e-8f).bits, 0x0000);
+	EXPECT_EQ(float16(5.9604644775390625e-8f).bits, 0x0001);
+	// 1 + 2^-11 is halfway between 1 and the next half: ties to even.
+	EXPECT_EQ(float16(1.00048828125f).bits, 0x3c00);
+	EXPECT_EQ(float16(1.00146484375f).bits, 0x3c02);
+	EXPECT_TRUE(std::isinf(static_cast<float>(float16(std::numeric_limits<float>::infinity()))));
+	EXPECT_TRUE(std::isnan(static_cast<float>(float16(std::numeric_limits<float>::quiet_NaN()))));
+
+	EXPECT_EQ(bfloat16(1.0f).bits, 0x3f80);
+	EXPECT_EQ(bfloat16(1.00390625f).bits, 0x3f80);
+	EXPECT_EQ(bfloat16(1.01171875f).bits, 0x3f82);
+	EXPECT_TRUE(std::isnan(static_cast<float>(bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+
+	// Every finite half survives a round trip, through the scalar and the bulk conversions.
+	std::vector<float16> halves;
+	for (std::uint32_t bits = 0; bits < 0x10000u; ++bits) {
+		if ((bits & 0x7c00u) != 0x7c00u) halves.push_back(float16::from_bits(static_cast<std::uint16_t>(bits)));
+	}
+	std::vector<float> floats(halves.size());
+	std::vector<float16> back(halves.size());
+	for (auto level : { simd_level::scalar, simd_level::avx2 }) {
+		limit_simd_level(level);
+		convert_elements(halves.data(), halves.size(), floats.data());
+		convert_elements(floats.data(), floats.size(), back.data());
+		for (std::size_t i = 0; i < halves.size(); ++i) {
+			ASSERT_EQ(floats[i], static_cast<float>(halves[i]));
+			ASSERT_EQ(back[i].bits, halves[i].bits);
+		}
+	}
+	limit_simd_level(simd_level::avx512);
+}
+
+template<class H>
+void check_half_multiplication(const std::size_t rows, const std::size_t inner, const std::size_t columns)
+{
+	std::mt19937 g(42);
+	std::uniform_int_distribution<> int_dist(-8, 8);
+	matrix<H> a(rows, inner);
+	matrix<H> b(inner, columns);
+	std::generate(std::begin(a), std::end(a), [&]() { return H(static_cast<float>(int_dist(g)) / 4); });
+	std::generate(std::begin(b), std::end(b), [&]() { return H(static_cast<float>(int_dist(g)) / 4); });
+
+	matrix<float> af(rows, inner);
+	matrix<float> bf(inner, columns);
+	std::copy(std::cbegin(a), std::cend(a), std::begin(af));
+	std::copy(std::cbegin(b), std::cend(b), std::begin(bf));
+	const auto expected = naive_product<float>(af, bf);
+
+	for (auto level : { simd_level::scalar, simd_level::avx2, simd_level::avx512 }) {
+		limit_simd_level(level);
+		matrix<float> c(rows, columns);
+		multiply(matrix_execution::par, a, b, c);
+		EXPECT_TRUE(std::equal(std::cbegin(c), std::cend(c), std::cbegin(expected)));
+	}
+	limit_simd_level(simd_level::avx512);
+}
+
+TEST(MatrixFloat16, MultiplyIntoFloat) {
+	check_half_multiplication<float16>(70, 131, 45);
+	check_half_multiplication<bfloat16>(129, 64, 33);
+}
+
+template<class Q>
+void check_quantized_multiplication(const std::size_t rows, const std::size_t inner, const std::size_t columns)
+{
+	std::mt19937 g(42);
+	using values_type = typename quantized_matrix<Q>::values_type;
+	const auto a = random_matrix<values_type>(g, rows, inner, -quantized_matrix<Q>::max_value, quantized_matrix<Q>::max_value);
+	const auto b = random_matrix<values_type>(g, columns, inner, -quantized_matrix<Q>::max_value, quantized_matrix<Q>::max_value);
+	std::vector<float> a_scales(rows);
+	std::vector<float> b_scales(columns);
+	for (std::size_t i = 0; i < rows; ++i) a_scales[i] = 0.5f + static_cast<float>(i % 3);
+	for (std::size_t j = 0; j < columns; ++j) b_scales[j] = 0.25f * static_cast<float>(j % 5 + 1);
+	const quantized_matrix<Q> qa(a, a_scales);
+	const quantized_matrix<Q> qb(b, b_scales);
+	const quantized_matrix<Q> qbt(transpose(b), { 0.125f });
+
+	matrix<float> expected(rows, columns);
+	matrix<float> expected_per_tensor(rows, columns);
+	for (std::size_t i = 0; i < rows; ++i) {
+		for (std::size_t j = 0; j < columns; ++j) {
+			std::int64_t sum = 0;
+			for (std::size_t k = 0; k < inner; ++k) sum += std::int64_t{ a(i, k) } * b(j, k);
+			expected(i, j) = static_cast<float>(sum) * (a_scales[i] * b_scales[j]);
+			expected_per_tensor(i, j) = static_cast<float>(sum) * (a_scales[i] * 0.125f);
+		}
+	}
+
+	for (auto level : { simd_level::scalar, simd_level::avx2, simd_level::avx512 }) {
+		limit_simd_level(level);
+		matrix<float> c(rows, columns);
+		multiply_transposed(matrix_execution::par, qa, qb, c);
+		EXPECT_TRUE(std::equal(std::cbegin(c), std::cend(c), std::cbegin(expected)));
+		multiply(qa, qbt, c);
+		EXPECT_TRUE(std::equal(std::cbegin(c), std::cend(c), std::cbegin(expected_per_tensor)));
+	}
+	limit_simd_level(simd_level::avx512);
+
+	matrix<float> wrong(rows + 1, columns);
+	EXPECT_THROW(multiply_transposed(qa, qb, wrong), std::invalid_argument);
+	EXPECT_THROW(multiply(qa, quantized_matrix<Q>(transpose(b), std::vector<float>(inner, 1.0f)), wrong), std::invalid_argument);
+}
+
+TEST(MatrixQuantized, MultiplyMatchesIntegerProduct) {
+	check_quantized_multiplication<std::int8_t>(37, 200, 13);
+	check_quantized_multiplication<std::int8_t>(8, 64, 4);
+	check_quantized_multiplication<std::int16_t>(21, 77, 10);
+
+	// int8 dot products are exact in int32 up to 133144 terms of 127 * 127.
+	using values_type = quantized_matrix<std::int8_t>::values_type;
+	const quantized_matrix<std::int8_t> longest(values_type(1, 133144, std::int8_t{ 127 }), { 1.0f });
+	matrix<float> c(1, 1);
+	multiply_transposed(longest, longest, c);
+	EXPECT_EQ(c(0, 0), static_cast<float>(std::int64_t{ 133144 } * 127 * 127));
+	const quantized_matrix<std::int8_t> too_long(values_type(1, 133145, std::int8_t{ 127 }), { 1.0f });
+	EXPECT_THROW(multiply_transposed(too_long, too_long, c), std::invalid_argument);
+}
+
+TEST(MatrixQuantized, QuantizeAndDequantize) {
+	std::mt19937 g(42);
+	std::uniform_real_distribution<float> dist(-3.0f, 3.0f);
+	matrix<float> m(9, 50);
+	std::generate(std::begin(m), std::end(m), [&]() { return dist(g); });
+	for (std::size_t j = 0; j < m.count_columns(); ++j) m(4, j) = 0.0f;
+
+	for (auto mode : { quantization::per_row, quantization::per_tensor }) {
+		const auto q8 = quantize<std::int8_t>(m, mode);
+		const auto q16 = quantize<std::int16_t>(m, mode);
+		EXPECT_EQ(q8.mode(), mode);
+		EXPECT_EQ(q8.scales().size(), mode == quantization::per_row ? 9u : 1u);
+		const auto d8 = dequantize(q8);
+		const auto d16 = dequantize(q16);
+		for (std::size_t i = 0; i < m.count_rows(); ++i) {
+			for (std::size_t j = 0; j < m.count_columns(); ++j) {
+				EXPECT_LE(std::abs(d8(i, j) - m(i, j)), q8.scale(i) * 0.5f + 1e-6f);
+				EXPECT_LE(std::abs(d16(i, j) - m(i, j)), q16.scale(i) * 0.5f + 1e-6f);
+				EXPECT_EQ(q8(i, j), d8(i, j));
+			}
+		}
+	}
+	EXPECT_EQ(quantize<std::int8_t>(m)(4, 7), 0.0f);
+
+	// A denormal maximum has a scale whose float inverse is infinite.
+	matrix<float> tiny(1, 3, 0.0f);
+	tiny(0, 1) = 1e-40f;
+	const auto q_tiny = quantize<std::int8_t>(tiny);
+	EXPECT_EQ(q_tiny.values()(0, 0), 0);
+	EXPECT_EQ(q_tiny.values()(0, 1), 127);
+	for (const double bad : { std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(), 1e300 }) {
+		matrix<double> d(2, 2, 1.0);
+		d(1, 0) = bad;
+		EXPECT_THROW(quantize<std::int8_t>(d), std::invalid_argument);
+		EXPECT_THROW(quantize<std::int16_t>(d, quantization::per_tensor), std::invalid_argument);
+	}
+
+	using values_type = quantized_matrix<std::int8_t>::values_type;
+	EXPECT_THROW(quantized_matrix<std::int8_t>(values_type(3, 2), std::vector<float>(2, 1.0f)), std::invalid_argument);
+	EXPECT_THROW(quantized_matrix<std::int8_t>(values_type(3, 2, std::int8_t{ -128 }), { 1.0f }), std::invalid_argument);
+}
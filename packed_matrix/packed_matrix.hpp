@@ -0,0 +1,859 @@
+#pragma once
+#ifndef PACKED_MATRIX_HPP
+#define PACKED_MATRIX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../matrix/matrix.hpp"
+#include "../matrix_ops/thread_pool.hpp"
+#include "../matrix_ops/multiply.hpp"
+#include "../matrix_ops/factorization.hpp"
+#include "../matrix_ops/reductions.hpp"
+
+// Packed storage of structured matrices.
+//
+// symmetric_matrix<T> stores the lower triangle of a symmetric n x n matrix,
+// triangular_matrix<T, lower_triangle | upper_triangle> the lower or upper
+// triangle of a triangular one, n (n + 1) / 2 elements row by row instead of
+// n * n. banded_matrix<T> stores the lower_bandwidth() diagonals below the main
+// diagonal, the main diagonal and the upper_bandwidth() diagonals above it, one
+// row of lower_bandwidth() + upper_bandwidth() + 1 elements after the other.
+//
+// Every stored row is contiguous, so in each case the element (i, j) is found at
+// a row origin plus j:
+//
+//   symmetric, lower   values()[i (i + 1) / 2 + j]                    j <= i
+//   upper              values()[i n - i (i + 1) / 2 + j]              j >= i
+//   banded             values()[i (kl + ku) + kl + j]                 i - kl <= j <= i + ku
+//
+// The band positions of the first and last rows that fall outside the matrix
+// are stored as T{}.
+//
+// operator() reads any element like matrix::operator(), the elements outside
+// the triangle or the band are T{}. symmetric_matrix returns references, (i, j)
+// and (j, i) being the same element; the other two are changed with set(),
+// which throws std::out_of_range outside the structure. The kernels at the end
+// of the file (multiply_vector, multiply, solve) read each stored element once.
+
+struct lower_triangle
+{
+	static constexpr bool is_upper = false;
+};
+
+struct upper_triangle
+{
+	static constexpr bool is_upper = true;
+};
+
+namespace matrix_detail {
+
+	template<class M>
+	inline void check_square_matrix(const M& m)
+	{
+		if (m.count_rows() != m.count_columns()) {
+			throw std::invalid_argument{ "Matrix must be square" };
+		}
+	}
+
+	constexpr std::size_t packed_triangle_size(const std::size_t n) noexcept { return n * (n + 1) / 2; }
+
+	// Index of the element 0 of row i (possibly outside the triangle of an upper one).
+	constexpr std::size_t lower_row_origin(const std::size_t i) noexcept { return i * (i + 1) / 2; }
+	constexpr std::size_t upper_row_origin(const std::size_t n, const std::size_t i) noexcept { return i * n - i * (i + 1) / 2; }
+
+	// Pointers to the element 0 of every row, for views and row access.
+	template<class T, class Origin>
+	std::vector<const T*> packed_row_table(const T* values, const std::size_t rows, Origin origin)
+	{
+		std::vector<const T*> table(rows);
+		for (std::size_t i = 0; i < rows; ++i) table[i] = values + origin(i);
+		return table;
+	}
+
+} // namespace matrix_detail
+
+template<typename T, typename A = std::allocator<T>>
+struct symmetric_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+	using allocator_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
+	using value_container = std::vector<T, allocator_type>;
+
+	explicit symmetric_matrix(const allocator_type& alloc = allocator_type{})
+		: symmetric_matrix(0, T{}, alloc)
+	{}
+
+	// size x size matrix with all elements equal to 'value'.
+	explicit symmetric_matrix(const size_type size, const T& value = T{}, const allocator_type& alloc = allocator_type{})
+		: size_{ size }
+		, values_(matrix_detail::packed_triangle_size(size), value, alloc)
+	{}
+
+	// The lower triangle of a square dense matrix (matrix, fixed_matrix, ...),
+	// the upper one is not read.
+	template<class M, class = std::enable_if_t<is_matrix_container<M>::value>>
+	explicit symmetric_matrix(const M& dense, const allocator_type& alloc = allocator_type{})
+		: symmetric_matrix(dense.count_rows(), T{}, alloc)
+	{
+		matrix_detail::check_square_matrix(dense);
+		for (size_type i = 0; i < size_; ++i) {
+			const auto& src = dense[i];
+			T* dst = values_.data() + matrix_detail::lower_row_origin(i);
+			for (size_type j = 0; j <= i; ++j) dst[j] = src[j];
+		}
+	}
+
+	inline size_type count_rows() const noexcept { return size_; }
+	inline size_type count_columns() const noexcept { return size_; }
+
+	// Row by row, the elements (i, 0) to (i, i) of each row i.
+	inline const value_container& values() const noexcept { return values_; }
+	inline value_container& values() noexcept { return values_; }
+
+	allocator_type get_allocator() const { return values_.get_allocator(); }
+
+	T& operator()(const size_type row, const size_type column)
+	{
+		return values_[checked_index(row, column)];
+	}
+
+	const T& operator()(const size_type row, const size_type column) const
+	{
+		return values_[checked_index(row, column)];
+	}
+
+	// Dense copy, for any matrix type constructible as M(rows, columns).
+	template<class M = matrix<T>>
+	M to_dense() const
+	{
+		M result(size_, size_);
+		for (size_type i = 0; i < size_; ++i) {
+			const T* src = values_.data() + matrix_detail::lower_row_origin(i);
+			auto&& row = result[i];
+			for (size_type j = 0; j <= i; ++j) {
+				row[j] = src[j];
+				result[j][i] = src[j];
+			}
+		}
+		return result;
+	}
+
+private:
+	inline size_type checked_index(const size_type row, const size_type column) const
+	{
+		if (row >= size_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= size_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+		return row >= column ? matrix_detail::lower_row_origin(row) + column : matrix_detail::lower_row_origin(column) + row;
+	}
+
+	size_type size_;
+	value_container values_;
+};
+
+template<typename T, typename Tri = lower_triangle, typename A = std::allocator<T>>
+struct triangular_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+	using triangle = Tri;
+	using allocator_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
+	using value_container = std::vector<T, allocator_type>;
+
+	static constexpr bool is_upper = Tri::is_upper;
+
+	explicit triangular_matrix(const allocator_type& alloc = allocator_type{})
+		: triangular_matrix(0, T{}, alloc)
+	{}
+
+	// size x size matrix with all elements of the triangle equal to 'value'.
+	explicit triangular_matrix(const size_type size, const T& value = T{}, const allocator_type& alloc = allocator_type{})
+		: size_{ size }
+		, values_(matrix_detail::packed_triangle_size(size), value, alloc)
+	{}
+
+	// The triangle of a square dense matrix (matrix, fixed_matrix, ...), the
+	// other elements are not read.
+	template<class M, class = std::enable_if_t<is_matrix_container<M>::value>>
+	explicit triangular_matrix(const M& dense, const allocator_type& alloc = allocator_type{})
+		: triangular_matrix(dense.count_rows(), T{}, alloc)
+	{
+		matrix_detail::check_square_matrix(dense);
+		for (size_type i = 0; i < size_; ++i) {
+			const auto& src = dense[i];
+			T* dst = values_.data() + row_origin(i);
+			for (size_type j = first_column(i); j < last_column(i); ++j) dst[j] = src[j];
+		}
+	}
+
+	inline size_type count_rows() const noexcept { return size_; }
+	inline size_type count_columns() const noexcept { return size_; }
+
+	// Row by row, the elements of each row within the triangle.
+	inline const value_container& values() const noexcept { return values_; }
+	inline value_container& values() noexcept { return values_; }
+
+	allocator_type get_allocator() const { return values_.get_allocator(); }
+
+	// Columns [first_column(row), last_column(row)) of a row are stored.
+	inline size_type first_column(const size_type row) const noexcept { return is_upper ? row : 0; }
+	inline size_type last_column(const size_type row) const noexcept { return is_upper ? size_ : row + 1; }
+
+	// Element value, T{} outside the triangle.
+	T operator()(const size_type row, const size_type column) const
+	{
+		check_indices(row, column);
+		return in_triangle(row, column) ? values_[row_origin(row) + column] : T{};
+	}
+
+	void set(const size_type row, const size_type column, const T& value)
+	{
+		check_indices(row, column);
+		if (!in_triangle(row, column)) {
+			throw std::out_of_range{ "Element is outside the triangle" };
+		}
+		values_[row_origin(row) + column] = value;
+	}
+
+	// Dense copy, for any matrix type constructible as M(rows, columns).
+	template<class M = matrix<T>>
+	M to_dense() const
+	{
+		M result(size_, size_);
+		for (size_type i = 0; i < size_; ++i) {
+			const T* src = values_.data() + row_origin(i);
+			auto&& row = result[i];
+			for (size_type j = first_column(i); j < last_column(i); ++j) row[j] = src[j];
+		}
+		return result;
+	}
+
+	// values() index of the element 0 of a row.
+	inline size_type row_origin(const size_type row) const noexcept
+	{
+		return is_upper ? matrix_detail::upper_row_origin(size_, row) : matrix_detail::lower_row_origin(row);
+	}
+
+private:
+	inline bool in_triangle(const size_type row, const size_type column) const noexcept
+	{
+		return is_upper ? column >= row : column <= row;
+	}
+
+	inline void check_indices(const size_type row, const size_type column) const
+	{
+		if (row >= size_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= size_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+	}
+
+	size_type size_;
+	value_container values_;
+};
+
+template<typename T, typename A = std::allocator<T>>
+struct banded_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+	using allocator_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
+	using value_container = std::vector<T, allocator_type>;
+
+	explicit banded_matrix(const allocator_type& alloc = allocator_type{})
+		: banded_matrix(0, 0, 0, 0, alloc)
+	{}
+
+	// rows x columns matrix of zeros with 'lower' diagonals below the main one
+	// and 'upper' above it.
+	banded_matrix(const size_type rows, const size_type columns, const size_type lower, const size_type upper,
+		const allocator_type& alloc = allocator_type{})
+		: count_rows_{ rows }
+		, count_columns_{ columns }
+		, lower_{ lower }
+		, upper_{ upper }
+		, values_(rows * (lower + upper + 1), T{}, alloc)
+	{}
+
+	// The band of a dense matrix (matrix, fixed_matrix, ...), the other elements
+	// are not read.
+	template<class M, class = std::enable_if_t<is_matrix_container<M>::value>>
+	banded_matrix(const M& dense, const size_type lower, const size_type upper, const allocator_type& alloc = allocator_type{})
+		: banded_matrix(dense.count_rows(), dense.count_columns(), lower, upper, alloc)
+	{
+		for (size_type i = 0; i < count_rows_; ++i) {
+			const auto& src = dense[i];
+			T* dst = values_.data() + row_origin(i);
+			for (size_type j = first_column(i); j < last_column(i); ++j) dst[j] = src[j];
+		}
+	}
+
+	inline size_type count_rows() const noexcept { return count_rows_; }
+	inline size_type count_columns() const noexcept { return count_columns_; }
+	inline size_type lower_bandwidth() const noexcept { return lower_; }
+	inline size_type upper_bandwidth() const noexcept { return upper_; }
+	// Stored elements per row.
+	inline size_type row_width() const noexcept { return lower_ + upper_ + 1; }
+
+	// Row by row, row_width() elements from the column i - lower_bandwidth() of each row i.
+	inline const value_container& values() const noexcept { return values_; }
+	inline value_container& values() noexcept { return values_; }
+
+	allocator_type get_allocator() const { return values_.get_allocator(); }
+
+	// Columns [first_column(row), last_column(row)) of a row are in the band.
+	inline size_type first_column(const size_type row) const noexcept { return row > lower_ ? row - lower_ : 0; }
+	inline size_type last_column(const size_type row) const noexcept { return std::min(count_columns_, row + upper_ + 1); }
+
+	// Element value, T{} outside the band.
+	T operator()(const size_type row, const size_type column) const
+	{
+		check_indices(row, column);
+		return in_band(row, column) ? values_[row_origin(row) + column] : T{};
+	}
+
+	void set(const size_type row, const size_type column, const T& value)
+	{
+		check_indices(row, column);
+		if (!in_band(row, column)) {
+			throw std::out_of_range{ "Element is outside the band" };
+		}
+		values_[row_origin(row) + column] = value;
+	}
+
+	// Dense copy, for any matrix type constructible as M(rows, columns).
+	template<class M = matrix<T>>
+	M to_dense() const
+	{
+		M result(count_rows_, count_columns_);
+		for (size_type i = 0; i < count_rows_; ++i) {
+			const T* src = values_.data() + row_origin(i);
+			auto&& row = result[i];
+			for (size_type j = first_column(i); j < last_column(i); ++j) row[j] = src[j];
+		}
+		return result;
+	}
+
+	// values() index of the element 0 of a row, which is in the band only for
+	// the first rows. Band elements are at indices up to the end of the row.
+	inline size_type row_origin(const size_type row) const noexcept { return row * (lower_ + upper_) + lower_; }
+
+private:
+	inline bool in_band(const size_type row, const size_type column) const noexcept
+	{
+		return column + lower_ >= row && column <= row + upper_;
+	}
+
+	inline void check_indices(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+	}
+
+	size_type count_rows_;
+	size_type count_columns_;
+	size_type lower_;
+	size_type upper_;
+	value_container values_;
+};
+
+template<typename T, typename A = std::allocator<T>>
+using lower_triangular_matrix = triangular_matrix<T, lower_triangle, A>;
+
+template<typename T, typename A = std::allocator<T>>
+using upper_triangular_matrix = triangular_matrix<T, upper_triangle, A>;
+
+namespace matrix_detail {
+
+	// The lanes of the kernels below fill four registers, the rest of a short
+	// row (bands, first rows of a triangle) goes through one register first.
+	constexpr std::size_t single_register_lanes(const std::size_t lanes) noexcept { return lanes >= 4 ? lanes / 4 : 1; }
+
+	// Sum of a[j] * x[j] for j < count.
+	template<std::size_t Lanes, class T>
+	MATRIX_FORCE_INLINE T dot_lanes(const std::size_t count, const T* a, const T* x)
+	{
+		constexpr std::size_t Width = single_register_lanes(Lanes);
+		T lanes[Lanes] = {};
+		std::size_t j = 0;
+		for (; count - j >= Lanes; j += Lanes) {
+			MATRIX_UNROLL
+			for (std::size_t l = 0; l < Lanes; ++l) lanes[l] += a[j + l] * x[j + l];
+		}
+		for (; count - j >= Width; j += Width) {
+			MATRIX_UNROLL
+			for (std::size_t l = 0; l < Width; ++l) lanes[l] += a[j + l] * x[j + l];
+		}
+		T result = combine_lanes<Lanes>(lanes, [](const T p, const T q) { return p + q; });
+		for (; j < count; ++j) result += a[j] * x[j];
+		return result;
+	}
+
+	// One row i of a symmetric product from the lower triangle: the sum of
+	// a[j] * x[j] for the row and y[j] += a[j] * xi for the column, j < count,
+	// each a[j] loaded once.
+	template<std::size_t Lanes, class T>
+	MATRIX_FORCE_INLINE T symmetric_row_lanes(const std::size_t count, const T* a, const T* x, const T xi, T* y)
+	{
+		constexpr std::size_t Width = single_register_lanes(Lanes);
+		T lanes[Lanes] = {};
+		std::size_t j = 0;
+		for (; count - j >= Lanes; j += Lanes) {
+			MATRIX_UNROLL
+			for (std::size_t l = 0; l < Lanes; ++l) {
+				const T value = a[j + l];
+				lanes[l] += value * x[j + l];
+				y[j + l] += value * xi;
+			}
+		}
+		for (; count - j >= Width; j += Width) {
+			MATRIX_UNROLL
+			for (std::size_t l = 0; l < Width; ++l) {
+				const T value = a[j + l];
+				lanes[l] += value * x[j + l];
+				y[j + l] += value * xi;
+			}
+		}
+		T result = combine_lanes<Lanes>(lanes, [](const T p, const T q) { return p + q; });
+		for (; j < count; ++j) {
+			result += a[j] * x[j];
+			y[j] += a[j] * xi;
+		}
+		return result;
+	}
+
+	// y[i] = the band of row i of 'a' times x, for the rows [first, last).
+	template<std::size_t Lanes, class M, class T>
+	MATRIX_FORCE_INLINE void banded_rows_lanes(const M& a, const std::size_t first, const std::size_t last, const T* x, T* y)
+	{
+		const T* values = a.values().data();
+		for (std::size_t i = first; i < last; ++i) {
+			const std::size_t column = a.first_column(i);
+			const std::size_t end = a.last_column(i);
+			y[i] = column < end ? dot_lanes<Lanes>(end - column, values + a.row_origin(i) + column, x + column) : T{};
+		}
+	}
+
+	// The kernels above compiled for one instruction set, as the reduction
+	// kernels. Bands narrower than the lanes use the lanes of one register.
+#define MATRIX_PACKED_KERNELS(name, target, bytes)                                                          \
+	struct name                                                                                             \
+	{                                                                                                       \
+		template<class T>                                                                                   \
+		target static T dot(const std::size_t count, const T* a, const T* x)                                \
+		{                                                                                                   \
+			return dot_lanes<reduction_lanes<T>(bytes)>(count, a, x);                                       \
+		}                                                                                                   \
+		template<class T>                                                                                   \
+		target static T symmetric_row(const std::size_t count, const T* a, const T* x, const T xi, T* y)    \
+		{                                                                                                   \
+			return symmetric_row_lanes<reduction_lanes<T>(bytes)>(count, a, x, xi, y);                      \
+		}                                                                                                   \
+		template<class M, class T>                                                                          \
+		target static void banded_rows(const M& a, const std::size_t first, const std::size_t last,         \
+			const T* x, T* y)                                                                               \
+		{                                                                                                   \
+			constexpr std::size_t lanes = reduction_lanes<T>(bytes);                                        \
+			if (a.row_width() >= lanes) banded_rows_lanes<lanes>(a, first, last, x, y);                     \
+			else banded_rows_lanes<single_register_lanes(lanes)>(a, first, last, x, y);                     \
+		}                                                                                                   \
+	};
+
+	MATRIX_PACKED_KERNELS(packed_kernels_generic, , 64)
+#if MATRIX_X86
+	MATRIX_PACKED_KERNELS(packed_kernels_avx2, MATRIX_TARGET("avx2"), 128)
+	MATRIX_PACKED_KERNELS(packed_kernels_avx512, MATRIX_TARGET("avx512f"), 256)
+#endif
+
+#undef MATRIX_PACKED_KERNELS
+
+	// Calls v(kernels) with the kernels of the active instruction set.
+	template<class Visitor>
+	inline decltype(auto) with_packed_kernels(Visitor&& v)
+	{
+#if MATRIX_X86
+		switch (active_simd_level()) {
+		case simd_level::avx512: return v(packed_kernels_avx512{});
+		case simd_level::avx2: return v(packed_kernels_avx2{});
+		default: break;
+		}
+#endif
+		return v(packed_kernels_generic{});
+	}
+
+	// Calls f(first, last) for ranges of the n rows of a lower triangle holding
+	// about the same number of elements, in parallel according to the policy.
+	template<class ExecutionPolicy, class F>
+	void for_each_triangle_rows(const ExecutionPolicy& policy, const std::size_t n, F f)
+	{
+		const std::size_t tiles = std::min(n, std::min(4 * matrix_execution::thread_count(policy),
+			std::max<std::size_t>(1, packed_triangle_size(n) / matrix_execution::min_parallel_elements)));
+		if (tiles < 2) {
+			if (n != 0) f(std::size_t{ 0 }, n);
+			return;
+		}
+
+		// The rows before n sqrt(t / tiles) hold t / tiles of the elements.
+		const auto row_at = [n, tiles](const std::size_t tile) {
+			if (tile == tiles) return n;
+			return std::min(n, static_cast<std::size_t>(static_cast<double>(n) * std::sqrt(static_cast<double>(tile) / static_cast<double>(tiles))));
+		};
+		matrix_execution::for_each_tile(policy, 0, tiles, 1, [&](const std::size_t first_tile, const std::size_t last_tile) {
+			for (std::size_t tile = first_tile; tile < last_tile; ++tile) {
+				const std::size_t first = row_at(tile);
+				const std::size_t last = row_at(tile + 1);
+				if (first < last) f(first, last);
+			}
+		});
+	}
+
+	template<class M, class X, class Y>
+	inline void check_packed_vector_product(const M& a, const X& x, const Y& y)
+	{
+		if (std::size(x) != a.count_columns() || std::size(y) != a.count_rows()) {
+			throw std::invalid_argument{ "Matrix and vector sizes do not match" };
+		}
+		if (static_cast<const void*>(&x) == static_cast<const void*>(&y)) {
+			throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+		}
+	}
+
+	// Rows [first, first + rows) of a matrix, as a matrix.
+	template<class M>
+	struct row_range
+	{
+		using value_type = typename M::value_type;
+
+		M& m;
+		std::size_t first;
+		std::size_t rows;
+
+		inline std::size_t count_rows() const noexcept { return rows; }
+		inline std::size_t count_columns() const noexcept { return m.count_columns(); }
+		inline decltype(auto) operator[](const std::size_t row) const { return m[first + row]; }
+	};
+
+	// Rows of a symmetric matrix expanded at once for multiply().
+	constexpr std::size_t symmetric_panel_rows = 256;
+
+	// Solves the rows [first, last) of t x = b in place, in the columns
+	// [first_column, last_column) of b. The rows of x outside [first, last) must
+	// have been subtracted from b already: this is the diagonal block of a
+	// blocked solve, or the whole solve for first = 0, last = n.
+	template<class L, class B>
+	void triangular_solve_block(const L& t, B& b, const bool upper, const std::size_t first, const std::size_t last,
+		const std::size_t first_column, const std::size_t last_column)
+	{
+		using T = typename B::value_type;
+		if (!upper) {
+			for (std::size_t i = first; i < last; ++i) {
+				auto&& row = b[i];
+				const auto& coefficients = t[i];
+				for (std::size_t p = first; p < i; ++p) {
+					const T l = coefficients[p];
+					const auto& x = b[p];
+					for (std::size_t column = first_column; column < last_column; ++column) row[column] -= l * x[column];
+				}
+				const T diagonal = coefficients[i];
+				for (std::size_t column = first_column; column < last_column; ++column) row[column] /= diagonal;
+			}
+		}
+		else {
+			for (std::size_t i = last; i-- > first;) {
+				auto&& row = b[i];
+				const auto& coefficients = t[i];
+				for (std::size_t p = i + 1; p < last; ++p) {
+					const T u = coefficients[p];
+					const auto& x = b[p];
+					for (std::size_t column = first_column; column < last_column; ++column) row[column] -= u * x[column];
+				}
+				const T diagonal = coefficients[i];
+				for (std::size_t column = first_column; column < last_column; ++column) row[column] /= diagonal;
+			}
+		}
+	}
+
+	// Solves t x = b in place for a vector, one dot product of a packed row
+	// with the solved part of x per element.
+	template<class M, class T>
+	void triangular_solve_vector(const M& t, T* x)
+	{
+		const std::size_t n = t.count_rows();
+		const T* values = t.values().data();
+		with_packed_kernels([&](auto kernels) {
+			using kernels_type = decltype(kernels);
+			if constexpr (M::is_upper) {
+				for (std::size_t i = n; i-- > 0;) {
+					const T* row = values + t.row_origin(i);
+					x[i] = (x[i] - kernels_type::dot(n - i - 1, row + i + 1, x + i + 1)) / row[i];
+				}
+			}
+			else {
+				for (std::size_t i = 0; i < n; ++i) {
+					const T* row = values + t.row_origin(i);
+					x[i] = (x[i] - kernels_type::dot(i, row, x)) / row[i];
+				}
+			}
+		});
+	}
+
+	// Blocked substitution for many right-hand sides: the diagonal blocks are
+	// solved by the loops above, split between threads by columns, and the rest
+	// of b is updated by one product of blocks per diagonal block.
+	template<class ExecutionPolicy, class L, class B>
+	void triangular_solve_blocked(const ExecutionPolicy& policy, const L& t, const bool upper, B b)
+	{
+		const std::size_t n = t.count_rows();
+		const std::size_t columns = b.count_columns();
+		const std::size_t threads = matrix_execution::thread_count(policy);
+		const std::size_t grain = matrix_execution::row_grain(factorization_block * factorization_block);
+
+		const auto solve_block = [&](const std::size_t first, const std::size_t last) {
+			matrix_execution::for_each_tile(policy, 0, columns, grain, [&](const std::size_t first_column, const std::size_t last_column) {
+				triangular_solve_block(t, b, upper, first, last, first_column, last_column);
+			});
+		};
+
+		if (!upper) {
+			for (std::size_t k = 0; k < n; k += factorization_block) {
+				const std::size_t kb = std::min(factorization_block, n - k);
+				solve_block(k, k + kb);
+				if (k + kb < n) {
+					auto rest = b.block(k + kb, 0, n - k - kb, columns);
+					gemm(t.block(k + kb, k, n - k - kb, kb), b.block(k, 0, kb, columns), rest, threads, gemm_update::subtract);
+				}
+			}
+		}
+		else {
+			for (std::size_t end = n; end > 0;) {
+				const std::size_t k = (end - 1) / factorization_block * factorization_block;
+				solve_block(k, end);
+				if (k > 0) {
+					auto top = b.block(0, 0, k, columns);
+					gemm(t.block(0, k, k, end - k), b.block(k, 0, end - k, columns), top, threads, gemm_update::subtract);
+				}
+				end = k;
+			}
+		}
+	}
+
+} // namespace matrix_detail
+
+// y = a * x for vectors with contiguous elements (std::vector, std::array).
+// Each stored element is read once and used for both (i, j) and (j, i): half
+// the memory traffic of the dense product. Rows are split between threads by
+// their number of elements, each thread accumulating into its own copy of y.
+template<class ExecutionPolicy, class T, class A, class X, class Y,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_vector(const ExecutionPolicy& policy, const symmetric_matrix<T, A>& a, const X& x, Y& y)
+{
+	matrix_detail::check_packed_vector_product(a, x, y);
+	const std::size_t n = a.count_rows();
+	const T* values = a.values().data();
+	const T* xs = std::data(x);
+	T* ys = std::data(y);
+	std::fill_n(ys, n, T{});
+
+	const auto product = [values, xs](const std::size_t first, const std::size_t last, T* target) {
+		matrix_detail::with_packed_kernels([&](auto kernels) {
+			using kernels_type = decltype(kernels);
+			for (std::size_t i = first; i < last; ++i) {
+				const T* row = values + matrix_detail::lower_row_origin(i);
+				const T xi = xs[i];
+				target[i] += kernels_type::symmetric_row(i, row, xs, xi, target) + row[i] * xi;
+			}
+		});
+	};
+
+	std::mutex merge_mutex;
+	matrix_detail::for_each_triangle_rows(policy, n, [&](const std::size_t first, const std::size_t last) {
+		if (first == 0 && last == n) {
+			product(first, last, ys);
+			return;
+		}
+		std::vector<T> partial(last, T{});
+		product(first, last, partial.data());
+		std::lock_guard<std::mutex> lock{ merge_mutex };
+		for (std::size_t row = 0; row < last; ++row) {
+			ys[row] += partial[row];
+		}
+	});
+}
+
+template<class T, class A, class X, class Y>
+void multiply_vector(const symmetric_matrix<T, A>& a, const X& x, Y& y)
+{
+	multiply_vector(matrix_execution::seq, a, x, y);
+}
+
+// y = a * x for vectors with contiguous elements, a dot product of the band of
+// each row with x; rows are split between threads.
+template<class ExecutionPolicy, class T, class A, class X, class Y,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_vector(const ExecutionPolicy& policy, const banded_matrix<T, A>& a, const X& x, Y& y)
+{
+	matrix_detail::check_packed_vector_product(a, x, y);
+	const T* xs = std::data(x);
+	T* ys = std::data(y);
+
+	matrix_execution::for_each_tile(policy, 0, a.count_rows(), matrix_execution::row_grain(a.row_width()),
+		[&](const std::size_t first, const std::size_t last) {
+			matrix_detail::with_packed_kernels([&](auto kernels) {
+				decltype(kernels)::banded_rows(a, first, last, xs, ys);
+			});
+		});
+}
+
+template<class T, class A, class X, class Y>
+void multiply_vector(const banded_matrix<T, A>& a, const X& x, Y& y)
+{
+	multiply_vector(matrix_execution::seq, a, x, y);
+}
+
+// c = a * b with a dense b and c (matrix, fixed_matrix, ...). Panels of rows of
+// a are expanded from the packed triangle and multiplied by b with the kernels
+// of multiply(), so the product runs at the speed of the dense one with a
+// buffer of symmetric_panel_rows rows instead of a dense copy of a.
+template<class ExecutionPolicy, class T, class A, class MB, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy> && is_matrix_container<MB>::value>>
+void multiply(const ExecutionPolicy& policy, const symmetric_matrix<T, A>& a, const MB& b, MC& c)
+{
+	if (a.count_columns() != b.count_rows() || c.count_rows() != a.count_rows() || c.count_columns() != b.count_columns()) {
+		throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+	}
+	if (static_cast<const void*>(&c) == static_cast<const void*>(&b)) {
+		throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+	}
+
+	const std::size_t n = a.count_rows();
+	if (n == 0 || b.count_columns() == 0) return;
+	const T* values = a.values().data();
+	const std::size_t panel_rows = std::min(n, matrix_detail::symmetric_panel_rows);
+	matrix<T> panel(panel_rows, n);
+
+	for (std::size_t first = 0; first < n; first += panel_rows) {
+		const std::size_t rows = std::min(panel_rows, n - first);
+		for (std::size_t i = first; i < first + rows; ++i) {
+			const T* src = values + matrix_detail::lower_row_origin(i);
+			std::copy_n(src, i + 1, panel[i - first]);
+		}
+		// Above the diagonal, row i is column i of the lower triangle: read the
+		// rows of the triangle below the panel.
+		for (std::size_t j = first + 1; j < n; ++j) {
+			const T* src = values + matrix_detail::lower_row_origin(j);
+			for (std::size_t i = first; i < std::min(first + rows, j); ++i) panel[i - first][j] = src[i];
+		}
+
+		matrix_detail::row_range<MC> target{ c, first, rows };
+		matrix_detail::gemm(panel.block(0, 0, rows, n), b, target, matrix_execution::thread_count(policy));
+	}
+}
+
+template<class T, class A, class MB, class MC>
+void multiply(const symmetric_matrix<T, A>& a, const MB& b, MC& c)
+{
+	multiply(matrix_execution::seq, a, b, c);
+}
+
+// x with t x = b by substitution, b is a std::vector or std::array of
+// count_rows() values, or a matrix with a right-hand side in each column. Many
+// right-hand sides are solved by blocks as in lu_factorization::solve, the
+// products of blocks reading the packed rows in place. Throws
+// matrix_factorization_error if an element of the diagonal is zero.
+template<class ExecutionPolicy, class T, class Tri, class A, class B,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+B solve(const ExecutionPolicy& policy, const triangular_matrix<T, Tri, A>& t, B b)
+{
+	const std::size_t n = t.count_rows();
+	const T* values = t.values().data();
+	for (std::size_t i = 0; i < n; ++i) {
+		if (values[t.row_origin(i) + i] == T{}) {
+			throw matrix_factorization_error{ "solve error: matrix is singular" };
+		}
+	}
+
+	if constexpr (is_matrix_container<B>::value) {
+		if (b.count_rows() != n) {
+			throw std::invalid_argument{ "Matrix sizes do not match for solve" };
+		}
+		const std::size_t columns = b.count_columns();
+		if (columns < matrix_detail::blocked_solve_columns) {
+			// Few right-hand sides: each column is solved like a vector.
+			std::vector<T> x(n);
+			for (std::size_t column = 0; column < columns; ++column) {
+				for (std::size_t i = 0; i < n; ++i) x[i] = b[i][column];
+				matrix_detail::triangular_solve_vector(t, x.data());
+				for (std::size_t i = 0; i < n; ++i) b[i][column] = x[i];
+			}
+		}
+		else {
+			// The packed rows read in place as the rows of a dense matrix.
+			const auto table = matrix_detail::packed_row_table(values, n, [&t](const std::size_t i) { return t.row_origin(i); });
+			const const_matrix_view<T> rows(table.data(), n, n, 0);
+			if (n >= matrix_detail::factorization_blocked_size) {
+				matrix_detail::triangular_solve_blocked(policy, rows, Tri::is_upper, matrix_detail::view_of(b));
+			}
+			else {
+				matrix_detail::triangular_solve_block(rows, b, Tri::is_upper, 0, n, 0, columns);
+			}
+		}
+	}
+	else {
+		if (std::size(b) != n) {
+			throw std::invalid_argument{ "Vector size does not match for solve" };
+		}
+		matrix_detail::triangular_solve_vector(t, std::data(b));
+	}
+	return b;
+}
+
+template<class T, class Tri, class A, class B>
+B solve(const triangular_matrix<T, Tri, A>& t, B b)
+{
+	return solve(matrix_execution::par, t, std::move(b));
+}
+
+// y = a * x, runs on the shared thread pool when a is large enough.
+template<class T, class A, class VA>
+std::vector<T, VA> operator*(const symmetric_matrix<T, A>& a, const std::vector<T, VA>& x)
+{
+	std::vector<T, VA> y(a.count_rows(), T{}, x.get_allocator());
+	multiply_vector(matrix_execution::par, a, x, y);
+	return y;
+}
+
+template<class T, class A, class VA>
+std::vector<T, VA> operator*(const banded_matrix<T, A>& a, const std::vector<T, VA>& x)
+{
+	std::vector<T, VA> y(a.count_rows(), T{}, x.get_allocator());
+	multiply_vector(matrix_execution::par, a, x, y);
+	return y;
+}
+
+template<class T, class A, class MA, class S>
+matrix<T, MA, S> operator*(const symmetric_matrix<T, A>& a, const matrix<T, MA, S>& b)
+{
+	matrix<T, MA, S> c(a.count_rows(), b.count_columns(), T{}, b.get_allocator());
+	multiply(matrix_execution::par, a, b, c);
+	return c;
+}
+
+#endif // !PACKED_MATRIX_HPP
@@ -0,0 +1,450 @@
+#pragma once
+#ifndef SPARSE_MATRIX_HPP
+#define SPARSE_MATRIX_HPP
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../matrix/matrix.hpp"
+#include "../matrix_ops/thread_pool.hpp"
+
+// Compressed storage formats for sparse_matrix<T, F, A>.
+//
+// csr_format keeps the non-zero elements row by row (compressed sparse rows),
+// csc_format column by column (compressed sparse columns). The "major" lines are
+// the rows for CSR and the columns for CSC: offsets()[i]..offsets()[i + 1] is the
+// range of indices() (the minor index of every element, ascending within a line)
+// and values() belonging to the major line i.
+struct csr_format
+{
+	static constexpr bool is_row_major = true;
+};
+
+struct csc_format
+{
+	static constexpr bool is_row_major = false;
+};
+
+// An element of a matrix in coordinate (COO) form.
+template<class T>
+struct sparse_triplet
+{
+	std::size_t row;
+	std::size_t column;
+	T value;
+};
+
+template<typename T, typename F = csr_format, typename A = std::allocator<T>>
+struct sparse_matrix
+{
+	using value_type = T;
+	using size_type = std::size_t;
+	using format = F;
+	using allocator_type = typename std::allocator_traits<A>::template rebind_alloc<T>;
+	using index_allocator = typename std::allocator_traits<A>::template rebind_alloc<size_type>;
+
+	using value_container = std::vector<T, allocator_type>;
+	using index_container = std::vector<size_type, index_allocator>;
+
+	static constexpr bool is_row_major = F::is_row_major;
+
+	explicit sparse_matrix(const allocator_type& alloc = allocator_type{})
+		: sparse_matrix(0, 0, alloc)
+	{}
+
+	// rows x columns matrix of zeros.
+	sparse_matrix(const size_type rows, const size_type columns, const allocator_type& alloc = allocator_type{})
+		: count_rows_{ rows }
+		, count_columns_{ columns }
+		, offsets_(major(rows, columns) + 1, 0, index_allocator(alloc))
+		, indices_(index_allocator(alloc))
+		, values_(alloc)
+	{}
+
+	// Builds the matrix from (row, column, value) triplets in any order, values of
+	// duplicate coordinates are summed. Takes O(nonzeros + rows + columns) apart from
+	// sorting the elements within each line.
+	template<class Triplets>
+	sparse_matrix(const size_type rows, const size_type columns, const Triplets& triplets, const allocator_type& alloc = allocator_type{})
+		: sparse_matrix(rows, columns, alloc)
+	{
+		const size_type count = static_cast<size_type>(std::distance(std::begin(triplets), std::end(triplets)));
+		for (const auto& triplet : triplets) {
+			if (triplet.row >= count_rows_ || triplet.column >= count_columns_) {
+				throw std::out_of_range{ "Triplet index is out of range" };
+			}
+			++offsets_[major_index(triplet) + 1];
+		}
+		for (size_type line = 0; line < major_count(); ++line) {
+			offsets_[line + 1] += offsets_[line];
+		}
+
+		indices_.resize(count);
+		values_.resize(count);
+		{
+			index_container next(offsets_.begin(), offsets_.end() - 1, offsets_.get_allocator());
+			for (const auto& triplet : triplets) {
+				const size_type position = next[major_index(triplet)]++;
+				indices_[position] = minor_index(triplet);
+				values_[position] = triplet.value;
+			}
+		}
+		sort_and_merge_lines();
+	}
+	sparse_matrix(const size_type rows, const size_type columns, std::initializer_list<sparse_triplet<T>> triplets,
+		const allocator_type& alloc = allocator_type{})
+		: sparse_matrix(rows, columns, std::vector<sparse_triplet<T>>(triplets), alloc)
+	{}
+
+	// Keeps the elements of a dense matrix (matrix, fixed_matrix, ...) that are
+	// not equal to T{}.
+	template<class M, class = std::enable_if_t<is_matrix_container<M>::value>>
+	explicit sparse_matrix(const M& dense, const allocator_type& alloc = allocator_type{})
+		: sparse_matrix(dense.count_rows(), dense.count_columns(), alloc)
+	{
+		for (size_type line = 0; line < major_count(); ++line) {
+			for (size_type index = 0; index < minor_count(); ++index) {
+				const T& value = is_row_major ? dense[line][index] : dense[index][line];
+				if (value != T{}) {
+					indices_.push_back(index);
+					values_.push_back(value);
+				}
+			}
+			offsets_[line + 1] = indices_.size();
+		}
+	}
+
+	// Converts between CSR and CSC.
+	template<class OtherFormat, class = std::enable_if_t<!std::is_same_v<OtherFormat, F>>>
+	explicit sparse_matrix(const sparse_matrix<T, OtherFormat, A>& other)
+		: sparse_matrix(other.count_rows(), other.count_columns(), other.values().get_allocator())
+	{
+		const auto& other_offsets = other.offsets();
+		const auto& other_indices = other.indices();
+		const auto& other_values = other.values();
+
+		for (const size_type index : other_indices) {
+			++offsets_[index + 1];
+		}
+		for (size_type line = 0; line < major_count(); ++line) {
+			offsets_[line + 1] += offsets_[line];
+		}
+
+		indices_.resize(other_indices.size());
+		values_.resize(other_values.size());
+		index_container next(offsets_.begin(), offsets_.end() - 1, offsets_.get_allocator());
+		// The other major lines are visited in order, so the minor indices come out sorted.
+		for (size_type other_line = 0; other_line + 1 < other_offsets.size(); ++other_line) {
+			for (size_type k = other_offsets[other_line]; k < other_offsets[other_line + 1]; ++k) {
+				const size_type position = next[other_indices[k]]++;
+				indices_[position] = other_line;
+				values_[position] = other_values[k];
+			}
+		}
+	}
+
+	inline size_type count_rows() const noexcept { return count_rows_; }
+	inline size_type count_columns() const noexcept { return count_columns_; }
+	inline size_type count_nonzeros() const noexcept { return values_.size(); }
+
+	inline const index_container& offsets() const noexcept { return offsets_; }
+	inline const index_container& indices() const noexcept { return indices_; }
+	inline const value_container& values() const noexcept { return values_; }
+	// The structure is fixed, the stored values may be changed in place.
+	inline value_container& values() noexcept { return values_; }
+
+	allocator_type get_allocator() const { return values_.get_allocator(); }
+
+	// Element value, T{} if the element is not stored. O(log(nonzeros in the line)).
+	T operator()(const size_type row, const size_type column) const
+	{
+		if (row >= count_rows_) {
+			throw std::out_of_range{ "Row index is out of range" };
+		}
+		if (column >= count_columns_) {
+			throw std::out_of_range{ "Column index is out of range" };
+		}
+
+		const size_type line = is_row_major ? row : column;
+		const size_type index = is_row_major ? column : row;
+		const auto first = indices_.begin() + offsets_[line];
+		const auto last = indices_.begin() + offsets_[line + 1];
+		const auto it = std::lower_bound(first, last, index);
+		return (it != last && *it == index) ? values_[it - indices_.begin()] : T{};
+	}
+
+	// Dense copy, for any matrix type constructible as M(rows, columns).
+	template<class M = matrix<T>>
+	M to_dense() const
+	{
+		M result(count_rows_, count_columns_);
+		for (size_type line = 0; line < major_count(); ++line) {
+			for (size_type k = offsets_[line]; k < offsets_[line + 1]; ++k) {
+				if constexpr (is_row_major) result[line][indices_[k]] = values_[k];
+				else result[indices_[k]][line] = values_[k];
+			}
+		}
+		return result;
+	}
+
+private:
+	static constexpr size_type major(const size_type rows, const size_type columns) noexcept { return is_row_major ? rows : columns; }
+
+	inline size_type major_count() const noexcept { return major(count_rows_, count_columns_); }
+	inline size_type minor_count() const noexcept { return is_row_major ? count_columns_ : count_rows_; }
+
+	template<class Triplet>
+	static inline size_type major_index(const Triplet& triplet) noexcept { return is_row_major ? triplet.row : triplet.column; }
+	template<class Triplet>
+	static inline size_type minor_index(const Triplet& triplet) noexcept { return is_row_major ? triplet.column : triplet.row; }
+
+	// Sorts every line by the minor index and sums the duplicates, compacting the arrays.
+	void sort_and_merge_lines()
+	{
+		std::vector<std::pair<size_type, T>> line_elements;
+		size_type write = 0;
+		size_type line_begin = 0;
+		for (size_type line = 0; line < major_count(); ++line) {
+			const size_type line_end = offsets_[line + 1];
+			if (!std::is_sorted(indices_.begin() + line_begin, indices_.begin() + line_end)) {
+				line_elements.clear();
+				for (size_type k = line_begin; k < line_end; ++k) {
+					line_elements.emplace_back(indices_[k], std::move(values_[k]));
+				}
+				std::stable_sort(line_elements.begin(), line_elements.end(),
+					[](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+				for (size_type k = line_begin; k < line_end; ++k) {
+					indices_[k] = line_elements[k - line_begin].first;
+					values_[k] = std::move(line_elements[k - line_begin].second);
+				}
+			}
+
+			const size_type line_write = write;
+			for (size_type k = line_begin; k < line_end; ++k) {
+				if (write != line_write && indices_[write - 1] == indices_[k]) {
+					values_[write - 1] += values_[k];
+				}
+				else {
+					if (write != k) {
+						indices_[write] = indices_[k];
+						values_[write] = std::move(values_[k]);
+					}
+					++write;
+				}
+			}
+			line_begin = line_end;
+			offsets_[line + 1] = write;
+		}
+		indices_.resize(write);
+		values_.erase(values_.begin() + write, values_.end());
+	}
+
+	size_type count_rows_;
+	size_type count_columns_;
+
+	index_container offsets_;
+	index_container indices_;
+	value_container values_;
+};
+
+namespace matrix_detail {
+
+	// Calls f(first, last) for ranges of major lines holding about the same number
+	// of non-zero elements, in parallel according to the policy.
+	template<class ExecutionPolicy, class Offsets, class F>
+	void for_each_balanced_lines(const ExecutionPolicy& policy, const Offsets& offsets, const std::size_t work_per_element, F f)
+	{
+		const std::size_t lines = offsets.size() - 1;
+		const std::size_t work = (offsets.back() + lines) * std::max<std::size_t>(work_per_element, 1);
+		const std::size_t tiles = std::min(lines, std::min(4 * matrix_execution::thread_count(policy),
+			std::max<std::size_t>(1, work / matrix_execution::min_parallel_elements)));
+		if (tiles < 2) {
+			if (lines != 0) f(std::size_t{ 0 }, lines);
+			return;
+		}
+
+		// A line weighs its number of elements plus one, tile t starts at the first
+		// line with t/tiles of the total weight before it.
+		const std::size_t total = offsets.back() + lines;
+		const auto line_at = [&offsets, lines, total, tiles](const std::size_t tile) {
+			const std::size_t target = total * tile / tiles;
+			std::size_t low = 0;
+			std::size_t high = lines;
+			while (low < high) {
+				const std::size_t middle = low + (high - low) / 2;
+				if (offsets[middle] + middle < target) low = middle + 1;
+				else high = middle;
+			}
+			return low;
+		};
+		matrix_execution::for_each_tile(policy, 0, tiles, 1, [&](const std::size_t first_tile, const std::size_t last_tile) {
+			for (std::size_t tile = first_tile; tile < last_tile; ++tile) {
+				const std::size_t first = line_at(tile);
+				const std::size_t last = line_at(tile + 1);
+				if (first < last) f(first, last);
+			}
+		});
+	}
+
+	template<class M, class X, class Y>
+	inline void check_sparse_vector_product(const M& a, const X& x, const Y& y)
+	{
+		if (x.size() != a.count_columns() || y.size() != a.count_rows()) {
+			throw std::invalid_argument{ "Matrix and vector sizes do not match" };
+		}
+	}
+
+} // namespace matrix_detail
+
+// y = a * x for vectors with size() and operator[] (std::vector, std::array, ...).
+// CSR rows are split between threads by their number of non-zero elements. CSC
+// columns scatter into y, so each thread accumulates into its own copy of y.
+template<class ExecutionPolicy, class T, class F, class A, class X, class Y,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy>>>
+void multiply_vector(const ExecutionPolicy& policy, const sparse_matrix<T, F, A>& a, const X& x, Y& y)
+{
+	matrix_detail::check_sparse_vector_product(a, x, y);
+	if (static_cast<const void*>(&x) == static_cast<const void*>(&y)) {
+		throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+	}
+
+	const auto& offsets = a.offsets();
+	const auto& indices = a.indices();
+	const auto& values = a.values();
+
+	if constexpr (F::is_row_major) {
+		matrix_detail::for_each_balanced_lines(policy, offsets, 1, [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = first; row < last; ++row) {
+				T sum{};
+				for (std::size_t k = offsets[row]; k < offsets[row + 1]; ++k) {
+					sum += values[k] * x[indices[k]];
+				}
+				y[row] = sum;
+			}
+		});
+	}
+	else {
+		const std::size_t rows = a.count_rows();
+		for (std::size_t row = 0; row < rows; ++row) {
+			y[row] = T{};
+		}
+
+		const auto scatter = [&](const std::size_t first, const std::size_t last, auto& target) {
+			for (std::size_t column = first; column < last; ++column) {
+				const T xc = x[column];
+				for (std::size_t k = offsets[column]; k < offsets[column + 1]; ++k) {
+					target[indices[k]] += values[k] * xc;
+				}
+			}
+		};
+
+		std::mutex merge_mutex;
+		matrix_detail::for_each_balanced_lines(policy, offsets, 1, [&](const std::size_t first, const std::size_t last) {
+			if (first == 0 && last == a.count_columns()) {
+				scatter(first, last, y);
+				return;
+			}
+			std::vector<T> partial(rows, T{});
+			scatter(first, last, partial);
+			std::lock_guard<std::mutex> lock{ merge_mutex };
+			for (std::size_t row = 0; row < rows; ++row) {
+				y[row] += partial[row];
+			}
+		});
+	}
+}
+
+template<class T, class F, class A, class X, class Y>
+void multiply_vector(const sparse_matrix<T, F, A>& a, const X& x, Y& y)
+{
+	multiply_vector(matrix_execution::seq, a, x, y);
+}
+
+// c = a * b with a dense b and c (matrix, fixed_matrix, ...). CSR rows are split
+// between threads like in multiply_vector, CSC products are split by columns of c.
+template<class ExecutionPolicy, class T, class F, class A, class MB, class MC,
+	class = std::enable_if_t<matrix_execution::is_execution_policy_v<ExecutionPolicy> && is_matrix_container<MB>::value>>
+void multiply(const ExecutionPolicy& policy, const sparse_matrix<T, F, A>& a, const MB& b, MC& c)
+{
+	if (a.count_columns() != b.count_rows() || c.count_rows() != a.count_rows() || c.count_columns() != b.count_columns()) {
+		throw std::invalid_argument{ "Matrix sizes do not match for multiplication" };
+	}
+	if (static_cast<const void*>(&c) == static_cast<const void*>(&b)) {
+		throw std::invalid_argument{ "Result of multiplication must not refer to an operand" };
+	}
+
+	const auto& offsets = a.offsets();
+	const auto& indices = a.indices();
+	const auto& values = a.values();
+	const std::size_t columns = b.count_columns();
+	if (columns == 0) return;
+
+	if constexpr (F::is_row_major) {
+		matrix_detail::for_each_balanced_lines(policy, offsets, columns, [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = first; row < last; ++row) {
+				auto&& dst = c[row];
+				for (std::size_t j = 0; j < columns; ++j) dst[j] = T{};
+				for (std::size_t k = offsets[row]; k < offsets[row + 1]; ++k) {
+					const T value = values[k];
+					const auto& src = b[indices[k]];
+					for (std::size_t j = 0; j < columns; ++j) {
+						dst[j] += value * src[j];
+					}
+				}
+			}
+		});
+	}
+	else {
+		const std::size_t rows = a.count_rows();
+		const std::size_t work = (a.count_nonzeros() + rows) * columns;
+		const std::size_t grain = std::max<std::size_t>(8, columns * matrix_execution::min_parallel_elements / std::max<std::size_t>(work, 1));
+		matrix_execution::for_each_tile(policy, 0, columns, grain, [&](const std::size_t first, const std::size_t last) {
+			for (std::size_t row = 0; row < rows; ++row) {
+				auto&& dst = c[row];
+				for (std::size_t j = first; j < last; ++j) dst[j] = T{};
+			}
+			for (std::size_t column = 0; column + 1 < offsets.size(); ++column) {
+				const auto& src = b[column];
+				for (std::size_t k = offsets[column]; k < offsets[column + 1]; ++k) {
+					const T value = values[k];
+					auto&& dst = c[indices[k]];
+					for (std::size_t j = first; j < last; ++j) {
+						dst[j] += value * src[j];
+					}
+				}
+			}
+		});
+	}
+}
+
+// y = a * x, runs on the shared thread pool when a is large enough.
+template<class T, class F, class A, class VA>
+std::vector<T, VA> operator*(const sparse_matrix<T, F, A>& a, const std::vector<T, VA>& x)
+{
+	std::vector<T, VA> y(a.count_rows(), T{}, x.get_allocator());
+	multiply_vector(matrix_execution::par, a, x, y);
+	return y;
+}
+
+template<class T, class F, class A, class MA, class S>
+matrix<T, MA, S> operator*(const sparse_matrix<T, F, A>& a, const matrix<T, MA, S>& b)
+{
+	matrix<T, MA, S> c(a.count_rows(), b.count_columns(), T{}, b.get_allocator());
+	multiply(matrix_execution::par, a, b, c);
+	return c;
+}
+
+template<typename T, typename A = std::allocator<T>>
+using csr_matrix = sparse_matrix<T, csr_format, A>;
+
+template<typename T, typename A = std::allocator<T>>
+using csc_matrix = sparse_matrix<T, csc_format, A>;
+
+#endif // !SPARSE_MATRIX_HPP